@@ -1,6 +1,7 @@
 #pragma once
 
 #define ANALOG_SCOPE_PACKET_RECV_SIZE (1024 * 1024)
+#define ANALOG_SCOPE_SAMPLES_MAX (1024 * 1024 * 1024)
 
 struct ldiAnalogScope {
 	ldiApp* appContext;
@@ -19,11 +20,11 @@ struct ldiAnalogScope {
 	int32_t					recvTempPos = 0;
 
 	// Shared data.
-	std::mutex				samplesLockMutex;
-	uint8_t*				samples;
-	std::atomic_int			sampleCount;
+	ldiRingBuffer			sampleRing;
 
 	// Main thread only.
+	uint8_t*				samples;
+	int						sampleCount;
 	float					samplesF[1024 * 1024];
 };
 
@@ -46,21 +47,24 @@ void analogScopeWorkerThread(ldiAnalogScope* Scope) {
 		std::cout << "Got connection\n";
 
 		while (Scope->serialPortConnected) {
+			int waitResult = serialPortWaitForData(&Scope->serialPort, 100);
+
+			if (waitResult == -1) {
+				analogScopeDisconnect(Scope);
+				break;
+			} else if (waitResult == 0) {
+				continue;
+			}
+
 			Scope->recvTempSize = serialPortReadData(&Scope->serialPort, Scope->recvTemp, ANALOG_SCOPE_PACKET_RECV_SIZE);
 			Scope->recvTempPos = 0;
 
 			if (Scope->recvTempSize == -1) {
 				analogScopeDisconnect(Scope);
 				break;
-			} else if (Scope->recvTempSize == 0) {
-				// TODO: I hate this :(. Find a better way.
-				Sleep(1);
-			} else {
-
-				//std::unique_lock<std::mutex> lock(Scope->samplesLockMutex);
-				memcpy(Scope->samples + Scope->sampleCount, Scope->recvTemp, Scope->recvTempSize);
-				Scope->sampleCount += Scope->recvTempSize;
-				//std::cout << "Got data: " << Scope->sampleCount << " " << Scope->recvTempSize << "\n";
+			} else if (Scope->recvTempSize > 0) {
+				// NOTE: Samples that don't fit are dropped and counted in the ring overflow.
+				ringBufferWrite(&Scope->sampleRing, Scope->recvTemp, Scope->recvTempSize);
 			}
 		}
 	}
@@ -70,11 +74,15 @@ void analogScopeWorkerThread(ldiAnalogScope* Scope) {
 
 int analogScopeInit(ldiApp* AppContext, ldiAnalogScope* Scope) {
 	Scope->appContext = AppContext;
-	Scope->workerThread = std::thread(analogScopeWorkerThread, Scope);
 
-	Scope->samples = new uint8_t[1024 * 1024 * 1024];
+	// NOTE: ~500000 samples per second, so the ring holds ~8 seconds of data if the UI stalls.
+	ringBufferInit(&Scope->sampleRing, 1, 4 * 1024 * 1024);
+
+	Scope->samples = new uint8_t[ANALOG_SCOPE_SAMPLES_MAX];
 	Scope->sampleCount = 0;
 
+	Scope->workerThread = std::thread(analogScopeWorkerThread, Scope);
+
 	return 1;
 }
 
@@ -94,13 +102,32 @@ void analogScopeDestroy(ldiAnalogScope* Scope) {
 	analogScopeDisconnect(Scope);
 
 	Scope->workerThreadRunning = false;
+	Scope->serialPortConnectCondVar.notify_all();
 	Scope->workerThread.join();
+
+	ringBufferDestroy(&Scope->sampleRing);
+	delete[] Scope->samples;
+}
+
+// Move everything the worker thread has published into the main thread sample history.
+void analogScopeUpdate(ldiAnalogScope* Scope) {
+	int64_t space = ANALOG_SCOPE_SAMPLES_MAX - Scope->sampleCount;
+
+	if (space > 0) {
+		Scope->sampleCount += (int)ringBufferRead(&Scope->sampleRing, Scope->samples + Scope->sampleCount, space);
+	} else {
+		// NOTE: History is full, discard incoming samples.
+		ringBufferSkipTo(&Scope->sampleRing, Scope->sampleRing.writeCursor.load());
+	}
 }
 
 void analogScopeShowUi(ldiAnalogScope* Scope) {
+	analogScopeUpdate(Scope);
+
 	if (ImGui::Begin("Analog scope", 0, ImGuiWindowFlags_NoCollapse)) {
 		int sampleTotal = Scope->sampleCount;
 		ImGui::Text("Samples: %d", sampleTotal);
+		ImGui::Text("Dropped: %lld", Scope->sampleRing.overflowCount.load());
 
 		static int lastTriggerIndex = 0;
 
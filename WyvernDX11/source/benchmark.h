@@ -0,0 +1,946 @@
+#pragma once
+
+#include <algorithm>
+
+//----------------------------------------------------------------------------------------------------
+// Geometry pipeline benchmarks.
+//----------------------------------------------------------------------------------------------------
+// Run headless with: WyvernDX11.exe -benchmark [output.json]
+//
+// Meshes and textures are generated procedurally so results don't depend on customer parts. Every
+// stage is timed over several mesh sizes with warmup runs discarded. Results are written as JSON,
+// including a scaling exponent between consecutive sizes (1.0 = linear) to catch super-linear stages.
+//
+// Panther and Hawk receive paths are timed against the device simulators in deviceSim.h.
+
+#define BENCH_SAMPLES_PER_SIDE 4
+// NOTE: Roughly the surfel edge length produced by the voxel remesh in project units.
+#define BENCH_QUAD_EDGE 0.01f
+
+struct ldiBenchMesh {
+	std::string		name;
+	ldiQuadModel	quadModel;
+	// NOTE: Triangulated copy of the quads with UVs, used as the source model for color transfer.
+	ldiModel		model;
+};
+
+struct ldiBenchResult {
+	std::string		stage;
+	std::string		mesh;
+	int				size;
+	int64_t			items;
+	int				repeats;
+	double			minTime;
+	double			maxTime;
+	double			meanTime;
+	double			medianTime;
+	double			stdDev;
+	bool			hasScaling;
+	double			scaling;
+};
+
+struct ldiBenchTimer {
+	int					warmup;
+	int					repeats;
+	int					run;
+	std::vector<double>	samples;
+	double				startTime;
+};
+
+struct ldiBenchmark {
+	int							warmup = 1;
+	int							repeats = 5;
+	std::vector<int>			meshSizes = { 32, 64, 128, 256 };
+	std::vector<int>			voxelSizes = { 8, 16, 24, 32 };
+	int							textureSize = 2048;
+	// NOTE: Camera frame widths, heights keep the sensor aspect.
+	std::vector<int>			frameSizes = { 820, 1640, 3280 };
+	int							deviceMoveCount = 100;
+	int							deviceFrameCount = 30;
+	std::vector<ldiBenchResult>	results;
+};
+
+//----------------------------------------------------------------------------------------------------
+// Synthetic meshes.
+//----------------------------------------------------------------------------------------------------
+inline float _benchHash(int X, int Y, int Seed) {
+	uint32_t h = (uint32_t)X * 374761393u + (uint32_t)Y * 668265263u + (uint32_t)Seed * 2246822519u;
+	h = (h ^ (h >> 13)) * 1274126177u;
+	h = h ^ (h >> 16);
+
+	return (float)(h & 0xFFFFFF) / (float)0xFFFFFF;
+}
+
+int _benchAddVertex(ldiBenchMesh* Mesh, vec3 Position, vec2 Uv) {
+	int idx = (int)Mesh->quadModel.verts.size();
+	Mesh->quadModel.verts.push_back(Position);
+
+	ldiMeshVertex vert = {};
+	vert.pos = Position;
+	vert.uv = Uv;
+	Mesh->model.verts.push_back(vert);
+
+	return idx;
+}
+
+// NOTE: Expects counter clockwise winding when viewed from outside. Triangles match convertQuadToTriModel.
+void _benchAddQuad(ldiBenchMesh* Mesh, int V0, int V1, int V2, int V3) {
+	Mesh->quadModel.indices.push_back(V0);
+	Mesh->quadModel.indices.push_back(V1);
+	Mesh->quadModel.indices.push_back(V2);
+	Mesh->quadModel.indices.push_back(V3);
+
+	Mesh->model.indices.push_back(V3);
+	Mesh->model.indices.push_back(V1);
+	Mesh->model.indices.push_back(V0);
+	Mesh->model.indices.push_back(V2);
+	Mesh->model.indices.push_back(V1);
+	Mesh->model.indices.push_back(V3);
+}
+
+// Box with each face subdivided into quads. When Spherize is set the box becomes a cube sphere of
+// radius HalfSize.x. Each face gets its own tile of a 3x2 UV atlas.
+void _benchAppendBox(ldiBenchMesh* Mesh, vec3 Center, vec3 HalfSize, ivec3 Segments, bool Spherize) {
+	// NOTE: Axes chosen so cross(U, V) points out of the face.
+	const int faceAxis[6][3] = {
+		{ 0, 1, 2 }, { 0, 2, 1 },
+		{ 1, 2, 0 }, { 1, 0, 2 },
+		{ 2, 0, 1 }, { 2, 1, 0 },
+	};
+
+	for (int f = 0; f < 6; ++f) {
+		float sign = (f % 2 == 0) ? 1.0f : -1.0f;
+		int nAxis = faceAxis[f][0];
+		int uAxis = faceAxis[f][1];
+		int vAxis = faceAxis[f][2];
+
+		int segU = Segments[uAxis];
+		int segV = Segments[vAxis];
+		vec2 tileMin((f % 3) / 3.0f, (f / 3) / 2.0f);
+		int baseIdx = (int)Mesh->quadModel.verts.size();
+
+		for (int iV = 0; iV <= segV; ++iV) {
+			for (int iU = 0; iU <= segU; ++iU) {
+				float s = (float)iU / (float)segU;
+				float t = (float)iV / (float)segV;
+
+				vec3 p(0.0f);
+				p[nAxis] = sign;
+				p[uAxis] = s * 2.0f - 1.0f;
+				p[vAxis] = t * 2.0f - 1.0f;
+
+				if (Spherize) {
+					p = glm::normalize(p) * HalfSize.x;
+				} else {
+					p *= HalfSize;
+				}
+
+				vec2 uv = tileMin + vec2(s / 3.0f, t / 2.0f);
+				_benchAddVertex(Mesh, Center + p, uv);
+			}
+		}
+
+		for (int iV = 0; iV < segV; ++iV) {
+			for (int iU = 0; iU < segU; ++iU) {
+				int v0 = baseIdx + iU + iV * (segU + 1);
+				int v1 = v0 + 1;
+				int v2 = v1 + (segU + 1);
+				int v3 = v0 + (segU + 1);
+
+				_benchAddQuad(Mesh, v0, v1, v2, v3);
+			}
+		}
+	}
+}
+
+// Subdivided cube sphere, Size quads along each face edge.
+void benchCreateSphere(ldiBenchMesh* Mesh, int Size) {
+	Mesh->name = "sphere";
+	float radius = (Size * BENCH_QUAD_EDGE) / (float)(M_PI * 0.5);
+	_benchAppendBox(Mesh, vec3(0.0f), vec3(radius), ivec3(Size), true);
+}
+
+// Torus with multi frequency surface noise and per vertex jitter. Size quads around the minor ring.
+void benchCreateNoisyTorus(ldiBenchMesh* Mesh, int Size) {
+	Mesh->name = "noisyTorus";
+
+	const int segMajor = Size * 4;
+	const int segMinor = Size;
+	const float minorRadius = (segMinor * BENCH_QUAD_EDGE) / (float)(M_PI * 2.0);
+	const float majorRadius = (segMajor * BENCH_QUAD_EDGE) / (float)(M_PI * 2.0);
+	const float noiseAmp = minorRadius * 0.15f;
+	const float jitterAmp = BENCH_QUAD_EDGE * 0.1f;
+
+	for (int iU = 0; iU < segMajor; ++iU) {
+		for (int iV = 0; iV < segMinor; ++iV) {
+			float theta = (float)iU / segMajor * (float)(M_PI * 2.0);
+			float phi = (float)iV / segMinor * (float)(M_PI * 2.0);
+
+			float noise = sinf(7 * theta + 3 * phi) * 0.5f + sinf(13 * theta - 5 * phi + 1.3f) * 0.3f + sinf(29 * theta + 11 * phi) * 0.2f;
+			float r = minorRadius + noise * noiseAmp + (_benchHash(iU, iV, 1) - 0.5f) * jitterAmp;
+
+			vec3 p;
+			p.x = (majorRadius + r * cosf(phi)) * cosf(theta);
+			p.y = r * sinf(phi);
+			p.z = (majorRadius + r * cosf(phi)) * sinf(theta);
+
+			_benchAddVertex(Mesh, p, vec2((float)iU / segMajor, (float)iV / segMinor));
+		}
+	}
+
+	for (int iU = 0; iU < segMajor; ++iU) {
+		for (int iV = 0; iV < segMinor; ++iV) {
+			int nU = (iU + 1) % segMajor;
+			int nV = (iV + 1) % segMinor;
+
+			_benchAddQuad(Mesh, iU * segMinor + iV, iU * segMinor + nV, nU * segMinor + nV, nU * segMinor + iV);
+		}
+	}
+}
+
+// Cube sphere body with thin fins thinner than the transfer ray offset and the surfel grid cell.
+void benchCreateThinFeatures(ldiBenchMesh* Mesh, int Size) {
+	Mesh->name = "thinFeatures";
+
+	const float radius = (Size * BENCH_QUAD_EDGE) / (float)(M_PI * 0.5);
+	_benchAppendBox(Mesh, vec3(0.0f), vec3(radius), ivec3(Size), true);
+
+	const int finCount = 6;
+	const float finThickness = 0.002f;
+	const float finLength = radius * 0.75f;
+	const float finHeight = radius * 0.25f;
+	const int segLength = max(1, (int)(finLength * 2.0f / BENCH_QUAD_EDGE));
+	const int segHeight = max(1, (int)(finHeight * 2.0f / BENCH_QUAD_EDGE));
+
+	for (int i = 0; i < finCount; ++i) {
+		float angle = (float)i / finCount * (float)(M_PI * 2.0);
+		vec3 center(cosf(angle) * radius * 1.5f, (i - finCount / 2) * radius * 0.1f, sinf(angle) * radius * 1.5f);
+
+		// NOTE: Alternate orientations so fins are thin along every axis.
+		vec3 halfSize;
+		ivec3 segments;
+
+		switch (i % 3) {
+			case 0: halfSize = vec3(finThickness, finHeight, finLength); segments = ivec3(1, segHeight, segLength); break;
+			case 1: halfSize = vec3(finLength, finThickness, finHeight); segments = ivec3(segLength, 1, segHeight); break;
+			default: halfSize = vec3(finHeight, finLength, finThickness); segments = ivec3(segHeight, segLength, 1); break;
+		}
+
+		_benchAppendBox(Mesh, center, halfSize, segments, false);
+	}
+}
+
+// RGBA texture with checker, gradient and noise so bilinear sampling sees real variation.
+void benchCreateTexture(ldiImage* Image, int Size) {
+	Image->width = Size;
+	Image->height = Size;
+	Image->data = new uint8_t[Size * Size * 4];
+
+	for (int iY = 0; iY < Size; ++iY) {
+		for (int iX = 0; iX < Size; ++iX) {
+			int checker = ((iX / 64) + (iY / 64)) & 1;
+			float noise = _benchHash(iX, iY, 7);
+			uint8_t* p = &Image->data[(iX + iY * Size) * 4];
+
+			p[0] = (uint8_t)(checker * 200 + noise * 55);
+			p[1] = (uint8_t)((iX * 255) / Size);
+			p[2] = (uint8_t)((iY * 255) / Size);
+			p[3] = (uint8_t)(noise * 255);
+		}
+	}
+}
+
+// Same blend of shapes the model editor uses, scaled to the grid.
+float _benchVoxelSdf(vec3 Pos, void* UserData) {
+	ldiVoxelGrid* grid = (ldiVoxelGrid*)UserData;
+
+	float hX = grid->cellSizeX * 0.5f;
+	float hY = grid->cellSizeY * 0.5f;
+	float hZ = grid->cellSizeZ * 0.5f;
+	float scale = grid->cellSizeX / 256.0f;
+
+	float dist = glm::length(Pos - vec3(hX, hY + 30 * scale, hZ)) - 40.0f * scale;
+	float dist2 = glm::length(Pos - vec3(hX - 20 * scale, hY - 20 * scale, hZ - 15 * scale)) - 30 * scale;
+
+	vec3 q = abs(Pos - vec3(hX, hY - 50 * scale, hZ)) - vec3(30 * scale);
+	float dist3 = glm::length(vmax(q, vec3(0.0f))) + min(max(q.x, max(q.y, q.z)), 0.0) - 4 * scale;
+
+	float k = 40.0f * scale;
+	float h = clampf(0.5 + 0.5 * (dist3 - dist) / k, 0.0, 1.0);
+	dist = lerp(dist3, dist, h) - k * h * (1.0 - h);
+	dist = min(dist, dist2);
+
+	return dist;
+}
+
+// Camera frame with sensor noise and a laser line that wanders across the rows.
+void benchCreateScanFrame(ldiImage* Image, int Width, int Height) {
+	Image->width = Width;
+	Image->height = Height;
+	Image->data = new uint8_t[Width * Height];
+
+	for (int iY = 0; iY < Height; ++iY) {
+		for (int iX = 0; iX < Width; ++iX) {
+			Image->data[iX + iY * Width] = (uint8_t)(8 + _benchHash(iX, iY, 13) * 15.0f);
+		}
+	}
+
+	for (int iX = 0; iX < Width; ++iX) {
+		float lineY = Height * (0.5f + 0.3f * sinf(iX * 6.0f / Width));
+		int startY = max(0, (int)lineY - 10);
+		int endY = min(Height - 1, (int)lineY + 10);
+
+		for (int iY = startY; iY <= endY; ++iY) {
+			float d = (iY - lineY) / (1.5f + Width / 1000.0f);
+			int v = Image->data[iX + iY * Width] + (int)(220.0f * expf(-d * d));
+			Image->data[iX + iY * Width] = (uint8_t)min(v, 255);
+		}
+	}
+}
+
+void benchFillVoxelGrid(ldiVoxelGrid* Grid) {
+	voxelFillSdf(Grid, _benchVoxelSdf, Grid);
+}
+
+//----------------------------------------------------------------------------------------------------
+// Timing.
+//----------------------------------------------------------------------------------------------------
+// Usage:
+//   benchTimerInit(&timer, Bench);
+//   while (benchTimerNext(&timer)) { <untimed setup> benchTimerStart(&timer); <stage> benchTimerStop(&timer); }
+//   benchTimerFinish(Bench, &timer, "stage", mesh, size, items);
+void benchTimerInit(ldiBenchTimer* Timer, ldiBenchmark* Bench) {
+	Timer->warmup = Bench->warmup;
+	Timer->repeats = Bench->repeats;
+	Timer->run = 0;
+	Timer->samples.clear();
+}
+
+bool benchTimerNext(ldiBenchTimer* Timer) {
+	return Timer->run < Timer->warmup + Timer->repeats;
+}
+
+void benchTimerStart(ldiBenchTimer* Timer) {
+	Timer->startTime = getTime();
+}
+
+void benchTimerStop(ldiBenchTimer* Timer) {
+	double t0 = getTime() - Timer->startTime;
+
+	if (Timer->run >= Timer->warmup) {
+		Timer->samples.push_back(t0);
+	}
+
+	Timer->run++;
+}
+
+void benchTimerFinish(ldiBenchmark* Bench, ldiBenchTimer* Timer, const char* Stage, const std::string& Mesh, int Size, int64_t Items) {
+	std::vector<double> samples = Timer->samples;
+	std::sort(samples.begin(), samples.end());
+
+	ldiBenchResult result = {};
+	result.stage = Stage;
+	result.mesh = Mesh;
+	result.size = Size;
+	result.items = Items;
+	result.repeats = (int)samples.size();
+	result.minTime = samples.front();
+	result.maxTime = samples.back();
+
+	double sum = 0.0;
+	for (size_t i = 0; i < samples.size(); ++i) {
+		sum += samples[i];
+	}
+	result.meanTime = sum / samples.size();
+
+	size_t mid = samples.size() / 2;
+	result.medianTime = (samples.size() % 2) ? samples[mid] : (samples[mid - 1] + samples[mid]) * 0.5;
+
+	double variance = 0.0;
+	for (size_t i = 0; i < samples.size(); ++i) {
+		variance += (samples[i] - result.meanTime) * (samples[i] - result.meanTime);
+	}
+	result.stdDev = sqrt(variance / samples.size());
+
+	// NOTE: Scaling exponent against the previous size of the same stage and mesh.
+	result.hasScaling = false;
+	result.scaling = 0.0;
+
+	for (int i = (int)Bench->results.size() - 1; i >= 0; --i) {
+		ldiBenchResult* prev = &Bench->results[i];
+
+		if (prev->stage == result.stage && prev->mesh == result.mesh) {
+			if (prev->items > 0 && result.items > prev->items && prev->medianTime > 0.0) {
+				result.hasScaling = true;
+				result.scaling = log(result.medianTime / prev->medianTime) / log((double)result.items / (double)prev->items);
+			}
+			break;
+		}
+	}
+
+	std::cout << "[Bench] " << Stage << " " << Mesh << " " << Size << " items: " << Items << " median: " << (result.medianTime * 1000.0) << " ms stddev: " << (result.stdDev * 1000.0) << " ms";
+
+	if (result.hasScaling) {
+		std::cout << " scaling: " << result.scaling;
+
+		if (result.scaling > 1.25) {
+			std::cout << " (SUPER-LINEAR)";
+		}
+	}
+
+	std::cout << "\n";
+
+	Bench->results.push_back(result);
+}
+
+bool benchWriteResults(ldiBenchmark* Bench, const std::string& Path) {
+	FILE* f;
+	if (fopen_s(&f, Path.c_str(), "w") != 0 || f == 0) {
+		std::cout << "Could not open benchmark results file: " << Path << "\n";
+		return false;
+	}
+
+	fprintf(f, "{\n\t\"warmup\": %d,\n\t\"repeats\": %d,\n\t\"threads\": %d,\n\t\"results\": [\n", Bench->warmup, Bench->repeats, threadPoolGetThreadCount());
+
+	for (size_t i = 0; i < Bench->results.size(); ++i) {
+		ldiBenchResult* r = &Bench->results[i];
+
+		fprintf(f, "\t\t{ \"stage\": \"%s\", \"mesh\": \"%s\", \"size\": %d, \"items\": %lld, \"repeats\": %d, ", r->stage.c_str(), r->mesh.c_str(), r->size, r->items, r->repeats);
+		fprintf(f, "\"minMs\": %f, \"maxMs\": %f, \"meanMs\": %f, \"medianMs\": %f, \"stdDevMs\": %f, ", r->minTime * 1000.0, r->maxTime * 1000.0, r->meanTime * 1000.0, r->medianTime * 1000.0, r->stdDev * 1000.0);
+		fprintf(f, "\"itemsPerSec\": %f, ", r->medianTime > 0.0 ? r->items / r->medianTime : 0.0);
+
+		if (r->hasScaling) {
+			fprintf(f, "\"scaling\": %f }", r->scaling);
+		} else {
+			fprintf(f, "\"scaling\": null }");
+		}
+
+		fprintf(f, "%s\n", (i + 1 < Bench->results.size()) ? "," : "");
+	}
+
+	fprintf(f, "\t]\n}\n");
+	fclose(f);
+
+	std::cout << "Benchmark results written to " << Path << "\n";
+
+	return true;
+}
+
+//----------------------------------------------------------------------------------------------------
+// Stages.
+//----------------------------------------------------------------------------------------------------
+void _benchSurfelStages(ldiApp* AppContext, ldiBenchmark* Bench, ldiBenchMesh* Mesh, int Size, ldiImage* Texture) {
+	ldiBenchTimer timer;
+	const int quadCount = (int)(Mesh->quadModel.indices.size() / 4);
+
+	std::vector<ldiNewSurfel> surfels;
+
+	benchTimerInit(&timer, Bench);
+	while (benchTimerNext(&timer)) {
+		benchTimerStart(&timer);
+		geoCreateSurfelsNew(&Mesh->quadModel, &surfels, PROJECT_SAMPLES_IMAGE_WIDTH, BENCH_SAMPLES_PER_SIDE);
+		benchTimerStop(&timer);
+	}
+	benchTimerFinish(Bench, &timer, "geoCreateSurfelsNew", Mesh->name, Size, quadCount);
+
+	ldiSpatialGrid grid = {};
+	vec3 boundsMin;
+	vec3 boundsMax;
+
+	benchTimerInit(&timer, Bench);
+	while (benchTimerNext(&timer)) {
+		spatialGridDestroy(&grid);
+		benchTimerStart(&timer);
+		geoBuildSurfelSpatialGrid(&surfels, 0.03f, &grid, &boundsMin, &boundsMax);
+		benchTimerStop(&timer);
+	}
+	benchTimerFinish(Bench, &timer, "geoBuildSurfelSpatialGrid", Mesh->name, Size, quadCount);
+
+	ldiSampleAtlas samples = {};
+
+	ldiPhysicsMesh cookedMesh = {};
+	physicsCookMesh(AppContext->physics, &Mesh->model, &cookedMesh);
+
+	benchTimerInit(&timer, Bench);
+	while (benchTimerNext(&timer)) {
+		benchTimerStart(&timer);
+		geoTransferColorToSurfels(AppContext, &cookedMesh, &Mesh->model, Texture, &surfels, &samples);
+		benchTimerStop(&timer);
+	}
+	benchTimerFinish(Bench, &timer, "geoTransferColorToSurfels", Mesh->name, Size, (int64_t)quadCount * BENCH_SAMPLES_PER_SIDE * BENCH_SAMPLES_PER_SIDE);
+
+	benchTimerInit(&timer, Bench);
+	while (benchTimerNext(&timer)) {
+		benchTimerStart(&timer);
+		geoTransferColorToSurfels(AppContext, &cookedMesh, &Mesh->model, Texture, &surfels, &samples, true, true);
+		benchTimerStop(&timer);
+	}
+	benchTimerFinish(Bench, &timer, "geoTransferColorToSurfelsAdaptive", Mesh->name, Size, (int64_t)quadCount * BENCH_SAMPLES_PER_SIDE * BENCH_SAMPLES_PER_SIDE);
+
+	physicsDestroyCookedMesh(AppContext->physics, &cookedMesh);
+	sampleAtlasDestroy(&samples);
+
+	std::vector<vec3> positions(surfels.size());
+
+	for (size_t i = 0; i < surfels.size(); ++i) {
+		positions[i] = surfels[i].position;
+	}
+
+	ldiPointIndex pointIndex = {};
+
+	benchTimerInit(&timer, Bench);
+	while (benchTimerNext(&timer)) {
+		benchTimerStart(&timer);
+		pointIndexBuild(&pointIndex, positions.data(), (int)positions.size());
+		benchTimerStop(&timer);
+	}
+	benchTimerFinish(Bench, &timer, "pointIndexBuild", Mesh->name, Size, quadCount);
+
+	ldiNormalSmoothSettings smoothSettings = geoGetDefaultNormalSmoothSettings();
+	std::vector<vec3> smoothedNormals;
+
+	benchTimerInit(&timer, Bench);
+	while (benchTimerNext(&timer)) {
+		benchTimerStart(&timer);
+		geoSmoothSurfelNormals(&surfels, &pointIndex, &smoothSettings, &smoothedNormals);
+		benchTimerStop(&timer);
+	}
+	benchTimerFinish(Bench, &timer, "geoSmoothSurfelNormals", Mesh->name, Size, quadCount);
+
+	pointIndexDestroy(&pointIndex);
+
+	ldiSurfelVis surfelVis = {};
+
+	benchTimerInit(&timer, Bench);
+	while (benchTimerNext(&timer)) {
+		benchTimerStart(&timer);
+		surfelVisBuild(&surfelVis, &surfels);
+		benchTimerStop(&timer);
+	}
+	benchTimerFinish(Bench, &timer, "surfelVisBuild", Mesh->name, Size, quadCount);
+
+	// NOTE: A fixed spread of views around the upper hemisphere.
+	const vec3 visViews[] = {
+		vec3(0.0f, 1.0f, 0.0f), glm::normalize(vec3(1.0f, 1.0f, 0.0f)), glm::normalize(vec3(-1.0f, 1.0f, 0.0f)),
+		glm::normalize(vec3(0.0f, 1.0f, 1.0f)), glm::normalize(vec3(0.0f, 1.0f, -1.0f)), vec3(1.0f, 0.0f, 0.0f),
+		vec3(-1.0f, 0.0f, 0.0f), vec3(0.0f, 0.0f, 1.0f),
+	};
+	const int visViewCount = sizeof(visViews) / sizeof(visViews[0]);
+	ldiSurfelVisSettings visSettings = surfelVisGetDefaultSettings();
+	std::vector<uint8_t> visResults;
+
+	benchTimerInit(&timer, Bench);
+	while (benchTimerNext(&timer)) {
+		benchTimerStart(&timer);
+		surfelVisQueryViews(&surfelVis, visViews, visViewCount, &visSettings, &visResults);
+		benchTimerStop(&timer);
+	}
+	benchTimerFinish(Bench, &timer, "surfelVisQueryViews", Mesh->name, Size, (int64_t)quadCount * visViewCount);
+
+	surfelVisDestroy(&surfelVis);
+
+	// NOTE: Partitioning only reads the surfels, normals and grid from the project, and writes surfel colors.
+	ldiProjectContext* project = new ldiProjectContext();
+	project->surfelsSpatialGrid = grid;
+	project->surfelsSmoothedNormals = smoothedNormals;
+
+	benchTimerInit(&timer, Bench);
+	while (benchTimerNext(&timer)) {
+		project->surfels = surfels;
+		benchTimerStart(&timer);
+		_surfacePartitioning(AppContext, project);
+		benchTimerStop(&timer);
+	}
+	benchTimerFinish(Bench, &timer, "_surfacePartitioning", Mesh->name, Size, quadCount);
+
+	project->surfelsSpatialGrid = {};
+	delete project;
+	spatialGridDestroy(&grid);
+
+	benchTimerInit(&timer, Bench);
+	while (benchTimerNext(&timer)) {
+		benchTimerStart(&timer);
+		modelCreateFaceNormals(&Mesh->model);
+		benchTimerStop(&timer);
+	}
+	benchTimerFinish(Bench, &timer, "modelCreateFaceNormals", Mesh->name, Size, Mesh->model.indices.size() / 3);
+
+	ldiVertexFaceAdjacency adjacency;
+	meshBuildVertexFaceAdjacency(&Mesh->model, &adjacency);
+
+	benchTimerInit(&timer, Bench);
+	while (benchTimerNext(&timer)) {
+		benchTimerStart(&timer);
+		meshComputeVertexNormals(&Mesh->model, NW_AREA, &adjacency);
+		benchTimerStop(&timer);
+	}
+	benchTimerFinish(Bench, &timer, "meshComputeVertexNormals", Mesh->name, Size, Mesh->model.indices.size() / 3);
+
+	mat4 benchTransform = glm::rotate(mat4(1.0f), 0.5f, vec3(0.0f, 1.0f, 0.0f));
+	benchTransform = glm::translate(benchTransform, vec3(1.0f, 2.0f, 3.0f));
+
+	benchTimerInit(&timer, Bench);
+	while (benchTimerNext(&timer)) {
+		benchTimerStart(&timer);
+		ldiModel transModel = modelGetTransformed(&Mesh->model, benchTransform);
+		benchTimerStop(&timer);
+	}
+	benchTimerFinish(Bench, &timer, "modelGetTransformed", Mesh->name, Size, Mesh->model.verts.size());
+
+	std::vector<ldiMeshVertex> transVerts(Mesh->model.verts.size());
+
+	benchTimerInit(&timer, Bench);
+	while (benchTimerNext(&timer)) {
+		benchTimerStart(&timer);
+		meshTransformVerts(Mesh->model.verts.data(), transVerts.data(), (int)transVerts.size(), benchTransform);
+		benchTimerStop(&timer);
+	}
+	benchTimerFinish(Bench, &timer, "meshTransformVerts", Mesh->name, Size, Mesh->model.verts.size());
+
+	ldiMeshDistance meshDistance;
+
+	benchTimerInit(&timer, Bench);
+	while (benchTimerNext(&timer)) {
+		benchTimerStart(&timer);
+		meshDistanceBuild(&Mesh->model, &meshDistance);
+		benchTimerStop(&timer);
+	}
+	benchTimerFinish(Bench, &timer, "meshDistanceBuild", Mesh->name, Size, Mesh->model.indices.size() / 3);
+
+	vec3 modelBoundsMin = Mesh->model.verts[0].pos;
+	vec3 modelBoundsMax = modelBoundsMin;
+
+	for (size_t i = 0; i < Mesh->model.verts.size(); ++i) {
+		vec3 p = Mesh->model.verts[i].pos;
+		modelBoundsMin.x = min(modelBoundsMin.x, p.x);
+		modelBoundsMin.y = min(modelBoundsMin.y, p.y);
+		modelBoundsMin.z = min(modelBoundsMin.z, p.z);
+		modelBoundsMax.x = max(modelBoundsMax.x, p.x);
+		modelBoundsMax.y = max(modelBoundsMax.y, p.y);
+		modelBoundsMax.z = max(modelBoundsMax.z, p.z);
+	}
+
+	const int sdfSize = 32;
+	vec3 sdfExtent = modelBoundsMax - modelBoundsMin;
+	float sdfCellSize = max(sdfExtent.x, max(sdfExtent.y, sdfExtent.z)) * 1.2f / sdfSize;
+	vec3 sdfOrigin = (modelBoundsMin + modelBoundsMax) * 0.5f - vec3(sdfCellSize * sdfSize * 0.5f);
+	std::vector<float> sdfVolume(sdfSize * sdfSize * sdfSize);
+
+	benchTimerInit(&timer, Bench);
+	while (benchTimerNext(&timer)) {
+		benchTimerStart(&timer);
+		meshDistanceFillVolume(&meshDistance, sdfOrigin, sdfCellSize, sdfSize, sdfSize, sdfSize, sdfVolume.data());
+		benchTimerStop(&timer);
+	}
+	benchTimerFinish(Bench, &timer, "meshDistanceFillVolume", Mesh->name, Size, sdfVolume.size());
+
+	ldiDecimateSettings decimateSettings = meshDecimateGetDefaultSettings((int)(Mesh->quadModel.indices.size() / 4 / 2));
+
+	benchTimerInit(&timer, Bench);
+	while (benchTimerNext(&timer)) {
+		ldiModel decimated;
+		benchTimerStart(&timer);
+		meshDecimateQuads(&Mesh->quadModel, &decimateSettings, &decimated);
+		benchTimerStop(&timer);
+	}
+	benchTimerFinish(Bench, &timer, "meshDecimateQuads", Mesh->name, Size, Mesh->quadModel.indices.size() / 4);
+
+	// NOTE: Reorders a copy each run, the bench mesh keeps its generated order for the other stages.
+	benchTimerInit(&timer, Bench);
+	while (benchTimerNext(&timer)) {
+		ldiModel reordered = Mesh->model;
+		benchTimerStart(&timer);
+		meshReorderModel(&reordered, SC_HILBERT, nullptr);
+		benchTimerStop(&timer);
+	}
+	benchTimerFinish(Bench, &timer, "meshReorderModel", Mesh->name, Size, Mesh->model.indices.size() / 3);
+}
+
+void _benchColorStages(ldiBenchmark* Bench, ldiImage* Texture) {
+	ldiColorTransform* transform = colorGetTransform("../../assets/profiles/sRGB_v4_ICC_preference.icc", "../../assets/profiles/USWebCoatedSWOP.icc", INTENT_PERCEPTUAL, true);
+
+	if (!transform) {
+		return;
+	}
+
+	const char* stageNames[2] = { "colorConvertImage", "colorConvertImageLut" };
+	int64_t pixelCount = (int64_t)Texture->width * Texture->height;
+
+	for (int lutIter = 0; lutIter < 2; ++lutIter) {
+		ldiBenchTimer timer;
+		benchTimerInit(&timer, Bench);
+		while (benchTimerNext(&timer)) {
+			ldiImage cmyk = {};
+			ldiImage previews[4] = {};
+
+			benchTimerStart(&timer);
+			colorConvertImage(transform, Texture, &cmyk, lutIter == 1, previews);
+			benchTimerStop(&timer);
+
+			delete[] cmyk.data;
+			for (int i = 0; i < 4; ++i) {
+				delete[] previews[i].data;
+			}
+		}
+		benchTimerFinish(Bench, &timer, stageNames[lutIter], "texture", Texture->width, pixelCount);
+	}
+}
+
+void _benchSamplerStages(ldiBenchmark* Bench, ldiImage* Texture) {
+	const int sampleCount = 1 << 20;
+	std::vector<vec2> uvs(sampleCount);
+	std::vector<uint32_t> results(sampleCount);
+
+	for (int i = 0; i < sampleCount; ++i) {
+		uvs[i] = vec2(_benchHash(i, 0, 11), _benchHash(i, 1, 11));
+	}
+
+	ldiTexSampler sampler;
+	texSamplerInit(&sampler, Texture, TAM_CLAMP);
+
+	ldiBenchTimer timer;
+	benchTimerInit(&timer, Bench);
+	while (benchTimerNext(&timer)) {
+		benchTimerStart(&timer);
+		texSampleBilinear(&sampler, sampleCount, uvs.data(), results.data());
+		benchTimerStop(&timer);
+	}
+	benchTimerFinish(Bench, &timer, "texSampleBilinear", "texture", Texture->width, sampleCount);
+
+	benchTimerInit(&timer, Bench);
+	while (benchTimerNext(&timer)) {
+		benchTimerStart(&timer);
+		for (int i = 0; i < sampleCount; ++i) {
+			results[i] = texSampleBilinearScalar(&sampler, 0, uvs[i]);
+		}
+		benchTimerStop(&timer);
+	}
+	benchTimerFinish(Bench, &timer, "texSampleBilinearScalar", "texture", Texture->width, sampleCount);
+
+	texSamplerDestroy(&sampler);
+}
+
+void _benchScanLineStages(ldiBenchmark* Bench) {
+	for (size_t sizeIter = 0; sizeIter < Bench->frameSizes.size(); ++sizeIter) {
+		int width = Bench->frameSizes[sizeIter];
+		int height = width * 2464 / 3280;
+
+		ldiImage frame;
+		benchCreateScanFrame(&frame, width, height);
+
+		ldiScanLineExtractor extractor;
+		computerVisionScanLineInit(&extractor);
+		std::vector<vec2> points;
+
+		ldiBenchTimer timer;
+		benchTimerInit(&timer, Bench);
+		while (benchTimerNext(&timer)) {
+			benchTimerStart(&timer);
+			computerVisionExtractScanLine(&extractor, frame, &points);
+			benchTimerStop(&timer);
+		}
+		benchTimerFinish(Bench, &timer, "computerVisionExtractScanLine", "scanFrame", width, (int64_t)width * height);
+
+		// NOTE: Band around where the line is expected, as used during a scan.
+		extractor.roiY = height / 8;
+		extractor.roiWidth = width;
+		extractor.roiHeight = height * 3 / 4;
+
+		benchTimerInit(&timer, Bench);
+		while (benchTimerNext(&timer)) {
+			benchTimerStart(&timer);
+			computerVisionExtractScanLine(&extractor, frame, &points);
+			benchTimerStop(&timer);
+		}
+		benchTimerFinish(Bench, &timer, "computerVisionExtractScanLineRoi", "scanFrame", width, (int64_t)extractor.roiWidth * extractor.roiHeight);
+
+		extractor.roiWidth = 0;
+		extractor.peakMode = SLPM_GAUSSIAN;
+
+		benchTimerInit(&timer, Bench);
+		while (benchTimerNext(&timer)) {
+			benchTimerStart(&timer);
+			computerVisionExtractScanLine(&extractor, frame, &points);
+			benchTimerStop(&timer);
+		}
+		benchTimerFinish(Bench, &timer, "computerVisionExtractScanLineGaussian", "scanFrame", width, (int64_t)width * height);
+
+		delete[] frame.data;
+	}
+}
+
+// NOTE: Device stages run against the simulators with all delays removed, so they measure protocol,
+// transfer, and processing overhead only.
+void _benchDeviceStages(ldiApp* AppContext, ldiBenchmark* Bench) {
+	ldiBenchTimer timer;
+
+	ldiPantherSim* pantherSim = new ldiPantherSim();
+	pantherSim->timeScale = 0.0f;
+	pantherSimInit(pantherSim);
+
+	ldiPanther* panther = new ldiPanther();
+	pantherInit(AppContext, panther);
+	pantherConnectLoopback(panther, &pantherSim->loopback);
+
+	benchTimerInit(&timer, Bench);
+	while (benchTimerNext(&timer)) {
+		benchTimerStart(&timer);
+		for (int i = 0; i < Bench->deviceMoveCount; ++i) {
+			pantherMoveAndWait(panther, PA_X, (i & 1) ? 1000 : 0, 0.0f);
+		}
+		benchTimerStop(&timer);
+	}
+	benchTimerFinish(Bench, &timer, "pantherMoveRoundTrip", "pantherSim", Bench->deviceMoveCount, Bench->deviceMoveCount);
+
+	for (size_t sizeIter = 0; sizeIter < Bench->frameSizes.size(); ++sizeIter) {
+		int width = Bench->frameSizes[sizeIter];
+		int height = width * 2464 / 3280;
+		int64_t framePixels = (int64_t)width * height;
+
+		// NOTE: New port per size so a closing connection can't hold up the next bind.
+		ldiHawkSim* hawkSim = new ldiHawkSim();
+		hawkSim->width = width;
+		hawkSim->height = height;
+		hawkSim->frameRate = 0.0f;
+		hawkSim->timeScale = 0.0f;
+
+		if (!hawkSimInit(hawkSim, HAWK_SIM_DEFAULT_PORT + (int)sizeIter)) {
+			delete hawkSim;
+			break;
+		}
+
+		ldiHawk* hawk = new ldiHawk();
+		hawkInit(hawk, "127.0.0.1", hawkSim->port);
+		hawkWaitForPacket(hawk, HO_SETTINGS);
+
+		benchTimerInit(&timer, Bench);
+		while (benchTimerNext(&timer)) {
+			benchTimerStart(&timer);
+			for (int i = 0; i < Bench->deviceFrameCount; ++i) {
+				hawkClearWaitPacket(hawk);
+				hawkWaitForPacket(hawk, HO_FRAME);
+			}
+			benchTimerStop(&timer);
+		}
+		benchTimerFinish(Bench, &timer, "hawkFrameReceive", "hawkSim", width, framePixels * Bench->deviceFrameCount);
+
+		// NOTE: Scan job pattern: step an axis, take the next frame, find the laser line.
+		int scanPointCount = 0;
+
+		benchTimerInit(&timer, Bench);
+		while (benchTimerNext(&timer)) {
+			benchTimerStart(&timer);
+			for (int i = 0; i < Bench->deviceFrameCount; ++i) {
+				pantherMoveAndWait(panther, PA_Z, i * 10, 0.0f);
+				hawkClearWaitPacket(hawk);
+				hawkWaitForPacket(hawk, HO_FRAME);
+
+				std::unique_lock<std::mutex> lock(hawk->valuesMutex);
+
+				ldiImage frame = {};
+				frame.data = hawk->frameBuffer;
+				frame.width = hawk->imgWidth;
+				frame.height = hawk->imgHeight;
+
+				scanPointCount += (int)computerVisionFindScanLine(frame).size();
+			}
+			benchTimerStop(&timer);
+		}
+		benchTimerFinish(Bench, &timer, "scanCaptureLoop", "hawkSim", width, framePixels * Bench->deviceFrameCount);
+
+		// NOTE: Only waits for the averaged frame. With no simulated delays HO_AVERAGE_GATHERED and
+		// HO_FRAME arrive back to back and the single wait slot can skip over the first.
+		hawkSetMode(hawk, CCM_WAIT);
+
+		benchTimerInit(&timer, Bench);
+		while (benchTimerNext(&timer)) {
+			benchTimerStart(&timer);
+			hawkClearWaitPacket(hawk);
+			hawkSetMode(hawk, CCM_AVERAGE);
+			hawkWaitForPacket(hawk, HO_FRAME);
+			benchTimerStop(&timer);
+		}
+		benchTimerFinish(Bench, &timer, "hawkAverageCapture", "hawkSim", width, framePixels);
+
+		std::cout << "[Bench] Frames " << width << "x" << height << ": " << hawkSim->framesSent << " sent, " << scanPointCount << " scan points\n";
+
+		hawkDestroy(hawk);
+		delete hawk;
+		hawkSimDestroy(hawkSim);
+		delete hawkSim;
+	}
+
+	pantherDestroy(panther);
+	delete panther;
+	pantherSimDestroy(pantherSim);
+	delete pantherSim;
+}
+
+// Runs all stages over all sizes and writes results. Does not need a window or graphics device.
+int benchmarkRun(ldiApp* AppContext, const std::string& OutputPath) {
+	ldiBenchmark bench;
+
+	std::cout << "Running geometry benchmarks (warmup " << bench.warmup << ", repeats " << bench.repeats << ")\n";
+
+	ldiImage texture = {};
+	benchCreateTexture(&texture, bench.textureSize);
+
+	_benchColorStages(&bench, &texture);
+	_benchSamplerStages(&bench, &texture);
+
+	for (size_t sizeIter = 0; sizeIter < bench.meshSizes.size(); ++sizeIter) {
+		int size = bench.meshSizes[sizeIter];
+
+		for (int meshIter = 0; meshIter < 3; ++meshIter) {
+			ldiBenchMesh mesh;
+
+			if (meshIter == 0) {
+				benchCreateSphere(&mesh, size);
+			} else if (meshIter == 1) {
+				benchCreateNoisyTorus(&mesh, size);
+			} else {
+				benchCreateThinFeatures(&mesh, size);
+			}
+
+			std::cout << "[Bench] Mesh " << mesh.name << " " << size << ": " << mesh.quadModel.verts.size() << " verts " << (mesh.quadModel.indices.size() / 4) << " quads\n";
+
+			_benchSurfelStages(AppContext, &bench, &mesh, size, &texture);
+		}
+	}
+
+	delete[] texture.data;
+
+	for (size_t sizeIter = 0; sizeIter < bench.voxelSizes.size(); ++sizeIter) {
+		int size = bench.voxelSizes[sizeIter];
+		ldiVoxelGrid grid = voxelCreateGrid(size, size, size);
+
+		ldiBenchTimer timer;
+		benchTimerInit(&timer, &bench);
+		while (benchTimerNext(&timer)) {
+			benchTimerStart(&timer);
+			benchFillVoxelGrid(&grid);
+			benchTimerStop(&timer);
+		}
+		benchTimerFinish(&bench, &timer, "voxelFillSdf", "voxelBlend", size, (int64_t)grid.cellSizeX * grid.cellSizeY * grid.cellSizeZ);
+
+		benchTimerInit(&timer, &bench);
+		while (benchTimerNext(&timer)) {
+			ldiModel voxelModel;
+			benchTimerStart(&timer);
+			voxelMarch(&grid, &voxelModel);
+			benchTimerStop(&timer);
+		}
+		benchTimerFinish(&bench, &timer, "voxelMarch", "voxelBlend", size, (int64_t)grid.cellSizeX * grid.cellSizeY * grid.cellSizeZ);
+
+		voxelDestroyGrid(&grid);
+	}
+
+	_benchScanLineStages(&bench);
+	_benchDeviceStages(AppContext, &bench);
+
+	if (!benchWriteResults(&bench, OutputPath)) {
+		return 1;
+	}
+
+	return 0;
+}
\ No newline at end of file
@@ -0,0 +1,148 @@
+#pragma once
+
+//----------------------------------------------------------------------------------------------------
+// Calibration observation index.
+//----------------------------------------------------------------------------------------------------
+// Flattened charuco corner observations of a calibration job with lookups by sample, by corner global ID
+// and by axis position. Built in one pass over the samples, so it is cheap to rebuild whenever the job
+// changes rather than kept in sync.
+
+struct ldiCalibObservation {
+	int										sampleId;
+	int										cornerGlobalId;
+	vec2									position;
+};
+
+struct ldiCalibObservations {
+	// NOTE: Grouped by sample, in sample order. Sample S owns [sampleObsStart[S], sampleObsStart[S + 1]).
+	std::vector<ldiCalibObservation>		obs;
+	std::vector<int>						sampleObsStart;
+
+	// Observation indices grouped by corner global ID, same start offset scheme.
+	std::vector<int>						cornerObsStart;
+	std::vector<int>						cornerObsIds;
+
+	// Inverse of job poseToSampleIds, -1 for samples without a pose.
+	std::vector<int>						sampleToPose;
+	std::vector<std::vector<int>>			samplesByPhase;
+	std::unordered_map<uint64_t, std::vector<int>>	samplesByPosition;
+};
+
+inline uint64_t calibGetAxisPositionKey(int X, int Y, int Z, int C, int A) {
+	int position[5] = { X, Y, Z, C, A };
+	return hashFnv1a(HASH_FNV1A_SEED, position, sizeof(position));
+}
+
+// Exact key for two axis values, used to group samples into columns along the remaining axis.
+inline uint64_t calibGetAxisPairKey(int A, int B) {
+	return ((uint64_t)(uint32_t)A << 32) | (uint64_t)(uint32_t)B;
+}
+
+void calibBuildObservations(ldiCalibrationJob* Job, ldiCalibObservations* Obs) {
+	PROFILE_ZONE("Build observations");
+
+	int sampleCount = (int)Job->samples.size();
+	int cornerCount = (int)Job->cube.points.size();
+
+	Obs->obs.clear();
+	Obs->sampleObsStart.resize(sampleCount + 1);
+	Obs->samplesByPhase.clear();
+	Obs->samplesByPosition.clear();
+
+	for (int sampleIter = 0; sampleIter < sampleCount; ++sampleIter) {
+		ldiCalibSample* sample = &Job->samples[sampleIter];
+		Obs->sampleObsStart[sampleIter] = (int)Obs->obs.size();
+
+		if (sample->phase >= 0) {
+			if (sample->phase >= (int)Obs->samplesByPhase.size()) {
+				Obs->samplesByPhase.resize(sample->phase + 1);
+			}
+
+			Obs->samplesByPhase[sample->phase].push_back(sampleIter);
+		}
+
+		Obs->samplesByPosition[calibGetAxisPositionKey(sample->X, sample->Y, sample->Z, sample->C, sample->A)].push_back(sampleIter);
+
+		std::vector<ldiCharucoBoard>* boards = &sample->cube.boards;
+		for (size_t boardIter = 0; boardIter < boards->size(); ++boardIter) {
+			ldiCharucoBoard* board = &(*boards)[boardIter];
+
+			for (size_t cornerIter = 0; cornerIter < board->corners.size(); ++cornerIter) {
+				ldiCalibObservation obs;
+				obs.sampleId = sampleIter;
+				obs.cornerGlobalId = (board->id * 9) + board->corners[cornerIter].id;
+				obs.position = board->corners[cornerIter].position;
+				Obs->obs.push_back(obs);
+
+				cornerCount = max(cornerCount, obs.cornerGlobalId + 1);
+			}
+		}
+	}
+
+	Obs->sampleObsStart[sampleCount] = (int)Obs->obs.size();
+
+	// Counting sort by corner keeps each corner's observations in sample order.
+	Obs->cornerObsStart.assign(cornerCount + 1, 0);
+
+	for (size_t i = 0; i < Obs->obs.size(); ++i) {
+		++Obs->cornerObsStart[Obs->obs[i].cornerGlobalId + 1];
+	}
+
+	for (int i = 0; i < cornerCount; ++i) {
+		Obs->cornerObsStart[i + 1] += Obs->cornerObsStart[i];
+	}
+
+	std::vector<int> cornerFill(Obs->cornerObsStart.begin(), Obs->cornerObsStart.end() - 1);
+	Obs->cornerObsIds.resize(Obs->obs.size());
+
+	for (size_t i = 0; i < Obs->obs.size(); ++i) {
+		Obs->cornerObsIds[cornerFill[Obs->obs[i].cornerGlobalId]++] = (int)i;
+	}
+
+	Obs->sampleToPose.assign(sampleCount, -1);
+
+	for (size_t poseIter = 0; poseIter < Job->poseToSampleIds.size(); ++poseIter) {
+		Obs->sampleToPose[Job->poseToSampleIds[poseIter]] = (int)poseIter;
+	}
+}
+
+int calibGetSampleObservationCount(ldiCalibObservations* Obs, int SampleId) {
+	return Obs->sampleObsStart[SampleId + 1] - Obs->sampleObsStart[SampleId];
+}
+
+int calibGetCornerObservationCount(ldiCalibObservations* Obs, int CornerGlobalId) {
+	if (CornerGlobalId < 0 || CornerGlobalId + 1 >= (int)Obs->cornerObsStart.size()) {
+		return 0;
+	}
+
+	return Obs->cornerObsStart[CornerGlobalId + 1] - Obs->cornerObsStart[CornerGlobalId];
+}
+
+// Empty if the job has no samples in that phase.
+const std::vector<int>& calibGetSamplesInPhase(ldiCalibObservations* Obs, int Phase) {
+	static const std::vector<int> empty;
+
+	if (Phase < 0 || Phase >= (int)Obs->samplesByPhase.size()) {
+		return empty;
+	}
+
+	return Obs->samplesByPhase[Phase];
+}
+
+// Appends every sample captured at the given axis position.
+void calibFindSamplesAtPosition(ldiCalibrationJob* Job, ldiCalibObservations* Obs, int X, int Y, int Z, int C, int A, std::vector<int>& SampleIds) {
+	auto bucket = Obs->samplesByPosition.find(calibGetAxisPositionKey(X, Y, Z, C, A));
+
+	if (bucket == Obs->samplesByPosition.end()) {
+		return;
+	}
+
+	for (size_t i = 0; i < bucket->second.size(); ++i) {
+		ldiCalibSample* sample = &Job->samples[bucket->second[i]];
+
+		// NOTE: Keys are hashes, check for the rare collision.
+		if (sample->X == X && sample->Y == Y && sample->Z == Z && sample->C == C && sample->A == A) {
+			SampleIds.push_back(bucket->second[i]);
+		}
+	}
+}
\ No newline at end of file
@@ -33,31 +33,411 @@ void calibSetDefaultCamera(ldiCalibrationJob* Job) {
 	Job->camDist.at<double>(3) = 0.00217368989251554;
 }
 
-// Takes image sample files and generates the initial calibration samples for a job.
-void calibFindInitialObservations(ldiCalibrationJob* Job, const std::string& DirectoryPath) {
-	calibClearJob(Job);
+//----------------------------------------------------------------------------------------------------
+// Batch charuco detection.
+//----------------------------------------------------------------------------------------------------
+// A loader thread reads and hashes sample files ahead of the pool, bounded by the number of frames held
+// in memory. Archive frames are read compressed and decoded by the detection task. Detection runs as
+// pool tasks that borrow a detector from a shared free list. Results are cached by file contents and
+// camera intrinsics, so rerunning over the same set skips detection.
+
+// NOTE: Bump when detection or the results layout changes to invalidate old cache files.
+#define CALIB_CHARUCO_CACHE_VERSION 1
+#define CALIB_CHARUCO_CACHE_PATH "../cache/charuco_detections.dat"
+
+struct ldiCharucoCache {
+	bool											loaded = false;
+	std::unordered_map<uint64_t, ldiCharucoResults>	results;
+};
+
+ldiCharucoCache _calibCharucoCache;
+
+struct ldiCharucoBatch;
+
+struct ldiCharucoBatchItem {
+	ldiCharucoBatch*				batch;
+	ldiCalibSample					sample;
+	std::vector<uint8_t>			packed;
+	uint64_t						key;
+	bool							loaded;
+	bool							detected;
+};
+
+struct ldiCharucoBatch {
+	std::vector<ldiCharucoBatchItem>	items;
+	cv::Mat*							camMat;
+	cv::Mat*							camDist;
+
+	std::mutex							mutex;
+	std::condition_variable				loadedCondVar;
+	std::condition_variable				frameFreedCondVar;
+	int									loadedCount;
+	int									framesInMemory;
+	int									maxFramesInMemory;
+	std::vector<ldiCharucoDetector*>	freeDetectors;
+	std::vector<ldiCharucoDetector*>	allDetectors;
+};
+
+void calibCharucoCacheLoad() {
+	_calibCharucoCache.loaded = true;
+	_calibCharucoCache.results.clear();
+
+	FILE* file;
+	fopen_s(&file, CALIB_CHARUCO_CACHE_PATH, "rb");
+
+	if (file == 0) {
+		return;
+	}
 
-	calibSetDefaultCamera(Job);
+	int version = 0;
+	fread(&version, sizeof(int), 1, file);
 
-	std::vector<std::string> filePaths = listAllFilesInDirectory(DirectoryPath);
+	if (version == CALIB_CHARUCO_CACHE_VERSION) {
+		size_t count = deserializeVectorPrep(file);
+		for (size_t i = 0; i < count; ++i) {
+			uint64_t key = 0;
+			fread(&key, sizeof(uint64_t), 1, file);
+			deserializeCharucoResults(file, &_calibCharucoCache.results[key]);
+		}
+	}
 
-	std::cout << "Filepaths: " << DirectoryPath << "\n";
+	fclose(file);
 
-	for (int i = 0; i < filePaths.size(); ++i) {
-		if (endsWith(filePaths[i], ".dat")) {
-			std::cout << "Check file " << (i + 1) << "/" << filePaths.size() << " " << filePaths[i] << "\n";
+	std::cout << "Loaded " << _calibCharucoCache.results.size() << " cached charuco detections\n";
+}
 
-			ldiCalibSample sample = {};
-			sample.path = filePaths[i];
+void calibCharucoCacheSave() {
+	FILE* file;
+	fopen_s(&file, CALIB_CHARUCO_CACHE_PATH, "wb");
 
-			calibLoadCalibSampleData(&sample);
-			computerVisionFindCharuco(sample.frame, &sample.cube, &Job->camMat, &Job->camDist);
-			calibFreeCalibImages(&sample);
+	if (file == 0) {
+		std::cout << "Could not write charuco cache: " << CALIB_CHARUCO_CACHE_PATH << "\n";
+		return;
+	}
+
+	int version = CALIB_CHARUCO_CACHE_VERSION;
+	fwrite(&version, sizeof(int), 1, file);
+
+	int count = (int)_calibCharucoCache.results.size();
+	fwrite(&count, sizeof(int), 1, file);
+
+	for (auto i = _calibCharucoCache.results.begin(); i != _calibCharucoCache.results.end(); ++i) {
+		uint64_t key = i->first;
+		fwrite(&key, sizeof(uint64_t), 1, file);
+		serializeCharucoResults(file, &i->second);
+	}
+
+	fclose(file);
+}
+
+// Pose estimation depends on the intrinsics, so they are part of the cache key.
+uint64_t _calibCharucoCameraKey(cv::Mat* CamMat, cv::Mat* CamDist) {
+	int version = CALIB_CHARUCO_CACHE_VERSION;
+	uint64_t key = hashFnv1a(HASH_FNV1A_SEED, &version, sizeof(version));
+	key = hashFnv1a(key, CamMat->data, CamMat->total() * CamMat->elemSize());
+	key = hashFnv1a(key, CamDist->data, CamDist->total() * CamDist->elemSize());
+
+	return key;
+}
+
+void _calibCharucoReleaseFrame(ldiCharucoBatch* Batch, ldiCharucoBatchItem* Item) {
+	calibFreeCalibImages(&Item->sample);
+	std::vector<uint8_t>().swap(Item->packed);
+
+	std::unique_lock<std::mutex> lock(Batch->mutex);
+	--Batch->framesInMemory;
+	Batch->frameFreedCondVar.notify_one();
+}
 
-			Job->samples.push_back(sample);
+void _calibCharucoLoadThread(ldiCharucoBatch* Batch, uint64_t CameraKey) {
+	PROFILE_THREAD_NAME("Charuco loader");
+
+	for (size_t i = 0; i < Batch->items.size(); ++i) {
+		ldiCharucoBatchItem* item = &Batch->items[i];
+
+		{
+			std::unique_lock<std::mutex> lock(Batch->mutex);
+
+			while (Batch->framesInMemory >= Batch->maxFramesInMemory) {
+				Batch->frameFreedCondVar.wait(lock);
+			}
+
+			++Batch->framesInMemory;
+		}
+
+		{
+			PROFILE_ZONE("Load calib sample");
+			uint64_t contentHash = 0;
+
+			if (calibLoadCalibSampleData(&item->sample, &contentHash, &item->packed)) {
+				item->loaded = true;
+				item->key = hashFnv1a(CameraKey, &contentHash, sizeof(contentHash));
+			}
+		}
+
+		std::unique_lock<std::mutex> lock(Batch->mutex);
+		++Batch->loadedCount;
+		Batch->loadedCondVar.notify_one();
+	}
+}
+
+void _calibCharucoDetectTask(void* UserData) {
+	ldiCharucoBatchItem* item = (ldiCharucoBatchItem*)UserData;
+	ldiCharucoBatch* batch = item->batch;
+
+	ldiCharucoDetector* detector = nullptr;
+
+	{
+		std::unique_lock<std::mutex> lock(batch->mutex);
+
+		if (!batch->freeDetectors.empty()) {
+			detector = batch->freeDetectors.back();
+			batch->freeDetectors.pop_back();
 		}
 	}
 
+	if (detector == nullptr) {
+		detector = new ldiCharucoDetector();
+		computerVisionCharucoDetectorInit(detector);
+
+		std::unique_lock<std::mutex> lock(batch->mutex);
+		batch->allDetectors.push_back(detector);
+	}
+
+	bool frameValid = true;
+
+	if (!item->packed.empty()) {
+		PROFILE_ZONE("Unpack calib sample");
+		frameValid = calibUnpackCalibSampleData(&item->sample, item->packed);
+	}
+
+	if (frameValid) {
+		PROFILE_ZONE("Find charuco");
+		PROFILE_BYTES((int64_t)item->sample.frame.width * item->sample.frame.height);
+		item->detected = computerVisionFindCharuco(item->sample.frame, &item->sample.cube, batch->camMat, batch->camDist, detector);
+	}
+
+	_calibCharucoReleaseFrame(batch, item);
+
+	std::unique_lock<std::mutex> lock(batch->mutex);
+	batch->freeDetectors.push_back(detector);
+}
+
+// Finds charuco observations for every file in FilePaths. Samples come back in FilePaths order, with
+// image data freed. Files that fail to load are skipped.
+void calibFindCharucoBatch(const std::vector<std::string>& FilePaths, cv::Mat* CamMat, cv::Mat* CamDist, std::vector<ldiCalibSample>& Samples, bool UseCache = true) {
+	if (UseCache && !_calibCharucoCache.loaded) {
+		calibCharucoCacheLoad();
+	}
+
+	ldiCharucoBatch batch;
+	batch.camMat = CamMat;
+	batch.camDist = CamDist;
+	batch.loadedCount = 0;
+	batch.framesInMemory = 0;
+	// NOTE: Enough frames to keep every thread busy while the next ones load.
+	batch.maxFramesInMemory = threadPoolGetThreadCount() * 2;
+
+	batch.items.resize(FilePaths.size());
+	for (size_t i = 0; i < FilePaths.size(); ++i) {
+		batch.items[i].batch = &batch;
+		batch.items[i].sample.path = FilePaths[i];
+		batch.items[i].key = 0;
+		batch.items[i].loaded = false;
+		batch.items[i].detected = false;
+	}
+
+	std::thread loadThread(_calibCharucoLoadThread, &batch, _calibCharucoCameraKey(CamMat, CamDist));
+
+	ldiTaskGroup group;
+	int cacheHits = 0;
+
+	for (size_t i = 0; i < batch.items.size(); ++i) {
+		// NOTE: Run pool tasks while waiting on the loader, the pool may have no workers of its own.
+		while (true) {
+			{
+				std::unique_lock<std::mutex> lock(batch.mutex);
+
+				if (batch.loadedCount > (int)i) {
+					break;
+				}
+			}
+
+			if (!threadPoolRunOne()) {
+				std::unique_lock<std::mutex> lock(batch.mutex);
+
+				if (batch.loadedCount <= (int)i) {
+					batch.loadedCondVar.wait_for(lock, std::chrono::milliseconds(1));
+				}
+			}
+		}
+
+		ldiCharucoBatchItem* item = &batch.items[i];
+
+		if (!item->loaded) {
+			_calibCharucoReleaseFrame(&batch, item);
+			continue;
+		}
+
+		if (UseCache) {
+			auto cached = _calibCharucoCache.results.find(item->key);
+
+			if (cached != _calibCharucoCache.results.end()) {
+				item->sample.cube = cached->second;
+				item->detected = true;
+				++cacheHits;
+				_calibCharucoReleaseFrame(&batch, item);
+				continue;
+			}
+		}
+
+		threadPoolRun(&group, _calibCharucoDetectTask, item);
+	}
+
+	threadPoolWait(&group);
+	loadThread.join();
+
+	for (size_t i = 0; i < batch.allDetectors.size(); ++i) {
+		delete batch.allDetectors[i];
+	}
+
+	int sampleCount = 0;
+	int newResultCount = 0;
+
+	for (size_t i = 0; i < batch.items.size(); ++i) {
+		ldiCharucoBatchItem* item = &batch.items[i];
+
+		if (!item->loaded) {
+			continue;
+		}
+
+		if (UseCache && item->detected && _calibCharucoCache.results.count(item->key) == 0) {
+			_calibCharucoCache.results[item->key] = item->sample.cube;
+			++newResultCount;
+		}
+
+		Samples.push_back(item->sample);
+		++sampleCount;
+	}
+
+	if (newResultCount > 0) {
+		calibCharucoCacheSave();
+	}
+
+	std::cout << "Charuco batch: " << sampleCount << " samples, " << cacheHits << " cached, " << (sampleCount - cacheHits) << " detected\n";
+}
+
+//----------------------------------------------------------------------------------------------------
+// Sample archive conversion.
+//----------------------------------------------------------------------------------------------------
+struct ldiSampleConvertContext {
+	const std::vector<std::string>*		paths;
+	int									baseIdx;
+	ldiSampleArchiveEntry*				entries;
+	std::vector<uint8_t>*				packed;
+	bool*								valid;
+};
+
+void calibConvertSampleBatch(int StartIdx, int EndIdx, void* UserData) {
+	ldiSampleConvertContext* context = (ldiSampleConvertContext*)UserData;
+
+	for (int i = StartIdx; i < EndIdx; ++i) {
+		ldiCalibSample sample = {};
+		sample.path = (*context->paths)[context->baseIdx + i];
+
+		context->valid[i] = calibLoadCalibSampleData(&sample);
+
+		if (!context->valid[i]) {
+			continue;
+		}
+
+		ldiSampleArchiveEntry* entry = &context->entries[i];
+		*entry = {};
+		entry->phase = sample.phase;
+		entry->X = sample.X;
+		entry->Y = sample.Y;
+		entry->Z = sample.Z;
+		entry->C = sample.C;
+		entry->A = sample.A;
+
+		sampleArchivePackFrame(&sample.frame, entry, context->packed[i]);
+		calibFreeCalibImages(&sample);
+	}
+}
+
+// Packs a directory of .dat samples into one archive, in directory order. Frames are compressed in
+// parallel a window at a time so memory stays bounded.
+bool calibConvertSampleDirectory(const std::string& DirectoryPath, const std::string& ArchivePath) {
+	PROFILE_ZONE_LOG("Convert samples");
+
+	std::vector<std::string> samplePaths = calibListSamplePaths(DirectoryPath);
+
+	// NOTE: The archive might be open for reading from an earlier job.
+	calibCloseSampleArchives();
+
+	ldiSampleArchive archive;
+
+	if (!sampleArchiveCreate(&archive, ArchivePath)) {
+		return false;
+	}
+
+	int windowSize = threadPoolGetThreadCount() * 2;
+	std::vector<ldiSampleArchiveEntry> entries(windowSize);
+	std::vector<std::vector<uint8_t>> packed(windowSize);
+	bool* valid = new bool[windowSize];
+
+	uint64_t rawBytes = 0;
+	uint64_t packedBytes = 0;
+
+	for (int baseIdx = 0; baseIdx < (int)samplePaths.size(); baseIdx += windowSize) {
+		int count = min(windowSize, (int)samplePaths.size() - baseIdx);
+
+		ldiSampleConvertContext context;
+		context.paths = &samplePaths;
+		context.baseIdx = baseIdx;
+		context.entries = entries.data();
+		context.packed = packed.data();
+		context.valid = valid;
+		parallelFor(0, count, 1, calibConvertSampleBatch, &context);
+
+		for (int i = 0; i < count; ++i) {
+			if (!valid[i]) {
+				continue;
+			}
+
+			sampleArchiveAddPacked(&archive, &entries[i], packed[i]);
+			rawBytes += (uint64_t)entries[i].width * entries[i].height;
+			packedBytes += packed[i].size();
+		}
+
+		std::cout << "Converted " << (baseIdx + count) << "/" << samplePaths.size() << " samples\n";
+	}
+
+	delete[] valid;
+
+	int entryCount = (int)archive.entries.size();
+	sampleArchiveClose(&archive);
+
+	std::cout << "Sample archive " << ArchivePath << ": " << entryCount << " frames, " << (rawBytes / (1024 * 1024)) << " MB -> " << (packedBytes / (1024 * 1024)) << " MB\n";
+
+	return true;
+}
+
+// Takes image sample files and generates the initial calibration samples for a job. DirectoryPath can also
+// be a sample archive.
+void calibFindInitialObservations(ldiCalibrationJob* Job, const std::string& DirectoryPath) {
+	PROFILE_ZONE_LOG("Initial observations");
+
+	calibClearJob(Job);
+
+	calibSetDefaultCamera(Job);
+
+	std::cout << "Filepaths: " << DirectoryPath << "\n";
+
+	std::vector<std::string> samplePaths = calibListSamplePaths(DirectoryPath);
+
+	calibFindCharucoBatch(samplePaths, &Job->camMat, &Job->camDist, Job->samples);
+
 	std::cout << "Initial observations complete\n";
 }
 
@@ -150,8 +530,133 @@ void calibRealignWorldVolume(ldiCalibrationJob* Job, mat4 CubeOffset = mat4(1.0)
 	}
 }
 
+//----------------------------------------------------------------------------------------------------
+// Volume metrics.
+//----------------------------------------------------------------------------------------------------
+struct ldiTbPose {
+	int x;
+	int y;
+	int z;
+	mat4 pose;
+};
+
+struct ldiTbColumn {
+	int x;
+	int y;
+	int z;
+	std::vector<ldiTbPose> poses;
+};
+
+// Columns are kept in first seen order, the map only finds them.
+void _calibAddColumnPose(std::vector<ldiTbColumn>& Columns, std::unordered_map<uint64_t, int>& ColumnIds, uint64_t Key, ldiTbColumn* NewColumn, ldiTbPose* Pose) {
+	auto columnId = ColumnIds.find(Key);
+	int id;
+
+	if (columnId == ColumnIds.end()) {
+		id = (int)Columns.size();
+		ColumnIds[Key] = id;
+		Columns.push_back(*NewColumn);
+	} else {
+		id = columnId->second;
+	}
+
+	Columns[id].poses.push_back(*Pose);
+}
+
+struct ldiColumnDistContext {
+	std::vector<ldiTbColumn>*	columns;
+	double*						accum;
+	int*						counts;
+};
+
+void _calibColumnDistBatch(int StartIdx, int EndIdx, void* UserData) {
+	ldiColumnDistContext* context = (ldiColumnDistContext*)UserData;
+
+	for (int colIter = StartIdx; colIter < EndIdx; ++colIter) {
+		std::vector<ldiTbPose>* poses = &(*context->columns)[colIter].poses;
+		double distAccum = 0.0;
+		int distAccumCount = 0;
+
+		// Pair all cubes in column.
+		for (size_t cubeIter0 = 0; cubeIter0 < poses->size(); ++cubeIter0) {
+			ldiTbPose* cube0 = &(*poses)[cubeIter0];
+
+			for (size_t cubeIter1 = cubeIter0 + 1; cubeIter1 < poses->size(); ++cubeIter1) {
+				ldiTbPose* cube1 = &(*poses)[cubeIter1];
+
+				double cubeMechDist = glm::distance(vec3(cube0->x, cube0->y, cube0->z), vec3(cube1->x, cube1->y, cube1->z));
+				double distVolSpace = glm::distance(vec3(cube0->pose[3]), vec3(cube1->pose[3]));
+				double distNorm = distVolSpace / cubeMechDist;
+
+				distAccum += distNorm;
+				distAccumCount += 1;
+			}
+		}
+
+		context->accum[colIter] = distAccum;
+		context->counts[colIter] = distAccumCount;
+	}
+}
+
+// Average ratio of volume space distance to mechanical distance over all pose pairs in each column.
+double _calibGetColumnAverageDist(std::vector<ldiTbColumn>* Columns) {
+	int columnCount = (int)Columns->size();
+	std::vector<double> accum(columnCount);
+	std::vector<int> counts(columnCount);
+
+	ldiColumnDistContext context;
+	context.columns = Columns;
+	context.accum = accum.data();
+	context.counts = counts.data();
+	parallelFor(0, columnCount, 1, _calibColumnDistBatch, &context);
+
+	// NOTE: Summed in column order so the result doesn't depend on scheduling.
+	double distAccum = 0.0;
+	int distAccumCount = 0;
+
+	for (int i = 0; i < columnCount; ++i) {
+		distAccum += accum[i];
+		distAccumCount += counts[i];
+	}
+
+	return distAccum / (double)distAccumCount;
+}
+
+struct ldiAxisCircleContext {
+	ldiCalibrationJob*			job;
+	std::vector<int>*			posesC;
+	std::vector<int>*			posesA;
+	vec3*						originsC;
+	vec3*						originsA;
+};
+
+void _calibAxisCircleBatch(int StartIdx, int EndIdx, void* UserData) {
+	ldiAxisCircleContext* context = (ldiAxisCircleContext*)UserData;
+	ldiCalibrationJob* job = context->job;
+
+	for (int pointIter = StartIdx; pointIter < EndIdx; ++pointIter) {
+		std::vector<vec3d> axisPointsC;
+		std::vector<vec3d> axisPointsA;
+
+		for (size_t i = 0; i < context->posesC->size(); ++i) {
+			int poseIter = (*context->posesC)[i];
+			axisPointsC.push_back(mat4d(job->cubePoses[poseIter]) * vec4d(job->cube.points[pointIter], 1.0));
+		}
+
+		for (size_t i = 0; i < context->posesA->size(); ++i) {
+			int poseIter = (*context->posesA)[i];
+			axisPointsA.push_back(mat4d(job->cubePoses[poseIter]) * vec4d(job->cube.points[pointIter], 1.0));
+		}
+
+		context->originsC[pointIter] = computerVisionFitCircle(axisPointsC).origin;
+		context->originsA[pointIter] = computerVisionFitCircle(axisPointsA).origin;
+	}
+}
+
 // Determine metrics for the calibration volume.
 void calibEstimateCalibVolumeMetrics(ldiCalibrationJob* Job) {
+	PROFILE_ZONE("Estimate volume metrics");
+
 	Job->metricsCalculated = false;
 
 	if (!Job->initialEstimations) {
@@ -159,27 +664,20 @@ void calibEstimateCalibVolumeMetrics(ldiCalibrationJob* Job) {
 		return;
 	}
 
+	ldiCalibObservations obs;
+	calibBuildObservations(Job, &obs);
+
 	//----------------------------------------------------------------------------------------------------
 	// Sort into columns.
 	//----------------------------------------------------------------------------------------------------
-	struct ldiTbPose {
-		int x;
-		int y;
-		int z;
-		mat4 pose;
-	};
-
-	struct ldiTbColumn {
-		int x;
-		int y;
-		int z;
-		std::vector<ldiTbPose> poses;
-	};
-
 	std::vector<ldiTbColumn> columnX;
 	std::vector<ldiTbColumn> columnY;
 	std::vector<ldiTbColumn> columnZ;
 
+	std::unordered_map<uint64_t, int> columnIdsX;
+	std::unordered_map<uint64_t, int> columnIdsY;
+	std::unordered_map<uint64_t, int> columnIdsZ;
+
 	// TODO: Use view error to decide if view should be included.
 	for (size_t sampleIter = 0; sampleIter < Job->poseToSampleIds.size(); ++sampleIter) {
 		ldiCalibSample* sample = &Job->samples[Job->poseToSampleIds[sampleIter]];
@@ -192,91 +690,31 @@ void calibEstimateCalibVolumeMetrics(ldiCalibrationJob* Job) {
 		int y = sample->Y;
 		int z = sample->Z;
 
-		// X.
-		{
-			size_t columnId = -1;
-			for (size_t i = 0; i < columnX.size(); ++i) {
-				if (columnX[i].y == y && columnX[i].z == z) {
-					columnId = i;
-					break;
-				}
-			}
-
-			if (columnId == -1) {
-				columnId = columnX.size();
+		ldiTbPose pose;
+		pose.x = x;
+		pose.y = y;
+		pose.z = z;
+		pose.pose = Job->cubePoses[sampleIter];
 
-				ldiTbColumn column;
-				column.x = 0;
-				column.y = y;
-				column.z = z;
-				columnX.push_back(column);
-			}
+		ldiTbColumn column;
 
-			ldiTbPose pose;
-			pose.x = x;
-			pose.y = y;
-			pose.z = z;
-			pose.pose = Job->cubePoses[sampleIter];
-			columnX[columnId].poses.push_back(pose);
-
-			//std::cout << "(X) View: " << sampleIter << " Sample: " << stereoSampleId[sampleIter] <<  " Mech: " << x << "," << y << "," << z << "\n";
-		}
+		// X.
+		column.x = 0;
+		column.y = y;
+		column.z = z;
+		_calibAddColumnPose(columnX, columnIdsX, calibGetAxisPairKey(y, z), &column, &pose);
 
 		// Y.
-		{
-			size_t columnId = -1;
-			for (size_t i = 0; i < columnY.size(); ++i) {
-				if (columnY[i].x == x && columnY[i].z == z) {
-					columnId = i;
-					break;
-				}
-			}
-
-			if (columnId == -1) {
-				columnId = columnY.size();
-
-				ldiTbColumn column;
-				column.x = x;
-				column.y = 0;
-				column.z = z;
-				columnY.push_back(column);
-			}
-
-			ldiTbPose pose;
-			pose.x = x;
-			pose.y = y;
-			pose.z = z;
-			pose.pose = Job->cubePoses[sampleIter];
-			columnY[columnId].poses.push_back(pose);
-		}
+		column.x = x;
+		column.y = 0;
+		column.z = z;
+		_calibAddColumnPose(columnY, columnIdsY, calibGetAxisPairKey(x, z), &column, &pose);
 
 		// Z.
-		{
-			size_t columnId = -1;
-			for (size_t i = 0; i < columnZ.size(); ++i) {
-				if (columnZ[i].x == x && columnZ[i].y == y) {
-					columnId = i;
-					break;
-				}
-			}
-
-			if (columnId == -1) {
-				columnId = columnZ.size();
-
-				ldiTbColumn column;
-				column.x = x;
-				column.y = y;
-				column.z = 0;
-				columnZ.push_back(column);
-			}
-
-			ldiTbPose pose;
-			pose.x = x;
-			pose.y = y;
-			pose.z = z;
-			pose.pose = Job->cubePoses[sampleIter];
-			columnZ[columnId].poses.push_back(pose);
-		}
+		column.x = x;
+		column.y = y;
+		column.z = 0;
+		_calibAddColumnPose(columnZ, columnIdsZ, calibGetAxisPairKey(x, y), &column, &pose);
 	}
 
 	std::cout << "X columns: " << columnX.size() << "\n";
@@ -286,99 +724,9 @@ void calibEstimateCalibVolumeMetrics(ldiCalibrationJob* Job) {
 	//----------------------------------------------------------------------------------------------------
 	// Find real movement distances.
 	//----------------------------------------------------------------------------------------------------
-	double distAvgX = 0.0f;
-	double distAvgY = 0.0f;
-	double distAvgZ = 0.0f;
-
-	// X
-	{
-		double distAccum = 0.0;
-		int distAccumCount = 0;
-
-		std::vector<ldiTbColumn>* column = &columnX;
-		for (size_t colIter = 0; colIter < column->size(); ++colIter) {
-
-			// Pair all cubes in column.
-			for (size_t cubeIter0 = 0; cubeIter0 < (*column)[colIter].poses.size(); ++cubeIter0) {
-				ldiTbPose cube0 = (*column)[colIter].poses[cubeIter0];
-
-				for (size_t cubeIter1 = cubeIter0 + 1; cubeIter1 < (*column)[colIter].poses.size(); ++cubeIter1) {
-					ldiTbPose cube1 = (*column)[colIter].poses[cubeIter1];
-
-					double cubeMechDist = glm::distance(vec3(cube0.x, cube0.y, cube0.z), vec3(cube1.x, cube1.y, cube1.z));
-					double distVolSpace = glm::distance(vec3(cube0.pose[3]), vec3(cube1.pose[3]));
-					double distNorm = distVolSpace / cubeMechDist;
-
-					distAccum += distNorm;
-					distAccumCount += 1;
-
-					//std::cout << "Cube point dist: " << distVolSpace << "/" << cubeMechDist << " = " << distNorm << "\n";
-				}
-			}
-		}
-
-		distAvgX = distAccum / (double)distAccumCount;
-	}
-
-	// Y
-	{
-		double distAccum = 0.0;
-		int distAccumCount = 0;
-
-		std::vector<ldiTbColumn>* column = &columnY;
-		for (size_t colIter = 0; colIter < column->size(); ++colIter) {
-
-			// Pair all cubes in column.
-			for (size_t cubeIter0 = 0; cubeIter0 < (*column)[colIter].poses.size(); ++cubeIter0) {
-				ldiTbPose cube0 = (*column)[colIter].poses[cubeIter0];
-
-				for (size_t cubeIter1 = cubeIter0 + 1; cubeIter1 < (*column)[colIter].poses.size(); ++cubeIter1) {
-					ldiTbPose cube1 = (*column)[colIter].poses[cubeIter1];
-
-					double cubeMechDist = glm::distance(vec3(cube0.x, cube0.y, cube0.z), vec3(cube1.x, cube1.y, cube1.z));
-					double distVolSpace = glm::distance(vec3(cube0.pose[3]), vec3(cube1.pose[3]));
-					double distNorm = distVolSpace / cubeMechDist;
-
-					distAccum += distNorm;
-					distAccumCount += 1;
-
-					//std::cout << "Cube point dist: " << distVolSpace << "/" << cubeMechDist << " = " << distNorm << "\n";
-				}
-			}
-		}
-
-		distAvgY = distAccum / (double)distAccumCount;
-	}
-
-	// Z
-	{
-		double distAccum = 0.0;
-		int distAccumCount = 0;
-
-		std::vector<ldiTbColumn>* column = &columnZ;
-		for (size_t colIter = 0; colIter < column->size(); ++colIter) {
-
-			// Pair all cubes in column.
-			for (size_t cubeIter0 = 0; cubeIter0 < (*column)[colIter].poses.size(); ++cubeIter0) {
-				ldiTbPose cube0 = (*column)[colIter].poses[cubeIter0];
-
-				for (size_t cubeIter1 = cubeIter0 + 1; cubeIter1 < (*column)[colIter].poses.size(); ++cubeIter1) {
-					ldiTbPose cube1 = (*column)[colIter].poses[cubeIter1];
-
-					double cubeMechDist = glm::distance(vec3(cube0.x, cube0.y, cube0.z), vec3(cube1.x, cube1.y, cube1.z));
-					double distVolSpace = glm::distance(vec3(cube0.pose[3]), vec3(cube1.pose[3]));
-					double distNorm = distVolSpace / cubeMechDist;
-
-					distAccum += distNorm;
-					distAccumCount += 1;
-
-					//std::cout << "Cube point dist: " << distVolSpace << "/" << cubeMechDist << " = " << distNorm << "\n";
-				}
-			}
-		}
-
-		distAvgZ = distAccum / (double)distAccumCount;
-	}
+	double distAvgX = _calibGetColumnAverageDist(&columnX);
+	double distAvgY = _calibGetColumnAverageDist(&columnY);
+	double distAvgZ = _calibGetColumnAverageDist(&columnZ);
 
 	std::cout << "Dist avg X: " << distAvgX << "\n";
 	std::cout << "Dist avg Y: " << distAvgY << "\n";
@@ -459,44 +807,50 @@ void calibEstimateCalibVolumeMetrics(ldiCalibrationJob* Job) {
 	Job->axisCPoints.clear();
 	Job->axisAPoints.clear();
 
-	// Just for visualization.
+	std::vector<int> posesC;
+	std::vector<int> posesA;
+
 	for (size_t poseIter = 0; poseIter < Job->poseToSampleIds.size(); ++poseIter) {
 		ldiCalibSample* sample = &Job->samples[Job->poseToSampleIds[poseIter]];
 
 		if (sample->phase == 2) {
-			vec3 transPoint = Job->cubePoses[poseIter][3];
-			Job->axisCPoints.push_back(transPoint);
+			posesC.push_back((int)poseIter);
 		} else if (sample->phase == 3) {
-			vec3 transPoint = Job->cubePoses[poseIter][3];
-			Job->axisAPoints.push_back(transPoint);
+			posesA.push_back((int)poseIter);
 		}
 	}
 
+	// Just for visualization.
+	for (size_t i = 0; i < posesC.size(); ++i) {
+		Job->axisCPoints.push_back(Job->cubePoses[posesC[i]][3]);
+	}
+
+	for (size_t i = 0; i < posesA.size(); ++i) {
+		Job->axisAPoints.push_back(Job->cubePoses[posesA[i]][3]);
+	}
+
+	int cubePointCount = (int)Job->cube.points.size();
+	std::vector<vec3> pointOriginsC(cubePointCount);
+	std::vector<vec3> pointOriginsA(cubePointCount);
+
+	ldiAxisCircleContext circleContext;
+	circleContext.job = Job;
+	circleContext.posesC = &posesC;
+	circleContext.posesA = &posesA;
+	circleContext.originsC = pointOriginsC.data();
+	circleContext.originsA = pointOriginsA.data();
+	parallelFor(0, cubePointCount, 1, _calibAxisCircleBatch, &circleContext);
+
 	std::vector<vec3> circOriginsC;
 	std::vector<vec3> circOriginsA;
 
-	for (size_t pointIter = 0; pointIter < Job->cube.points.size(); ++pointIter) {
+	for (int pointIter = 0; pointIter < cubePointCount; ++pointIter) {
 		if (pointIter / 9 == 2) {
 			continue;
 		}
 
-		std::vector<vec3d> axisPointsC;
-		std::vector<vec3d> axisPointsA;
-
-		for (size_t poseIter = 0; poseIter < Job->poseToSampleIds.size(); ++poseIter) {
-			ldiCalibSample* sample = &Job->samples[Job->poseToSampleIds[poseIter]];
-
-			if (sample->phase == 2) {
-				vec3d transPoint = mat4d(Job->cubePoses[poseIter]) * vec4d(Job->cube.points[pointIter], 1.0);
-				axisPointsC.push_back(transPoint);
-			} else if (sample->phase == 3) {
-				vec3d transPoint = mat4d(Job->cubePoses[poseIter]) * vec4d(Job->cube.points[pointIter], 1.0);
-				axisPointsA.push_back(transPoint);
-			}
-		}
-
-		circOriginsC.push_back(computerVisionFitCircle(axisPointsC).origin);
-		circOriginsA.push_back(computerVisionFitCircle(axisPointsA).origin);
+		circOriginsC.push_back(pointOriginsC[pointIter]);
+		circOriginsA.push_back(pointOriginsA[pointIter]);
 	}
 
 	ldiLine fitC = computerVisionFitLine(circOriginsC);
@@ -514,13 +868,15 @@ void calibEstimateCalibVolumeMetrics(ldiCalibrationJob* Job) {
 	mat4 samp0;
 	bool foundSample0 = false;
 
-	for (size_t sampleIter = 0; sampleIter < Job->samples.size(); ++sampleIter) {
-		ldiCalibSample* sample = &Job->samples[sampleIter];
+	const std::vector<int>& zeroSamples = calibGetSamplesInPhase(&obs, 0);
 
-		if (sample->phase == 0) {
-			samp0 = Job->cubePoses[sampleIter];
+	for (size_t i = 0; i < zeroSamples.size(); ++i) {
+		int poseId = obs.sampleToPose[zeroSamples[i]];
+
+		if (poseId != -1) {
+			samp0 = Job->cubePoses[poseId];
 			foundSample0 = true;
-			std::cout << "Zero sample: " << sampleIter << "\n";
+			std::cout << "Zero sample: " << zeroSamples[i] << "\n";
 			break;
 		}
 	}
@@ -537,15 +893,36 @@ void calibEstimateCalibVolumeMetrics(ldiCalibrationJob* Job) {
 	//std::cout << "Zero cube world: " << GetStr(&Job->cubeWorlds[0]) << "\n";
 }
 
-double calibGetProjectionRMSE(ldiCalibrationJob* Job) {
-	std::vector<cv::Point3f> projPoints;
+//----------------------------------------------------------------------------------------------------
+// Projection error.
+//----------------------------------------------------------------------------------------------------
+struct ldiProjectionEvalContext {
+	ldiCalibrationJob*			model;
+	ldiCalibrationJob*			data;
+	ldiCalibObservations*		obs;
+	ldiCameraModel				camModel;
+	mat4						worldToCamera;
+	cv::Point2f*				reproj;
+	double*						sampleErrorSq;
+};
+
+void _calibProjectionEvalBatch(int StartIdx, int EndIdx, void* UserData) {
+	ldiProjectionEvalContext* context = (ldiProjectionEvalContext*)UserData;
+
+	std::vector<vec3> points;
+	std::vector<vec3> projPoints;
+	std::vector<vec2> imagePoints;
+
+	for (int sampleIter = StartIdx; sampleIter < EndIdx; ++sampleIter) {
+		int obsStart = context->obs->sampleObsStart[sampleIter];
+		int obsEnd = context->obs->sampleObsStart[sampleIter + 1];
+		context->sampleErrorSq[sampleIter] = 0.0;
+
+		if (obsStart == obsEnd) {
+			continue;
+		}
 
-	Job->projObs.clear();
-	Job->projReproj.clear();
-	Job->projError.clear();
-	
-	for (size_t sampleIter = 0; sampleIter < Job->samples.size(); ++sampleIter) {
-		ldiCalibSample* sample = &Job->samples[sampleIter];
+		ldiCalibSample* sample = &context->data->samples[sampleIter];
 
 		ldiHorsePosition pos = {};
 		pos.x = sample->X;
@@ -554,53 +931,94 @@ double calibGetProjectionRMSE(ldiCalibrationJob* Job) {
 		pos.a = sample->A;
 		pos.c = sample->C;
 
-		std::vector<vec3> points;
-		horseGetProjectionCubePoints(Job, pos, points);
+		horseGetProjectionCubePoints(context->model, pos, points);
 
-		std::vector<ldiCharucoBoard>* boards = &sample->cube.boards;
-		for (size_t boardIter = 0; boardIter < boards->size(); ++boardIter) {
-			ldiCharucoBoard* board = &(*boards)[boardIter];
+		projPoints.clear();
+		for (int obsIter = obsStart; obsIter < obsEnd; ++obsIter) {
+			projPoints.push_back(points[context->obs->obs[obsIter].cornerGlobalId]);
+		}
 
-			for (size_t cornerIter = 0; cornerIter < board->corners.size(); ++cornerIter) {
-				ldiCharucoCorner* corner = &board->corners[cornerIter];
-				int cornerGlobalId = (board->id * 9) + corner->id;
-				
-				Job->projObs.push_back(corner->position);
-				projPoints.push_back(toPoint3f(points[cornerGlobalId]));
-			}
+		imagePoints.resize(projPoints.size());
+		cameraModelProject(&context->camModel, context->worldToCamera, projPoints.data(), (int)projPoints.size(), imagePoints.data());
+
+		double errorSq = 0.0;
+
+		for (int obsIter = obsStart; obsIter < obsEnd; ++obsIter) {
+			cv::Point2f reproj = toPoint2f(imagePoints[obsIter - obsStart]);
+			context->reproj[obsIter] = reproj;
+
+			double errX = (double)context->obs->obs[obsIter].position.x - (double)reproj.x;
+			double errY = (double)context->obs->obs[obsIter].position.y - (double)reproj.y;
+			errorSq += errX * errX + errY * errY;
 		}
+
+		context->sampleErrorSq[sampleIter] = errorSq;
 	}
+}
 
-	mat4 camMat = glm::inverse(Job->camVolumeMat);
-	cv::Mat rtMat = convertTransformToRT(convertGlmTransMatToOpenCvMat(camMat));
-	
-	cv::Mat r = cv::Mat::zeros(1, 3, CV_64F);
-	r.at<double>(0) = rtMat.at<double>(0);
-	r.at<double>(1) = rtMat.at<double>(1);
-	r.at<double>(2) = rtMat.at<double>(2);
+// Projects the observations of Data through the volume calibration of Model. Model and Data can be the
+// same job, or different jobs to check how well one calibration explains another capture. Returns the
+// per axis RMSE.
+double calibEvaluateProjection(ldiCalibrationJob* Model, ldiCalibrationJob* Data, ldiCalibObservations* Obs, std::vector<cv::Point2f>* Reproj = nullptr) {
+	PROFILE_ZONE("Evaluate projection");
 
-	cv::Mat t = cv::Mat::zeros(1, 3, CV_64F);
-	t.at<double>(0) = rtMat.at<double>(3);
-	t.at<double>(1) = rtMat.at<double>(4);
-	t.at<double>(2) = rtMat.at<double>(5);
+	int sampleCount = (int)Data->samples.size();
+	int obsCount = (int)Obs->obs.size();
 
-	cv::projectPoints(projPoints, r, t, Job->camMat, Job->camDist, Job->projReproj);
+	if (obsCount == 0) {
+		return 0.0;
+	}
 
-	double meanError = 0.0;
-	
-	for (size_t i = 0; i < Job->projObs.size(); ++i) {
-		double errX = (double)Job->projObs[i].x - (double)Job->projReproj[i].x;
-		meanError += errX * errX;
+	std::vector<cv::Point2f> localReproj;
+
+	if (Reproj == nullptr) {
+		Reproj = &localReproj;
+	}
 
-		double errY = (double)Job->projObs[i].y - (double)Job->projReproj[i].y;
-		meanError += errY * errY;
+	Reproj->resize(obsCount);
+	std::vector<double> sampleErrorSq(sampleCount);
 
-		double err = glm::length(Job->projObs[i] - toVec2(Job->projReproj[i]));
-		Job->projError.push_back(err);
+	ldiProjectionEvalContext context;
+	context.model = Model;
+	context.data = Data;
+	context.obs = Obs;
+	context.reproj = Reproj->data();
+	context.sampleErrorSq = sampleErrorSq.data();
+	context.worldToCamera = glm::inverse(Model->camVolumeMat);
+
+	// NOTE: Project only, no undistort grid needed.
+	context.camModel = {};
+	cameraModelInit(&context.camModel, Model->camMat, Model->camDist, 3280, 2464, 0);
+
+	parallelFor(0, sampleCount, 8, _calibProjectionEvalBatch, &context);
+
+	// NOTE: Summed in sample order so the result doesn't depend on scheduling.
+	double meanError = 0.0;
+
+	for (int i = 0; i < sampleCount; ++i) {
+		meanError += sampleErrorSq[i];
 	}
 
-	meanError /= (double)(Job->projObs.size() * 2.0);
-	meanError = sqrt(meanError);
+	meanError /= (double)(obsCount * 2.0);
+
+	return sqrt(meanError);
+}
+
+double calibGetProjectionRMSE(ldiCalibrationJob* Job) {
+	PROFILE_ZONE("Projection RMSE");
+
+	ldiCalibObservations obs;
+	calibBuildObservations(Job, &obs);
+
+	double meanError = calibEvaluateProjection(Job, Job, &obs, &Job->projReproj);
+
+	Job->projObs.resize(obs.obs.size());
+	Job->projError.resize(obs.obs.size());
+
+	for (size_t i = 0; i < obs.obs.size(); ++i) {
+		Job->projObs[i] = obs.obs[i].position;
+		Job->projError[i] = glm::length(Job->projObs[i] - toVec2(Job->projReproj[i]));
+	}
 
 	double pixelRmse = meanError * sqrt(2.0);
 
@@ -609,8 +1027,10 @@ double calibGetProjectionRMSE(ldiCalibrationJob* Job) {
 	return meanError;
 }
 
-// Takes image sample files and generates scanner calibration.
+// Takes image sample files and generates scanner calibration. DirectoryPath can also be a sample archive.
 void calibCalibrateScanner(ldiCalibrationJob* Job, const std::string& DirectoryPath) {
+	PROFILE_ZONE("Calibrate scanner");
+
 	for (size_t i = 0; i < Job->scanSamples.size(); ++i) {
 		calibFreeCalibImages(&Job->scanSamples[i]);
 	}
@@ -626,105 +1046,98 @@ void calibCalibrateScanner(ldiCalibrationJob* Job, const std::string& DirectoryP
 		return;
 	}
 
-	std::vector<std::string> filePaths = listAllFilesInDirectory(DirectoryPath);
+	std::vector<std::string> samplePaths = calibListSamplePaths(DirectoryPath);
 
-	for (int i = 0; i < filePaths.size(); ++i) {
-		if (endsWith(filePaths[i], ".dat")) {
-			ldiCalibSample sample = {};
-			sample.path = filePaths[i];
+	ldiCameraModel camModel = {};
+	cameraModelInit(&camModel, Job->camMat, Job->camDist, 3280, 2464);
 
-			calibLoadCalibSampleData(&sample);
+	for (size_t i = 0; i < samplePaths.size(); ++i) {
+		ldiCalibSample sample = {};
+		sample.path = samplePaths[i];
 
-			// Find machine basis for this sample position.
-			ldiHorsePosition horsePos = {};
-			horsePos.x = sample.X;
-			horsePos.y = sample.Y;
-			horsePos.z = sample.Z;
-			horsePos.c = sample.C;
-			horsePos.a = sample.A;
+		if (!calibLoadCalibSampleData(&sample)) {
+			calibFreeCalibImages(&sample);
+			continue;
+		}
 
-			std::vector<vec3> cubePoints;
-			std::vector<ldiCalibCubeSide> cubeSides;
-			std::vector<vec3> cubeCorners;
+		// Find machine basis for this sample position.
+		ldiHorsePosition horsePos = {};
+		horsePos.x = sample.X;
+		horsePos.y = sample.Y;
+		horsePos.z = sample.Z;
+		horsePos.c = sample.C;
+		horsePos.a = sample.A;
 
-			horseGetRefinedCubeAtPosition(Job, horsePos, cubePoints, cubeSides, cubeCorners);
+		std::vector<vec3> cubePoints;
+		std::vector<ldiCalibCubeSide> cubeSides;
+		std::vector<vec3> cubeCorners;
 
-			// Plane scan line bounds.
-			ldiPlane boundPlanes[4];
+		horseGetRefinedCubeAtPosition(Job, horsePos, cubePoints, cubeSides, cubeCorners);
 
-			vec3 dir01 = glm::normalize(cubeCorners[1] - cubeCorners[0]);
-			vec3 dir12 = glm::normalize(cubeCorners[2] - cubeCorners[1]);
-			vec3 dir23 = glm::normalize(cubeCorners[3] - cubeCorners[2]);
-			vec3 dir30 = glm::normalize(cubeCorners[0] - cubeCorners[3]);
+		// Plane scan line bounds.
+		ldiPlane boundPlanes[4];
 
-			boundPlanes[0].normal = dir01;
-			boundPlanes[0].point = cubeCorners[0] + dir01 * 0.2f;
+		vec3 dir01 = glm::normalize(cubeCorners[1] - cubeCorners[0]);
+		vec3 dir12 = glm::normalize(cubeCorners[2] - cubeCorners[1]);
+		vec3 dir23 = glm::normalize(cubeCorners[3] - cubeCorners[2]);
+		vec3 dir30 = glm::normalize(cubeCorners[0] - cubeCorners[3]);
 
-			boundPlanes[1].normal = dir12;
-			boundPlanes[1].point = cubeCorners[1] + dir12 * 0.01f;
+		boundPlanes[0].normal = dir01;
+		boundPlanes[0].point = cubeCorners[0] + dir01 * 0.2f;
 
-			boundPlanes[2].normal = dir23;
-			boundPlanes[2].point = cubeCorners[2] + dir23 * 0.2f;
+		boundPlanes[1].normal = dir12;
+		boundPlanes[1].point = cubeCorners[1] + dir12 * 0.01f;
 
-			boundPlanes[3].normal = dir30;
-			boundPlanes[3].point = cubeCorners[3] + dir30 * 3.0f;
+		boundPlanes[2].normal = dir23;
+		boundPlanes[2].point = cubeCorners[2] + dir23 * 0.2f;
 
-			{
-				//cv::Mat srcImage(cv::Size(sample.frame.width, sample.frame.height), CV_8UC1, sample.frame.data);
-				//cv::Mat downscaleImage;
-				//cv::Mat upscaleImage;
-				//cv::resize(srcImage, downscaleImage, cv::Size(3280 / 2, 2464 / 2));
-				//cv::resize(downscaleImage, upscaleImage, cv::Size(3280, 2464));
-				//std::vector<vec2> points = computerVisionFindScanLine({ sample.frame.width / 2, sample.frame.height / 2, downscaleImage.data });
-				std::vector<vec2> points = computerVisionFindScanLine(sample.frame);
+		boundPlanes[3].normal = dir30;
+		boundPlanes[3].point = cubeCorners[3] + dir30 * 3.0f;
 
-				std::vector<cv::Point2f> distortedPoints;
-				std::vector<cv::Point2f> undistortedPoints;
+		{
+			//cv::Mat srcImage(cv::Size(sample.frame.width, sample.frame.height), CV_8UC1, sample.frame.data);
+			//cv::Mat downscaleImage;
+			//cv::Mat upscaleImage;
+			//cv::resize(srcImage, downscaleImage, cv::Size(3280 / 2, 2464 / 2));
+			//cv::resize(downscaleImage, upscaleImage, cv::Size(3280, 2464));
+			//std::vector<vec2> points = computerVisionFindScanLine({ sample.frame.width / 2, sample.frame.height / 2, downscaleImage.data });
+			std::vector<vec2> points = computerVisionFindScanLine(sample.frame);
 
-				for (size_t pIter = 0; pIter < points.size(); ++pIter) {
-					distortedPoints.push_back(toPoint2f(points[pIter]));
-				}
+			cameraModelUndistort(&camModel, points.data(), (int)points.size(), points.data());
 
-				cv::undistortPoints(distortedPoints, undistortedPoints, Job->camMat, Job->camDist, cv::noArray(), Job->camMat);
+			Job->scanPoints.push_back(points);
 
-				for (size_t pIter = 0; pIter < points.size(); ++pIter) {
-					points[pIter] = toVec2(undistortedPoints[pIter]);
-				}
+			// Project points against current machine basis.
+			ldiCamera camera = horseGetCamera(Job, horsePos, 3280, 2464);
 
-				Job->scanPoints.push_back(points);
-
-				// Project points against current machine basis.
-				ldiCamera camera = horseGetCamera(Job, horsePos, 3280, 2464);
-
-				//if (i == 0) {
-				{
-					for (size_t pIter = 0; pIter < points.size(); ++pIter) {
-						ldiLine ray = screenToRay(&camera, points[pIter]);
+			//if (i == 0) {
+			{
+				for (size_t pIter = 0; pIter < points.size(); ++pIter) {
+					ldiLine ray = screenToRay(&camera, points[pIter]);
 
-						vec3 worldPoint;
-						getRayPlaneIntersection(ray, cubeSides[1].plane, worldPoint);
+					vec3 worldPoint;
+					getRayPlaneIntersection(ray, cubeSides[1].plane, worldPoint);
 
-						// Check point within bounds.
-						bool pointWithinBounds = true;
-						for (int bIter = 0; bIter < 4; ++bIter) {
-							if (glm::dot(boundPlanes[bIter].normal, worldPoint - boundPlanes[bIter].point) <= 0.0f){
-								pointWithinBounds = false;
-								break;
-							}
+					// Check point within bounds.
+					bool pointWithinBounds = true;
+					for (int bIter = 0; bIter < 4; ++bIter) {
+						if (glm::dot(boundPlanes[bIter].normal, worldPoint - boundPlanes[bIter].point) <= 0.0f){
+							pointWithinBounds = false;
+							break;
 						}
+					}
 
-						if (pointWithinBounds) {
-							Job->scanWorldPoints.push_back(worldPoint);
-							//Job->scanRays[j].push_back(ray);
-						}
+					if (pointWithinBounds) {
+						Job->scanWorldPoints.push_back(worldPoint);
+						//Job->scanRays[j].push_back(ray);
 					}
 				}
 			}
+		}
 
-			calibFreeCalibImages(&sample);
+		calibFreeCalibImages(&sample);
 
-			Job->scanSamples.push_back(sample);
-		}
+		Job->scanSamples.push_back(sample);
 	}
 
 	computerVisionFitPlane(Job->scanWorldPoints, &Job->scanPlane);
@@ -744,6 +1157,8 @@ void calibCalibrateScanner(ldiCalibrationJob* Job, const std::string& DirectoryP
 }
 
 void calibGetInitialEstimations(ldiCalibrationJob* Job) {
+	PROFILE_ZONE("Initial estimations");
+
 	// Unknown parameters (That need initial estimations):
 	// - X axis direction.
 	// - Y axis direction.
@@ -922,6 +1337,8 @@ void calibGetInitialEstimations(ldiCalibrationJob* Job) {
 }
 
 void calibLoadNewBA(ldiCalibrationJob* Job, const std::string& FilePath) {
+	PROFILE_ZONE("Load bundle adjust results");
+
 	FILE* f;
 
 	fopen_s(&f, FilePath.c_str(), "r");
@@ -1032,7 +1449,8 @@ void calibLoadNewBA(ldiCalibrationJob* Job, const std::string& FilePath) {
 }
 
 void calibOptimizeVolume(ldiCalibrationJob* Job) {
-	std::cout << "Starting volume calibration optimization: " << getTime() << "\n";
+	PROFILE_ZONE_LOG("Volume calibration optimization");
+	std::cout << "Starting volume calibration optimization\n";
 
 	STARTUPINFOA si;
 	PROCESS_INFORMATION pi;
@@ -1062,14 +1480,79 @@ void calibOptimizeVolume(ldiCalibrationJob* Job) {
 	calibLoadNewBA(Job, "../cache/ba_refined.txt");
 }
 
-void calibCompareVolumeCalibrations(const std::string& CalibPathA, const std::string& CalibPathB) {
-	ldiCalibrationJob jobA;
-	if (!calibLoadCalibJob(CalibPathA, &jobA)) {
-		return;
+struct ldiCalibJobLoadTask {
+	std::string					path;
+	ldiCalibrationJob*			job;
+	bool						result;
+};
+
+void _calibLoadCalibJobTask(void* UserData) {
+	ldiCalibJobLoadTask* task = (ldiCalibJobLoadTask*)UserData;
+	task->result = calibLoadCalibJob(task->path, task->job);
+}
+
+struct ldiCornerShiftContext {
+	ldiCalibObservations*		obsA;
+	ldiCalibObservations*		obsB;
+	std::vector<std::pair<int, int>>*	samplePairs;
+	double*						shiftAccum;
+	int*						shiftCounts;
+};
+
+void _calibCornerShiftBatch(int StartIdx, int EndIdx, void* UserData) {
+	ldiCornerShiftContext* context = (ldiCornerShiftContext*)UserData;
+
+	for (int pairIter = StartIdx; pairIter < EndIdx; ++pairIter) {
+		int sampleA = (*context->samplePairs)[pairIter].first;
+		int sampleB = (*context->samplePairs)[pairIter].second;
+
+		int aIter = context->obsA->sampleObsStart[sampleA];
+		int aEnd = context->obsA->sampleObsStart[sampleA + 1];
+		int bStart = context->obsB->sampleObsStart[sampleB];
+		int bEnd = context->obsB->sampleObsStart[sampleB + 1];
+
+		double shiftAccum = 0.0;
+		int shiftCount = 0;
+
+		// NOTE: Sample corner lists are tiny, match by corner ID directly.
+		for (; aIter < aEnd; ++aIter) {
+			ldiCalibObservation* obsA = &context->obsA->obs[aIter];
+
+			for (int bIter = bStart; bIter < bEnd; ++bIter) {
+				ldiCalibObservation* obsB = &context->obsB->obs[bIter];
+
+				if (obsA->cornerGlobalId == obsB->cornerGlobalId) {
+					shiftAccum += glm::distance(obsA->position, obsB->position);
+					++shiftCount;
+					break;
+				}
+			}
+		}
+
+		context->shiftAccum[pairIter] = shiftAccum;
+		context->shiftCounts[pairIter] = shiftCount;
 	}
+}
+
+void calibCompareVolumeCalibrations(const std::string& CalibPathA, const std::string& CalibPathB) {
+	PROFILE_ZONE("Compare volume calibrations");
 
+	ldiCalibrationJob jobA;
 	ldiCalibrationJob jobB;
-	if (!calibLoadCalibJob(CalibPathB, &jobB)) {
+
+	// NOTE: Load B on the pool while A loads here.
+	ldiCalibJobLoadTask loadB;
+	loadB.path = CalibPathB;
+	loadB.job = &jobB;
+	loadB.result = false;
+
+	ldiTaskGroup loadGroup;
+	threadPoolRun(&loadGroup, _calibLoadCalibJobTask, &loadB);
+
+	bool loadedA = calibLoadCalibJob(CalibPathA, &jobA);
+	threadPoolWait(&loadGroup);
+
+	if (!loadedA || !loadB.result) {
 		return;
 	}
 
@@ -1117,4 +1600,65 @@ void calibCompareVolumeCalibrations(const std::string& CalibPathA, const std::st
 	std::cout << "Angle XC: " << errorXC << "\n";
 	std::cout << "Cam mat: " << (jobA.camMat - jobB.camMat) << "\n";
 	std::cout << "Cam dist: " << (jobA.camDist - jobB.camDist) << "\n";
+
+	//----------------------------------------------------------------------------------------------------
+	// Cross projection.
+	//----------------------------------------------------------------------------------------------------
+	ldiCalibObservations obsA;
+	ldiCalibObservations obsB;
+	calibBuildObservations(&jobA, &obsA);
+	calibBuildObservations(&jobB, &obsB);
+
+	std::cout << "Projection RMSE:\n";
+	std::cout << "A data, A calib: " << calibEvaluateProjection(&jobA, &jobA, &obsA) << "\n";
+	std::cout << "B data, B calib: " << calibEvaluateProjection(&jobB, &jobB, &obsB) << "\n";
+	std::cout << "A data, B calib: " << calibEvaluateProjection(&jobB, &jobA, &obsA) << "\n";
+	std::cout << "B data, A calib: " << calibEvaluateProjection(&jobA, &jobB, &obsB) << "\n";
+
+	//----------------------------------------------------------------------------------------------------
+	// Shared positions.
+	//----------------------------------------------------------------------------------------------------
+	// Samples captured at the same axis position in both sets, compared by image corner shift.
+	std::vector<std::pair<int, int>> samplePairs;
+	std::vector<int> matches;
+
+	for (size_t sampleIter = 0; sampleIter < jobA.samples.size(); ++sampleIter) {
+		ldiCalibSample* sample = &jobA.samples[sampleIter];
+
+		matches.clear();
+		calibFindSamplesAtPosition(&jobB, &obsB, sample->X, sample->Y, sample->Z, sample->C, sample->A, matches);
+
+		for (size_t i = 0; i < matches.size(); ++i) {
+			if (jobB.samples[matches[i]].phase == sample->phase) {
+				samplePairs.push_back(std::pair<int, int>((int)sampleIter, matches[i]));
+				break;
+			}
+		}
+	}
+
+	int pairCount = (int)samplePairs.size();
+	std::vector<double> shiftAccum(pairCount);
+	std::vector<int> shiftCounts(pairCount);
+
+	ldiCornerShiftContext shiftContext;
+	shiftContext.obsA = &obsA;
+	shiftContext.obsB = &obsB;
+	shiftContext.samplePairs = &samplePairs;
+	shiftContext.shiftAccum = shiftAccum.data();
+	shiftContext.shiftCounts = shiftCounts.data();
+	parallelFor(0, pairCount, 8, _calibCornerShiftBatch, &shiftContext);
+
+	double totalShift = 0.0;
+	int totalCount = 0;
+
+	for (int i = 0; i < pairCount; ++i) {
+		totalShift += shiftAccum[i];
+		totalCount += shiftCounts[i];
+	}
+
+	std::cout << "Shared positions: " << pairCount << " samples, " << totalCount << " corners\n";
+
+	if (totalCount > 0) {
+		std::cout << "Mean corner shift: " << (totalShift / (double)totalCount) << " (pixel)\n";
+	}
 }
\ No newline at end of file
@@ -156,10 +156,182 @@ void calibSaveStereoCalibImage(ldiImage* Image0, ldiImage* Image1, int X, int Y,
 	fclose(file);
 }
 
-void calibLoadCalibSampleData(ldiCalibSample* Sample) {
+//----------------------------------------------------------------------------------------------------
+// Sample archives.
+//----------------------------------------------------------------------------------------------------
+// Samples in an archive use "<archive path>#<index>" as their path, so job files that store sample paths
+// work the same for archives and directories of .dat files. Archives are opened on first use and shared.
+
+std::mutex							_calibArchivesMutex;
+std::vector<ldiSampleArchive*>		_calibArchives;
+
+std::string calibGetArchiveSamplePath(const std::string& ArchivePath, int Index) {
+	return ArchivePath + "#" + std::to_string(Index);
+}
+
+bool calibParseArchiveSamplePath(const std::string& Path, std::string& ArchivePath, int* Index) {
+	size_t split = Path.rfind('#');
+
+	if (split == std::string::npos) {
+		return false;
+	}
+
+	ArchivePath = Path.substr(0, split);
+
+	if (!endsWith(ArchivePath, SAMPLE_ARCHIVE_EXT)) {
+		return false;
+	}
+
+	*Index = atoi(Path.c_str() + split + 1);
+
+	return true;
+}
+
+ldiSampleArchive* calibGetSampleArchive(const std::string& ArchivePath) {
+	std::unique_lock<std::mutex> lock(_calibArchivesMutex);
+
+	for (size_t i = 0; i < _calibArchives.size(); ++i) {
+		if (_calibArchives[i]->path == ArchivePath) {
+			return _calibArchives[i];
+		}
+	}
+
+	ldiSampleArchive* archive = new ldiSampleArchive();
+
+	if (!sampleArchiveOpen(archive, ArchivePath)) {
+		delete archive;
+		return nullptr;
+	}
+
+	_calibArchives.push_back(archive);
+
+	return archive;
+}
+
+void calibCloseSampleArchives() {
+	std::unique_lock<std::mutex> lock(_calibArchivesMutex);
+
+	for (size_t i = 0; i < _calibArchives.size(); ++i) {
+		sampleArchiveClose(_calibArchives[i]);
+		delete _calibArchives[i];
+	}
+
+	_calibArchives.clear();
+}
+
+// Path can be a directory of .dat files or a sample archive.
+std::vector<std::string> calibListSamplePaths(const std::string& Path) {
+	std::vector<std::string> result;
+
+	if (endsWith(Path, SAMPLE_ARCHIVE_EXT)) {
+		ldiSampleArchive* archive = calibGetSampleArchive(Path);
+
+		if (archive) {
+			for (size_t i = 0; i < archive->entries.size(); ++i) {
+				result.push_back(calibGetArchiveSamplePath(Path, (int)i));
+			}
+		}
+
+		return result;
+	}
+
+	std::vector<std::string> filePaths = listAllFilesInDirectory(Path);
+
+	for (size_t i = 0; i < filePaths.size(); ++i) {
+		if (endsWith(filePaths[i], ".dat")) {
+			result.push_back(filePaths[i]);
+		}
+	}
+
+	return result;
+}
+
+ldiSampleArchiveEntry* _calibReadArchiveSample(const std::string& Path, std::vector<uint8_t>& Packed) {
+	std::string archivePath;
+	int index;
+
+	if (!calibParseArchiveSamplePath(Path, archivePath, &index)) {
+		return nullptr;
+	}
+
+	ldiSampleArchive* archive = calibGetSampleArchive(archivePath);
+
+	if (archive == nullptr || !sampleArchiveReadPacked(archive, index, Packed)) {
+		std::cout << "Could not read archive sample: " << Path << "\n";
+		return nullptr;
+	}
+
+	return &archive->entries[index];
+}
+
+// Decodes a frame left packed by calibLoadCalibSampleData.
+bool calibUnpackCalibSampleData(ldiCalibSample* Sample, std::vector<uint8_t>& Packed) {
+	std::string archivePath;
+	int index;
+
+	if (!calibParseArchiveSamplePath(Sample->path, archivePath, &index)) {
+		return false;
+	}
+
+	ldiSampleArchive* archive = calibGetSampleArchive(archivePath);
+
+	if (archive == nullptr) {
+		return false;
+	}
+
+	Sample->frame.data = new uint8_t[Sample->frame.width * Sample->frame.height];
+
+	if (!sampleArchiveUnpack(&archive->entries[index], Packed, &Sample->frame)) {
+		std::cout << "Could not decode archive sample: " << Sample->path << "\n";
+		delete[] Sample->frame.data;
+		Sample->frame.data = nullptr;
+		return false;
+	}
+
+	Sample->imageLoaded = true;
+
+	return true;
+}
+
+//----------------------------------------------------------------------------------------------------
+// Sample files.
+//----------------------------------------------------------------------------------------------------
+// ContentHash, if not null, receives a hash of the whole .dat file. Archive samples give the same hash as
+// the file they were converted from. If Packed is not null, archive frames are left compressed in it for
+// calibUnpackCalibSampleData so decoding can happen on another thread.
+bool calibLoadCalibSampleData(ldiCalibSample* Sample, uint64_t* ContentHash = nullptr, std::vector<uint8_t>* Packed = nullptr) {
+	std::vector<uint8_t> localPacked;
+	ldiSampleArchiveEntry* entry = _calibReadArchiveSample(Sample->path, Packed ? *Packed : localPacked);
+
+	if (entry) {
+		Sample->phase = entry->phase;
+		Sample->X = entry->X;
+		Sample->Y = entry->Y;
+		Sample->Z = entry->Z;
+		Sample->C = entry->C;
+		Sample->A = entry->A;
+		Sample->frame.width = entry->width;
+		Sample->frame.height = entry->height;
+
+		if (ContentHash) {
+			*ContentHash = entry->contentHash;
+		}
+
+		if (Packed) {
+			return true;
+		}
+
+		return calibUnpackCalibSampleData(Sample, localPacked);
+	}
+
 	FILE* file;
 	fopen_s(&file, Sample->path.c_str(), "rb");
 
+	if (file == 0) {
+		std::cout << "Could not open calib sample: " << Sample->path << "\n";
+		return false;
+	}
+
 	fread(&Sample->phase, sizeof(int), 1, file);
 	fread(&Sample->X, sizeof(int), 1, file);
 	fread(&Sample->Y, sizeof(int), 1, file);
@@ -176,11 +348,25 @@ void calibLoadCalibSampleData(ldiCalibSample* Sample) {
 	Sample->frame.width = width;
 	Sample->frame.height = height;
 
-	fread(Sample->frame.data, width * height, 1, file);
+	size_t frameRead = fread(Sample->frame.data, width * height, 1, file);
+	fclose(file);
+
+	if (frameRead != 1) {
+		std::cout << "Calib sample is truncated: " << Sample->path << "\n";
+		delete[] Sample->frame.data;
+		Sample->frame.data = nullptr;
+		return false;
+	}
 
 	Sample->imageLoaded = true;
 
-	fclose(file);
+	if (ContentHash) {
+		int header[8] = { Sample->phase, Sample->X, Sample->Y, Sample->Z, Sample->C, Sample->A, width, height };
+		*ContentHash = hashFnv1a(HASH_FNV1A_SEED, header, sizeof(header));
+		*ContentHash = hashFnv1a(*ContentHash, Sample->frame.data, (size_t)width * height);
+	}
+
+	return true;
 }
 
 void calibFreeCalibImages(ldiCalibSample* Sample) {
@@ -193,6 +379,16 @@ void calibFreeCalibImages(ldiCalibSample* Sample) {
 void calibLoadSampleImages(ldiCalibSample* Sample) {
 	calibFreeCalibImages(Sample);
 
+	std::vector<uint8_t> packed;
+	ldiSampleArchiveEntry* entry = _calibReadArchiveSample(Sample->path, packed);
+
+	if (entry) {
+		Sample->frame.width = entry->width;
+		Sample->frame.height = entry->height;
+		calibUnpackCalibSampleData(Sample, packed);
+		return;
+	}
+
 	FILE* file;
 	fopen_s(&file, Sample->path.c_str(), "rb");
 
@@ -395,6 +591,62 @@ void deserializeCharucoBoard(FILE* File, ldiCharucoBoard* Board) {
 	}
 }
 
+void serializeCharucoResults(FILE* File, ldiCharucoResults* Results) {
+	serializeVectorPrep(File, Results->markers);
+	for (size_t i = 0; i < Results->markers.size(); ++i) {
+		fwrite(&Results->markers[i], sizeof(ldiCharucoMarker), 1, File);
+	}
+
+	serializeVectorPrep(File, Results->rejectedMarkers);
+	for (size_t i = 0; i < Results->rejectedMarkers.size(); ++i) {
+		fwrite(&Results->rejectedMarkers[i], sizeof(ldiCharucoMarker), 1, File);
+	}
+
+	serializeVectorPrep(File, Results->boards);
+	for (size_t i = 0; i < Results->boards.size(); ++i) {
+		serializeCharucoBoard(File, &Results->boards[i]);
+	}
+
+	serializeVectorPrep(File, Results->rejectedBoards);
+	for (size_t i = 0; i < Results->rejectedBoards.size(); ++i) {
+		serializeCharucoBoard(File, &Results->rejectedBoards[i]);
+	}
+}
+
+void deserializeCharucoResults(FILE* File, ldiCharucoResults* Results) {
+	Results->markers.clear();
+	size_t count = deserializeVectorPrep(File);
+	for (size_t i = 0; i < count; ++i) {
+		ldiCharucoMarker marker = {};
+		fread(&marker, sizeof(ldiCharucoMarker), 1, File);
+		Results->markers.push_back(marker);
+	}
+
+	Results->rejectedMarkers.clear();
+	count = deserializeVectorPrep(File);
+	for (size_t i = 0; i < count; ++i) {
+		ldiCharucoMarker marker = {};
+		fread(&marker, sizeof(ldiCharucoMarker), 1, File);
+		Results->rejectedMarkers.push_back(marker);
+	}
+
+	Results->boards.clear();
+	count = deserializeVectorPrep(File);
+	for (size_t i = 0; i < count; ++i) {
+		ldiCharucoBoard board = {};
+		deserializeCharucoBoard(File, &board);
+		Results->boards.push_back(board);
+	}
+
+	Results->rejectedBoards.clear();
+	count = deserializeVectorPrep(File);
+	for (size_t i = 0; i < count; ++i) {
+		ldiCharucoBoard board = {};
+		deserializeCharucoBoard(File, &board);
+		Results->rejectedBoards.push_back(board);
+	}
+}
+
 void serialize(FILE* File, ldiQuadModel* Model) {
 	serialize(File, Model->verts);
 	serialize(File, Model->indices);
@@ -486,29 +738,7 @@ void calibSaveCalibJob(const std::string& FilePath, ldiCalibrationJob* Job) {
 		fwrite(&sample->C, sizeof(int), 1, file);
 		fwrite(&sample->A, sizeof(int), 1, file);
 
-		auto chRes = &sample->cube;
-
-		serializeVectorPrep(file, chRes->markers);
-		for (size_t markerIter = 0; markerIter < chRes->markers.size(); ++markerIter) {
-			auto marker = &chRes->markers[markerIter];
-			fwrite(&marker, sizeof(ldiCharucoMarker), 1, file);
-		}
-
-		serializeVectorPrep(file, chRes->rejectedMarkers);
-		for (size_t markerIter = 0; markerIter < chRes->rejectedMarkers.size(); ++markerIter) {
-			auto marker = &chRes->rejectedMarkers[markerIter];
-			fwrite(&marker, sizeof(ldiCharucoMarker), 1, file);
-		}
-
-		serializeVectorPrep(file, chRes->boards);
-		for (size_t boardIter = 0; boardIter < chRes->boards.size(); ++boardIter) {
-			serializeCharucoBoard(file, &chRes->boards[boardIter]);
-		}
-
-		serializeVectorPrep(file, chRes->rejectedBoards);
-		for (size_t boardIter = 0; boardIter < chRes->rejectedBoards.size(); ++boardIter) {
-			serializeCharucoBoard(file, &chRes->rejectedBoards[boardIter]);
-		}
+		serializeCharucoResults(file, &sample->cube);
 	}
 
 	serializeMat(file, Job->camMat);
@@ -588,35 +818,7 @@ bool calibLoadCalibJob(const std::string& FilePath, ldiCalibrationJob* Job) {
 		fread(&sample.C, sizeof(int), 1, file);
 		fread(&sample.A, sizeof(int), 1, file);
 
-		auto chRes = &sample.cube;
-
-		size_t markerCount = deserializeVectorPrep(file);
-		for (size_t markerIter = 0; markerIter < markerCount; ++markerIter) {
-			ldiCharucoMarker marker = {};
-			fread(&marker, sizeof(ldiCharucoMarker), 1, file);
-			chRes->markers.push_back(marker);
-		}
-
-		markerCount = deserializeVectorPrep(file);
-		for (size_t markerIter = 0; markerIter < markerCount; ++markerIter) {
-			ldiCharucoMarker marker = {};
-			fread(&marker, sizeof(ldiCharucoMarker), 1, file);
-			chRes->rejectedMarkers.push_back(marker);
-		}
-
-		size_t boardCount = deserializeVectorPrep(file);
-		for (size_t boardIter = 0; boardIter < boardCount; ++boardIter) {
-			ldiCharucoBoard board = {};
-			deserializeCharucoBoard(file, &board);
-			chRes->boards.push_back(board);
-		}
-
-		boardCount = deserializeVectorPrep(file);
-		for (size_t boardIter = 0; boardIter < boardCount; ++boardIter) {
-			ldiCharucoBoard board = {};
-			deserializeCharucoBoard(file, &board);
-			chRes->rejectedBoards.push_back(board);
-		}
+		deserializeCharucoResults(file, &sample.cube);
 
 		Job->samples.push_back(sample);
 	}
@@ -0,0 +1,465 @@
+#pragma once
+
+#include <emmintrin.h>
+
+//----------------------------------------------------------------------------------------------------
+// Camera model.
+//----------------------------------------------------------------------------------------------------
+// Pinhole camera with the OpenCV Brown-Conrady distortion the calibration produces (k1 k2 p1 p2 k3 and
+// the rational k4 k5 k6). Project and undistort run over contiguous arrays, 4 points at a time with
+// SSE2, and don't allocate.
+//
+// Undistortion starts from a lookup grid of converged inverses built at init, bilinearly interpolated,
+// then refined with Newton steps on the distortion model. Points outside the grid fall back to the fixed
+// point iteration cv::undistortPoints uses, from the distorted position.
+//
+// NOTE: cv::undistortPoints stops after 5 iterations by default, which leaves over a pixel of error in
+// the image corners of the IMX219 lens. Results here are the converged inverse.
+//
+// Usage:
+//   ldiCameraModel model = {};
+//   cameraModelInit(&model, Job->camMat, Job->camDist, 3280, 2464);
+//   cameraModelUndistort(&model, points.data(), (int)points.size(), points.data());
+
+#define CAMERA_MODEL_GRID_STEP 16
+#define CAMERA_MODEL_NEWTON_STEPS 1
+// NOTE: Same cap cv::undistortPoints uses by default, only hit outside the grid.
+#define CAMERA_MODEL_FALLBACK_ITERATIONS 5
+#define CAMERA_MODEL_GRID_ITERATIONS 20
+
+struct ldiCameraModel {
+	double					fx;
+	double					fy;
+	double					cx;
+	double					cy;
+	// NOTE: OpenCV order, k1 k2 p1 p2 k3 k4 k5 k6.
+	double					dist[8];
+
+	int						width;
+	int						height;
+	uint64_t				key;
+
+	// Undistorted normalized coords at every GridStep pixels, NaN where the inverse doesn't exist.
+	int						gridStep;
+	int						gridWidth;
+	int						gridHeight;
+	std::vector<vec2>		grid;
+};
+
+//----------------------------------------------------------------------------------------------------
+// Scalar model.
+//----------------------------------------------------------------------------------------------------
+inline void _cameraModelDistort(ldiCameraModel* Model, double X, double Y, double* Xd, double* Yd) {
+	const double* k = Model->dist;
+	double x2 = X * X;
+	double y2 = Y * Y;
+	double xy = X * Y;
+	double r2 = x2 + y2;
+	double r4 = r2 * r2;
+	double r6 = r4 * r2;
+
+	double radial = (1.0 + k[0] * r2 + k[1] * r4 + k[4] * r6) / (1.0 + k[5] * r2 + k[6] * r4 + k[7] * r6);
+
+	*Xd = X * radial + 2.0 * k[2] * xy + k[3] * (r2 + 2.0 * x2);
+	*Yd = Y * radial + k[2] * (r2 + 2.0 * y2) + 2.0 * k[3] * xy;
+}
+
+// Inverse of distortion for normalized coords. Returns false if the iteration left the valid region, in
+// which case the result is the distorted input, matching cv::undistortPoints.
+inline bool _cameraModelUndistortIterate(ldiCameraModel* Model, double Xd, double Yd, double X, double Y, int Iterations, double* ResultX, double* ResultY) {
+	const double* k = Model->dist;
+
+	for (int i = 0; i < Iterations; ++i) {
+		double r2 = X * X + Y * Y;
+		double r4 = r2 * r2;
+		double r6 = r4 * r2;
+
+		double icdist = (1.0 + k[5] * r2 + k[6] * r4 + k[7] * r6) / (1.0 + k[0] * r2 + k[1] * r4 + k[4] * r6);
+
+		if (icdist < 0.0) {
+			*ResultX = Xd;
+			*ResultY = Yd;
+			return false;
+		}
+
+		double deltaX = 2.0 * k[2] * X * Y + k[3] * (r2 + 2.0 * X * X);
+		double deltaY = k[2] * (r2 + 2.0 * Y * Y) + 2.0 * k[3] * X * Y;
+
+		X = (Xd - deltaX) * icdist;
+		Y = (Yd - deltaY) * icdist;
+	}
+
+	*ResultX = X;
+	*ResultY = Y;
+
+	return true;
+}
+
+// One Newton step towards distort(X, Y) == (Xd, Yd).
+inline void _cameraModelNewtonStep(ldiCameraModel* Model, double Xd, double Yd, double* X, double* Y) {
+	const double* k = Model->dist;
+	double x = *X;
+	double y = *Y;
+	double x2 = x * x;
+	double y2 = y * y;
+	double xy = x * y;
+	double r2 = x2 + y2;
+	double r4 = r2 * r2;
+	double r6 = r4 * r2;
+
+	double num = 1.0 + k[0] * r2 + k[1] * r4 + k[4] * r6;
+	double den = 1.0 + k[5] * r2 + k[6] * r4 + k[7] * r6;
+	double numD = k[0] + 2.0 * k[1] * r2 + 3.0 * k[4] * r4;
+	double denD = k[5] + 2.0 * k[6] * r2 + 3.0 * k[7] * r4;
+	double radial = num / den;
+	// Derivative of radial by r2.
+	double radialD = (numD * den - num * denD) / (den * den);
+
+	double errX = x * radial + 2.0 * k[2] * xy + k[3] * (r2 + 2.0 * x2) - Xd;
+	double errY = y * radial + k[2] * (r2 + 2.0 * y2) + 2.0 * k[3] * xy - Yd;
+
+	// NOTE: Jacobian is symmetric.
+	double jXX = radial + 2.0 * x2 * radialD + 2.0 * k[2] * y + 6.0 * k[3] * x;
+	double jXY = 2.0 * xy * radialD + 2.0 * k[2] * x + 2.0 * k[3] * y;
+	double jYY = radial + 2.0 * y2 * radialD + 6.0 * k[2] * y + 2.0 * k[3] * x;
+	double invDet = 1.0 / (jXX * jYY - jXY * jXY);
+
+	*X = x - (jYY * errX - jXY * errY) * invDet;
+	*Y = y - (jXX * errY - jXY * errX) * invDet;
+}
+
+vec2 cameraModelProjectScalar(ldiCameraModel* Model, const mat4& WorldToCamera, vec3 Point) {
+	vec3 p = WorldToCamera * vec4(Point, 1.0f);
+	double invZ = (p.z != 0.0f) ? 1.0 / p.z : 1.0;
+
+	double xd, yd;
+	_cameraModelDistort(Model, p.x * invZ, p.y * invZ, &xd, &yd);
+
+	return vec2(xd * Model->fx + Model->cx, yd * Model->fy + Model->cy);
+}
+
+vec2 cameraModelUndistortScalar(ldiCameraModel* Model, vec2 Point) {
+	double xd = (Point.x - Model->cx) / Model->fx;
+	double yd = (Point.y - Model->cy) / Model->fy;
+
+	double x, y;
+	_cameraModelUndistortIterate(Model, xd, yd, xd, yd, CAMERA_MODEL_FALLBACK_ITERATIONS, &x, &y);
+
+	return vec2(x * Model->fx + Model->cx, y * Model->fy + Model->cy);
+}
+
+//----------------------------------------------------------------------------------------------------
+// Init.
+//----------------------------------------------------------------------------------------------------
+struct ldiCameraModelGridContext {
+	ldiCameraModel*			model;
+};
+
+void _cameraModelGridBatch(int StartIdx, int EndIdx, void* UserData) {
+	ldiCameraModelGridContext* context = (ldiCameraModelGridContext*)UserData;
+	ldiCameraModel* model = context->model;
+
+	for (int gY = StartIdx; gY < EndIdx; ++gY) {
+		for (int gX = 0; gX < model->gridWidth; ++gX) {
+			double xd = (gX * model->gridStep - model->cx) / model->fx;
+			double yd = (gY * model->gridStep - model->cy) / model->fy;
+
+			double x, y;
+			vec2* node = &model->grid[gX + gY * model->gridWidth];
+
+			if (_cameraModelUndistortIterate(model, xd, yd, xd, yd, CAMERA_MODEL_GRID_ITERATIONS, &x, &y)) {
+				// NOTE: Fixed point gets close, Newton polishes to full precision.
+				for (int step = 0; step < 3; ++step) {
+					_cameraModelNewtonStep(model, xd, yd, &x, &y);
+				}
+
+				*node = vec2(x, y);
+			} else {
+				*node = vec2(NAN, NAN);
+			}
+		}
+	}
+}
+
+// Rebuilds only when the calibration or image size changed, so it is cheap to call before every batch.
+// GridStep of 0 skips the undistort grid for models that only project.
+// NOTE: The key is hashed from the matrices as given, they are only converted to doubles on a rebuild.
+void cameraModelInit(ldiCameraModel* Model, cv::Mat CamMat, cv::Mat CamDist, int Width, int Height, int GridStep = CAMERA_MODEL_GRID_STEP) {
+	int layout[7] = { CamMat.type(), (int)CamMat.total(), CamDist.type(), (int)CamDist.total(), Width, Height, GridStep };
+
+	uint64_t key = hashFnv1a(HASH_FNV1A_SEED, layout, sizeof(layout));
+	key = hashFnv1a(key, CamMat.data, CamMat.total() * CamMat.elemSize());
+	key = hashFnv1a(key, CamDist.data, CamDist.total() * CamDist.elemSize());
+
+	if (key == Model->key) {
+		return;
+	}
+
+	PROFILE_ZONE("Camera model init");
+
+	cv::Mat camMat;
+	cv::Mat camDist;
+	CamMat.convertTo(camMat, CV_64F);
+	CamDist.convertTo(camDist, CV_64F);
+
+	int distCount = (int)camDist.total();
+
+	Model->key = key;
+	Model->width = Width;
+	Model->height = Height;
+
+	Model->fx = camMat.at<double>(0, 0);
+	Model->fy = camMat.at<double>(1, 1);
+	Model->cx = camMat.at<double>(0, 2);
+	Model->cy = camMat.at<double>(1, 2);
+
+	for (int i = 0; i < 8; ++i) {
+		Model->dist[i] = (i < distCount) ? camDist.at<double>(i) : 0.0;
+	}
+
+	for (int i = 8; i < distCount; ++i) {
+		if (camDist.at<double>(i) != 0.0) {
+			std::cout << "Camera model: Thin prism and tilt coefficients are not supported\n";
+			break;
+		}
+	}
+
+	Model->gridStep = GridStep;
+	Model->grid.clear();
+
+	if (GridStep <= 0) {
+		Model->gridWidth = 0;
+		Model->gridHeight = 0;
+		return;
+	}
+
+	Model->gridWidth = (Width + GridStep - 1) / GridStep + 1;
+	Model->gridHeight = (Height + GridStep - 1) / GridStep + 1;
+	Model->grid.resize(Model->gridWidth * Model->gridHeight);
+
+	ldiCameraModelGridContext context;
+	context.model = Model;
+	parallelFor(0, Model->gridHeight, 8, _cameraModelGridBatch, &context);
+}
+
+//----------------------------------------------------------------------------------------------------
+// Batched project.
+//----------------------------------------------------------------------------------------------------
+inline void _cameraModelDistort4(ldiCameraModel* Model, __m128 X, __m128 Y, __m128* Xd, __m128* Yd) {
+	const double* k = Model->dist;
+	__m128 one = _mm_set1_ps(1.0f);
+	__m128 two = _mm_set1_ps(2.0f);
+
+	__m128 x2 = _mm_mul_ps(X, X);
+	__m128 y2 = _mm_mul_ps(Y, Y);
+	__m128 xy = _mm_mul_ps(X, Y);
+	__m128 r2 = _mm_add_ps(x2, y2);
+	__m128 r4 = _mm_mul_ps(r2, r2);
+	__m128 r6 = _mm_mul_ps(r4, r2);
+
+	__m128 num = _mm_add_ps(one, _mm_mul_ps(_mm_set1_ps((float)k[0]), r2));
+	num = _mm_add_ps(num, _mm_mul_ps(_mm_set1_ps((float)k[1]), r4));
+	num = _mm_add_ps(num, _mm_mul_ps(_mm_set1_ps((float)k[4]), r6));
+
+	__m128 den = _mm_add_ps(one, _mm_mul_ps(_mm_set1_ps((float)k[5]), r2));
+	den = _mm_add_ps(den, _mm_mul_ps(_mm_set1_ps((float)k[6]), r4));
+	den = _mm_add_ps(den, _mm_mul_ps(_mm_set1_ps((float)k[7]), r6));
+
+	__m128 radial = _mm_div_ps(num, den);
+	__m128 p1 = _mm_set1_ps((float)k[2]);
+	__m128 p2 = _mm_set1_ps((float)k[3]);
+
+	// X * radial + 2 * p1 * xy + p2 * (r2 + 2 * x2).
+	__m128 xd = _mm_mul_ps(X, radial);
+	xd = _mm_add_ps(xd, _mm_mul_ps(_mm_mul_ps(two, p1), xy));
+	xd = _mm_add_ps(xd, _mm_mul_ps(p2, _mm_add_ps(r2, _mm_mul_ps(two, x2))));
+
+	// Y * radial + p1 * (r2 + 2 * y2) + 2 * p2 * xy.
+	__m128 yd = _mm_mul_ps(Y, radial);
+	yd = _mm_add_ps(yd, _mm_mul_ps(p1, _mm_add_ps(r2, _mm_mul_ps(two, y2))));
+	yd = _mm_add_ps(yd, _mm_mul_ps(_mm_mul_ps(two, p2), xy));
+
+	*Xd = xd;
+	*Yd = yd;
+}
+
+// Projects world Points through WorldToCamera and the lens into pixel Results.
+void cameraModelProject(ldiCameraModel* Model, const mat4& WorldToCamera, const vec3* Points, int Count, vec2* Results) {
+	const mat4& m = WorldToCamera;
+	__m128 fx = _mm_set1_ps((float)Model->fx);
+	__m128 fy = _mm_set1_ps((float)Model->fy);
+	__m128 cx = _mm_set1_ps((float)Model->cx);
+	__m128 cy = _mm_set1_ps((float)Model->cy);
+	__m128 one = _mm_set1_ps(1.0f);
+
+	int i = 0;
+
+	for (; i + 4 <= Count; i += 4) {
+		const vec3* p = Points + i;
+		__m128 px = _mm_setr_ps(p[0].x, p[1].x, p[2].x, p[3].x);
+		__m128 py = _mm_setr_ps(p[0].y, p[1].y, p[2].y, p[3].y);
+		__m128 pz = _mm_setr_ps(p[0].z, p[1].z, p[2].z, p[3].z);
+
+		__m128 cX = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(m[0][0]), px), _mm_mul_ps(_mm_set1_ps(m[1][0]), py)), _mm_add_ps(_mm_mul_ps(_mm_set1_ps(m[2][0]), pz), _mm_set1_ps(m[3][0])));
+		__m128 cY = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(m[0][1]), px), _mm_mul_ps(_mm_set1_ps(m[1][1]), py)), _mm_add_ps(_mm_mul_ps(_mm_set1_ps(m[2][1]), pz), _mm_set1_ps(m[3][1])));
+		__m128 cZ = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(m[0][2]), px), _mm_mul_ps(_mm_set1_ps(m[1][2]), py)), _mm_add_ps(_mm_mul_ps(_mm_set1_ps(m[2][2]), pz), _mm_set1_ps(m[3][2])));
+
+		// NOTE: Points on the camera plane use Z of 1, same as cv::projectPoints.
+		__m128 zeroZ = _mm_cmpeq_ps(cZ, _mm_setzero_ps());
+		__m128 invZ = _mm_div_ps(one, _mm_or_ps(_mm_and_ps(zeroZ, one), _mm_andnot_ps(zeroZ, cZ)));
+
+		__m128 xd, yd;
+		_cameraModelDistort4(Model, _mm_mul_ps(cX, invZ), _mm_mul_ps(cY, invZ), &xd, &yd);
+
+		__m128 u = _mm_add_ps(_mm_mul_ps(xd, fx), cx);
+		__m128 v = _mm_add_ps(_mm_mul_ps(yd, fy), cy);
+
+		// Interleave back to vec2.
+		_mm_storeu_ps(&Results[i].x, _mm_unpacklo_ps(u, v));
+		_mm_storeu_ps(&Results[i + 2].x, _mm_unpackhi_ps(u, v));
+	}
+
+	for (; i < Count; ++i) {
+		Results[i] = cameraModelProjectScalar(Model, WorldToCamera, Points[i]);
+	}
+}
+
+//----------------------------------------------------------------------------------------------------
+// Batched undistort.
+//----------------------------------------------------------------------------------------------------
+// Bilinear grid guess in normalized coords. Returns false outside the grid or next to a failed node.
+inline bool _cameraModelGridGuess(ldiCameraModel* Model, vec2 Point, vec2* Guess) {
+	if (Model->gridStep <= 0) {
+		return false;
+	}
+
+	float gx = Point.x / Model->gridStep;
+	float gy = Point.y / Model->gridStep;
+
+	if (!(gx >= 0.0f && gy >= 0.0f && gx < Model->gridWidth - 1 && gy < Model->gridHeight - 1)) {
+		return false;
+	}
+
+	int x0 = (int)gx;
+	int y0 = (int)gy;
+	float fX = gx - x0;
+	float fY = gy - y0;
+
+	const vec2* row0 = &Model->grid[x0 + y0 * Model->gridWidth];
+	const vec2* row1 = row0 + Model->gridWidth;
+
+	vec2 a = row0[0] + (row0[1] - row0[0]) * fX;
+	vec2 b = row1[0] + (row1[1] - row1[0]) * fX;
+	*Guess = a + (b - a) * fY;
+
+	// NOTE: NaN fails both comparisons.
+	return Guess->x == Guess->x && Guess->y == Guess->y;
+}
+
+// Undistorts pixel Points into pixel Results, in place is fine.
+void cameraModelUndistort(ldiCameraModel* Model, const vec2* Points, int Count, vec2* Results) {
+	const double* k = Model->dist;
+	float invFx = (float)(1.0 / Model->fx);
+	float invFy = (float)(1.0 / Model->fy);
+
+	__m128 one = _mm_set1_ps(1.0f);
+	__m128 two = _mm_set1_ps(2.0f);
+	__m128 three = _mm_set1_ps(3.0f);
+	__m128 six = _mm_set1_ps(6.0f);
+	__m128 k1 = _mm_set1_ps((float)k[0]);
+	__m128 k2 = _mm_set1_ps((float)k[1]);
+	__m128 p1 = _mm_set1_ps((float)k[2]);
+	__m128 p2 = _mm_set1_ps((float)k[3]);
+	__m128 k3 = _mm_set1_ps((float)k[4]);
+	__m128 k4 = _mm_set1_ps((float)k[5]);
+	__m128 k5 = _mm_set1_ps((float)k[6]);
+	__m128 k6 = _mm_set1_ps((float)k[7]);
+	__m128 fx = _mm_set1_ps((float)Model->fx);
+	__m128 fy = _mm_set1_ps((float)Model->fy);
+	__m128 cx = _mm_set1_ps((float)Model->cx);
+	__m128 cy = _mm_set1_ps((float)Model->cy);
+
+	int i = 0;
+
+	for (; i + 4 <= Count; i += 4) {
+		alignas(16) float gx[4], gy[4], dx[4], dy[4];
+		bool inGrid = true;
+
+		for (int j = 0; j < 4; ++j) {
+			vec2 guess;
+			inGrid &= _cameraModelGridGuess(Model, Points[i + j], &guess);
+			gx[j] = guess.x;
+			gy[j] = guess.y;
+			dx[j] = (Points[i + j].x - (float)Model->cx) * invFx;
+			dy[j] = (Points[i + j].y - (float)Model->cy) * invFy;
+		}
+
+		if (!inGrid) {
+			for (int j = 0; j < 4; ++j) {
+				Results[i + j] = cameraModelUndistortScalar(Model, Points[i + j]);
+			}
+
+			continue;
+		}
+
+		__m128 x = _mm_load_ps(gx);
+		__m128 y = _mm_load_ps(gy);
+		__m128 xd = _mm_load_ps(dx);
+		__m128 yd = _mm_load_ps(dy);
+
+		for (int step = 0; step < CAMERA_MODEL_NEWTON_STEPS; ++step) {
+			__m128 x2 = _mm_mul_ps(x, x);
+			__m128 y2 = _mm_mul_ps(y, y);
+			__m128 xy = _mm_mul_ps(x, y);
+			__m128 r2 = _mm_add_ps(x2, y2);
+			__m128 r4 = _mm_mul_ps(r2, r2);
+			__m128 r6 = _mm_mul_ps(r4, r2);
+
+			__m128 num = _mm_add_ps(_mm_add_ps(one, _mm_mul_ps(k1, r2)), _mm_add_ps(_mm_mul_ps(k2, r4), _mm_mul_ps(k3, r6)));
+			__m128 den = _mm_add_ps(_mm_add_ps(one, _mm_mul_ps(k4, r2)), _mm_add_ps(_mm_mul_ps(k5, r4), _mm_mul_ps(k6, r6)));
+			__m128 numD = _mm_add_ps(k1, _mm_add_ps(_mm_mul_ps(_mm_mul_ps(two, k2), r2), _mm_mul_ps(_mm_mul_ps(three, k3), r4)));
+			__m128 denD = _mm_add_ps(k4, _mm_add_ps(_mm_mul_ps(_mm_mul_ps(two, k5), r2), _mm_mul_ps(_mm_mul_ps(three, k6), r4)));
+			__m128 invDen = _mm_div_ps(one, den);
+			__m128 radial = _mm_mul_ps(num, invDen);
+			__m128 radialD = _mm_mul_ps(_mm_sub_ps(numD, _mm_mul_ps(radial, denD)), invDen);
+
+			__m128 errX = _mm_add_ps(_mm_mul_ps(x, radial), _mm_add_ps(_mm_mul_ps(_mm_mul_ps(two, p1), xy), _mm_mul_ps(p2, _mm_add_ps(r2, _mm_mul_ps(two, x2)))));
+			__m128 errY = _mm_add_ps(_mm_mul_ps(y, radial), _mm_add_ps(_mm_mul_ps(p1, _mm_add_ps(r2, _mm_mul_ps(two, y2))), _mm_mul_ps(_mm_mul_ps(two, p2), xy)));
+			errX = _mm_sub_ps(errX, xd);
+			errY = _mm_sub_ps(errY, yd);
+
+			__m128 jXX = _mm_add_ps(_mm_add_ps(radial, _mm_mul_ps(_mm_mul_ps(two, x2), radialD)), _mm_add_ps(_mm_mul_ps(_mm_mul_ps(two, p1), y), _mm_mul_ps(_mm_mul_ps(six, p2), x)));
+			__m128 jXY = _mm_add_ps(_mm_mul_ps(_mm_mul_ps(two, xy), radialD), _mm_add_ps(_mm_mul_ps(_mm_mul_ps(two, p1), x), _mm_mul_ps(_mm_mul_ps(two, p2), y)));
+			__m128 jYY = _mm_add_ps(_mm_add_ps(radial, _mm_mul_ps(_mm_mul_ps(two, y2), radialD)), _mm_add_ps(_mm_mul_ps(_mm_mul_ps(six, p1), y), _mm_mul_ps(_mm_mul_ps(two, p2), x)));
+			__m128 invDet = _mm_div_ps(one, _mm_sub_ps(_mm_mul_ps(jXX, jYY), _mm_mul_ps(jXY, jXY)));
+
+			x = _mm_sub_ps(x, _mm_mul_ps(_mm_sub_ps(_mm_mul_ps(jYY, errX), _mm_mul_ps(jXY, errY)), invDet));
+			y = _mm_sub_ps(y, _mm_mul_ps(_mm_sub_ps(_mm_mul_ps(jXX, errY), _mm_mul_ps(jXY, errX)), invDet));
+		}
+
+		__m128 u = _mm_add_ps(_mm_mul_ps(x, fx), cx);
+		__m128 v = _mm_add_ps(_mm_mul_ps(y, fy), cy);
+
+		_mm_storeu_ps(&Results[i].x, _mm_unpacklo_ps(u, v));
+		_mm_storeu_ps(&Results[i + 2].x, _mm_unpackhi_ps(u, v));
+	}
+
+	for (; i < Count; ++i) {
+		vec2 guess;
+
+		if (_cameraModelGridGuess(Model, Points[i], &guess)) {
+			double xd = (Points[i].x - Model->cx) / Model->fx;
+			double yd = (Points[i].y - Model->cy) / Model->fy;
+			double x = guess.x;
+			double y = guess.y;
+
+			for (int step = 0; step < CAMERA_MODEL_NEWTON_STEPS; ++step) {
+				_cameraModelNewtonStep(Model, xd, yd, &x, &y);
+			}
+
+			Results[i] = vec2(x * Model->fx + Model->cx, y * Model->fy + Model->cy);
+		} else {
+			Results[i] = cameraModelUndistortScalar(Model, Points[i]);
+		}
+	}
+}
\ No newline at end of file
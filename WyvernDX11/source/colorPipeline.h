@@ -0,0 +1,358 @@
+#pragma once
+
+#include <emmintrin.h>
+#include "lcms2.h"
+
+//----------------------------------------------------------------------------------------------------
+// Color pipeline.
+//----------------------------------------------------------------------------------------------------
+// sRGB to CMYK conversion for source textures. Transforms are cached by a hash of the profile contents
+// and intent, so repeated imports skip profile parsing and transform optimization. Images are converted
+// in row tiles across the thread pool, either exactly through lcms or through a 33^3 LUT with
+// tetrahedral interpolation. The gamma corrected channel previews are written in the same pass.
+
+#define COLOR_LUT_SIZE 33
+#define COLOR_TILE_ROWS 16
+
+struct ldiColorTransform {
+	uint64_t				key;
+	cmsHTRANSFORM			transform;
+
+	// RGB to CMYK at COLOR_LUT_SIZE^3 grid points, 4 floats per point in 0..255.
+	bool					lutBuilt;
+	std::vector<float>		lut;
+	// NOTE: Per input byte, the lower grid index and the weight towards the next one.
+	int						lutIdx[256];
+	float					lutFrac[256];
+};
+
+struct ldiColorPipeline {
+	std::mutex							mutex;
+	std::vector<ldiColorTransform*>		transforms;
+};
+
+ldiColorPipeline _colorPipeline;
+
+// Ink colors used to view each CMYK channel.
+const vec3 colorCmykInkColor[4] = {
+	vec3(0, 166.0 / 255.0, 214.0 / 255.0),
+	vec3(1.0f, 0, 144.0 / 255.0),
+	vec3(245.0 / 255.0, 230.0 / 255.0, 23.0 / 255.0),
+	vec3(0.0f, 0.0f, 0.0f)
+};
+
+void _colorBuildLut(ldiColorTransform* Transform, cmsHPROFILE SrcProfile, cmsHPROFILE DstProfile, int Intent) {
+	PROFILE_ZONE_LOG("Build CMYK LUT");
+
+	const int n = COLOR_LUT_SIZE;
+
+	// NOTE: 16 bit in and out so grid points between 8 bit values are sampled exactly.
+	cmsHTRANSFORM transform16 = cmsCreateTransform(SrcProfile, TYPE_RGB_16, DstProfile, TYPE_CMYK_16, Intent, 0);
+
+	std::vector<uint16_t> gridRgb(n * n * n * 3);
+	std::vector<uint16_t> gridCmyk(n * n * n * 4);
+
+	for (int iR = 0; iR < n; ++iR) {
+		for (int iG = 0; iG < n; ++iG) {
+			for (int iB = 0; iB < n; ++iB) {
+				int idx = (iR * n + iG) * n + iB;
+				gridRgb[idx * 3 + 0] = (uint16_t)((iR * 65535 + (n - 1) / 2) / (n - 1));
+				gridRgb[idx * 3 + 1] = (uint16_t)((iG * 65535 + (n - 1) / 2) / (n - 1));
+				gridRgb[idx * 3 + 2] = (uint16_t)((iB * 65535 + (n - 1) / 2) / (n - 1));
+			}
+		}
+	}
+
+	cmsDoTransform(transform16, gridRgb.data(), gridCmyk.data(), n * n * n);
+	cmsDeleteTransform(transform16);
+
+	Transform->lut.resize(n * n * n * 4);
+
+	for (int i = 0; i < n * n * n * 4; ++i) {
+		Transform->lut[i] = gridCmyk[i] * (255.0f / 65535.0f);
+	}
+
+	for (int i = 0; i < 256; ++i) {
+		float f = i * (n - 1) / 255.0f;
+		int idx = min((int)f, n - 2);
+
+		Transform->lutIdx[i] = idx;
+		Transform->lutFrac[i] = f - idx;
+	}
+
+	Transform->lutBuilt = true;
+}
+
+// Returns a cached sRGB (RGBA_8) to CMYK_8 transform, creating it on first use. Returns null if a
+// profile can't be loaded.
+ldiColorTransform* colorGetTransform(const char* SrcProfilePath, const char* DstProfilePath, int Intent, bool BuildLut) {
+	uint8_t* srcData = nullptr;
+	uint8_t* dstData = nullptr;
+	int srcSize = readFile(SrcProfilePath, &srcData);
+	int dstSize = readFile(DstProfilePath, &dstData);
+
+	if (srcSize <= 0 || dstSize <= 0) {
+		std::cout << "Could not load color profiles " << SrcProfilePath << ", " << DstProfilePath << "\n";
+		delete[] srcData;
+		delete[] dstData;
+		return nullptr;
+	}
+
+	uint64_t key = HASH_FNV1A_SEED;
+	key = hashFnv1a(key, srcData, srcSize);
+	key = hashFnv1a(key, dstData, dstSize);
+	key = hashFnv1a(key, &Intent, sizeof(Intent));
+
+	std::unique_lock<std::mutex> lock(_colorPipeline.mutex);
+
+	ldiColorTransform* result = nullptr;
+
+	for (size_t i = 0; i < _colorPipeline.transforms.size(); ++i) {
+		if (_colorPipeline.transforms[i]->key == key) {
+			result = _colorPipeline.transforms[i];
+			break;
+		}
+	}
+
+	if (!result || (BuildLut && !result->lutBuilt)) {
+		PROFILE_ZONE_LOG("Create color transform");
+
+		cmsHPROFILE srcProfile = cmsOpenProfileFromMem(srcData, srcSize);
+		cmsHPROFILE dstProfile = cmsOpenProfileFromMem(dstData, dstSize);
+
+		if (!srcProfile || !dstProfile) {
+			std::cout << "Could not open color profiles\n";
+		} else {
+			if (!result) {
+				std::cout << "sRGB color profile info: " << cmsGetProfileVersion(srcProfile) << "\n";
+				std::cout << "CMYK color profile info: " << cmsGetProfileVersion(dstProfile) << "\n";
+
+				result = new ldiColorTransform();
+				result->key = key;
+				result->lutBuilt = false;
+				result->transform = cmsCreateTransform(srcProfile, TYPE_RGBA_8, dstProfile, TYPE_CMYK_8, Intent, 0);
+				_colorPipeline.transforms.push_back(result);
+			}
+
+			if (BuildLut && !result->lutBuilt) {
+				_colorBuildLut(result, srcProfile, dstProfile, Intent);
+			}
+		}
+
+		if (srcProfile) {
+			cmsCloseProfile(srcProfile);
+		}
+
+		if (dstProfile) {
+			cmsCloseProfile(dstProfile);
+		}
+	}
+
+	delete[] srcData;
+	delete[] dstData;
+
+	return result;
+}
+
+void colorPipelineDestroy() {
+	std::unique_lock<std::mutex> lock(_colorPipeline.mutex);
+
+	for (size_t i = 0; i < _colorPipeline.transforms.size(); ++i) {
+		cmsDeleteTransform(_colorPipeline.transforms[i]->transform);
+		delete _colorPipeline.transforms[i];
+	}
+
+	_colorPipeline.transforms.clear();
+}
+
+//----------------------------------------------------------------------------------------------------
+// LUT evaluation.
+//----------------------------------------------------------------------------------------------------
+// NOTE: All 4 output channels are interpolated at once in one SSE register.
+inline uint32_t _colorLutSample(ldiColorTransform* Transform, const uint8_t* Rgb) {
+	const int n = COLOR_LUT_SIZE;
+	const float* lut = Transform->lut.data();
+
+	int iR = Transform->lutIdx[Rgb[0]];
+	int iG = Transform->lutIdx[Rgb[1]];
+	int iB = Transform->lutIdx[Rgb[2]];
+	float fR = Transform->lutFrac[Rgb[0]];
+	float fG = Transform->lutFrac[Rgb[1]];
+	float fB = Transform->lutFrac[Rgb[2]];
+
+	const int strideR = n * n * 4;
+	const int strideG = n * 4;
+	const int strideB = 4;
+
+	const float* c000 = lut + iR * strideR + iG * strideG + iB * strideB;
+	const float* c111 = c000 + strideR + strideG + strideB;
+
+	// NOTE: Pick the tetrahedron containing the point, walking from c000 to c111 along the axes
+	// in order of decreasing fraction.
+	int stride0, stride1;
+	float w0, w1, w2;
+
+	if (fR >= fG) {
+		if (fG >= fB) {
+			stride0 = strideR; stride1 = strideR + strideG; w0 = fR; w1 = fG; w2 = fB;
+		} else if (fR >= fB) {
+			stride0 = strideR; stride1 = strideR + strideB; w0 = fR; w1 = fB; w2 = fG;
+		} else {
+			stride0 = strideB; stride1 = strideR + strideB; w0 = fB; w1 = fR; w2 = fG;
+		}
+	} else {
+		if (fR >= fB) {
+			stride0 = strideG; stride1 = strideR + strideG; w0 = fG; w1 = fR; w2 = fB;
+		} else if (fG >= fB) {
+			stride0 = strideG; stride1 = strideG + strideB; w0 = fG; w1 = fB; w2 = fR;
+		} else {
+			stride0 = strideB; stride1 = strideG + strideB; w0 = fB; w1 = fG; w2 = fR;
+		}
+	}
+
+	__m128 p0 = _mm_loadu_ps(c000);
+	__m128 p1 = _mm_loadu_ps(c000 + stride0);
+	__m128 p2 = _mm_loadu_ps(c000 + stride1);
+	__m128 p3 = _mm_loadu_ps(c111);
+
+	// c = p0 + w0 * (p1 - p0) + w1 * (p2 - p1) + w2 * (p3 - p2).
+	__m128 c = _mm_add_ps(p0, _mm_mul_ps(_mm_set1_ps(w0), _mm_sub_ps(p1, p0)));
+	c = _mm_add_ps(c, _mm_mul_ps(_mm_set1_ps(w1), _mm_sub_ps(p2, p1)));
+	c = _mm_add_ps(c, _mm_mul_ps(_mm_set1_ps(w2), _mm_sub_ps(p3, p2)));
+
+	__m128i ci = _mm_cvtps_epi32(c);
+	ci = _mm_packs_epi32(ci, ci);
+	ci = _mm_packus_epi16(ci, ci);
+
+	return (uint32_t)_mm_cvtsi128_si32(ci);
+}
+
+//----------------------------------------------------------------------------------------------------
+// Image conversion.
+//----------------------------------------------------------------------------------------------------
+struct ldiColorPreviewTables {
+	// Packed RGBA preview color for each channel value.
+	uint32_t		channel[4][256];
+};
+
+void colorCreatePreviewTables(ldiColorPreviewTables* Tables) {
+	for (int channelIter = 0; channelIter < 4; ++channelIter) {
+		for (int i = 0; i < 256; ++i) {
+			float vi = LinearToGamma(i / 255.0f);
+			vec3 col = glm::mix(vec3(1, 1, 1), colorCmykInkColor[channelIter], vi);
+
+			uint32_t r = (uint8_t)(col.r * 255);
+			uint32_t g = (uint8_t)(col.g * 255);
+			uint32_t b = (uint8_t)(col.b * 255);
+
+			Tables->channel[channelIter][i] = r | (g << 8) | (b << 16) | (255u << 24);
+		}
+	}
+}
+
+struct ldiColorConvertContext {
+	ldiColorTransform*		transform;
+	bool					useLut;
+	int						width;
+	int						height;
+	const uint8_t*			srcRgba;
+	uint8_t*				dstCmyk;
+	// Optional, 4 RGBA images.
+	ldiImage*				previews;
+	ldiColorPreviewTables	tables;
+};
+
+void _colorWritePreviews(ldiColorConvertContext* Context, int StartPixel, int EndPixel) {
+	const uint32_t* cmyk = (const uint32_t*)Context->dstCmyk;
+	uint32_t* c = (uint32_t*)Context->previews[0].data;
+	uint32_t* m = (uint32_t*)Context->previews[1].data;
+	uint32_t* y = (uint32_t*)Context->previews[2].data;
+	uint32_t* k = (uint32_t*)Context->previews[3].data;
+
+	for (int i = StartPixel; i < EndPixel; ++i) {
+		uint32_t v = cmyk[i];
+		c[i] = Context->tables.channel[0][v & 0xFF];
+		m[i] = Context->tables.channel[1][(v >> 8) & 0xFF];
+		y[i] = Context->tables.channel[2][(v >> 16) & 0xFF];
+		k[i] = Context->tables.channel[3][v >> 24];
+	}
+}
+
+void colorConvertBatch(int StartIdx, int EndIdx, void* UserData) {
+	ldiColorConvertContext* context = (ldiColorConvertContext*)UserData;
+
+	for (int tileIter = StartIdx; tileIter < EndIdx; ++tileIter) {
+		int startRow = tileIter * COLOR_TILE_ROWS;
+		int endRow = min(startRow + COLOR_TILE_ROWS, context->height);
+		int startPixel = startRow * context->width;
+		int endPixel = endRow * context->width;
+
+		if (context->srcRgba) {
+			if (context->useLut) {
+				uint32_t* dst = (uint32_t*)context->dstCmyk;
+
+				for (int i = startPixel; i < endPixel; ++i) {
+					dst[i] = _colorLutSample(context->transform, context->srcRgba + i * 4);
+				}
+			} else {
+				cmsDoTransform(context->transform->transform, context->srcRgba + startPixel * 4, context->dstCmyk + startPixel * 4, endPixel - startPixel);
+			}
+		}
+
+		// NOTE: Previews are written while the tile is still in cache.
+		if (context->previews) {
+			_colorWritePreviews(context, startPixel, endPixel);
+		}
+	}
+}
+
+void _colorAllocPreviews(ldiImage* Previews, int Width, int Height) {
+	for (int i = 0; i < 4; ++i) {
+		Previews[i].width = Width;
+		Previews[i].height = Height;
+		Previews[i].data = new uint8_t[Width * Height * 4];
+	}
+}
+
+// Converts an RGBA image to CMYK, allocates Dst. If Previews is not null also allocates and fills the 4
+// channel preview images. UseLut is faster but approximate, the transform must have been created with a LUT.
+void colorConvertImage(ldiColorTransform* Transform, ldiImage* Src, ldiImage* Dst, bool UseLut, ldiImage* Previews) {
+	Dst->width = Src->width;
+	Dst->height = Src->height;
+	Dst->data = new uint8_t[Src->width * Src->height * 4];
+
+	ldiColorConvertContext cc;
+	cc.transform = Transform;
+	cc.useLut = UseLut && Transform->lutBuilt;
+	cc.width = Src->width;
+	cc.height = Src->height;
+	cc.srcRgba = Src->data;
+	cc.dstCmyk = Dst->data;
+	cc.previews = Previews;
+
+	if (Previews) {
+		_colorAllocPreviews(Previews, Src->width, Src->height);
+		colorCreatePreviewTables(&cc.tables);
+	}
+
+	int tileCount = (Src->height + COLOR_TILE_ROWS - 1) / COLOR_TILE_ROWS;
+	parallelFor(0, tileCount, 1, colorConvertBatch, &cc);
+}
+
+// Creates the 4 channel preview images for an existing CMYK image.
+void colorCreateCmykPreviews(ldiImage* Cmyk, ldiImage* Previews) {
+	ldiColorConvertContext cc;
+	cc.transform = nullptr;
+	cc.useLut = false;
+	cc.width = Cmyk->width;
+	cc.height = Cmyk->height;
+	cc.srcRgba = nullptr;
+	cc.dstCmyk = Cmyk->data;
+	cc.previews = Previews;
+
+	_colorAllocPreviews(Previews, Cmyk->width, Cmyk->height);
+	colorCreatePreviewTables(&cc.tables);
+
+	int tileCount = (Cmyk->height + COLOR_TILE_ROWS - 1) / COLOR_TILE_ROWS;
+	parallelFor(0, tileCount, 1, colorConvertBatch, &cc);
+}
\ No newline at end of file
@@ -1,5 +1,7 @@
 #pragma once
 
+#include <emmintrin.h>
+
 auto _dictionary = cv::aruco::getPredefinedDictionary(cv::aruco::DICT_4X4_1000);
 std::vector<cv::Ptr<cv::aruco::CharucoBoard>> _charucoBoards;
 
@@ -414,12 +416,42 @@ void createCharucos(bool Output) {
 	}
 }
 
-bool computerVisionFindCharuco(ldiImage Image, ldiCharucoResults* Results, cv::Mat* CameraMatrix, cv::Mat* CameraDist) {
+// Detector state for computerVisionFindCharuco. Building it is not free, so batch jobs keep one per thread
+// and reuse it across frames.
+struct ldiCharucoDetector {
+	cv::aruco::DetectorParameters			parameters;
+	cv::aruco::ArucoDetector				arucoDetector;
+	std::vector<cv::aruco::CharucoDetector>	charucoDetectors;
+};
+
+void computerVisionCharucoDetectorInit(ldiCharucoDetector* Detector) {
+	Detector->parameters = cv::aruco::DetectorParameters();
+	Detector->parameters.minMarkerPerimeterRate = 0.015;
+	// TODO: Check if this is doing anything.
+	Detector->parameters.cornerRefinementMethod = cv::aruco::CORNER_REFINE_SUBPIX;
+
+	Detector->arucoDetector = cv::aruco::ArucoDetector(_dictionary, Detector->parameters);
+
+	Detector->charucoDetectors.clear();
+	for (size_t i = 0; i < _charucoBoards.size(); ++i) {
+		Detector->charucoDetectors.push_back(cv::aruco::CharucoDetector(*(_charucoBoards[i]).get(), cv::aruco::CharucoParameters(), Detector->parameters));
+	}
+}
+
+// Detector can be null, a temporary one is built for the call.
+bool computerVisionFindCharuco(ldiImage Image, ldiCharucoResults* Results, cv::Mat* CameraMatrix, cv::Mat* CameraDist, ldiCharucoDetector* Detector = nullptr) {
 	int offset = 1;
 
 	try {
 		double t0 = getTime();
 
+		ldiCharucoDetector localDetector;
+
+		if (Detector == nullptr) {
+			computerVisionCharucoDetectorInit(&localDetector);
+			Detector = &localDetector;
+		}
+
 		cv::Mat srcImage(cv::Size(Image.width, Image.height), CV_8UC1, Image.data);
 
 		//{
@@ -451,16 +483,9 @@ bool computerVisionFindCharuco(ldiImage Image, ldiCharucoResults* Results, cv::M
 		//	//cv::resize(downscaleImage, srcImage, cv::Size(3280, 2464), 0.0, 0.0, cv::INTER_LINEAR);
 		//}
 
-		auto parameters = cv::aruco::DetectorParameters();
-		parameters.minMarkerPerimeterRate = 0.015;
-		// TODO: Check if this is doing anything.
-		parameters.cornerRefinementMethod = cv::aruco::CORNER_REFINE_SUBPIX;
-
-		cv::aruco::ArucoDetector arucoDetector(_dictionary, parameters);
-
 		std::vector<int> markerIds;
 		std::vector<std::vector<cv::Point2f>> markerCorners, rejectedMarkers;
-		arucoDetector.detectMarkers(srcImage, markerCorners, markerIds, rejectedMarkers);
+		Detector->arucoDetector.detectMarkers(srcImage, markerCorners, markerIds, rejectedMarkers);
 
 		// TODO: Use refine strategy to detect more markers.
 		//cv::Ptr<cv::aruco::Board> board = charucoBoard.staticCast<aruco::Board>();
@@ -506,8 +531,7 @@ bool computerVisionFindCharuco(ldiImage Image, ldiCharucoResults* Results, cv::M
 				std::vector<cv::Point2f> charucoCorners;
 				std::vector<int> charucoIds;
 
-				cv::aruco::CharucoDetector charucoDetector(*(_charucoBoards[i]).get(), cv::aruco::CharucoParameters(), parameters);
-				charucoDetector.detectBoard(srcImage, charucoCorners, charucoIds, markerCorners, markerIds);
+				Detector->charucoDetectors[i].detectBoard(srcImage, charucoCorners, charucoIds, markerCorners, markerIds);
 				//std::cout << "    " << i << " Charucos: " << charucoIds.size() << "\n";
 
 				// Board is valid if it has at least one corner.
@@ -1100,18 +1124,42 @@ ldiCircle computerVisionFitCircle(std::vector<vec3d>& Points) {
 	return circle;
 }
 
-std::vector<vec2> computerVisionFindScanLine(ldiImage Image) {
-	std::vector<vec2> result;
+//----------------------------------------------------------------------------------------------------
+// Scan line extraction.
+//----------------------------------------------------------------------------------------------------
+// Finds the laser line in a camera frame as one sub-pixel point per signal per column. Intensities are
+// remapped through a table, thresholded 16 columns at a time, and the frame is processed in column
+// strips across the thread pool. Rows are walked in memory order inside each strip. The input frame
+// is never modified.
+
+#define SCAN_LINE_STRIP_WIDTH 64
 
-	int mappingMin = 22;
-	int mappingMax = 75;
+enum ldiScanLinePeakMode {
+	SLPM_CENTROID,
+	SLPM_GAUSSIAN,
+};
+
+struct ldiScanLineExtractor {
+	// Input value to remapped intensity.
+	uint8_t					remap[256];
+	// Smallest input value that remaps to at least peakMin.
+	int						peakMinInput;
+	ldiScanLinePeakMode		peakMode;
+
+	// ROI in pixels, zero width or height uses the full frame.
+	int						roiX;
+	int						roiY;
+	int						roiWidth;
+	int						roiHeight;
+};
 
-	float diff = 255.0f / (mappingMax - mappingMin);
-	for (int i = 0; i < Image.width * Image.height; ++i) {
-		int v = Image.data[i];
-		//v = (int)(GammaToLinear(v / 255.0) * 255.0);
+void computerVisionScanLineInit(ldiScanLineExtractor* Extractor, int MappingMin = 22, int MappingMax = 75, int PeakMin = 50, ldiScanLinePeakMode PeakMode = SLPM_CENTROID) {
+	float diff = 255.0f / (MappingMax - MappingMin);
 
-		v = (v - mappingMin) * diff;
+	Extractor->peakMinInput = 256;
+
+	for (int i = 255; i >= 0; --i) {
+		int v = (i - MappingMin) * diff;
 
 		if (v < 0) {
 			v = 0;
@@ -1119,135 +1167,267 @@ std::vector<vec2> computerVisionFindScanLine(ldiImage Image) {
 			v = 255;
 		}
 
-		Image.data[i] = v;
+		Extractor->remap[i] = (uint8_t)v;
+
+		if (v >= PeakMin) {
+			Extractor->peakMinInput = i;
+		}
 	}
 
-	int sigPeakMin = 50;
+	Extractor->peakMode = PeakMode;
+	Extractor->roiX = 0;
+	Extractor->roiY = 0;
+	Extractor->roiWidth = 0;
+	Extractor->roiHeight = 0;
+}
 
-	struct ldiScanLineSignal {
-		int x;
-		int y0;
-		int y1;
-	};
+struct ldiScanLineSeg {
+	int x;
+	int y0;
+	int y1;
+};
 
-	std::vector<vec4> tempSegs;
+struct ldiScanLineContext {
+	ldiScanLineExtractor*				extractor;
+	ldiImage							image;
+	int									x0;
+	int									x1;
+	int									y0;
+	int									y1;
+	std::vector<std::vector<vec2>>		stripPoints;
+};
 
-	// Process each column.
-	for (int iX = 0; iX < Image.width; ++iX) {
-		// Find all signals in this column.
-		int sigState = 0;
-		int sigStart = -1;
+bool _scanLineSegCompare(const ldiScanLineSeg& A, const ldiScanLineSeg& B) {
+	return A.x < B.x;
+}
 
-		for (int iY = 0; iY < Image.height; ++iY) {
-			int v = Image.data[iY * Image.width + iX];
+float _scanLineGetPeak(ldiScanLineContext* Context, int X, int Y0, int Y1) {
+	const uint8_t* remap = Context->extractor->remap;
+	const uint8_t* data = Context->image.data;
+	const int width = Context->image.width;
+
+	if (Context->extractor->peakMode == SLPM_GAUSSIAN) {
+		int peakY = Y0;
+		int peakEndY = Y0;
+		int peakV = -1;
+
+		for (int iY = Y0; iY <= Y1; ++iY) {
+			int v = remap[data[iY * width + X]];
+
+			if (v > peakV) {
+				peakV = v;
+				peakY = iY;
+				peakEndY = iY;
+			} else if (v == peakV && peakEndY == iY - 1) {
+				peakEndY = iY;
+			}
+		}
 
-			if (sigState == 0) {
-				// Looking for start of signal.
-				if (v >= sigPeakMin) {
-					sigState = 1;
-					sigStart = iY;
-				}
-			} else if (sigState == 1) {
-				// Looking for end of signal.
-				if (v < sigPeakMin) {
-					sigState = 0;
+		// NOTE: Saturated peaks are flat, use the middle of the plateau.
+		if (peakEndY != peakY) {
+			return (peakY + peakEndY) * 0.5f + 0.5f;
+		}
 
-					tempSegs.push_back(vec4(iX, sigStart, iX, (iY - 1)));
-				}
+		// NOTE: Three point Gaussian fit, falls back to the peak pixel at the signal edges.
+		if (peakY > Y0 && peakY < Y1) {
+			float a = logf(remap[data[(peakY - 1) * width + X]] + 1.0f);
+			float b = logf(peakV + 1.0f);
+			float c = logf(remap[data[(peakY + 1) * width + X]] + 1.0f);
+			float denom = a - 2.0f * b + c;
+
+			if (denom < 0.0f) {
+				return peakY + 0.5f + 0.5f * (a - c) / denom;
 			}
 		}
+
+		return peakY + 0.5f;
+	}
+
+	float totalGravity = 0.0f;
+	float weightedY = 0.0f;
+
+	for (int iY = Y0; iY <= Y1; ++iY) {
+		float v = remap[data[iY * width + X]];
+		totalGravity += v;
+		weightedY += (iY + 0.5f) * v;
 	}
 
-	std::vector<vec4> segs;
+	return weightedY / totalGravity;
+}
 
-	// Find extents of each signal.
-	for (size_t i = 0; i < tempSegs.size(); ++i) {
-		vec4 seg = tempSegs[i];
-		vec4 final = seg;
+void computerVisionScanLineBatch(int StartIdx, int EndIdx, void* UserData) {
+	ldiScanLineContext* context = (ldiScanLineContext*)UserData;
+	ldiScanLineExtractor* extractor = context->extractor;
 
-		// Scan up to find break.
-		int minY = 0;
+	const uint8_t* data = context->image.data;
+	const int width = context->image.width;
+	const __m128i threshold = _mm_set1_epi8((char)min(extractor->peakMinInput, 255));
 
-		if (i != 0) {
-			vec4 segUp = tempSegs[i - 1];
+	std::vector<ldiScanLineSeg> segs;
 
-			if ((int)segUp.x == (int)seg.x) {
-				minY = segUp.w + (seg.y - segUp.w) / 2;
-			}
+	for (int stripIter = StartIdx; stripIter < EndIdx; ++stripIter) {
+		const int sx0 = context->x0 + stripIter * SCAN_LINE_STRIP_WIDTH;
+		const int sx1 = min(sx0 + SCAN_LINE_STRIP_WIDTH, context->x1);
+		const int groupCount = (sx1 - sx0) / 16;
+		const int tailX = sx0 + groupCount * 16;
+
+		int sigStart[SCAN_LINE_STRIP_WIDTH];
+		int prevMask[SCAN_LINE_STRIP_WIDTH / 16] = {};
+
+		for (int i = 0; i < SCAN_LINE_STRIP_WIDTH; ++i) {
+			sigStart[i] = -1;
 		}
 
-		for (int iY = (int)seg.y; iY >= minY; --iY) {
-			int v = Image.data[iY * Image.width + (int)seg.x];
-			final.y = iY;
+		segs.clear();
 
-			if (v == 0) {
-				break;
+		// Find all signals in each column of the strip.
+		if (extractor->peakMinInput <= 255) {
+			for (int iY = context->y0; iY < context->y1; ++iY) {
+				const uint8_t* row = data + iY * width;
+
+				for (int g = 0; g < groupCount; ++g) {
+					__m128i v = _mm_loadu_si128((const __m128i*)(row + sx0 + g * 16));
+					// NOTE: v >= threshold, unsigned.
+					int mask = _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_max_epu8(v, threshold), v));
+					int change = mask ^ prevMask[g];
+					prevMask[g] = mask;
+
+					while (change) {
+						int bit = 0;
+						while (!(change & (1 << bit))) {
+							++bit;
+						}
+						change &= ~(1 << bit);
+
+						int col = g * 16 + bit;
+
+						if (mask & (1 << bit)) {
+							sigStart[col] = iY;
+						} else {
+							segs.push_back({ sx0 + col, sigStart[col], iY - 1 });
+							sigStart[col] = -1;
+						}
+					}
+				}
+
+				for (int iX = tailX; iX < sx1; ++iX) {
+					int col = iX - sx0;
+					bool on = row[iX] >= extractor->peakMinInput;
+
+					if (on && sigStart[col] == -1) {
+						sigStart[col] = iY;
+					} else if (!on && sigStart[col] != -1) {
+						segs.push_back({ iX, sigStart[col], iY - 1 });
+						sigStart[col] = -1;
+					}
+				}
 			}
 		}
 
-		// Scan down to find break.
-		int maxY = Image.height - 1;
+		// NOTE: Rows were walked in order, so a stable sort gives segments per column top to bottom.
+		std::stable_sort(segs.begin(), segs.end(), _scanLineSegCompare);
+
+		std::vector<vec2>* points = &context->stripPoints[stripIter];
+
+		// Find extents of each signal, out to where the remapped intensity drops to zero, then the center.
+		for (size_t i = 0; i < segs.size(); ++i) {
+			ldiScanLineSeg seg = segs[i];
+			int y0 = seg.y0;
+			int y1 = seg.y1;
 
-		if (i != tempSegs.size() - 1) {
-			vec4 segDown = tempSegs[i + 1];
+			int minY = context->y0;
 
-			if ((int)segDown.x == (int)seg.x) {
-				maxY = seg.w + (segDown.y - seg.w) / 2;
+			if (i != 0 && segs[i - 1].x == seg.x) {
+				minY = segs[i - 1].y1 + (seg.y0 - segs[i - 1].y1) / 2;
 			}
-		}
 
-		for (int iY = (int)seg.w; iY <= maxY; ++iY) {
-			int v = Image.data[iY * Image.width + (int)seg.x];
-			final.w = iY;
+			for (int iY = seg.y0; iY >= minY; --iY) {
+				y0 = iY;
 
-			if (v == 0) {
-				break;
+				if (extractor->remap[data[iY * width + seg.x]] == 0) {
+					break;
+				}
 			}
-		}
 
-		segs.push_back(final);
-	}
+			int maxY = context->y1 - 1;
 
-	// Find center point of each signal.
-	for (size_t i = 0; i < segs.size(); ++i) {
-		vec4 seg = segs[i];
+			if (i != segs.size() - 1 && segs[i + 1].x == seg.x) {
+				maxY = seg.y1 + (segs[i + 1].y0 - seg.y1) / 2;
+			}
 
-		int x = (int)seg.x;
-		int y0 = (int)seg.y;
-		int y1 = (int)seg.w;
+			for (int iY = seg.y1; iY <= maxY; ++iY) {
+				y1 = iY;
 
-		float totalGravity = 0.0f;
-		float finalY = 0.0f;
+				if (extractor->remap[data[iY * width + seg.x]] == 0) {
+					break;
+				}
+			}
 
-		for (int iY = y0; iY <= y1; ++iY) {
-			float v = Image.data[iY * Image.width + x];
-			totalGravity += v;
+			points->push_back(vec2(seg.x + 0.5f, _scanLineGetPeak(context, seg.x, y0, y1)));
 		}
+	}
+}
 
-		for (int iY = y0; iY <= y1; ++iY) {
-			float v = Image.data[iY * Image.width + x];
-			finalY += (iY + 0.5f) * (v / totalGravity);
-		}
+// Points are in frame pixel coordinates, ordered by column then by row.
+void computerVisionExtractScanLine(ldiScanLineExtractor* Extractor, ldiImage Image, std::vector<vec2>* Points) {
+	PROFILE_ZONE("Extract scan line");
+
+	ldiScanLineContext context;
+	context.extractor = Extractor;
+	context.image = Image;
+	context.x0 = 0;
+	context.y0 = 0;
+	context.x1 = Image.width;
+	context.y1 = Image.height;
+
+	if (Extractor->roiWidth > 0 && Extractor->roiHeight > 0) {
+		context.x0 = clamp(Extractor->roiX, 0, Image.width);
+		context.y0 = clamp(Extractor->roiY, 0, Image.height);
+		context.x1 = clamp(Extractor->roiX + Extractor->roiWidth, 0, Image.width);
+		context.y1 = clamp(Extractor->roiY + Extractor->roiHeight, 0, Image.height);
+	}
+
+	Points->clear();
+
+	if (context.x1 <= context.x0 || context.y1 <= context.y0) {
+		return;
+	}
+
+	int stripCount = (context.x1 - context.x0 + SCAN_LINE_STRIP_WIDTH - 1) / SCAN_LINE_STRIP_WIDTH;
+	context.stripPoints.resize(stripCount);
+
+	parallelFor(0, stripCount, 1, computerVisionScanLineBatch, &context);
 
-		result.push_back(vec2((x + 0.5f), finalY));
+	for (int i = 0; i < stripCount; ++i) {
+		Points->insert(Points->end(), context.stripPoints[i].begin(), context.stripPoints[i].end());
 	}
 
+	PROFILE_ITEMS((int64_t)(context.x1 - context.x0) * (context.y1 - context.y0));
+}
+
+ldiScanLineExtractor _scanLineCreateDefaultExtractor() {
+	ldiScanLineExtractor result;
+	computerVisionScanLineInit(&result);
+
 	return result;
 }
 
-void computerVisionUndistortPoints(std::vector<vec2>& Points, cv::Mat CamMat, cv::Mat CamDist) {
-	std::vector<cv::Point2f> distortedPoints(Points.size());
-	std::vector<cv::Point2f> undistortedPoints;
+// Default extractor over the full frame.
+std::vector<vec2> computerVisionFindScanLine(ldiImage Image) {
+	static ldiScanLineExtractor extractor = _scanLineCreateDefaultExtractor();
 
-	for (size_t pIter = 0; pIter < Points.size(); ++pIter) {
-		distortedPoints[pIter] = toPoint2f(Points[pIter]);
-	}
+	std::vector<vec2> result;
+	computerVisionExtractScanLine(&extractor, Image, &result);
 
-	cv::undistortPoints(distortedPoints, undistortedPoints, CamMat, CamDist, cv::noArray(), CamMat);
+	return result;
+}
 
-	for (size_t pIter = 0; pIter < Points.size(); ++pIter) {
-		Points[pIter] = toVec2(undistortedPoints[pIter]);
-	}
+// NOTE: Each thread keeps its own model, rebuilt only when the calibration changes.
+void computerVisionUndistortPoints(std::vector<vec2>& Points, cv::Mat CamMat, cv::Mat CamDist, int ImageWidth = 3280, int ImageHeight = 2464) {
+	thread_local ldiCameraModel model = {};
+
+	cameraModelInit(&model, CamMat, CamDist, ImageWidth, ImageHeight);
+	cameraModelUndistort(&model, Points.data(), (int)Points.size(), Points.data());
 }
 
 enum ldiWeightedLinearRegressionResult {
@@ -0,0 +1,707 @@
+#pragma once
+
+//----------------------------------------------------------------------------------------------------
+// Device simulators.
+//----------------------------------------------------------------------------------------------------
+// In-process stand-ins for the Panther motion controller and the Hawk camera so the platform jobs and
+// receive paths can run and be timed without a machine attached.
+//
+// Panther: Speaks the PO_* serial protocol over an ldiSerialLoopback, connect with pantherConnectLoopback.
+// Moves follow a trapezoidal velocity profile and report PO_POSITION while moving.
+//
+// Hawk: Speaks the HO_* protocol over a localhost TCP socket, connect with hawkInit(Cam, "127.0.0.1", Port).
+// Frames are rendered (a noisy laser line) or cycled from recorded calibration samples.
+//
+// All simulated delays are multiplied by timeScale. 0 removes them to measure protocol overhead only.
+
+#define HAWK_SIM_DEFAULT_PORT 6970
+
+//----------------------------------------------------------------------------------------------------
+// Panther simulator.
+//----------------------------------------------------------------------------------------------------
+struct ldiPantherSim {
+	ldiSerialLoopback		loopback;
+
+	std::thread				workerThread;
+	std::atomic_bool		workerThreadRunning = false;
+
+	// Settings, set before pantherSimInit.
+	float					defaultVelocity = 16000.0f;		// Steps/s when a move has no max velocity.
+	float					acceleration = 64000.0f;		// Steps/s^2.
+	float					homeTime = 3.0f;
+	float					commandTime = 0.0005f;
+	float					positionRate = 50.0f;			// PO_POSITION updates per second while moving.
+	float					timeScale = 1.0f;
+	bool					requireHome = false;
+
+	// Device state, worker thread only.
+	int						position[5];
+	bool					homed;
+	bool					scanLaserEnabled;
+
+	uint8_t					recvPacket[PANTHER_RECV_TEMP_SIZE];
+	int						recvPacketSize;
+	int						recvPacketPayloadSize;
+	int						recvPacketState;
+
+	std::atomic_int			commandCount = 0;
+	std::atomic_int			moveCount = 0;
+};
+
+void _deviceSimSleep(double Seconds) {
+	if (Seconds > 0.0) {
+		std::this_thread::sleep_for(std::chrono::microseconds((int64_t)(Seconds * 1000000.0)));
+	}
+}
+
+void _deviceSimSleepUntil(double Time) {
+	_deviceSimSleep(Time - getTime());
+}
+
+void _pantherSimSendPacket(ldiPantherSim* Sim, uint8_t* Payload, int Size) {
+	uint8_t packet[260];
+
+	packet[0] = PANTHER_PACKET_START;
+	packet[1] = (uint8_t)Size;
+	memcpy(packet + 2, Payload, Size);
+	packet[Size + 2] = PANTHER_PACKET_END;
+
+	serialPipeWrite(&Sim->loopback.deviceToHost, packet, Size + 3);
+}
+
+void _pantherSimSendResponse(ldiPantherSim* Sim, ldiPantherStatus Status) {
+	uint8_t payload[29];
+	int status = (int)Status;
+	int homed = Sim->homed ? 1 : 0;
+
+	payload[0] = PO_CMD_RESPONSE;
+	memcpy(payload + 1, Sim->position, 5 * sizeof(int));
+	memcpy(payload + 21, &status, 4);
+	memcpy(payload + 25, &homed, 4);
+
+	_pantherSimSendPacket(Sim, payload, 29);
+}
+
+void _pantherSimSendPosition(ldiPantherSim* Sim) {
+	uint8_t payload[21];
+
+	payload[0] = PO_POSITION;
+	memcpy(payload + 1, Sim->position, 5 * sizeof(int));
+
+	_pantherSimSendPacket(Sim, payload, 21);
+}
+
+void _pantherSimSendMessage(ldiPantherSim* Sim, const char* Message) {
+	uint8_t payload[256];
+	int length = min((int)strlen(Message), 250);
+
+	payload[0] = PO_MESSAGE;
+	memcpy(payload + 1, Message, length);
+	payload[length + 1] = 0;
+
+	_pantherSimSendPacket(Sim, payload, length + 2);
+}
+
+// Distance covered after Time seconds of a trapezoidal move of Distance steps.
+float _pantherSimGetProfileDistance(float Distance, float Velocity, float Acceleration, float Time) {
+	float accelTime = Velocity / Acceleration;
+	float accelDist = 0.5f * Acceleration * accelTime * accelTime;
+
+	// NOTE: Short moves never reach full velocity.
+	if (accelDist * 2.0f > Distance) {
+		accelDist = Distance * 0.5f;
+		accelTime = sqrtf(Distance / Acceleration);
+		Velocity = Acceleration * accelTime;
+	}
+
+	float cruiseTime = (Distance - accelDist * 2.0f) / Velocity;
+
+	if (Time < accelTime) {
+		return 0.5f * Acceleration * Time * Time;
+	}
+
+	Time -= accelTime;
+
+	if (Time < cruiseTime) {
+		return accelDist + Velocity * Time;
+	}
+
+	Time = min(Time - cruiseTime, accelTime);
+
+	return accelDist + Velocity * cruiseTime + Velocity * Time - 0.5f * Acceleration * Time * Time;
+}
+
+float _pantherSimGetMoveTime(float Distance, float Velocity, float Acceleration) {
+	float accelTime = Velocity / Acceleration;
+	float accelDist = 0.5f * Acceleration * accelTime * accelTime;
+
+	if (accelDist * 2.0f > Distance) {
+		return 2.0f * sqrtf(Distance / Acceleration);
+	}
+
+	return accelTime * 2.0f + (Distance - accelDist * 2.0f) / Velocity;
+}
+
+ldiPantherStatus _pantherSimMove(ldiPantherSim* Sim, int Axis, int Target, float MaxVelocity) {
+	if (Axis < PA_X || Axis > PA_A) {
+		return PS_INVALID_PARAM;
+	}
+
+	if (Sim->requireHome && !Sim->homed) {
+		return PS_NOT_HOMED;
+	}
+
+	int start = Sim->position[Axis];
+	float distance = (float)abs(Target - start);
+	float direction = (Target < start) ? -1.0f : 1.0f;
+	float velocity = (MaxVelocity > 0.0f) ? MaxVelocity : Sim->defaultVelocity;
+
+	if (Sim->timeScale > 0.0f && distance > 0.0f) {
+		float moveTime = _pantherSimGetMoveTime(distance, velocity, Sim->acceleration);
+		float updateTime = 1.0f / Sim->positionRate;
+		double startTime = getTime();
+
+		for (float t = updateTime; t < moveTime; t += updateTime) {
+			_deviceSimSleepUntil(startTime + t * Sim->timeScale);
+
+			Sim->position[Axis] = start + (int)(direction * _pantherSimGetProfileDistance(distance, velocity, Sim->acceleration, t));
+			_pantherSimSendPosition(Sim);
+		}
+
+		_deviceSimSleepUntil(startTime + moveTime * Sim->timeScale);
+	}
+
+	Sim->position[Axis] = Target;
+	++Sim->moveCount;
+
+	return PS_OK;
+}
+
+void _pantherSimProcessPacket(ldiPantherSim* Sim) {
+	uint8_t* payload = Sim->recvPacket;
+	uint8_t opcode = payload[0];
+	ldiPantherStatus status = PS_OK;
+
+	++Sim->commandCount;
+	_deviceSimSleep(Sim->commandTime * Sim->timeScale);
+
+	switch (opcode) {
+		case PO_PING: {
+		} break;
+
+		case PO_DIAG: {
+			_pantherSimSendMessage(Sim, "Panther simulator");
+		} break;
+
+		case PO_HOME: {
+			_deviceSimSleep(Sim->homeTime * Sim->timeScale);
+
+			for (int i = 0; i < 5; ++i) {
+				Sim->position[i] = 0;
+			}
+
+			Sim->homed = true;
+		} break;
+
+		case PO_MOVE:
+		case PO_MOVE_RELATIVE: {
+			if (Sim->recvPacketPayloadSize < 10) {
+				status = PS_INVALID_PARAM;
+				break;
+			}
+
+			int axis = payload[1];
+			int32_t steps;
+			float maxVelocity;
+			memcpy(&steps, payload + 2, 4);
+			memcpy(&maxVelocity, payload + 6, 4);
+
+			if (opcode == PO_MOVE_RELATIVE && axis >= PA_X && axis <= PA_A) {
+				steps += Sim->position[axis];
+			}
+
+			status = _pantherSimMove(Sim, axis, steps, maxVelocity);
+		} break;
+
+		case PO_SCAN_LASER_STATE: {
+			int state = 0;
+			memcpy(&state, payload + 1, 4);
+			Sim->scanLaserEnabled = (state != 0);
+		} break;
+
+		default: {
+			// NOTE: Laser and galvo commands are accepted and do nothing.
+		}
+	}
+
+	_pantherSimSendResponse(Sim, status);
+}
+
+void _pantherSimWorkerThread(ldiPantherSim* Sim) {
+	PROFILE_THREAD_NAME("Panther sim");
+
+	uint8_t recvTemp[PANTHER_RECV_TEMP_SIZE];
+
+	while (Sim->workerThreadRunning) {
+		if (serialPipeWaitForData(&Sim->loopback.hostToDevice, 100) != 1) {
+			continue;
+		}
+
+		int recvSize = serialPipeRead(&Sim->loopback.hostToDevice, recvTemp, PANTHER_RECV_TEMP_SIZE);
+
+		// NOTE: Host packets are: start, 16 bit payload size, payload, end.
+		for (int i = 0; i < recvSize; ++i) {
+			uint8_t d = recvTemp[i];
+
+			if (Sim->recvPacketState == 0) {
+				if (d == PANTHER_PACKET_START) {
+					Sim->recvPacketState = 1;
+				}
+			} else if (Sim->recvPacketState == 1) {
+				Sim->recvPacketPayloadSize = d;
+				Sim->recvPacketState = 2;
+			} else if (Sim->recvPacketState == 2) {
+				Sim->recvPacketPayloadSize |= d << 8;
+				Sim->recvPacketSize = 0;
+				Sim->recvPacketState = (Sim->recvPacketPayloadSize > 0 && Sim->recvPacketPayloadSize <= PANTHER_RECV_TEMP_SIZE) ? 3 : 0;
+			} else if (Sim->recvPacketState == 3) {
+				Sim->recvPacket[Sim->recvPacketSize++] = d;
+
+				if (Sim->recvPacketSize == Sim->recvPacketPayloadSize) {
+					Sim->recvPacketState = 4;
+				}
+			} else if (Sim->recvPacketState == 4) {
+				Sim->recvPacketState = 0;
+
+				if (d == PANTHER_PACKET_END) {
+					_pantherSimProcessPacket(Sim);
+				}
+			}
+		}
+	}
+}
+
+void pantherSimInit(ldiPantherSim* Sim) {
+	for (int i = 0; i < 5; ++i) {
+		Sim->position[i] = 0;
+	}
+
+	Sim->homed = false;
+	Sim->scanLaserEnabled = false;
+	Sim->recvPacketState = 0;
+
+	serialPipeOpen(&Sim->loopback.hostToDevice);
+	serialPipeOpen(&Sim->loopback.deviceToHost);
+
+	Sim->workerThreadRunning = true;
+	Sim->workerThread = std::thread(_pantherSimWorkerThread, Sim);
+}
+
+void pantherSimDestroy(ldiPantherSim* Sim) {
+	if (!Sim->workerThreadRunning) {
+		return;
+	}
+
+	Sim->workerThreadRunning = false;
+	serialPipeClose(&Sim->loopback.hostToDevice);
+	serialPipeClose(&Sim->loopback.deviceToHost);
+	Sim->workerThread.join();
+}
+
+//----------------------------------------------------------------------------------------------------
+// Hawk simulator.
+//----------------------------------------------------------------------------------------------------
+struct ldiHawkSim {
+	std::thread					workerThread;
+	std::atomic_bool			workerThreadRunning = false;
+	SOCKET						listenSocket = INVALID_SOCKET;
+	int							port;
+
+	// Settings, set before hawkSimInit.
+	int							width = 3280;
+	int							height = 2464;
+	float						frameRate = 30.0f;				// 0 sends frames as fast as the socket allows.
+	int							averageFrameCount = 8;			// Frames gathered by the CCM_AVERAGE modes.
+	float						averageProcessTime = 0.05f;
+	float						timeScale = 1.0f;
+	ldiCameraCaptureMode		initialMode = CCM_CONTINUOUS;
+
+	// Recorded frames are used instead of rendered ones when present.
+	std::vector<ldiImage>		recordedFrames;
+
+	// Worker thread only.
+	ldiCameraCaptureMode		mode;
+	ldiCameraCaptureMode		modeAfterAverage;
+	int							shutterSpeed;
+	int							analogGain;
+	double						nextFrameTime;
+	double						gatherTime;
+	bool						gatherPending;
+	int							frameId;
+	std::vector<uint8_t>		framePacket;
+	ldiPacketBuilder			packetBuilder;
+
+	std::atomic_int				framesSent = 0;
+	std::atomic_int64_t			bytesSent = 0;
+};
+
+// Frames can also be replayed from a directory of calibration samples (.dat) or a sample archive.
+int hawkSimLoadRecordedFrames(ldiHawkSim* Sim, const std::string& Directory) {
+	std::vector<std::string> samplePaths = calibListSamplePaths(Directory);
+
+	for (size_t i = 0; i < samplePaths.size(); ++i) {
+		ldiCalibSample sample = {};
+		sample.path = samplePaths[i];
+
+		if (!calibLoadCalibSampleData(&sample)) {
+			calibFreeCalibImages(&sample);
+			continue;
+		}
+
+		Sim->recordedFrames.push_back(sample.frame);
+	}
+
+	std::cout << "Hawk sim loaded " << Sim->recordedFrames.size() << " recorded frames\n";
+
+	return (int)Sim->recordedFrames.size();
+}
+
+void _hawkSimRenderFrame(ldiHawkSim* Sim, uint8_t* Data, int Width, int Height) {
+	// NOTE: Laser line across the image that drifts each frame, on top of sensor noise below the scan line threshold.
+	float phase = Sim->frameId * 0.05f;
+	uint32_t seed = (uint32_t)Sim->frameId * 2654435761u + 1;
+
+	for (int iX = 0; iX < Width; ++iX) {
+		float lineY = Height * (0.5f + 0.25f * sinf(iX * 0.002f + phase));
+		int startY = max(0, (int)lineY - 8);
+		int endY = min(Height - 1, (int)lineY + 8);
+
+		for (int iY = 0; iY < Height; ++iY) {
+			seed = seed * 1664525u + 1013904223u;
+			Data[iY * Width + iX] = (uint8_t)(8 + ((seed >> 24) & 0xF));
+		}
+
+		for (int iY = startY; iY <= endY; ++iY) {
+			float d = (iY - lineY) / 2.5f;
+			int v = Data[iY * Width + iX] + (int)(220.0f * expf(-d * d));
+			Data[iY * Width + iX] = (uint8_t)min(v, 255);
+		}
+	}
+}
+
+bool _hawkSimSend(ldiHawkSim* Sim, SOCKET Socket, uint8_t* Data, int Size) {
+	int sent = 0;
+
+	while (sent < Size) {
+		int result = send(Socket, (const char*)Data + sent, Size - sent, 0);
+
+		if (result == SOCKET_ERROR) {
+			return false;
+		}
+
+		sent += result;
+	}
+
+	Sim->bytesSent += Size;
+
+	return true;
+}
+
+bool _hawkSimSendOpcode(ldiHawkSim* Sim, SOCKET Socket, int Opcode) {
+	ldiProtocolHeader packet;
+	packet.packetSize = sizeof(ldiProtocolHeader) - 4;
+	packet.opcode = Opcode;
+
+	return _hawkSimSend(Sim, Socket, (uint8_t*)&packet, sizeof(packet));
+}
+
+bool _hawkSimSendSettings(ldiHawkSim* Sim, SOCKET Socket) {
+	ldiProtocolSettings packet;
+	packet.header.packetSize = sizeof(ldiProtocolSettings) - 4;
+	packet.header.opcode = HO_SETTINGS;
+	packet.shutterSpeed = Sim->shutterSpeed;
+	packet.analogGain = Sim->analogGain;
+
+	return _hawkSimSend(Sim, Socket, (uint8_t*)&packet, sizeof(packet));
+}
+
+bool _hawkSimSendFrame(ldiHawkSim* Sim, SOCKET Socket) {
+	int width = Sim->width;
+	int height = Sim->height;
+	ldiImage* recorded = 0;
+
+	if (!Sim->recordedFrames.empty()) {
+		recorded = &Sim->recordedFrames[Sim->frameId % Sim->recordedFrames.size()];
+		width = recorded->width;
+		height = recorded->height;
+	}
+
+	int packetSize = sizeof(ldiProtocolImageHeader) + width * height;
+
+	if ((int)Sim->framePacket.size() < packetSize) {
+		Sim->framePacket.resize(packetSize);
+	}
+
+	ldiProtocolImageHeader* header = (ldiProtocolImageHeader*)Sim->framePacket.data();
+	header->header.packetSize = packetSize - 4;
+	header->header.opcode = HO_FRAME;
+	header->width = width;
+	header->height = height;
+
+	uint8_t* data = Sim->framePacket.data() + sizeof(ldiProtocolImageHeader);
+
+	if (recorded) {
+		memcpy(data, recorded->data, width * height);
+	} else {
+		_hawkSimRenderFrame(Sim, data, width, height);
+	}
+
+	++Sim->frameId;
+
+	if (!_hawkSimSend(Sim, Socket, Sim->framePacket.data(), packetSize)) {
+		return false;
+	}
+
+	++Sim->framesSent;
+
+	return true;
+}
+
+double _hawkSimGetFramePeriod(ldiHawkSim* Sim) {
+	if (Sim->frameRate <= 0.0f) {
+		return 0.0;
+	}
+
+	return Sim->timeScale / Sim->frameRate;
+}
+
+void _hawkSimSetMode(ldiHawkSim* Sim, ldiCameraCaptureMode Mode) {
+	double now = getTime();
+
+	if (Mode == CCM_AVERAGE || Mode == CCM_AVERAGE_NO_FLASH) {
+		// NOTE: Camera goes back to what it was doing once the averaged frame is sent.
+		if (!Sim->gatherPending) {
+			Sim->modeAfterAverage = Sim->mode;
+		}
+
+		Sim->gatherPending = true;
+		Sim->gatherTime = now + _hawkSimGetFramePeriod(Sim) * Sim->averageFrameCount;
+	} else {
+		Sim->gatherPending = false;
+	}
+
+	Sim->mode = Mode;
+	Sim->nextFrameTime = now + _hawkSimGetFramePeriod(Sim);
+}
+
+bool _hawkSimProcessPacket(ldiHawkSim* Sim, SOCKET Socket) {
+	ldiProtocolHeader* header = (ldiProtocolHeader*)Sim->packetBuilder.data;
+
+	if (header->opcode == HO_SETTINGS_REQUEST) {
+		return _hawkSimSendSettings(Sim, Socket);
+	} else if (header->opcode == HO_SET_VALUES) {
+		ldiProtocolSettings* packet = (ldiProtocolSettings*)Sim->packetBuilder.data;
+		Sim->shutterSpeed = packet->shutterSpeed;
+		Sim->analogGain = packet->analogGain;
+		return _hawkSimSendSettings(Sim, Socket);
+	} else if (header->opcode == HO_SET_CAPTURE_MODE) {
+		ldiProtocolMode* packet = (ldiProtocolMode*)Sim->packetBuilder.data;
+		_hawkSimSetMode(Sim, (ldiCameraCaptureMode)packet->mode);
+	} else {
+		std::cout << "Hawk sim got unknown opcode: " << header->opcode << "\n";
+	}
+
+	return true;
+}
+
+// Sends whatever is due. Returns false if the client went away.
+bool _hawkSimUpdate(ldiHawkSim* Sim, SOCKET Socket) {
+	double now = getTime();
+
+	if (Sim->gatherPending) {
+		if (now >= Sim->gatherTime) {
+			Sim->gatherPending = false;
+
+			if (!_hawkSimSendOpcode(Sim, Socket, HO_AVERAGE_GATHERED)) {
+				return false;
+			}
+
+			_deviceSimSleep(Sim->averageProcessTime * Sim->timeScale);
+
+			if (!_hawkSimSendFrame(Sim, Socket)) {
+				return false;
+			}
+
+			_hawkSimSetMode(Sim, Sim->modeAfterAverage);
+		}
+	} else if (Sim->mode == CCM_CONTINUOUS || Sim->mode == CCM_SINGLE) {
+		if (now >= Sim->nextFrameTime) {
+			if (!_hawkSimSendFrame(Sim, Socket)) {
+				return false;
+			}
+
+			// NOTE: Don't burst to catch up if the client fell behind.
+			Sim->nextFrameTime = max(Sim->nextFrameTime + _hawkSimGetFramePeriod(Sim), now);
+
+			if (Sim->mode == CCM_SINGLE) {
+				Sim->mode = CCM_WAIT;
+			}
+		}
+	}
+
+	return true;
+}
+
+int _hawkSimGetWaitTimeout(ldiHawkSim* Sim) {
+	double eventTime;
+
+	if (Sim->gatherPending) {
+		eventTime = Sim->gatherTime;
+	} else if (Sim->mode == CCM_CONTINUOUS || Sim->mode == CCM_SINGLE) {
+		eventTime = Sim->nextFrameTime;
+	} else {
+		return 100;
+	}
+
+	return clamp((int)((eventTime - getTime()) * 1000.0), 0, 100);
+}
+
+void _hawkSimServeClient(ldiHawkSim* Sim, SOCKET Socket) {
+	uint8_t recvBuffer[4096];
+
+	packetBuilderReset(&Sim->packetBuilder);
+	Sim->gatherPending = false;
+	_hawkSimSetMode(Sim, Sim->initialMode);
+
+	while (Sim->workerThreadRunning) {
+		WSAPOLLFD fds[1];
+		fds[0].fd = Socket;
+		fds[0].events = POLLRDNORM;
+
+		int pollResult = WSAPoll(fds, 1, _hawkSimGetWaitTimeout(Sim));
+
+		if (pollResult > 0) {
+			if (fds[0].revents & (POLLERR | POLLHUP | POLLNVAL)) {
+				break;
+			}
+
+			int recvBytes = recv(Socket, (char*)recvBuffer, sizeof(recvBuffer), 0);
+
+			if (recvBytes <= 0) {
+				break;
+			}
+
+			int bytesProcessed = 0;
+
+			while (bytesProcessed != recvBytes) {
+				bytesProcessed += packetBuilderProcessData(&Sim->packetBuilder, recvBuffer + bytesProcessed, recvBytes - bytesProcessed);
+
+				if (Sim->packetBuilder.state == 2) {
+					if (!_hawkSimProcessPacket(Sim, Socket)) {
+						return;
+					}
+
+					packetBuilderReset(&Sim->packetBuilder);
+				}
+			}
+		}
+
+		if (!_hawkSimUpdate(Sim, Socket)) {
+			return;
+		}
+	}
+}
+
+void _hawkSimWorkerThread(ldiHawkSim* Sim) {
+	PROFILE_THREAD_NAME("Hawk sim");
+
+	while (Sim->workerThreadRunning) {
+		WSAPOLLFD fds[1];
+		fds[0].fd = Sim->listenSocket;
+		fds[0].events = POLLRDNORM;
+
+		if (WSAPoll(fds, 1, 100) <= 0) {
+			continue;
+		}
+
+		SOCKET client = accept(Sim->listenSocket, NULL, NULL);
+
+		if (client == INVALID_SOCKET) {
+			continue;
+		}
+
+		int noDelay = 1;
+		setsockopt(client, IPPROTO_TCP, TCP_NODELAY, (const char*)&noDelay, sizeof(noDelay));
+
+		std::cout << "Hawk sim client connected\n";
+		_hawkSimServeClient(Sim, client);
+		std::cout << "Hawk sim client disconnected\n";
+
+		closesocket(client);
+	}
+}
+
+bool hawkSimInit(ldiHawkSim* Sim, int Port = HAWK_SIM_DEFAULT_PORT) {
+	WSADATA wsaData;
+
+	if (WSAStartup(MAKEWORD(2, 2), &wsaData) != 0) {
+		std::cout << "Hawk sim: Net startup failed\n";
+		return false;
+	}
+
+	Sim->port = Port;
+	Sim->shutterSpeed = 10000;
+	Sim->analogGain = 2;
+	Sim->frameId = 0;
+	Sim->mode = CCM_WAIT;
+	Sim->gatherPending = false;
+	packetBuilderInit(&Sim->packetBuilder, 1024);
+
+	Sim->listenSocket = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+
+	if (Sim->listenSocket == INVALID_SOCKET) {
+		std::cout << "Hawk sim: Listen socket failed: " << WSAGetLastError() << "\n";
+		WSACleanup();
+		return false;
+	}
+
+	sockaddr_in service = {};
+	service.sin_family = AF_INET;
+	service.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	service.sin_port = htons(Port);
+
+	if (bind(Sim->listenSocket, (SOCKADDR*)&service, sizeof(service)) == SOCKET_ERROR || listen(Sim->listenSocket, 1) == SOCKET_ERROR) {
+		std::cout << "Hawk sim: Bind failed: " << WSAGetLastError() << "\n";
+		closesocket(Sim->listenSocket);
+		Sim->listenSocket = INVALID_SOCKET;
+		WSACleanup();
+		return false;
+	}
+
+	std::cout << "Hawk sim listening on 127.0.0.1:" << Port << "\n";
+
+	Sim->workerThreadRunning = true;
+	Sim->workerThread = std::thread(_hawkSimWorkerThread, Sim);
+
+	return true;
+}
+
+void hawkSimDestroy(ldiHawkSim* Sim) {
+	if (!Sim->workerThreadRunning) {
+		return;
+	}
+
+	Sim->workerThreadRunning = false;
+	Sim->workerThread.join();
+
+	closesocket(Sim->listenSocket);
+	Sim->listenSocket = INVALID_SOCKET;
+	packetBuilderDestroy(&Sim->packetBuilder);
+
+	for (size_t i = 0; i < Sim->recordedFrames.size(); ++i) {
+		delete[] Sim->recordedFrames[i].data;
+	}
+	Sim->recordedFrames.clear();
+
+	WSACleanup();
+}
\ No newline at end of file
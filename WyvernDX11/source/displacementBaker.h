@@ -0,0 +1,539 @@
+#pragma once
+
+//----------------------------------------------------------------------------------------------------
+// Displacement baking.
+//----------------------------------------------------------------------------------------------------
+// Bakes the distance from a base model to a target model, along the base normals, into a texture over the
+// base model UVs. Each triangle's UV footprint is rasterized with edge functions, so the cost follows
+// texel coverage rather than how many triangles share a UV region.
+//
+// The texture is baked in bands of tile rows. Tiles in a band run across the pool, each rasterizes its
+// binned triangles, then casts the rays of all covered texels as one batch. Finished bands go to a band
+// callback, so the baker only holds one band. dispBakeToFile streams bands to disk, so its output isn't bound by
+// what fits in memory.
+//
+// Texels whose center is inside a triangle belong to the lowest triangle index covering them, the same as
+// the old bucket search. With conservative rasterization on, texels that a triangle only partially covers
+// take the values at the nearest point on the triangle, which fills the UV seams.
+
+#define DISPBAKE_FILE_MAGIC 0x5053444C
+#define DISPBAKE_FILE_VERSION 1
+
+struct ldiDispBakeSettings {
+	int									width;
+	int									height;
+	int									tileSize;
+	// Ray starts this far along the base normal, and travels at most maxDist.
+	float								normalAdjust;
+	float								maxDist;
+	bool								conservative;
+};
+
+// Called in row order with full width rows. Disp is RowCount * width floats, Normals is RGBA8.
+typedef bool (*ldiDispBakeBandFunc)(int RowStart, int RowCount, const float* Disp, const uint8_t* Normals, void* UserData);
+
+ldiDispBakeSettings dispBakeGetDefaultSettings(int Width, int Height) {
+	ldiDispBakeSettings result = {};
+	result.width = Width;
+	result.height = Height;
+	result.tileSize = 64;
+	result.normalAdjust = -0.4f;
+	result.maxDist = 1.0f;
+	result.conservative = true;
+
+	return result;
+}
+
+//----------------------------------------------------------------------------------------------------
+// Triangle setup.
+//----------------------------------------------------------------------------------------------------
+struct ldiDispBakeTri {
+	// Edge functions in texel space relative to the origin, E = a * x + b * y + c, positive inside. Edge I
+	// weights vertex I.
+	// NOTE: Relative to the first vertex so c doesn't lose precision far from the texture origin.
+	float								originX;
+	float								originY;
+	float								a[3];
+	float								b[3];
+	float								c[3];
+	// Conservative margin for a whole texel.
+	float								margin[3];
+	// Vertices 1 and 2 relative to vertex 0.
+	vec2								p1;
+	vec2								p2;
+	float								invArea;
+	int									minX;
+	int									minY;
+	int									maxX;
+	int									maxY;
+};
+
+struct ldiDispBakeContext {
+	ldiPhysicsMesh*						cookedMesh;
+	ldiModel*							baseModel;
+	ldiModel*							targetModel;
+	ldiDispBakeSettings*				settings;
+
+	std::vector<ldiDispBakeTri>			tris;
+	// Triangles overlapping tile T are binTris[binStart[T]] to binTris[binStart[T + 1]], in index order.
+	int									tilesX;
+	int									tilesY;
+	std::vector<int>					binStart;
+	std::vector<int>					binTris;
+
+	// Current band.
+	int									bandTileY;
+	int									bandRowStart;
+	int									bandRowCount;
+	float*								bandDisp;
+	uint8_t*							bandNormals;
+};
+
+struct ldiDispBakeTriSetupContext {
+	ldiDispBakeContext*					bake;
+	std::vector<uint8_t>*				valid;
+};
+
+void _dispBakeTriSetupBatch(int StartIdx, int EndIdx, void* UserData) {
+	ldiDispBakeTriSetupContext* context = (ldiDispBakeTriSetupContext*)UserData;
+	ldiDispBakeContext* bake = context->bake;
+	ldiModel* model = bake->baseModel;
+	float width = (float)bake->settings->width;
+	float height = (float)bake->settings->height;
+
+	for (int triIter = StartIdx; triIter < EndIdx; ++triIter) {
+		ldiDispBakeTri* tri = &bake->tris[triIter];
+		vec2 p[3];
+
+		for (int i = 0; i < 3; ++i) {
+			vec2 uv = model->verts[model->indices[triIter * 3 + i]].uv;
+			p[i] = vec2(uv.x * width, uv.y * height);
+		}
+
+		tri->originX = p[0].x;
+		tri->originY = p[0].y;
+
+		vec2 bMin;
+		bMin.x = min(min(p[0].x, p[1].x), p[2].x);
+		bMin.y = min(min(p[0].y, p[1].y), p[2].y);
+
+		vec2 bMax;
+		bMax.x = max(max(p[0].x, p[1].x), p[2].x);
+		bMax.y = max(max(p[0].y, p[1].y), p[2].y);
+
+		for (int i = 0; i < 3; ++i) {
+			p[i] -= vec2(tri->originX, tri->originY);
+		}
+
+		float area = (p[1].x - p[0].x) * (p[2].y - p[0].y) - (p[1].y - p[0].y) * (p[2].x - p[0].x);
+
+		// NOTE: Degenerate in UV space, never covers a texel center.
+		if (!(area != 0.0f)) {
+			(*context->valid)[triIter] = false;
+			continue;
+		}
+
+		tri->p1 = p[1];
+		tri->p2 = p[2];
+
+		float sign = (area > 0.0f) ? 1.0f : -1.0f;
+		tri->invArea = 1.0f / (area * sign);
+
+		for (int i = 0; i < 3; ++i) {
+			vec2 e0 = p[(i + 1) % 3];
+			vec2 e1 = p[(i + 2) % 3];
+
+			tri->a[i] = (e0.y - e1.y) * sign;
+			tri->b[i] = (e1.x - e0.x) * sign;
+			tri->c[i] = (e0.x * e1.y - e0.y * e1.x) * sign;
+			tri->margin[i] = 0.5f * (fabsf(tri->a[i]) + fabsf(tri->b[i]));
+		}
+
+		// Every texel the bounds touch, which includes every texel center inside.
+		tri->minX = max((int)floorf(bMin.x), 0);
+		tri->minY = max((int)floorf(bMin.y), 0);
+		tri->maxX = min((int)floorf(bMax.x), bake->settings->width - 1);
+		tri->maxY = min((int)floorf(bMax.y), bake->settings->height - 1);
+
+		(*context->valid)[triIter] = tri->minX <= tri->maxX && tri->minY <= tri->maxY;
+	}
+}
+
+void _dispBakeBinTris(ldiDispBakeContext* Bake) {
+	PROFILE_ZONE("Disp bake bin");
+
+	int triCount = (int)(Bake->baseModel->indices.size() / 3);
+	int tileSize = Bake->settings->tileSize;
+
+	Bake->tris.resize(triCount);
+	std::vector<uint8_t> valid(triCount);
+
+	ldiDispBakeTriSetupContext setupContext;
+	setupContext.bake = Bake;
+	setupContext.valid = &valid;
+	parallelFor(0, triCount, 4096, _dispBakeTriSetupBatch, &setupContext);
+
+	Bake->tilesX = (Bake->settings->width + tileSize - 1) / tileSize;
+	Bake->tilesY = (Bake->settings->height + tileSize - 1) / tileSize;
+
+	int tileCount = Bake->tilesX * Bake->tilesY;
+	Bake->binStart.assign(tileCount + 1, 0);
+
+	for (int pass = 0; pass < 2; ++pass) {
+		std::vector<int> cursor;
+
+		if (pass == 1) {
+			for (int i = 0; i < tileCount; ++i) {
+				Bake->binStart[i + 1] += Bake->binStart[i];
+			}
+
+			Bake->binTris.resize(Bake->binStart[tileCount]);
+			cursor.assign(Bake->binStart.begin(), Bake->binStart.end() - 1);
+		}
+
+		for (int triIter = 0; triIter < triCount; ++triIter) {
+			if (!valid[triIter]) {
+				continue;
+			}
+
+			ldiDispBakeTri* tri = &Bake->tris[triIter];
+
+			for (int tY = tri->minY / tileSize; tY <= tri->maxY / tileSize; ++tY) {
+				for (int tX = tri->minX / tileSize; tX <= tri->maxX / tileSize; ++tX) {
+					int tileIdx = tX + tY * Bake->tilesX;
+
+					if (pass == 0) {
+						++Bake->binStart[tileIdx + 1];
+					} else {
+						Bake->binTris[cursor[tileIdx]++] = triIter;
+					}
+				}
+			}
+		}
+	}
+}
+
+// Barycentric weights of the closest point on the triangle to P, relative to vertex 0 like P1 and P2.
+// NOTE: Voronoi region walk from Real-Time Collision Detection 5.1.5.
+void _dispBakeClosestPointWeights(vec2 P, vec2 P1, vec2 P2, float* W) {
+	vec2 ab = P1;
+	vec2 ac = P2;
+	vec2 ap = P;
+
+	float d1 = glm::dot(ab, ap);
+	float d2 = glm::dot(ac, ap);
+
+	if (d1 <= 0.0f && d2 <= 0.0f) {
+		W[0] = 1.0f; W[1] = 0.0f; W[2] = 0.0f;
+		return;
+	}
+
+	vec2 bp = P - P1;
+	float d3 = glm::dot(ab, bp);
+	float d4 = glm::dot(ac, bp);
+
+	if (d3 >= 0.0f && d4 <= d3) {
+		W[0] = 0.0f; W[1] = 1.0f; W[2] = 0.0f;
+		return;
+	}
+
+	float vc = d1 * d4 - d3 * d2;
+
+	if (vc <= 0.0f && d1 >= 0.0f && d3 <= 0.0f) {
+		float v = d1 / (d1 - d3);
+		W[0] = 1.0f - v; W[1] = v; W[2] = 0.0f;
+		return;
+	}
+
+	vec2 cp = P - P2;
+	float d5 = glm::dot(ab, cp);
+	float d6 = glm::dot(ac, cp);
+
+	if (d6 >= 0.0f && d5 <= d6) {
+		W[0] = 0.0f; W[1] = 0.0f; W[2] = 1.0f;
+		return;
+	}
+
+	float vb = d5 * d2 - d1 * d6;
+
+	if (vb <= 0.0f && d2 >= 0.0f && d6 <= 0.0f) {
+		float w = d2 / (d2 - d6);
+		W[0] = 1.0f - w; W[1] = 0.0f; W[2] = w;
+		return;
+	}
+
+	float va = d3 * d6 - d5 * d4;
+
+	if (va <= 0.0f && (d4 - d3) >= 0.0f && (d5 - d6) >= 0.0f) {
+		float w = (d4 - d3) / ((d4 - d3) + (d5 - d6));
+		W[0] = 0.0f; W[1] = 1.0f - w; W[2] = w;
+		return;
+	}
+
+	float denom = 1.0f / (va + vb + vc);
+	float v = vb * denom;
+	float w = vc * denom;
+	W[0] = 1.0f - v - w; W[1] = v; W[2] = w;
+}
+
+//----------------------------------------------------------------------------------------------------
+// Tiles.
+//----------------------------------------------------------------------------------------------------
+struct ldiDispBakeRay {
+	int									texel;
+	vec3								origin;
+	vec3								normal;
+};
+
+void _dispBakeTileBatch(int StartIdx, int EndIdx, void* UserData) {
+	ldiDispBakeContext* context = (ldiDispBakeContext*)UserData;
+	ldiDispBakeSettings* settings = context->settings;
+	ldiModel* baseModel = context->baseModel;
+	ldiModel* targetModel = context->targetModel;
+	int tileSize = settings->tileSize;
+
+	// NOTE: Owner is triangle index + 1. Center coverage always beats conservative coverage.
+	std::vector<int> owner(tileSize * tileSize);
+	std::vector<uint8_t> ownerCenter(tileSize * tileSize);
+	std::vector<ldiDispBakeRay> rays;
+	rays.reserve(tileSize * tileSize);
+
+	for (int tX = StartIdx; tX < EndIdx; ++tX) {
+		int tileIdx = tX + context->bandTileY * context->tilesX;
+		int x0 = tX * tileSize;
+		int y0 = context->bandRowStart;
+		int x1 = min(x0 + tileSize, settings->width) - 1;
+		int y1 = y0 + context->bandRowCount - 1;
+
+		std::fill(owner.begin(), owner.end(), 0);
+		std::fill(ownerCenter.begin(), ownerCenter.end(), 0);
+
+		//----------------------------------------------------------------------------------------------------
+		// Rasterize.
+		//----------------------------------------------------------------------------------------------------
+		for (int binIter = context->binStart[tileIdx]; binIter < context->binStart[tileIdx + 1]; ++binIter) {
+			int triIdx = context->binTris[binIter];
+			ldiDispBakeTri* tri = &context->tris[triIdx];
+
+			int sX = max(tri->minX, x0);
+			int eX = min(tri->maxX, x1);
+			int sY = max(tri->minY, y0);
+			int eY = min(tri->maxY, y1);
+
+			for (int iY = sY; iY <= eY; ++iY) {
+				float cY = iY + 0.5f - tri->originY;
+
+				for (int iX = sX; iX <= eX; ++iX) {
+					int local = (iX - x0) + (iY - y0) * tileSize;
+					float cX = iX + 0.5f - tri->originX;
+
+					// NOTE: Evaluated directly rather than stepped, so shared edges give the same result for
+					// both triangles.
+					float e0 = tri->a[0] * cX + tri->b[0] * cY + tri->c[0];
+					float e1 = tri->a[1] * cX + tri->b[1] * cY + tri->c[1];
+					float e2 = tri->a[2] * cX + tri->b[2] * cY + tri->c[2];
+
+					if (e0 >= 0.0f && e1 >= 0.0f && e2 >= 0.0f) {
+						if (!ownerCenter[local]) {
+							owner[local] = triIdx + 1;
+							ownerCenter[local] = 1;
+						}
+					} else if (settings->conservative && owner[local] == 0) {
+						if (e0 + tri->margin[0] >= 0.0f && e1 + tri->margin[1] >= 0.0f && e2 + tri->margin[2] >= 0.0f) {
+							owner[local] = triIdx + 1;
+						}
+					}
+				}
+			}
+		}
+
+		//----------------------------------------------------------------------------------------------------
+		// Gather rays.
+		//----------------------------------------------------------------------------------------------------
+		rays.clear();
+
+		for (int iY = y0; iY <= y1; ++iY) {
+			for (int iX = x0; iX <= x1; ++iX) {
+				int local = (iX - x0) + (iY - y0) * tileSize;
+
+				if (owner[local] == 0) {
+					continue;
+				}
+
+				int triIdx = owner[local] - 1;
+				ldiDispBakeTri* tri = &context->tris[triIdx];
+				float cX = iX + 0.5f - tri->originX;
+				float cY = iY + 0.5f - tri->originY;
+
+				float w[3];
+
+				if (ownerCenter[local]) {
+					for (int i = 0; i < 3; ++i) {
+						w[i] = (tri->a[i] * cX + tri->b[i] * cY + tri->c[i]) * tri->invArea;
+					}
+				} else {
+					_dispBakeClosestPointWeights(vec2(cX, cY), tri->p1, tri->p2, w);
+				}
+
+				ldiMeshVertex* v0 = &baseModel->verts[baseModel->indices[triIdx * 3 + 0]];
+				ldiMeshVertex* v1 = &baseModel->verts[baseModel->indices[triIdx * 3 + 1]];
+				ldiMeshVertex* v2 = &baseModel->verts[baseModel->indices[triIdx * 3 + 2]];
+
+				ldiDispBakeRay ray;
+				ray.texel = iX + (iY - y0) * settings->width;
+				ray.normal = v0->normal * w[0] + v1->normal * w[1] + v2->normal * w[2];
+				ray.origin = v0->pos * w[0] + v1->pos * w[1] + v2->pos * w[2] + ray.normal * settings->normalAdjust;
+				rays.push_back(ray);
+			}
+		}
+
+		PROFILE_ITEMS(rays.size());
+
+		//----------------------------------------------------------------------------------------------------
+		// Trace.
+		//----------------------------------------------------------------------------------------------------
+		for (size_t rayIter = 0; rayIter < rays.size(); ++rayIter) {
+			ldiDispBakeRay* ray = &rays[rayIter];
+			ldiRaycastResult result = physicsRaycast(context->cookedMesh, ray->origin, ray->normal, settings->maxDist);
+
+			if (!result.hit) {
+				continue;
+			}
+
+			ldiMeshVertex* v0 = &targetModel->verts[targetModel->indices[result.faceIdx * 3 + 0]];
+			ldiMeshVertex* v1 = &targetModel->verts[targetModel->indices[result.faceIdx * 3 + 1]];
+			ldiMeshVertex* v2 = &targetModel->verts[targetModel->indices[result.faceIdx * 3 + 2]];
+
+			float u = result.barry.x;
+			float v = result.barry.y;
+			float w = 1.0 - (u + v);
+			vec3 normal = w * v0->normal + u * v1->normal + v * v2->normal;
+
+			float dist = result.dist - glm::length(ray->normal * settings->normalAdjust);
+
+			uint8_t* dstNormal = &context->bandNormals[ray->texel * 4];
+			dstNormal[0] = (normal.x * 0.5 + 0.5) * 255;
+			dstNormal[1] = (normal.y * 0.5 + 0.5) * 255;
+			dstNormal[2] = (normal.z * 0.5 + 0.5) * 255;
+			dstNormal[3] = 255;
+
+			context->bandDisp[ray->texel] = dist;
+		}
+	}
+}
+
+//----------------------------------------------------------------------------------------------------
+// Bake.
+//----------------------------------------------------------------------------------------------------
+bool dispBake(ldiPhysicsMesh* CookedMesh, ldiModel* BaseModel, ldiModel* TargetModel, ldiDispBakeSettings* Settings, ldiDispBakeBandFunc BandFunc, void* UserData) {
+	PROFILE_ZONE("Disp bake");
+
+	if (Settings->width <= 0 || Settings->height <= 0 || Settings->tileSize <= 0) {
+		std::cout << "Displacement bake has invalid size\n";
+		return false;
+	}
+
+	ldiDispBakeContext context;
+	context.cookedMesh = CookedMesh;
+	context.baseModel = BaseModel;
+	context.targetModel = TargetModel;
+	context.settings = Settings;
+
+	_dispBakeBinTris(&context);
+
+	size_t bandTexels = (size_t)Settings->width * Settings->tileSize;
+	std::vector<float> bandDisp(bandTexels);
+	std::vector<uint8_t> bandNormals(bandTexels * 4);
+	context.bandDisp = bandDisp.data();
+	context.bandNormals = bandNormals.data();
+
+	for (int tY = 0; tY < context.tilesY; ++tY) {
+		context.bandTileY = tY;
+		context.bandRowStart = tY * Settings->tileSize;
+		context.bandRowCount = min(Settings->tileSize, Settings->height - context.bandRowStart);
+
+		size_t texelCount = (size_t)Settings->width * context.bandRowCount;
+		memset(context.bandDisp, 0, texelCount * sizeof(float));
+		memset(context.bandNormals, 0, texelCount * 4);
+
+		parallelFor(0, context.tilesX, 1, _dispBakeTileBatch, &context);
+
+		if (!BandFunc(context.bandRowStart, context.bandRowCount, context.bandDisp, context.bandNormals, UserData)) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+//----------------------------------------------------------------------------------------------------
+// Writers.
+//----------------------------------------------------------------------------------------------------
+bool _dispBakeImageBand(int RowStart, int RowCount, const float* Disp, const uint8_t* Normals, void* UserData) {
+	ldiDispImage* image = (ldiDispImage*)UserData;
+	size_t offset = (size_t)RowStart * image->width;
+	size_t count = (size_t)RowCount * image->width;
+
+	memcpy(image->data + offset, Disp, count * sizeof(float));
+	memcpy(image->normalData + offset * 4, Normals, count * 4);
+
+	return true;
+}
+
+// OutTex must be allocated, its size is the bake size.
+bool dispBakeToImage(ldiPhysicsMesh* CookedMesh, ldiModel* BaseModel, ldiModel* TargetModel, ldiDispImage* OutTex) {
+	ldiDispBakeSettings settings = dispBakeGetDefaultSettings(OutTex->width, OutTex->height);
+
+	return dispBake(CookedMesh, BaseModel, TargetModel, &settings, _dispBakeImageBand, OutTex);
+}
+
+struct ldiDispBakeFileWriter {
+	FILE*								file;
+	int									width;
+	int									height;
+};
+
+// File layout: header { magic, version, width, height }, then all displacement floats row major, then all
+// RGBA8 normals row major.
+bool _dispBakeFileBand(int RowStart, int RowCount, const float* Disp, const uint8_t* Normals, void* UserData) {
+	ldiDispBakeFileWriter* writer = (ldiDispBakeFileWriter*)UserData;
+	int64_t headerSize = 4 * sizeof(int32_t);
+	int64_t planeTexels = (int64_t)writer->width * writer->height;
+	int64_t offset = (int64_t)RowStart * writer->width;
+	size_t count = (size_t)RowCount * writer->width;
+
+	if (_fseeki64(writer->file, headerSize + offset * sizeof(float), SEEK_SET) != 0 || fwrite(Disp, sizeof(float), count, writer->file) != count) {
+		std::cout << "Displacement bake failed to write band\n";
+		return false;
+	}
+
+	if (_fseeki64(writer->file, headerSize + planeTexels * sizeof(float) + offset * 4, SEEK_SET) != 0 || fwrite(Normals, 4, count, writer->file) != count) {
+		std::cout << "Displacement bake failed to write band\n";
+		return false;
+	}
+
+	return true;
+}
+
+// Bakes straight to disk, memory use is one band of tiles regardless of size.
+bool dispBakeToFile(ldiPhysicsMesh* CookedMesh, ldiModel* BaseModel, ldiModel* TargetModel, ldiDispBakeSettings* Settings, const std::string& FilePath) {
+	ldiDispBakeFileWriter writer;
+	writer.width = Settings->width;
+	writer.height = Settings->height;
+
+	fopen_s(&writer.file, FilePath.c_str(), "wb");
+
+	if (writer.file == 0) {
+		std::cout << "Could not open displacement file: " << FilePath << "\n";
+		return false;
+	}
+
+	int32_t header[4] = { DISPBAKE_FILE_MAGIC, DISPBAKE_FILE_VERSION, Settings->width, Settings->height };
+	fwrite(header, sizeof(header), 1, writer.file);
+
+	bool result = dispBake(CookedMesh, BaseModel, TargetModel, Settings, _dispBakeFileBand, &writer);
+
+	fclose(writer.file);
+
+	return result;
+}
\ No newline at end of file
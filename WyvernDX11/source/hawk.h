@@ -125,9 +125,8 @@ void hawkProcessPacket(ldiHawk* Cam, ldiPacketBuilder* Packet) {
 		{
 			std::unique_lock<std::mutex> lock(Cam->packetRecvdMutex);
 			Cam->packetRecvdOpcode = (ldiHawkOpcode)packetHeader->opcode;
+			Cam->packetRecvdCondVar.notify_all();
 		}
-
-		Cam->packetRecvdCondVar.notify_all();
 	}
 }
 
@@ -229,6 +228,16 @@ void hawkInit(ldiHawk* Cam, const std::string& Hostname, int Port) {
 	Cam->workerThread = std::thread(hawkWorkerThread, Cam);
 }
 
+void hawkDestroy(ldiHawk* Cam) {
+	Cam->workerThreadRunning = false;
+	hawkDisconnect(Cam);
+	Cam->workerThread.join();
+
+	delete[] Cam->frameBuffer;
+	delete[] Cam->rxBuffer;
+	packetBuilderDestroy(&Cam->packetBuilder);
+}
+
 void hawkTriggerAndGetFrame(ldiHawk* Cam) {
 
 }
@@ -270,25 +279,18 @@ void hawkSetMode(ldiHawk* Cam, ldiCameraCaptureMode Mode) {
 
 void hawkClearWaitPacket(ldiHawk* Cam) {
 	std::unique_lock<std::mutex> lock(Cam->packetRecvdMutex);
-	Cam->packetRecvdOpcode == HO_NONE;
+	Cam->packetRecvdOpcode = HO_NONE;
 }
 
 bool hawkWaitForPacket(ldiHawk* Cam, ldiHawkOpcode Opcode) {
-	while (true) {
-		{
-			std::unique_lock<std::mutex> lock(Cam->packetRecvdMutex);
-			if (Cam->packetRecvdOpcode == Opcode) {
-				return true;
-			}
-		}
+	// NOTE: Check and wait under one lock so a packet that lands in between isn't missed.
+	std::unique_lock<std::mutex> lock(Cam->packetRecvdMutex);
 
-		{
-			//std::cout << "Wait\n";
-			std::unique_lock<std::mutex> lock(Cam->packetRecvdMutex);
-			Cam->packetRecvdCondVar.wait(lock);
-			//std::cout << "Awake " << Cam->packetRecvdOpcode << "\n";
-		}
+	while (Cam->packetRecvdOpcode != Opcode) {
+		//std::cout << "Wait\n";
+		Cam->packetRecvdCondVar.wait(lock);
+		//std::cout << "Awake " << Cam->packetRecvdOpcode << "\n";
 	}
 
-	return false;
+	return true;
 }
\ No newline at end of file
@@ -1204,6 +1204,17 @@ void imageInspectorShowUi(ldiImageInspector* Tool) {
 			}
 		}
 
+		if (ImGui::Button("Convert samples to archive")) {
+			std::string directoryPath;
+			if (showOpenDirectoryDialog(Tool->appContext->hWnd, Tool->appContext->currentWorkingDir, directoryPath)) {
+
+				std::string archivePath;
+				if (showSaveFileDialog(Tool->appContext->hWnd, Tool->appContext->currentWorkingDir, archivePath, L"Sample archive", L"*.lsa", L"lsa")) {
+					calibConvertSampleDirectory(directoryPath, archivePath);
+				}
+			}
+		}
+
 		ImGui::Separator();
 		ImGui::Text("Volume");
 
@@ -1217,6 +1228,16 @@ void imageInspectorShowUi(ldiImageInspector* Tool) {
 			}
 		}
 
+		if (ImGui::Button("Initial observations (archive)")) {
+			Tool->imageMode = IIM_CALIBRATION_JOB;
+			_imageInspectorSelectCalibJob(Tool, -1, -1);
+
+			std::string archivePath;
+			if (showOpenFileDialog(Tool->appContext->hWnd, Tool->appContext->currentWorkingDir, archivePath, L"Sample archive", L"*.lsa")) {
+				calibFindInitialObservations(calibJob, archivePath);
+			}
+		}
+
 		if (ImGui::Button("Initial estimations")) {
 			calibGetInitialEstimations(calibJob);
 		}
@@ -1237,6 +1258,15 @@ void imageInspectorShowUi(ldiImageInspector* Tool) {
 			}
 		}
 
+		if (ImGui::Button("Calibrate scanner (archive)")) {
+			_imageInspectorSelectCalibJob(Tool, -1, -1);
+
+			std::string archivePath;
+			if (showOpenFileDialog(Tool->appContext->hWnd, Tool->appContext->currentWorkingDir, archivePath, L"Sample archive", L"*.lsa")) {
+				calibCalibrateScanner(calibJob, archivePath);
+			}
+		}
+
 		ImGui::Separator();
 		ImGui::Text("Galvo");
 
@@ -42,6 +42,7 @@
 #include "threadSafeQueue.h"
 #include "camera.h"
 #include "ui.h"
+#include "sampleArchive.h"
 #include "calibrationJob.h"
 
 struct ldiBasicConstantBuffer {
@@ -168,6 +169,9 @@ struct ldiApp {
 	bool						showGalvoInspector = false;
 	bool						showProjectInspector = true;
 
+	// Platform talks to in-process device simulators instead of real hardware.
+	bool						useDeviceSim = false;
+
 	ldiServer					server = {};
 	ldiPhysics*					physics = 0;
 	ldiImageInspector*			imageInspector = 0;
@@ -204,11 +208,21 @@ void _initTiming() {
 //----------------------------------------------------------------------------------------------------
 // Primary systems.
 //----------------------------------------------------------------------------------------------------
+#include "profiler.h"
+#include "threadPool.h"
+#include "ringBuffer.h"
+#include "cameraModel.h"
+#include "meshAttributes.h"
+#include "meshDistance.h"
+#include "meshDecimate.h"
+#include "pointIndex.h"
+#include "surfelVisibility.h"
 #include "computerVision.h"
 #include "serialPort.h"
 #include "graphics.h"
 #include "debugPrims.h"
 #include "spatialGrid.h"
+#include "meshReorder.h"
 #include "physics.h"
 #include "verletPhysics.h"
 #include "antOptimizer.h"
@@ -216,15 +230,23 @@ void _initTiming() {
 #include "horse.h"
 #include "analogScope.h"
 #include "panther.h"
+#include "deviceSim.h"
+#include "calibObservations.h"
 #include "calibration.h"
 #include "scan.h"
+#include "colorPipeline.h"
+#include "textureSampler.h"
+#include "sampleAtlas.h"
+#include "stageCache.h"
 #include "project.h"
 #include "modelInspector.h"
 #include "platform.h"
 #include "samplerTester.h"
 #include "imageInspector.h"
+#include "displacementBaker.h"
 #include "modelEditor.h"
 #include "galvoInspector.h"
+#include "benchmark.h"
 
 ldiPhysics*				_physics = new ldiPhysics();
 ldiApp*					_appContext = new ldiApp();
@@ -883,15 +905,37 @@ bool _initResources(ldiApp* AppContext) {
 //----------------------------------------------------------------------------------------------------
 // Application main.
 //----------------------------------------------------------------------------------------------------
-int main() {
+int main(int argc, char** argv) {
 	std::cout << "Starting WyvernDX11\n";
 	_initTiming();
+	PROFILE_THREAD_NAME("Main");
+	threadPoolInit();
 
 	char dirBuff[512];
 	GetCurrentDirectory(sizeof(dirBuff), dirBuff);
 	_appContext->currentWorkingDir = std::string(dirBuff);
 	std::cout << "Working directory: " << _appContext->currentWorkingDir << "\n";
 
+	// NOTE: Headless benchmark mode, no window or graphics device is created.
+	if (argc > 1 && strcmp(argv[1], "-benchmark") == 0) {
+		_appContext->physics = _physics;
+		if (physicsInit(_appContext, _physics) != 0) {
+			std::cout << "PhysX init failed\n";
+			return 1;
+		}
+
+		int result = benchmarkRun(_appContext, (argc > 2) ? argv[2] : "../cache/benchmark.json");
+		threadPoolDestroy();
+
+		return result;
+	}
+
+	for (int i = 1; i < argc; ++i) {
+		if (strcmp(argv[i], "-sim") == 0) {
+			_appContext->useDeviceSim = true;
+		}
+	}
+
 	_createWindow(_appContext);
 
 	// Initialize Direct3D.
@@ -1057,6 +1101,23 @@ int main() {
 				if (ImGui::MenuItem("Save calibration as...")) {}
 				ImGui::EndMenu();
 			}
+
+#if LDI_PROFILER
+			if (ImGui::BeginMenu("Profiler")) {
+				if (ImGui::MenuItem("Print summary")) {
+					profilerPrintSummary();
+				}
+
+				if (ImGui::MenuItem("Export Chrome trace")) {
+					profilerExportChromeTrace("../cache/trace.json");
+				}
+
+				if (ImGui::MenuItem("Reset")) {
+					profilerReset();
+				}
+				ImGui::EndMenu();
+			}
+#endif
 			
 			/*if (ImGui::BeginMenu("Workspace")) {
 				if (ImGui::MenuItem("Platform")) {}
@@ -1157,6 +1218,9 @@ int main() {
 	_unregisterWindow(_appContext);
 
 	platformDestroy(_platform);
+	colorPipelineDestroy();
+	calibCloseSampleArchives();
+	threadPoolDestroy();
 
 	return 0;
 }
\ No newline at end of file
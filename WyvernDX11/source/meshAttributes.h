@@ -0,0 +1,241 @@
+#pragma once
+
+#include <emmintrin.h>
+
+//----------------------------------------------------------------------------------------------------
+// Mesh attributes.
+//----------------------------------------------------------------------------------------------------
+// Parallel vertex normals and batched transforms for ldiModel.
+//
+// Vertex normals are a gather, not a scatter. Face normals are computed in parallel, then each vertex sums
+// its faces through a vertex to face adjacency. Adjacency lists are in face order, so area weighted
+// results are bit identical to the old serial scatter in modelCreateFaceNormals. The adjacency can be kept
+// and passed back in when only positions change.
+
+enum ldiNormalWeighting {
+	NW_AREA,
+	NW_ANGLE,
+	NW_UNIFORM,
+};
+
+struct ldiVertexFaceAdjacency {
+	// Faces of vertex V are vertFaces[vertFaceStart[V]] to vertFaces[vertFaceStart[V + 1]].
+	std::vector<int>					vertFaceStart;
+	std::vector<int>					vertFaces;
+};
+
+void meshBuildVertexFaceAdjacency(ldiModel* Model, ldiVertexFaceAdjacency* Adjacency) {
+	PROFILE_ZONE("Build vertex face adjacency");
+
+	int vertCount = (int)Model->verts.size();
+	int indexCount = (int)Model->indices.size();
+	const uint32_t* indices = Model->indices.data();
+
+	Adjacency->vertFaceStart.assign(vertCount + 1, 0);
+	Adjacency->vertFaces.resize(indexCount);
+
+	int* start = Adjacency->vertFaceStart.data();
+
+	for (int i = 0; i < indexCount; ++i) {
+		++start[indices[i] + 1];
+	}
+
+	for (int i = 0; i < vertCount; ++i) {
+		start[i + 1] += start[i];
+	}
+
+	// NOTE: Walks faces in order, so every list ends up sorted by face.
+	std::vector<int> cursor(start, start + vertCount);
+	int* faces = Adjacency->vertFaces.data();
+
+	for (int i = 0; i < indexCount; ++i) {
+		faces[cursor[indices[i]]++] = i / 3;
+	}
+}
+
+//----------------------------------------------------------------------------------------------------
+// Vertex normals.
+//----------------------------------------------------------------------------------------------------
+struct ldiVertexNormalContext {
+	ldiModel*							model;
+	ldiVertexFaceAdjacency*				adjacency;
+	ldiNormalWeighting					weighting;
+	vec3*								faceNormals;
+};
+
+void _meshFaceNormalBatch(int StartIdx, int EndIdx, void* UserData) {
+	ldiVertexNormalContext* context = (ldiVertexNormalContext*)UserData;
+	const ldiMeshVertex* verts = context->model->verts.data();
+	const uint32_t* indices = context->model->indices.data();
+
+	for (int faceIter = StartIdx; faceIter < EndIdx; ++faceIter) {
+		vec3 p0 = verts[indices[faceIter * 3 + 0]].pos;
+		vec3 p1 = verts[indices[faceIter * 3 + 1]].pos;
+		vec3 p2 = verts[indices[faceIter * 3 + 2]].pos;
+
+		// NOTE: Same winding as modelCreateFaceNormals. Length is twice the face area.
+		vec3 normal = glm::cross(p0 - p1, p2 - p1);
+
+		if (context->weighting != NW_AREA) {
+			normal = (glm::dot(normal, normal) > 0.0f) ? glm::normalize(normal) : vec3(0.0f, 0.0f, 0.0f);
+		}
+
+		context->faceNormals[faceIter] = normal;
+	}
+}
+
+inline float _meshCornerAngle(const ldiMeshVertex* Verts, const uint32_t* Face, int Vert) {
+	int corner = (Face[0] == (uint32_t)Vert) ? 0 : ((Face[1] == (uint32_t)Vert) ? 1 : 2);
+
+	vec3 p = Verts[Face[corner]].pos;
+	vec3 e0 = Verts[Face[(corner + 1) % 3]].pos - p;
+	vec3 e1 = Verts[Face[(corner + 2) % 3]].pos - p;
+
+	float lengthSq = glm::dot(e0, e0) * glm::dot(e1, e1);
+
+	if (lengthSq <= 0.0f) {
+		return 0.0f;
+	}
+
+	return acosf(glm::clamp(glm::dot(e0, e1) / sqrtf(lengthSq), -1.0f, 1.0f));
+}
+
+void _meshVertexNormalBatch(int StartIdx, int EndIdx, void* UserData) {
+	ldiVertexNormalContext* context = (ldiVertexNormalContext*)UserData;
+	ldiMeshVertex* verts = context->model->verts.data();
+	const uint32_t* indices = context->model->indices.data();
+	const int* start = context->adjacency->vertFaceStart.data();
+	const int* faces = context->adjacency->vertFaces.data();
+
+	for (int vertIter = StartIdx; vertIter < EndIdx; ++vertIter) {
+		vec3 normal(0.0f, 0.0f, 0.0f);
+
+		if (context->weighting == NW_ANGLE) {
+			for (int i = start[vertIter]; i < start[vertIter + 1]; ++i) {
+				normal += context->faceNormals[faces[i]] * _meshCornerAngle(verts, indices + faces[i] * 3, vertIter);
+			}
+		} else {
+			for (int i = start[vertIter]; i < start[vertIter + 1]; ++i) {
+				normal += context->faceNormals[faces[i]];
+			}
+		}
+
+		// NOTE: Unreferenced and fully degenerate vertices get a zero normal rather than NaN.
+		verts[vertIter].normal = (glm::dot(normal, normal) > 0.0f) ? glm::normalize(normal) : vec3(0.0f, 0.0f, 0.0f);
+	}
+}
+
+// Adjacency is built if not provided. A provided adjacency that is empty is filled in for reuse.
+void meshComputeVertexNormals(ldiModel* Model, ldiNormalWeighting Weighting = NW_AREA, ldiVertexFaceAdjacency* Adjacency = nullptr) {
+	PROFILE_ZONE("Compute vertex normals");
+
+	int faceCount = (int)(Model->indices.size() / 3);
+	int vertCount = (int)Model->verts.size();
+
+	ldiVertexFaceAdjacency localAdjacency;
+
+	if (Adjacency == nullptr) {
+		Adjacency = &localAdjacency;
+	}
+
+	if ((int)Adjacency->vertFaceStart.size() != vertCount + 1 || (int)Adjacency->vertFaces.size() != faceCount * 3) {
+		meshBuildVertexFaceAdjacency(Model, Adjacency);
+	}
+
+	std::vector<vec3> faceNormals(faceCount);
+
+	ldiVertexNormalContext context;
+	context.model = Model;
+	context.adjacency = Adjacency;
+	context.weighting = Weighting;
+	context.faceNormals = faceNormals.data();
+
+	parallelFor(0, faceCount, 4096, _meshFaceNormalBatch, &context);
+	parallelFor(0, vertCount, 4096, _meshVertexNormalBatch, &context);
+}
+
+//----------------------------------------------------------------------------------------------------
+// Transforms.
+//----------------------------------------------------------------------------------------------------
+struct ldiMeshTransformContext {
+	const ldiMeshVertex*				src;
+	ldiMeshVertex*						dst;
+	mat4								transform;
+	glm::mat3							normalMat;
+};
+
+void _meshTransformBatch(int StartIdx, int EndIdx, void* UserData) {
+	ldiMeshTransformContext* context = (ldiMeshTransformContext*)UserData;
+	const ldiMeshVertex* src = context->src;
+	ldiMeshVertex* dst = context->dst;
+	const mat4& m = context->transform;
+	const glm::mat3& n = context->normalMat;
+
+	__m128 m00 = _mm_set1_ps(m[0][0]), m01 = _mm_set1_ps(m[0][1]), m02 = _mm_set1_ps(m[0][2]);
+	__m128 m10 = _mm_set1_ps(m[1][0]), m11 = _mm_set1_ps(m[1][1]), m12 = _mm_set1_ps(m[1][2]);
+	__m128 m20 = _mm_set1_ps(m[2][0]), m21 = _mm_set1_ps(m[2][1]), m22 = _mm_set1_ps(m[2][2]);
+	__m128 m30 = _mm_set1_ps(m[3][0]), m31 = _mm_set1_ps(m[3][1]), m32 = _mm_set1_ps(m[3][2]);
+
+	__m128 n00 = _mm_set1_ps(n[0][0]), n01 = _mm_set1_ps(n[0][1]), n02 = _mm_set1_ps(n[0][2]);
+	__m128 n10 = _mm_set1_ps(n[1][0]), n11 = _mm_set1_ps(n[1][1]), n12 = _mm_set1_ps(n[1][2]);
+	__m128 n20 = _mm_set1_ps(n[2][0]), n21 = _mm_set1_ps(n[2][1]), n22 = _mm_set1_ps(n[2][2]);
+
+	int i = StartIdx;
+
+	for (; i + 4 <= EndIdx; i += 4) {
+		const ldiMeshVertex* v = src + i;
+
+		// NOTE: Vertices are AoS, loads and stores go through the SoA registers one lane at a time.
+		__m128 px = _mm_setr_ps(v[0].pos.x, v[1].pos.x, v[2].pos.x, v[3].pos.x);
+		__m128 py = _mm_setr_ps(v[0].pos.y, v[1].pos.y, v[2].pos.y, v[3].pos.y);
+		__m128 pz = _mm_setr_ps(v[0].pos.z, v[1].pos.z, v[2].pos.z, v[3].pos.z);
+		__m128 nx = _mm_setr_ps(v[0].normal.x, v[1].normal.x, v[2].normal.x, v[3].normal.x);
+		__m128 ny = _mm_setr_ps(v[0].normal.y, v[1].normal.y, v[2].normal.y, v[3].normal.y);
+		__m128 nz = _mm_setr_ps(v[0].normal.z, v[1].normal.z, v[2].normal.z, v[3].normal.z);
+
+		alignas(16) float rp[3][4];
+		_mm_store_ps(rp[0], _mm_add_ps(_mm_add_ps(_mm_mul_ps(m00, px), _mm_mul_ps(m10, py)), _mm_add_ps(_mm_mul_ps(m20, pz), m30)));
+		_mm_store_ps(rp[1], _mm_add_ps(_mm_add_ps(_mm_mul_ps(m01, px), _mm_mul_ps(m11, py)), _mm_add_ps(_mm_mul_ps(m21, pz), m31)));
+		_mm_store_ps(rp[2], _mm_add_ps(_mm_add_ps(_mm_mul_ps(m02, px), _mm_mul_ps(m12, py)), _mm_add_ps(_mm_mul_ps(m22, pz), m32)));
+
+		__m128 tx = _mm_add_ps(_mm_add_ps(_mm_mul_ps(n00, nx), _mm_mul_ps(n10, ny)), _mm_mul_ps(n20, nz));
+		__m128 ty = _mm_add_ps(_mm_add_ps(_mm_mul_ps(n01, nx), _mm_mul_ps(n11, ny)), _mm_mul_ps(n21, nz));
+		__m128 tz = _mm_add_ps(_mm_add_ps(_mm_mul_ps(n02, nx), _mm_mul_ps(n12, ny)), _mm_mul_ps(n22, nz));
+
+		// NOTE: Full precision normalize, zero length normals stay zero.
+		__m128 lengthSq = _mm_add_ps(_mm_add_ps(_mm_mul_ps(tx, tx), _mm_mul_ps(ty, ty)), _mm_mul_ps(tz, tz));
+		__m128 nonZero = _mm_cmpgt_ps(lengthSq, _mm_setzero_ps());
+		__m128 invLength = _mm_and_ps(nonZero, _mm_div_ps(_mm_set1_ps(1.0f), _mm_sqrt_ps(lengthSq)));
+
+		alignas(16) float rn[3][4];
+		_mm_store_ps(rn[0], _mm_mul_ps(tx, invLength));
+		_mm_store_ps(rn[1], _mm_mul_ps(ty, invLength));
+		_mm_store_ps(rn[2], _mm_mul_ps(tz, invLength));
+
+		for (int j = 0; j < 4; ++j) {
+			ldiMeshVertex* d = dst + i + j;
+			d->pos = vec3(rp[0][j], rp[1][j], rp[2][j]);
+			d->normal = vec3(rn[0][j], rn[1][j], rn[2][j]);
+			d->uv = v[j].uv;
+		}
+	}
+
+	for (; i < EndIdx; ++i) {
+		vec3 normal = n * src[i].normal;
+
+		dst[i].pos = m * vec4(src[i].pos, 1.0f);
+		dst[i].normal = (glm::dot(normal, normal) > 0.0f) ? glm::normalize(normal) : vec3(0.0f, 0.0f, 0.0f);
+		dst[i].uv = src[i].uv;
+	}
+}
+
+// Transforms positions by Transform and normals by its inverse transpose. Src and Dst can be the same.
+void meshTransformVerts(const ldiMeshVertex* Src, ldiMeshVertex* Dst, int Count, mat4 Transform) {
+	ldiMeshTransformContext context;
+	context.src = Src;
+	context.dst = Dst;
+	context.transform = Transform;
+	context.normalMat = glm::transpose(glm::inverse(glm::mat3(Transform)));
+
+	parallelFor(0, Count, 8192, _meshTransformBatch, &context);
+}
\ No newline at end of file
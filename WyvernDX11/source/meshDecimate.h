@@ -0,0 +1,1017 @@
+#pragma once
+
+#include <algorithm>
+#include <float.h>
+
+//----------------------------------------------------------------------------------------------------
+// Mesh decimation.
+//----------------------------------------------------------------------------------------------------
+// Quadric error edge collapse for building coarse proxies of an ldiModel or ldiQuadModel.
+//
+// Collapses are half edge collapses: a vertex moves onto a neighbour and is replaced by it. Surviving
+// vertices keep their UVs and normals untouched and surviving triangles keep their identity, which is what
+// the face map records. Vertices that share a position but not attributes (UV seams, hard edges) are
+// handled as one. Seam vertices only slide along their seam and take their twin with them, border vertices
+// only slide along the border, and anything more complicated is locked.
+//
+// Work runs in passes. Each pass rebuilds adjacency and evaluates every edge in parallel, then walks the
+// edges by cost and takes collapses whose one rings don't touch any collapse already taken. So every check
+// made at the start of the pass still holds when the collapse is applied, and the output doesn't depend on
+// the worker count.
+
+#define MESH_DECIMATE_MAX_RING 64
+#define MESH_DECIMATE_MAX_PASSES 1000
+
+struct ldiDecimateSettings {
+	// Stops at or below this many triangles. 0 to only stop on maxError.
+	int									targetTriCount;
+	// Largest allowed collapse error, roughly a distance in model units.
+	float								maxError;
+	// Cost of moving onto a vertex with different attributes, as a fraction of the model size per unit of
+	// normal or UV difference.
+	float								normalWeight;
+	float								uvWeight;
+	// Weight of the planes holding open edges (borders and seams) in place.
+	float								boundaryWeight;
+};
+
+struct ldiDecimateResult {
+	// Source triangle of each output triangle. Source quad for quad models.
+	std::vector<int>					faceMap;
+	// Output vertex each source vertex ended up as, -1 if it ended up in no output triangle.
+	std::vector<int>					vertMap;
+	// Largest error of any collapse that was applied.
+	float								error;
+	int									passCount;
+};
+
+ldiDecimateSettings meshDecimateGetDefaultSettings(int TargetTriCount) {
+	ldiDecimateSettings result = {};
+	result.targetTriCount = TargetTriCount;
+	result.maxError = FLT_MAX;
+	result.normalWeight = 0.01f;
+	result.uvWeight = 0.01f;
+	result.boundaryWeight = 10.0f;
+
+	return result;
+}
+
+//----------------------------------------------------------------------------------------------------
+// Quadrics.
+//----------------------------------------------------------------------------------------------------
+struct ldiDecimateQuadric {
+	double								a2, ab, ac, ad;
+	double								b2, bc, bd;
+	double								c2, cd;
+	double								d2;
+	// Total area, error is divided by it to get a squared distance.
+	double								w;
+};
+
+inline void _meshDecimateAddPlane(ldiDecimateQuadric* Q, vec3 N, float D, double Weight) {
+	double a = N.x;
+	double b = N.y;
+	double c = N.z;
+	double d = D;
+
+	Q->a2 += Weight * a * a;
+	Q->ab += Weight * a * b;
+	Q->ac += Weight * a * c;
+	Q->ad += Weight * a * d;
+	Q->b2 += Weight * b * b;
+	Q->bc += Weight * b * c;
+	Q->bd += Weight * b * d;
+	Q->c2 += Weight * c * c;
+	Q->cd += Weight * c * d;
+	Q->d2 += Weight * d * d;
+}
+
+inline void _meshDecimateAddQuadric(ldiDecimateQuadric* Q, const ldiDecimateQuadric* Other) {
+	Q->a2 += Other->a2;
+	Q->ab += Other->ab;
+	Q->ac += Other->ac;
+	Q->ad += Other->ad;
+	Q->b2 += Other->b2;
+	Q->bc += Other->bc;
+	Q->bd += Other->bd;
+	Q->c2 += Other->c2;
+	Q->cd += Other->cd;
+	Q->d2 += Other->d2;
+	Q->w += Other->w;
+}
+
+inline float _meshDecimateQuadricError(const ldiDecimateQuadric* Q, vec3 P) {
+	double x = P.x;
+	double y = P.y;
+	double z = P.z;
+
+	double error =
+		Q->a2 * x * x + 2.0 * Q->ab * x * y + 2.0 * Q->ac * x * z + 2.0 * Q->ad * x +
+		Q->b2 * y * y + 2.0 * Q->bc * y * z + 2.0 * Q->bd * y +
+		Q->c2 * z * z + 2.0 * Q->cd * z +
+		Q->d2;
+
+	if (error < 0.0) {
+		error = 0.0;
+	}
+
+	return (float)(error / (Q->w > 0.0 ? Q->w : 1.0));
+}
+
+//----------------------------------------------------------------------------------------------------
+// Decimation state.
+//----------------------------------------------------------------------------------------------------
+enum ldiDecimateVertKind : uint8_t {
+	DVK_MANIFOLD,
+	DVK_BORDER,
+	DVK_SEAM,
+	DVK_LOCKED,
+};
+
+struct ldiDecimateCollapse {
+	// Attribute vertices. Twins are the other side of a seam, -1 otherwise.
+	int									from;
+	int									to;
+	int									twinFrom;
+	int									twinTo;
+	// Triangles removed by the collapse.
+	int									removed;
+	// Edge the collapse came from, breaks cost ties.
+	int									edge;
+	float								cost;
+};
+
+struct ldiDecimateContext {
+	const ldiDecimateSettings*			settings;
+	const ldiMeshVertex*				verts;
+	int									vertCount;
+	float								normalWeightSq;
+	float								uvWeightSq;
+
+	// Vertices welded by exact position.
+	std::vector<int>					posIds;
+	std::vector<vec3>					positions;
+	int									posCount;
+	std::vector<ldiDecimateQuadric>		quadrics;
+
+	// Current triangles as attribute vertex indices, and the source triangle of each.
+	std::vector<uint32_t>				indices;
+	std::vector<int>					triSource;
+
+	// Rebuilt every pass. Triangles of vertex V are tris[start[V]] to tris[start[V + 1]].
+	std::vector<int>					vertTriStart;
+	std::vector<int>					vertTris;
+	std::vector<int>					posTriStart;
+	std::vector<int>					posTris;
+
+	// Bit C set if half edge C (corner C to C + 1) has no opposite, with attributes and by position.
+	std::vector<uint8_t>				triOpen;
+	std::vector<uint8_t>				triPosOpen;
+
+	// Attribute vertex on the other end of the vertex's open half edges. -1 none, -2 more than one.
+	std::vector<int>					openOut;
+	std::vector<int>					openIn;
+	// Bit 0 some open half edge is open by position too (border), bit 1 some is not (seam).
+	std::vector<uint8_t>				openType;
+	std::vector<uint8_t>				kinds;
+	std::vector<int>					twins;
+
+	std::vector<ldiDecimateCollapse>	collapses;
+	std::vector<int>					collapseTo;
+	std::vector<uint8_t>				posLocked;
+	std::vector<uint8_t>				triKeep;
+};
+
+struct _ldiDecimateWeldCompare {
+	const ldiMeshVertex*				verts;
+
+	bool operator()(int A, int B) const {
+		vec3 a = verts[A].pos;
+		vec3 b = verts[B].pos;
+
+		if (a.x != b.x) return a.x < b.x;
+		if (a.y != b.y) return a.y < b.y;
+		if (a.z != b.z) return a.z < b.z;
+
+		return A < B;
+	}
+};
+
+struct _ldiDecimateCollapseCompare {
+	bool operator()(const ldiDecimateCollapse& A, const ldiDecimateCollapse& B) const {
+		if (A.cost != B.cost) {
+			return A.cost < B.cost;
+		}
+
+		return A.edge < B.edge;
+	}
+};
+
+inline int _meshDecimatePos(ldiDecimateContext* Context, int Tri, int Corner) {
+	return Context->posIds[Context->indices[Tri * 3 + Corner]];
+}
+
+// Remap is null for attribute vertices, posIds for positions.
+void _meshDecimateBuildAdjacency(const std::vector<uint32_t>& Indices, const int* Remap, int VertCount, std::vector<int>& Start, std::vector<int>& Tris) {
+	int indexCount = (int)Indices.size();
+
+	Start.assign(VertCount + 1, 0);
+	Tris.resize(indexCount);
+
+	for (int i = 0; i < indexCount; ++i) {
+		int v = Remap ? Remap[Indices[i]] : (int)Indices[i];
+		++Start[v + 1];
+	}
+
+	for (int i = 0; i < VertCount; ++i) {
+		Start[i + 1] += Start[i];
+	}
+
+	std::vector<int> cursor(Start.begin(), Start.end() - 1);
+
+	for (int i = 0; i < indexCount; ++i) {
+		int v = Remap ? Remap[Indices[i]] : (int)Indices[i];
+		Tris[cursor[v]++] = i / 3;
+	}
+}
+
+inline bool _meshDecimateHasHalfEdge(const uint32_t* Indices, const int* Remap, const int* Start, const int* Tris, int From, int To) {
+	for (int i = Start[From]; i < Start[From + 1]; ++i) {
+		const uint32_t* tri = &Indices[Tris[i] * 3];
+
+		for (int c = 0; c < 3; ++c) {
+			int a = Remap ? Remap[tri[c]] : (int)tri[c];
+			int b = Remap ? Remap[tri[(c + 1) % 3]] : (int)tri[(c + 1) % 3];
+
+			if (a == From && b == To) {
+				return true;
+			}
+		}
+	}
+
+	return false;
+}
+
+//----------------------------------------------------------------------------------------------------
+// Per pass classification.
+//----------------------------------------------------------------------------------------------------
+void _meshDecimateOpenEdgeBatch(int StartIdx, int EndIdx, void* UserData) {
+	ldiDecimateContext* context = (ldiDecimateContext*)UserData;
+	const uint32_t* indices = context->indices.data();
+	const int* posIds = context->posIds.data();
+
+	for (int triIter = StartIdx; triIter < EndIdx; ++triIter) {
+		uint8_t open = 0;
+		uint8_t posOpen = 0;
+
+		for (int c = 0; c < 3; ++c) {
+			int i = indices[triIter * 3 + c];
+			int j = indices[triIter * 3 + (c + 1) % 3];
+
+			if (!_meshDecimateHasHalfEdge(indices, nullptr, context->vertTriStart.data(), context->vertTris.data(), j, i)) {
+				open |= 1 << c;
+			}
+
+			if (!_meshDecimateHasHalfEdge(indices, posIds, context->posTriStart.data(), context->posTris.data(), posIds[j], posIds[i])) {
+				posOpen |= 1 << c;
+			}
+		}
+
+		context->triOpen[triIter] = open;
+		context->triPosOpen[triIter] = posOpen;
+	}
+}
+
+inline int _meshDecimateMergeOpen(int Current, int Vert) {
+	if (Current == -1 || Current == Vert) {
+		return Vert;
+	}
+
+	return -2;
+}
+
+void _meshDecimateOpenVertBatch(int StartIdx, int EndIdx, void* UserData) {
+	ldiDecimateContext* context = (ldiDecimateContext*)UserData;
+	const uint32_t* indices = context->indices.data();
+
+	for (int v = StartIdx; v < EndIdx; ++v) {
+		int openOut = -1;
+		int openIn = -1;
+		uint8_t openType = 0;
+
+		for (int i = context->vertTriStart[v]; i < context->vertTriStart[v + 1]; ++i) {
+			int tri = context->vertTris[i];
+			uint8_t open = context->triOpen[tri];
+			uint8_t posOpen = context->triPosOpen[tri];
+
+			for (int c = 0; c < 3; ++c) {
+				if ((int)indices[tri * 3 + c] != v) {
+					continue;
+				}
+
+				int outEdge = c;
+				int inEdge = (c + 2) % 3;
+
+				if (open & (1 << outEdge)) {
+					openOut = _meshDecimateMergeOpen(openOut, indices[tri * 3 + (c + 1) % 3]);
+					openType |= (posOpen & (1 << outEdge)) ? 1 : 2;
+				}
+
+				if (open & (1 << inEdge)) {
+					openIn = _meshDecimateMergeOpen(openIn, indices[tri * 3 + (c + 2) % 3]);
+					openType |= (posOpen & (1 << inEdge)) ? 1 : 2;
+				}
+			}
+		}
+
+		context->openOut[v] = openOut;
+		context->openIn[v] = openIn;
+		context->openType[v] = openType;
+	}
+}
+
+void _meshDecimateKindBatch(int StartIdx, int EndIdx, void* UserData) {
+	ldiDecimateContext* context = (ldiDecimateContext*)UserData;
+	const uint32_t* indices = context->indices.data();
+	const int* posIds = context->posIds.data();
+
+	for (int p = StartIdx; p < EndIdx; ++p) {
+		int wedges[3];
+		int wedgeCount = 0;
+
+		for (int i = context->posTriStart[p]; i < context->posTriStart[p + 1] && wedgeCount < 3; ++i) {
+			int tri = context->posTris[i];
+
+			for (int c = 0; c < 3 && wedgeCount < 3; ++c) {
+				int v = indices[tri * 3 + c];
+
+				if (posIds[v] != p) {
+					continue;
+				}
+
+				bool found = false;
+
+				for (int w = 0; w < wedgeCount; ++w) {
+					found |= (wedges[w] == v);
+				}
+
+				if (!found) {
+					wedges[wedgeCount++] = v;
+				}
+			}
+		}
+
+		uint8_t kind = DVK_LOCKED;
+
+		if (wedgeCount == 1) {
+			int w = wedges[0];
+			context->twins[w] = -1;
+
+			if (context->openOut[w] == -1 && context->openIn[w] == -1) {
+				kind = DVK_MANIFOLD;
+			} else if (context->openOut[w] >= 0 && context->openIn[w] >= 0 && context->openType[w] == 1) {
+				kind = DVK_BORDER;
+			}
+		} else if (wedgeCount == 2) {
+			int w0 = wedges[0];
+			int w1 = wedges[1];
+			context->twins[w0] = -1;
+			context->twins[w1] = -1;
+
+			// NOTE: One seam running through, each side's open edges lead to the same positions as the other's.
+			if (context->openOut[w0] >= 0 && context->openIn[w0] >= 0 && context->openOut[w1] >= 0 && context->openIn[w1] >= 0 &&
+				context->openType[w0] == 2 && context->openType[w1] == 2 &&
+				posIds[context->openOut[w0]] == posIds[context->openIn[w1]] &&
+				posIds[context->openIn[w0]] == posIds[context->openOut[w1]]) {
+				kind = DVK_SEAM;
+				context->twins[w0] = w1;
+				context->twins[w1] = w0;
+			}
+		} else {
+			for (int w = 0; w < wedgeCount; ++w) {
+				context->twins[wedges[w]] = -1;
+			}
+		}
+
+		context->kinds[p] = kind;
+	}
+}
+
+//----------------------------------------------------------------------------------------------------
+// Collapse evaluation.
+//----------------------------------------------------------------------------------------------------
+// Distinct neighbours of position P. Returns -1 if there are more than fit.
+int _meshDecimateGetRing(ldiDecimateContext* Context, int P, int* Ring) {
+	int count = 0;
+
+	for (int i = Context->posTriStart[P]; i < Context->posTriStart[P + 1]; ++i) {
+		int tri = Context->posTris[i];
+
+		for (int c = 0; c < 3; ++c) {
+			int q = _meshDecimatePos(Context, tri, c);
+
+			if (q == P) {
+				continue;
+			}
+
+			bool found = false;
+
+			for (int r = 0; r < count; ++r) {
+				found |= (Ring[r] == q);
+			}
+
+			if (!found) {
+				if (count == MESH_DECIMATE_MAX_RING) {
+					return -1;
+				}
+
+				Ring[count++] = q;
+			}
+		}
+	}
+
+	return count;
+}
+
+inline float _meshDecimateAttributeCost(ldiDecimateContext* Context, int From, int To) {
+	const ldiMeshVertex* a = &Context->verts[From];
+	const ldiMeshVertex* b = &Context->verts[To];
+
+	vec3 dn = a->normal - b->normal;
+	vec2 duv = a->uv - b->uv;
+
+	return glm::dot(dn, dn) * Context->normalWeightSq + glm::dot(duv, duv) * Context->uvWeightSq;
+}
+
+// Fills the collapse of From onto To, cost is FLT_MAX if it isn't allowed.
+void _meshDecimateEvaluate(ldiDecimateContext* Context, int From, int To, ldiDecimateCollapse* Collapse) {
+	Collapse->from = From;
+	Collapse->to = To;
+	Collapse->twinFrom = -1;
+	Collapse->twinTo = -1;
+	Collapse->removed = 0;
+	Collapse->cost = FLT_MAX;
+
+	int pa = Context->posIds[From];
+	int pb = Context->posIds[To];
+
+	if (pa == pb) {
+		return;
+	}
+
+	uint8_t kindA = Context->kinds[pa];
+	uint8_t kindB = Context->kinds[pb];
+	bool alongOpenEdge = (Context->openOut[From] == To || Context->openIn[From] == To);
+
+	if (kindA == DVK_LOCKED) {
+		return;
+	}
+
+	if (kindA == DVK_BORDER && (!alongOpenEdge || (kindB != DVK_BORDER && kindB != DVK_LOCKED))) {
+		return;
+	}
+
+	if (kindA == DVK_SEAM) {
+		if (!alongOpenEdge || (kindB != DVK_SEAM && kindB != DVK_LOCKED)) {
+			return;
+		}
+
+		int twinFrom = Context->twins[From];
+		int twinOut = Context->openOut[twinFrom];
+		int twinIn = Context->openIn[twinFrom];
+
+		if (twinOut >= 0 && Context->posIds[twinOut] == pb) {
+			Collapse->twinTo = twinOut;
+		} else if (twinIn >= 0 && Context->posIds[twinIn] == pb) {
+			Collapse->twinTo = twinIn;
+		} else {
+			return;
+		}
+
+		Collapse->twinFrom = twinFrom;
+	}
+
+	// Link condition, the edge's triangles must be exactly the shared neighbours.
+	int ringA[MESH_DECIMATE_MAX_RING];
+	int ringB[MESH_DECIMATE_MAX_RING];
+	int ringCountA = _meshDecimateGetRing(Context, pa, ringA);
+	int ringCountB = _meshDecimateGetRing(Context, pb, ringB);
+
+	if (ringCountA < 0 || ringCountB < 0) {
+		return;
+	}
+
+	int common = 0;
+
+	for (int i = 0; i < ringCountA; ++i) {
+		for (int j = 0; j < ringCountB; ++j) {
+			common += (ringA[i] == ringB[j]);
+		}
+	}
+
+	int shared = 0;
+	vec3 target = Context->positions[pb];
+
+	for (int i = Context->posTriStart[pa]; i < Context->posTriStart[pa + 1]; ++i) {
+		int tri = Context->posTris[i];
+		int p[3] = { _meshDecimatePos(Context, tri, 0), _meshDecimatePos(Context, tri, 1), _meshDecimatePos(Context, tri, 2) };
+
+		if (p[0] == pb || p[1] == pb || p[2] == pb) {
+			++shared;
+			continue;
+		}
+
+		// No folds, the triangle's normal can't turn by more than about 75 degrees.
+		vec3 before[3];
+		vec3 after[3];
+
+		for (int c = 0; c < 3; ++c) {
+			before[c] = Context->positions[p[c]];
+			after[c] = (p[c] == pa) ? target : before[c];
+		}
+
+		vec3 n0 = glm::cross(before[1] - before[0], before[2] - before[0]);
+		vec3 n1 = glm::cross(after[1] - after[0], after[2] - after[0]);
+		float d = glm::dot(n0, n1);
+
+		if (d <= 0.25f * sqrtf(glm::dot(n0, n0) * glm::dot(n1, n1))) {
+			return;
+		}
+
+		// Same for the UV layout, triangles can't turn over in texture space.
+		vec2 uvBefore[3];
+		vec2 uvAfter[3];
+
+		for (int c = 0; c < 3; ++c) {
+			int v = Context->indices[tri * 3 + c];
+			uvBefore[c] = Context->verts[v].uv;
+
+			if (v == From) {
+				uvAfter[c] = Context->verts[To].uv;
+			} else if (v == Collapse->twinFrom) {
+				uvAfter[c] = Context->verts[Collapse->twinTo].uv;
+			} else {
+				uvAfter[c] = uvBefore[c];
+			}
+		}
+
+		float uvArea0 = (uvBefore[1].x - uvBefore[0].x) * (uvBefore[2].y - uvBefore[0].y) - (uvBefore[1].y - uvBefore[0].y) * (uvBefore[2].x - uvBefore[0].x);
+		float uvArea1 = (uvAfter[1].x - uvAfter[0].x) * (uvAfter[2].y - uvAfter[0].y) - (uvAfter[1].y - uvAfter[0].y) * (uvAfter[2].x - uvAfter[0].x);
+
+		if (uvArea0 * uvArea1 < 0.0f) {
+			return;
+		}
+	}
+
+	if (shared == 0 || shared > 2 || common != shared) {
+		return;
+	}
+
+	// NOTE: Closing a tetrahedron would leave two faces back to back.
+	if (shared == 2 && ringCountA == 3 && ringCountB == 3) {
+		return;
+	}
+
+	float cost = _meshDecimateQuadricError(&Context->quadrics[pa], target);
+	cost += _meshDecimateAttributeCost(Context, From, To);
+
+	if (Collapse->twinFrom != -1) {
+		cost += _meshDecimateAttributeCost(Context, Collapse->twinFrom, Collapse->twinTo);
+	}
+
+	Collapse->removed = shared;
+	Collapse->cost = cost;
+}
+
+void _meshDecimateEvaluateBatch(int StartIdx, int EndIdx, void* UserData) {
+	ldiDecimateContext* context = (ldiDecimateContext*)UserData;
+
+	for (int i = StartIdx; i < EndIdx; ++i) {
+		ldiDecimateCollapse* collapse = &context->collapses[i];
+		int edge = collapse->edge;
+
+		ldiDecimateCollapse forward;
+		ldiDecimateCollapse backward;
+		_meshDecimateEvaluate(context, collapse->from, collapse->to, &forward);
+		_meshDecimateEvaluate(context, collapse->to, collapse->from, &backward);
+
+		*collapse = (backward.cost < forward.cost) ? backward : forward;
+		collapse->edge = edge;
+	}
+}
+
+//----------------------------------------------------------------------------------------------------
+// Setup.
+//----------------------------------------------------------------------------------------------------
+void _meshDecimateQuadricBatch(int StartIdx, int EndIdx, void* UserData) {
+	ldiDecimateContext* context = (ldiDecimateContext*)UserData;
+	float boundaryWeight = context->settings->boundaryWeight;
+
+	for (int p = StartIdx; p < EndIdx; ++p) {
+		ldiDecimateQuadric q = {};
+
+		for (int i = context->posTriStart[p]; i < context->posTriStart[p + 1]; ++i) {
+			int tri = context->posTris[i];
+			vec3 v[3];
+
+			for (int c = 0; c < 3; ++c) {
+				v[c] = context->positions[_meshDecimatePos(context, tri, c)];
+			}
+
+			vec3 normal = glm::cross(v[1] - v[0], v[2] - v[0]);
+			float len = glm::length(normal);
+
+			if (len <= 0.0f) {
+				continue;
+			}
+
+			normal /= len;
+			double area = len * 0.5;
+			_meshDecimateAddPlane(&q, normal, -glm::dot(normal, v[0]), area);
+			q.w += area;
+
+			// Planes through open edges, perpendicular to the face, so borders and seams keep their shape.
+			uint8_t open = context->triOpen[tri];
+
+			for (int c = 0; c < 3; ++c) {
+				int next = (c + 1) % 3;
+
+				if (!(open & (1 << c)) || (_meshDecimatePos(context, tri, c) != p && _meshDecimatePos(context, tri, next) != p)) {
+					continue;
+				}
+
+				vec3 edge = v[next] - v[c];
+				vec3 edgeNormal = glm::cross(edge, normal);
+				float edgeNormalLen = glm::length(edgeNormal);
+
+				if (edgeNormalLen <= 0.0f) {
+					continue;
+				}
+
+				edgeNormal /= edgeNormalLen;
+				_meshDecimateAddPlane(&q, edgeNormal, -glm::dot(edgeNormal, v[c]), glm::dot(edge, edge) * boundaryWeight);
+			}
+		}
+
+		context->quadrics[p] = q;
+	}
+}
+
+void _meshDecimateClassify(ldiDecimateContext* Context) {
+	int triCount = (int)Context->indices.size() / 3;
+
+	_meshDecimateBuildAdjacency(Context->indices, nullptr, Context->vertCount, Context->vertTriStart, Context->vertTris);
+	_meshDecimateBuildAdjacency(Context->indices, Context->posIds.data(), Context->posCount, Context->posTriStart, Context->posTris);
+
+	Context->triOpen.resize(triCount);
+	Context->triPosOpen.resize(triCount);
+	parallelFor(0, triCount, 1024, _meshDecimateOpenEdgeBatch, Context);
+	parallelFor(0, Context->vertCount, 1024, _meshDecimateOpenVertBatch, Context);
+	parallelFor(0, Context->posCount, 1024, _meshDecimateKindBatch, Context);
+}
+
+void _meshDecimateRemapBatch(int StartIdx, int EndIdx, void* UserData) {
+	ldiDecimateContext* context = (ldiDecimateContext*)UserData;
+	uint32_t* indices = context->indices.data();
+
+	for (int triIter = StartIdx; triIter < EndIdx; ++triIter) {
+		for (int c = 0; c < 3; ++c) {
+			int to = context->collapseTo[indices[triIter * 3 + c]];
+
+			if (to != -1) {
+				indices[triIter * 3 + c] = to;
+			}
+		}
+
+		int p0 = _meshDecimatePos(context, triIter, 0);
+		int p1 = _meshDecimatePos(context, triIter, 1);
+		int p2 = _meshDecimatePos(context, triIter, 2);
+
+		context->triKeep[triIter] = (p0 != p1 && p1 != p2 && p2 != p0);
+	}
+}
+
+void _meshDecimateCompactTris(ldiDecimateContext* Context) {
+	int triCount = (int)Context->indices.size() / 3;
+	int keptCount = 0;
+
+	for (int i = 0; i < triCount; ++i) {
+		if (!Context->triKeep[i]) {
+			continue;
+		}
+
+		for (int c = 0; c < 3; ++c) {
+			Context->indices[keptCount * 3 + c] = Context->indices[i * 3 + c];
+		}
+
+		Context->triSource[keptCount] = Context->triSource[i];
+		++keptCount;
+	}
+
+	Context->indices.resize(keptCount * 3);
+	Context->triSource.resize(keptCount);
+}
+
+//----------------------------------------------------------------------------------------------------
+// Decimation.
+//----------------------------------------------------------------------------------------------------
+// Result gets the surviving vertices in their source order. False if the model has no triangles.
+bool meshDecimate(ldiModel* Model, ldiDecimateSettings* Settings, ldiModel* Result, ldiDecimateResult* Info = nullptr) {
+	PROFILE_ZONE("Mesh decimate");
+
+	int vertCount = (int)Model->verts.size();
+	int sourceTriCount = (int)Model->indices.size() / 3;
+
+	Result->verts.clear();
+	Result->indices.clear();
+
+	if (Info) {
+		Info->faceMap.clear();
+		Info->vertMap.assign(vertCount, -1);
+		Info->error = 0.0f;
+		Info->passCount = 0;
+	}
+
+	if (sourceTriCount == 0 || vertCount == 0) {
+		return false;
+	}
+
+	ldiDecimateContext context = {};
+	context.settings = Settings;
+	context.verts = Model->verts.data();
+	context.vertCount = vertCount;
+
+	// Weld by exact position.
+	{
+		std::vector<int> order(vertCount);
+
+		for (int i = 0; i < vertCount; ++i) {
+			order[i] = i;
+		}
+
+		_ldiDecimateWeldCompare compare;
+		compare.verts = context.verts;
+		std::sort(order.begin(), order.end(), compare);
+
+		context.posIds.resize(vertCount);
+		context.positions.clear();
+
+		for (int i = 0; i < vertCount; ++i) {
+			if (i == 0 || context.verts[order[i]].pos != context.verts[order[i - 1]].pos) {
+				context.positions.push_back(context.verts[order[i]].pos);
+			}
+
+			context.posIds[order[i]] = (int)context.positions.size() - 1;
+		}
+
+		context.posCount = (int)context.positions.size();
+	}
+
+	vec3 boundsMin = context.positions[0];
+	vec3 boundsMax = boundsMin;
+
+	for (int i = 0; i < context.posCount; ++i) {
+		vec3 p = context.positions[i];
+		boundsMin.x = min(boundsMin.x, p.x);
+		boundsMin.y = min(boundsMin.y, p.y);
+		boundsMin.z = min(boundsMin.z, p.z);
+		boundsMax.x = max(boundsMax.x, p.x);
+		boundsMax.y = max(boundsMax.y, p.y);
+		boundsMax.z = max(boundsMax.z, p.z);
+	}
+
+	float size = glm::length(boundsMax - boundsMin);
+	context.normalWeightSq = (Settings->normalWeight * size) * (Settings->normalWeight * size);
+	context.uvWeightSq = (Settings->uvWeight * size) * (Settings->uvWeight * size);
+
+	// Triangles already degenerate by position never make it out.
+	context.indices.reserve(sourceTriCount * 3);
+	context.triSource.reserve(sourceTriCount);
+
+	for (int triIter = 0; triIter < sourceTriCount; ++triIter) {
+		uint32_t i0 = Model->indices[triIter * 3 + 0];
+		uint32_t i1 = Model->indices[triIter * 3 + 1];
+		uint32_t i2 = Model->indices[triIter * 3 + 2];
+		int p0 = context.posIds[i0];
+		int p1 = context.posIds[i1];
+		int p2 = context.posIds[i2];
+
+		if (p0 == p1 || p1 == p2 || p2 == p0) {
+			continue;
+		}
+
+		context.indices.push_back(i0);
+		context.indices.push_back(i1);
+		context.indices.push_back(i2);
+		context.triSource.push_back(triIter);
+	}
+
+	context.openOut.resize(vertCount);
+	context.openIn.resize(vertCount);
+	context.openType.resize(vertCount);
+	context.twins.assign(vertCount, -1);
+	context.kinds.resize(context.posCount);
+	context.quadrics.resize(context.posCount);
+	context.collapseTo.assign(vertCount, -1);
+	context.posLocked.resize(context.posCount);
+
+	_meshDecimateClassify(&context);
+	parallelFor(0, context.posCount, 1024, _meshDecimateQuadricBatch, &context);
+
+	// Every source vertex's collapse target, followed to the survivor at the end.
+	std::vector<int> vertCollapse(vertCount, -1);
+
+	float maxErrorSq = (Settings->maxError < sqrtf(FLT_MAX)) ? Settings->maxError * Settings->maxError : FLT_MAX;
+	float appliedError = 0.0f;
+	int passCount = 0;
+
+	while (passCount < MESH_DECIMATE_MAX_PASSES) {
+		int triCount = (int)context.indices.size() / 3;
+
+		if (triCount <= Settings->targetTriCount) {
+			break;
+		}
+
+		if (passCount > 0) {
+			_meshDecimateClassify(&context);
+		}
+
+		++passCount;
+
+		// One candidate per edge. Interior edges are seen from both sides, keep the side going up in position.
+		context.collapses.clear();
+
+		for (int triIter = 0; triIter < triCount; ++triIter) {
+			for (int c = 0; c < 3; ++c) {
+				int i = context.indices[triIter * 3 + c];
+				int j = context.indices[triIter * 3 + (c + 1) % 3];
+
+				if (context.posIds[i] < context.posIds[j] || (context.triPosOpen[triIter] & (1 << c))) {
+					ldiDecimateCollapse collapse;
+					collapse.from = i;
+					collapse.to = j;
+					collapse.edge = triIter * 3 + c;
+					context.collapses.push_back(collapse);
+				}
+			}
+		}
+
+		parallelFor(0, (int)context.collapses.size(), 256, _meshDecimateEvaluateBatch, &context);
+
+		size_t validCount = 0;
+
+		for (size_t i = 0; i < context.collapses.size(); ++i) {
+			if (context.collapses[i].cost < FLT_MAX && context.collapses[i].cost <= maxErrorSq) {
+				context.collapses[validCount++] = context.collapses[i];
+			}
+		}
+
+		context.collapses.resize(validCount);
+
+		if (validCount == 0) {
+			break;
+		}
+
+		std::sort(context.collapses.begin(), context.collapses.end(), _ldiDecimateCollapseCompare());
+
+		// NOTE: Only take collapses up to a bit above the cost of the last one the target needs, so a pass
+		// doesn't reach past cheaper collapses the next pass would have found.
+		int removeCount = (Settings->targetTriCount > 0) ? triCount - Settings->targetTriCount : triCount;
+		size_t goalIdx = min((size_t)max(removeCount / 2, 1), validCount) - 1;
+		float passLimit = min(context.collapses[goalIdx].cost * 1.5f, maxErrorSq);
+
+		std::fill(context.posLocked.begin(), context.posLocked.end(), 0);
+		int removed = 0;
+		int appliedCount = 0;
+
+		for (size_t i = 0; i < validCount && removed < removeCount; ++i) {
+			ldiDecimateCollapse* collapse = &context.collapses[i];
+
+			if (collapse->cost > passLimit) {
+				break;
+			}
+
+			int pa = context.posIds[collapse->from];
+			int pb = context.posIds[collapse->to];
+
+			if (context.posLocked[pa] || context.posLocked[pb]) {
+				continue;
+			}
+
+			// Lock both one rings so no other collapse this pass touches a triangle this one looked at.
+			for (int e = 0; e < 2; ++e) {
+				int p = (e == 0) ? pa : pb;
+
+				for (int t = context.posTriStart[p]; t < context.posTriStart[p + 1]; ++t) {
+					int tri = context.posTris[t];
+					context.posLocked[_meshDecimatePos(&context, tri, 0)] = 1;
+					context.posLocked[_meshDecimatePos(&context, tri, 1)] = 1;
+					context.posLocked[_meshDecimatePos(&context, tri, 2)] = 1;
+				}
+			}
+
+			context.collapseTo[collapse->from] = collapse->to;
+			vertCollapse[collapse->from] = collapse->to;
+
+			if (collapse->twinFrom != -1) {
+				context.collapseTo[collapse->twinFrom] = collapse->twinTo;
+				vertCollapse[collapse->twinFrom] = collapse->twinTo;
+			}
+
+			_meshDecimateAddQuadric(&context.quadrics[pb], &context.quadrics[pa]);
+			appliedError = max(appliedError, collapse->cost);
+			removed += collapse->removed;
+			++appliedCount;
+		}
+
+		if (appliedCount == 0) {
+			break;
+		}
+
+		context.triKeep.resize(triCount);
+		parallelFor(0, triCount, 1024, _meshDecimateRemapBatch, &context);
+		_meshDecimateCompactTris(&context);
+
+		for (size_t i = 0; i < validCount; ++i) {
+			context.collapseTo[context.collapses[i].from] = -1;
+			context.collapseTo[context.collapses[i].to] = -1;
+
+			if (context.collapses[i].twinFrom != -1) {
+				context.collapseTo[context.collapses[i].twinFrom] = -1;
+			}
+		}
+	}
+
+	// Survivors in source order.
+	std::vector<int> newIds(vertCount, -1);
+	int triCount = (int)context.indices.size() / 3;
+
+	for (int i = 0; i < triCount * 3; ++i) {
+		newIds[context.indices[i]] = 0;
+	}
+
+	for (int i = 0; i < vertCount; ++i) {
+		if (newIds[i] == 0) {
+			newIds[i] = (int)Result->verts.size();
+			Result->verts.push_back(Model->verts[i]);
+		}
+	}
+
+	Result->indices.resize(triCount * 3);
+
+	for (int i = 0; i < triCount * 3; ++i) {
+		Result->indices[i] = newIds[context.indices[i]];
+	}
+
+	if (Info) {
+		Info->faceMap = context.triSource;
+		Info->error = sqrtf(appliedError);
+		Info->passCount = passCount;
+
+		for (size_t i = 0; i < Model->indices.size(); ++i) {
+			int v = Model->indices[i];
+
+			if (Info->vertMap[v] != -1) {
+				continue;
+			}
+
+			int survivor = v;
+
+			while (vertCollapse[survivor] != -1) {
+				survivor = vertCollapse[survivor];
+			}
+
+			Info->vertMap[v] = newIds[survivor];
+		}
+	}
+
+	PROFILE_ITEMS(sourceTriCount);
+
+	return true;
+}
+
+// Quads are split the same way as convertQuadToTriModel. The result is triangles with area weighted normals
+// and no UVs, the face map points at source quads.
+bool meshDecimateQuads(ldiQuadModel* Model, ldiDecimateSettings* Settings, ldiModel* Result, ldiDecimateResult* Info = nullptr) {
+	ldiModel triModel;
+	convertQuadToTriModel(Model, &triModel);
+
+	for (size_t i = 0; i < triModel.verts.size(); ++i) {
+		triModel.verts[i].normal = vec3(0.0f, 0.0f, 0.0f);
+		triModel.verts[i].uv = vec2(0.0f, 0.0f);
+	}
+
+	meshComputeVertexNormals(&triModel);
+
+	if (!meshDecimate(&triModel, Settings, Result, Info)) {
+		return false;
+	}
+
+	if (Info) {
+		for (size_t i = 0; i < Info->faceMap.size(); ++i) {
+			Info->faceMap[i] /= 2;
+		}
+	}
+
+	return true;
+}
\ No newline at end of file
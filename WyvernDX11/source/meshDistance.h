@@ -0,0 +1,781 @@
+#pragma once
+
+#include <algorithm>
+#include <float.h>
+
+//----------------------------------------------------------------------------------------------------
+// Mesh distance queries.
+//----------------------------------------------------------------------------------------------------
+// Closest point and signed distance to the triangles of an ldiModel, on the CPU.
+//
+// Triangles live in a binary AABB tree, stored in leaf order. A query descends the nearer child first and
+// skips any node further away than the best hit so far. Batches are spread over the thread pool and each
+// worker seeds a query with the triangle found by its previous point, which for neighbouring voxels is
+// almost always within a cell of the answer and prunes most of the tree up front.
+//
+// Sign comes from the angle weighted pseudo normal of the closest feature (face, edge or vertex), so the
+// mesh needs to be closed and consistently wound. Vertices are welded by position first, so UV seams and
+// split normals don't matter. Outward facing follows modelCreateFaceNormals.
+
+#define MESH_DISTANCE_LEAF_SIZE 4
+#define MESH_DISTANCE_SAH_DEPTH 64
+#define MESH_DISTANCE_STACK_SIZE 128
+#define MESH_DISTANCE_SPLIT_BINS 16
+
+enum ldiMeshTriFeature {
+	MTF_FACE,
+	MTF_VERT0,
+	MTF_VERT1,
+	MTF_VERT2,
+	MTF_EDGE01,
+	MTF_EDGE12,
+	MTF_EDGE20,
+};
+
+struct ldiMeshDistanceNode {
+	vec3								min;
+	// Leaf: first triangle. Interior: first child, the second child follows it.
+	int									start;
+	vec3								max;
+	// Zero for interior nodes.
+	int									count;
+};
+
+struct ldiMeshDistanceTri {
+	vec3								v[3];
+	// Pseudo normals, edges are v0v1, v1v2, v2v0. Only used for their direction.
+	vec3								faceNormal;
+	vec3								edgeNormal[3];
+	int									vertNormalId[3];
+};
+
+struct ldiMeshDistance {
+	std::vector<ldiMeshDistanceNode>	nodes;
+	// Leaf order. triIds maps back to the model triangle.
+	std::vector<ldiMeshDistanceTri>		tris;
+	std::vector<int>					triIds;
+	std::vector<vec3>					vertNormals;
+};
+
+struct ldiMeshClosestHit {
+	// Negative inside. FLT_MAX if nothing was found within range.
+	float								dist;
+	// Model triangle, -1 if nothing was found within range.
+	int									triId;
+	// Weights of the triangle's three vertices in index order.
+	vec3								bary;
+	vec3								point;
+};
+
+//----------------------------------------------------------------------------------------------------
+// Build.
+//----------------------------------------------------------------------------------------------------
+struct _ldiMeshDistanceBuild {
+	ldiMeshDistance*					distance;
+	std::vector<ldiMeshDistanceTri>		tris;
+	std::vector<vec3>					centroids;
+	std::vector<int>					order;
+};
+
+struct _ldiMeshCentroidCompare {
+	const vec3*							centroids;
+	int									axis;
+
+	bool operator()(int A, int B) const {
+		float a = centroids[A][axis];
+		float b = centroids[B][axis];
+
+		if (a != b) {
+			return a < b;
+		}
+
+		return A < B;
+	}
+};
+
+struct _ldiMeshSplitBin {
+	vec3								min;
+	vec3								max;
+	int									count;
+};
+
+inline float _meshBoundsHalfArea(vec3 Min, vec3 Max) {
+	vec3 e = Max - Min;
+
+	return e.x * e.y + e.y * e.z + e.z * e.x;
+}
+
+// Binned surface area heuristic along Axis. Partitions the range and returns the size of the left side, or
+// -1 if no split is better than the other.
+int _meshDistanceFindSplit(_ldiMeshDistanceBuild* Build, int Start, int Count, int Axis, float AxisMin, float AxisExtent) {
+	if (AxisExtent <= 0.0f) {
+		return -1;
+	}
+
+	_ldiMeshSplitBin bins[MESH_DISTANCE_SPLIT_BINS];
+
+	for (int i = 0; i < MESH_DISTANCE_SPLIT_BINS; ++i) {
+		bins[i].min = vec3(FLT_MAX, FLT_MAX, FLT_MAX);
+		bins[i].max = vec3(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+		bins[i].count = 0;
+	}
+
+	float binScale = MESH_DISTANCE_SPLIT_BINS / AxisExtent;
+	int* order = Build->order.data();
+
+	for (int i = Start; i < Start + Count; ++i) {
+		int binIdx = min((int)((Build->centroids[order[i]][Axis] - AxisMin) * binScale), MESH_DISTANCE_SPLIT_BINS - 1);
+		_ldiMeshSplitBin* bin = &bins[binIdx];
+		ldiMeshDistanceTri* tri = &Build->tris[order[i]];
+
+		for (int v = 0; v < 3; ++v) {
+			bin->min.x = min(bin->min.x, tri->v[v].x);
+			bin->min.y = min(bin->min.y, tri->v[v].y);
+			bin->min.z = min(bin->min.z, tri->v[v].z);
+			bin->max.x = max(bin->max.x, tri->v[v].x);
+			bin->max.y = max(bin->max.y, tri->v[v].y);
+			bin->max.z = max(bin->max.z, tri->v[v].z);
+		}
+
+		++bin->count;
+	}
+
+	// NOTE: Sweep from the right for the right side costs, then from the left to pick the plane.
+	float rightCost[MESH_DISTANCE_SPLIT_BINS];
+	vec3 boundsMin(FLT_MAX, FLT_MAX, FLT_MAX);
+	vec3 boundsMax(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+	int count = 0;
+
+	for (int i = MESH_DISTANCE_SPLIT_BINS - 1; i > 0; --i) {
+		boundsMin.x = min(boundsMin.x, bins[i].min.x);
+		boundsMin.y = min(boundsMin.y, bins[i].min.y);
+		boundsMin.z = min(boundsMin.z, bins[i].min.z);
+		boundsMax.x = max(boundsMax.x, bins[i].max.x);
+		boundsMax.y = max(boundsMax.y, bins[i].max.y);
+		boundsMax.z = max(boundsMax.z, bins[i].max.z);
+		count += bins[i].count;
+		rightCost[i] = (count > 0) ? count * _meshBoundsHalfArea(boundsMin, boundsMax) : 0.0f;
+	}
+
+	boundsMin = vec3(FLT_MAX, FLT_MAX, FLT_MAX);
+	boundsMax = vec3(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+	count = 0;
+
+	float bestCost = FLT_MAX;
+	int bestPlane = -1;
+
+	for (int i = 0; i < MESH_DISTANCE_SPLIT_BINS - 1; ++i) {
+		boundsMin.x = min(boundsMin.x, bins[i].min.x);
+		boundsMin.y = min(boundsMin.y, bins[i].min.y);
+		boundsMin.z = min(boundsMin.z, bins[i].min.z);
+		boundsMax.x = max(boundsMax.x, bins[i].max.x);
+		boundsMax.y = max(boundsMax.y, bins[i].max.y);
+		boundsMax.z = max(boundsMax.z, bins[i].max.z);
+		count += bins[i].count;
+
+		if (count == 0 || count == Count) {
+			continue;
+		}
+
+		float cost = count * _meshBoundsHalfArea(boundsMin, boundsMax) + rightCost[i + 1];
+
+		if (cost < bestCost) {
+			bestCost = cost;
+			bestPlane = i;
+		}
+	}
+
+	if (bestPlane == -1) {
+		return -1;
+	}
+
+	int left = Start;
+	int right = Start + Count - 1;
+
+	while (left <= right) {
+		int binIdx = min((int)((Build->centroids[order[left]][Axis] - AxisMin) * binScale), MESH_DISTANCE_SPLIT_BINS - 1);
+
+		if (binIdx <= bestPlane) {
+			++left;
+		} else {
+			std::swap(order[left], order[right]);
+			--right;
+		}
+	}
+
+	return left - Start;
+}
+
+void _meshDistanceBuildNode(_ldiMeshDistanceBuild* Build, int NodeIdx, int Start, int Count, int Depth) {
+	vec3 boundsMin(FLT_MAX, FLT_MAX, FLT_MAX);
+	vec3 boundsMax(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+	vec3 centroidMin = boundsMin;
+	vec3 centroidMax = boundsMax;
+
+	for (int i = Start; i < Start + Count; ++i) {
+		ldiMeshDistanceTri* tri = &Build->tris[Build->order[i]];
+
+		for (int v = 0; v < 3; ++v) {
+			boundsMin.x = min(boundsMin.x, tri->v[v].x);
+			boundsMin.y = min(boundsMin.y, tri->v[v].y);
+			boundsMin.z = min(boundsMin.z, tri->v[v].z);
+			boundsMax.x = max(boundsMax.x, tri->v[v].x);
+			boundsMax.y = max(boundsMax.y, tri->v[v].y);
+			boundsMax.z = max(boundsMax.z, tri->v[v].z);
+		}
+
+		vec3 c = Build->centroids[Build->order[i]];
+		centroidMin.x = min(centroidMin.x, c.x);
+		centroidMin.y = min(centroidMin.y, c.y);
+		centroidMin.z = min(centroidMin.z, c.z);
+		centroidMax.x = max(centroidMax.x, c.x);
+		centroidMax.y = max(centroidMax.y, c.y);
+		centroidMax.z = max(centroidMax.z, c.z);
+	}
+
+	ldiMeshDistanceNode* node = &Build->distance->nodes[NodeIdx];
+	node->min = boundsMin;
+	node->max = boundsMax;
+
+	if (Count <= MESH_DISTANCE_LEAF_SIZE) {
+		node->start = Start;
+		node->count = Count;
+		return;
+	}
+
+	vec3 extent = centroidMax - centroidMin;
+	int axis = 0;
+
+	if (extent.y > extent.x) {
+		axis = 1;
+	}
+
+	if (extent.z > extent[axis]) {
+		axis = 2;
+	}
+
+	int* order = Build->order.data();
+	int split = -1;
+
+	// NOTE: Past the SAH depth limit the rest of the subtree is balanced, which keeps the query stack bounded.
+	if (Depth < MESH_DISTANCE_SAH_DEPTH) {
+		split = _meshDistanceFindSplit(Build, Start, Count, axis, centroidMin[axis], extent[axis]);
+	}
+
+	if (split == -1) {
+		// NOTE: Ties are broken by triangle index so the tree is the same on every build.
+		_ldiMeshCentroidCompare compare;
+		compare.centroids = Build->centroids.data();
+		compare.axis = axis;
+
+		split = Count / 2;
+		std::nth_element(order + Start, order + Start + split, order + Start + Count, compare);
+	}
+
+	int childIdx = (int)Build->distance->nodes.size();
+	Build->distance->nodes.push_back({});
+	Build->distance->nodes.push_back({});
+
+	// NOTE: Push above may have moved the nodes.
+	node = &Build->distance->nodes[NodeIdx];
+	node->start = childIdx;
+	node->count = 0;
+
+	_meshDistanceBuildNode(Build, childIdx + 0, Start, split, Depth + 1);
+	_meshDistanceBuildNode(Build, childIdx + 1, Start + split, Count - split, Depth + 1);
+}
+
+struct _ldiMeshWeldCompare {
+	const ldiMeshVertex*				verts;
+
+	bool operator()(int A, int B) const {
+		vec3 a = verts[A].pos;
+		vec3 b = verts[B].pos;
+
+		if (a.x != b.x) return a.x < b.x;
+		if (a.y != b.y) return a.y < b.y;
+		if (a.z != b.z) return a.z < b.z;
+
+		return A < B;
+	}
+};
+
+inline float _meshTriCornerAngle(vec3 P, vec3 A, vec3 B) {
+	vec3 e0 = A - P;
+	vec3 e1 = B - P;
+	float d = glm::dot(e0, e0) * glm::dot(e1, e1);
+
+	if (d <= 0.0f) {
+		return 0.0f;
+	}
+
+	return acosf(clampf(glm::dot(e0, e1) / sqrtf(d), -1.0f, 1.0f));
+}
+
+// Triangles with no area are left out, they can't be closest to anything their neighbours aren't.
+void meshDistanceBuild(ldiModel* Model, ldiMeshDistance* Distance) {
+	PROFILE_ZONE("Build mesh distance");
+
+	Distance->nodes.clear();
+	Distance->tris.clear();
+	Distance->triIds.clear();
+	Distance->vertNormals.clear();
+
+	int vertCount = (int)Model->verts.size();
+	int triCount = (int)Model->indices.size() / 3;
+	const ldiMeshVertex* verts = Model->verts.data();
+	const uint32_t* indices = Model->indices.data();
+
+	// Weld by exact position.
+	std::vector<int> weldOrder(vertCount);
+	std::vector<int> weldIds(vertCount);
+
+	for (int i = 0; i < vertCount; ++i) {
+		weldOrder[i] = i;
+	}
+
+	_ldiMeshWeldCompare weldCompare;
+	weldCompare.verts = verts;
+	std::sort(weldOrder.begin(), weldOrder.end(), weldCompare);
+
+	int weldCount = 0;
+
+	for (int i = 0; i < vertCount; ++i) {
+		if (i > 0 && verts[weldOrder[i]].pos != verts[weldOrder[i - 1]].pos) {
+			++weldCount;
+		}
+
+		weldIds[weldOrder[i]] = weldCount;
+	}
+
+	if (vertCount > 0) {
+		++weldCount;
+	}
+
+	Distance->vertNormals.assign(weldCount, vec3(0.0f, 0.0f, 0.0f));
+
+	_ldiMeshDistanceBuild build;
+	build.distance = Distance;
+	build.tris.reserve(triCount);
+	build.centroids.reserve(triCount);
+
+	std::vector<int> buildTriIds;
+	buildTriIds.reserve(triCount);
+
+	// NOTE: Sum of the two face normals, keyed by the welded vertex pair.
+	std::unordered_map<uint64_t, vec3> edgeNormals;
+
+	for (int triIter = 0; triIter < triCount; ++triIter) {
+		ldiMeshDistanceTri tri;
+		int weld[3];
+
+		for (int v = 0; v < 3; ++v) {
+			tri.v[v] = verts[indices[triIter * 3 + v]].pos;
+			weld[v] = weldIds[indices[triIter * 3 + v]];
+			tri.vertNormalId[v] = weld[v];
+		}
+
+		vec3 normal = glm::cross(tri.v[0] - tri.v[1], tri.v[2] - tri.v[1]);
+
+		if (glm::dot(normal, normal) <= 0.0f || weld[0] == weld[1] || weld[1] == weld[2] || weld[2] == weld[0]) {
+			continue;
+		}
+
+		tri.faceNormal = glm::normalize(normal);
+
+		for (int v = 0; v < 3; ++v) {
+			float angle = _meshTriCornerAngle(tri.v[v], tri.v[(v + 1) % 3], tri.v[(v + 2) % 3]);
+			Distance->vertNormals[weld[v]] += tri.faceNormal * angle;
+
+			int a = weld[v];
+			int b = weld[(v + 1) % 3];
+			uint64_t key = ((uint64_t)(uint32_t)min(a, b) << 32) | (uint64_t)(uint32_t)max(a, b);
+			edgeNormals[key] += tri.faceNormal;
+		}
+
+		build.tris.push_back(tri);
+		build.centroids.push_back((tri.v[0] + tri.v[1] + tri.v[2]) * (1.0f / 3.0f));
+		buildTriIds.push_back(triIter);
+	}
+
+	for (size_t triIter = 0; triIter < build.tris.size(); ++triIter) {
+		ldiMeshDistanceTri* tri = &build.tris[triIter];
+
+		for (int v = 0; v < 3; ++v) {
+			int a = tri->vertNormalId[v];
+			int b = tri->vertNormalId[(v + 1) % 3];
+			uint64_t key = ((uint64_t)(uint32_t)min(a, b) << 32) | (uint64_t)(uint32_t)max(a, b);
+			tri->edgeNormal[v] = edgeNormals[key];
+		}
+	}
+
+	int usedCount = (int)build.tris.size();
+
+	if (usedCount == 0) {
+		return;
+	}
+
+	build.order.resize(usedCount);
+
+	for (int i = 0; i < usedCount; ++i) {
+		build.order[i] = i;
+	}
+
+	Distance->nodes.reserve(usedCount / MESH_DISTANCE_LEAF_SIZE * 2 + 1);
+	Distance->nodes.push_back({});
+	_meshDistanceBuildNode(&build, 0, 0, usedCount, 0);
+
+	Distance->tris.resize(usedCount);
+	Distance->triIds.resize(usedCount);
+
+	for (int i = 0; i < usedCount; ++i) {
+		Distance->tris[i] = build.tris[build.order[i]];
+		Distance->triIds[i] = buildTriIds[build.order[i]];
+	}
+}
+
+//----------------------------------------------------------------------------------------------------
+// Queries.
+//----------------------------------------------------------------------------------------------------
+// Closest point on triangle ABC to P, from Ericson's Real-Time Collision Detection 5.1.5.
+inline ldiMeshTriFeature _meshClosestPointOnTri(vec3 P, vec3 A, vec3 B, vec3 C, vec3* Bary) {
+	vec3 ab = B - A;
+	vec3 ac = C - A;
+	vec3 ap = P - A;
+	float d1 = glm::dot(ab, ap);
+	float d2 = glm::dot(ac, ap);
+
+	if (d1 <= 0.0f && d2 <= 0.0f) {
+		*Bary = vec3(1.0f, 0.0f, 0.0f);
+		return MTF_VERT0;
+	}
+
+	vec3 bp = P - B;
+	float d3 = glm::dot(ab, bp);
+	float d4 = glm::dot(ac, bp);
+
+	if (d3 >= 0.0f && d4 <= d3) {
+		*Bary = vec3(0.0f, 1.0f, 0.0f);
+		return MTF_VERT1;
+	}
+
+	float vc = d1 * d4 - d3 * d2;
+
+	if (vc <= 0.0f && d1 >= 0.0f && d3 <= 0.0f) {
+		float v = d1 / (d1 - d3);
+		*Bary = vec3(1.0f - v, v, 0.0f);
+		return MTF_EDGE01;
+	}
+
+	vec3 cp = P - C;
+	float d5 = glm::dot(ab, cp);
+	float d6 = glm::dot(ac, cp);
+
+	if (d6 >= 0.0f && d5 <= d6) {
+		*Bary = vec3(0.0f, 0.0f, 1.0f);
+		return MTF_VERT2;
+	}
+
+	float vb = d5 * d2 - d1 * d6;
+
+	if (vb <= 0.0f && d2 >= 0.0f && d6 <= 0.0f) {
+		float w = d2 / (d2 - d6);
+		*Bary = vec3(1.0f - w, 0.0f, w);
+		return MTF_EDGE20;
+	}
+
+	float va = d3 * d6 - d5 * d4;
+
+	if (va <= 0.0f && (d4 - d3) >= 0.0f && (d5 - d6) >= 0.0f) {
+		float w = (d4 - d3) / ((d4 - d3) + (d5 - d6));
+		*Bary = vec3(0.0f, 1.0f - w, w);
+		return MTF_EDGE12;
+	}
+
+	float denom = 1.0f / (va + vb + vc);
+	float v = vb * denom;
+	float w = vc * denom;
+	*Bary = vec3(1.0f - v - w, v, w);
+
+	return MTF_FACE;
+}
+
+inline float _meshTriDistSq(const ldiMeshDistanceTri* Tri, vec3 P) {
+	vec3 bary;
+	_meshClosestPointOnTri(P, Tri->v[0], Tri->v[1], Tri->v[2], &bary);
+	vec3 d = Tri->v[0] * bary.x + Tri->v[1] * bary.y + Tri->v[2] * bary.z - P;
+
+	return glm::dot(d, d);
+}
+
+inline float _meshNodeDistSq(const ldiMeshDistanceNode* Node, vec3 P) {
+	float dx = max(max(Node->min.x - P.x, P.x - Node->max.x), 0.0f);
+	float dy = max(max(Node->min.y - P.y, P.y - Node->max.y), 0.0f);
+	float dz = max(max(Node->min.z - P.z, P.z - Node->max.z), 0.0f);
+
+	return dx * dx + dy * dy + dz * dz;
+}
+
+// Index of the closest leaf order triangle closer than sqrt(BestDistSq), or Best if there is none.
+int _meshDistanceFindClosest(ldiMeshDistance* Distance, vec3 P, float* BestDistSq, int Best) {
+	const ldiMeshDistanceNode* nodes = Distance->nodes.data();
+	const ldiMeshDistanceTri* tris = Distance->tris.data();
+
+	int stackNode[MESH_DISTANCE_STACK_SIZE];
+	float stackDistSq[MESH_DISTANCE_STACK_SIZE];
+	int stackSize = 0;
+
+	float bestDistSq = *BestDistSq;
+	float rootDistSq = _meshNodeDistSq(&nodes[0], P);
+
+	if (rootDistSq < bestDistSq) {
+		stackNode[0] = 0;
+		stackDistSq[0] = rootDistSq;
+		stackSize = 1;
+	}
+
+	while (stackSize > 0) {
+		--stackSize;
+
+		// NOTE: Best may have improved since the node was pushed.
+		if (stackDistSq[stackSize] >= bestDistSq) {
+			continue;
+		}
+
+		const ldiMeshDistanceNode* node = &nodes[stackNode[stackSize]];
+
+		if (node->count) {
+			for (int i = node->start; i < node->start + node->count; ++i) {
+				float distSq = _meshTriDistSq(&tris[i], P);
+
+				if (distSq < bestDistSq) {
+					bestDistSq = distSq;
+					Best = i;
+				}
+			}
+
+			continue;
+		}
+
+		int nearIdx = node->start;
+		int farIdx = node->start + 1;
+		float nearDistSq = _meshNodeDistSq(&nodes[nearIdx], P);
+		float farDistSq = _meshNodeDistSq(&nodes[farIdx], P);
+
+		if (farDistSq < nearDistSq) {
+			std::swap(nearIdx, farIdx);
+			std::swap(nearDistSq, farDistSq);
+		}
+
+		// NOTE: Nearer child is pushed last so it is visited first.
+		if (farDistSq < bestDistSq) {
+			stackNode[stackSize] = farIdx;
+			stackDistSq[stackSize] = farDistSq;
+			++stackSize;
+		}
+
+		if (nearDistSq < bestDistSq) {
+			stackNode[stackSize] = nearIdx;
+			stackDistSq[stackSize] = nearDistSq;
+			++stackSize;
+		}
+	}
+
+	*BestDistSq = bestDistSq;
+
+	return Best;
+}
+
+void _meshDistanceFillHit(ldiMeshDistance* Distance, vec3 P, int TriIdx, ldiMeshClosestHit* Hit) {
+	if (TriIdx < 0) {
+		Hit->dist = FLT_MAX;
+		Hit->triId = -1;
+		Hit->bary = vec3(0.0f, 0.0f, 0.0f);
+		Hit->point = P;
+		return;
+	}
+
+	const ldiMeshDistanceTri* tri = &Distance->tris[TriIdx];
+
+	vec3 bary;
+	ldiMeshTriFeature feature = _meshClosestPointOnTri(P, tri->v[0], tri->v[1], tri->v[2], &bary);
+	vec3 point = tri->v[0] * bary.x + tri->v[1] * bary.y + tri->v[2] * bary.z;
+
+	vec3 pseudoNormal;
+
+	switch (feature) {
+		case MTF_VERT0: pseudoNormal = Distance->vertNormals[tri->vertNormalId[0]]; break;
+		case MTF_VERT1: pseudoNormal = Distance->vertNormals[tri->vertNormalId[1]]; break;
+		case MTF_VERT2: pseudoNormal = Distance->vertNormals[tri->vertNormalId[2]]; break;
+		case MTF_EDGE01: pseudoNormal = tri->edgeNormal[0]; break;
+		case MTF_EDGE12: pseudoNormal = tri->edgeNormal[1]; break;
+		case MTF_EDGE20: pseudoNormal = tri->edgeNormal[2]; break;
+		default: pseudoNormal = tri->faceNormal; break;
+	}
+
+	float dist = glm::length(P - point);
+
+	Hit->dist = (glm::dot(P - point, pseudoNormal) < 0.0f) ? -dist : dist;
+	Hit->triId = Distance->triIds[TriIdx];
+	Hit->bary = bary;
+	Hit->point = point;
+}
+
+// False if the mesh has no surface within MaxDist of P.
+bool meshDistanceQuery(ldiMeshDistance* Distance, vec3 P, ldiMeshClosestHit* Hit, float MaxDist = FLT_MAX) {
+	float bestDistSq = (MaxDist < sqrtf(FLT_MAX)) ? MaxDist * MaxDist : FLT_MAX;
+	int best = -1;
+
+	if (!Distance->nodes.empty()) {
+		best = _meshDistanceFindClosest(Distance, P, &bestDistSq, -1);
+	}
+
+	_meshDistanceFillHit(Distance, P, best, Hit);
+
+	return best != -1;
+}
+
+//----------------------------------------------------------------------------------------------------
+// Batched queries.
+//----------------------------------------------------------------------------------------------------
+struct ldiMeshDistanceBatchContext {
+	ldiMeshDistance*					distance;
+	float								maxDistSq;
+
+	const vec3*							points;
+	ldiMeshClosestHit*					hits;
+
+	vec3								origin;
+	float								cellSize;
+	int									sizeX;
+	int									sizeY;
+	float*								volume;
+};
+
+// Seeds the search with the previous point's triangle, which bounds the search to about the step between
+// points instead of the whole tree.
+inline int _meshDistanceFindCoherent(ldiMeshDistance* Distance, vec3 P, float MaxDistSq, int Hint) {
+	float bestDistSq = MaxDistSq;
+	int best = -1;
+
+	if (Hint != -1) {
+		float hintDistSq = _meshTriDistSq(&Distance->tris[Hint], P);
+
+		if (hintDistSq < bestDistSq) {
+			bestDistSq = hintDistSq;
+			best = Hint;
+		}
+	}
+
+	return _meshDistanceFindClosest(Distance, P, &bestDistSq, best);
+}
+
+void _meshDistanceQueryBatch(int StartIdx, int EndIdx, void* UserData) {
+	ldiMeshDistanceBatchContext* context = (ldiMeshDistanceBatchContext*)UserData;
+	int hint = -1;
+
+	for (int i = StartIdx; i < EndIdx; ++i) {
+		int best = _meshDistanceFindCoherent(context->distance, context->points[i], context->maxDistSq, hint);
+		_meshDistanceFillHit(context->distance, context->points[i], best, &context->hits[i]);
+
+		if (best != -1) {
+			hint = best;
+		}
+	}
+}
+
+// Points should be in a spatially coherent order, like scanlines or a space filling curve, to benefit from
+// the seeding.
+void meshDistanceQueryBatch(ldiMeshDistance* Distance, const vec3* Points, int Count, ldiMeshClosestHit* Hits, float MaxDist = FLT_MAX) {
+	PROFILE_ZONE("Mesh distance batch");
+
+	ldiMeshDistanceBatchContext context{};
+	context.distance = Distance;
+	context.maxDistSq = (MaxDist < sqrtf(FLT_MAX)) ? MaxDist * MaxDist : FLT_MAX;
+	context.points = Points;
+	context.hits = Hits;
+
+	if (Distance->nodes.empty()) {
+		for (int i = 0; i < Count; ++i) {
+			_meshDistanceFillHit(Distance, Points[i], -1, &Hits[i]);
+		}
+
+		return;
+	}
+
+	parallelFor(0, Count, 256, _meshDistanceQueryBatch, &context);
+
+	PROFILE_ITEMS(Count);
+}
+
+void _meshDistanceVolumeBatch(int StartIdx, int EndIdx, void* UserData) {
+	ldiMeshDistanceBatchContext* context = (ldiMeshDistanceBatchContext*)UserData;
+	int hint = -1;
+
+	for (int rowIter = StartIdx; rowIter < EndIdx; ++rowIter) {
+		int y = rowIter % context->sizeY;
+		int z = rowIter / context->sizeY;
+		float* row = context->volume + (size_t)rowIter * context->sizeX;
+
+		for (int x = 0; x < context->sizeX; ++x) {
+			vec3 p = context->origin + vec3(x + 0.5f, y + 0.5f, z + 0.5f) * context->cellSize;
+
+			ldiMeshClosestHit hit;
+			hint = _meshDistanceFindCoherent(context->distance, p, FLT_MAX, hint);
+			_meshDistanceFillHit(context->distance, p, hint, &hit);
+
+			row[x] = hit.dist;
+		}
+	}
+}
+
+// Signed distance at cell centers Origin + (X + 0.5) * CellSize for a SizeX * SizeY * SizeZ block, X
+// fastest. Same layout and sampling as the generateSdf compute shader.
+void meshDistanceFillVolume(ldiMeshDistance* Distance, vec3 Origin, float CellSize, int SizeX, int SizeY, int SizeZ, float* Volume) {
+	PROFILE_ZONE("Mesh distance volume");
+
+	size_t cellCount = (size_t)SizeX * SizeY * SizeZ;
+
+	if (Distance->nodes.empty()) {
+		for (size_t i = 0; i < cellCount; ++i) {
+			Volume[i] = FLT_MAX;
+		}
+
+		return;
+	}
+
+	ldiMeshDistanceBatchContext context{};
+	context.distance = Distance;
+	context.origin = Origin;
+	context.cellSize = CellSize;
+	context.sizeX = SizeX;
+	context.sizeY = SizeY;
+	context.volume = Volume;
+
+	parallelFor(0, SizeY * SizeZ, 4, _meshDistanceVolumeBatch, &context);
+
+	PROFILE_ITEMS((int64_t)cellCount);
+}
+
+//----------------------------------------------------------------------------------------------------
+// Voxel grid source.
+//----------------------------------------------------------------------------------------------------
+// Mesh in its own space, voxel cell C maps to Origin + C * CellSize.
+struct ldiMeshVoxelSdf {
+	ldiMeshDistance*					distance;
+	vec3								origin;
+	float								cellSize;
+};
+
+// ldiVoxelSdfFunc for voxelFillSdf, UserData is an ldiMeshVoxelSdf.
+float meshDistanceVoxelSdf(vec3 CellPos, void* UserData) {
+	ldiMeshVoxelSdf* sdf = (ldiMeshVoxelSdf*)UserData;
+
+	ldiMeshClosestHit hit;
+
+	if (!meshDistanceQuery(sdf->distance, sdf->origin + CellPos * sdf->cellSize, &hit)) {
+		return FLT_MAX;
+	}
+
+	return hit.dist / sdf->cellSize;
+}
\ No newline at end of file
@@ -0,0 +1,525 @@
+#pragma once
+
+#include <algorithm>
+
+//----------------------------------------------------------------------------------------------------
+// Mesh reordering.
+//----------------------------------------------------------------------------------------------------
+// Reorders vertices, faces and point sets so that things close in space are close in memory.
+//
+// Items are sorted along a Hilbert or Morton curve through their bounds. Triangles of an ldiModel are then
+// reordered for post transform vertex cache reuse (Forsyth's linear speed optimizer), starting from the
+// curve order so each restart picks up next to the last. Vertices finally go in order of first use.
+//
+// Every reorder hands back its permutation, so IDs that live outside the mesh can be carried over.
+
+enum ldiSpaceCurve {
+	SC_MORTON,
+	SC_HILBERT,
+};
+
+struct ldiReorderMap {
+	// New position I holds the item that used to be at newToOld[I].
+	std::vector<int>					newToOld;
+	std::vector<int>					oldToNew;
+};
+
+struct ldiModelReorder {
+	ldiReorderMap						faces;
+	ldiReorderMap						verts;
+};
+
+void _meshReorderMapFillInverse(ldiReorderMap* Map) {
+	Map->oldToNew.resize(Map->newToOld.size());
+
+	for (size_t i = 0; i < Map->newToOld.size(); ++i) {
+		Map->oldToNew[Map->newToOld[i]] = (int)i;
+	}
+}
+
+// Gathers Items into the new order.
+template<class T> void meshReorderApply(std::vector<T>& Items, ldiReorderMap* Map) {
+	assert(Items.size() == Map->newToOld.size());
+
+	std::vector<T> result(Items.size());
+
+	for (size_t i = 0; i < Items.size(); ++i) {
+		result[i] = Items[Map->newToOld[i]];
+	}
+
+	Items.swap(result);
+}
+
+//----------------------------------------------------------------------------------------------------
+// Space filling curves.
+//----------------------------------------------------------------------------------------------------
+#define MESH_REORDER_CURVE_BITS 21
+
+// Skilling's transpose form of the Hilbert index, bits are then interleaved like a Morton code.
+uint64_t _meshReorderHilbertKey(uint32_t X, uint32_t Y, uint32_t Z) {
+	uint32_t axes[3] = { X, Y, Z };
+
+	for (uint32_t q = 1 << (MESH_REORDER_CURVE_BITS - 1); q > 1; q >>= 1) {
+		uint32_t p = q - 1;
+
+		for (int i = 0; i < 3; ++i) {
+			if (axes[i] & q) {
+				axes[0] ^= p;
+			} else {
+				uint32_t t = (axes[0] ^ axes[i]) & p;
+				axes[0] ^= t;
+				axes[i] ^= t;
+			}
+		}
+	}
+
+	axes[1] ^= axes[0];
+	axes[2] ^= axes[1];
+
+	uint32_t t = 0;
+	for (uint32_t q = 1 << (MESH_REORDER_CURVE_BITS - 1); q > 1; q >>= 1) {
+		if (axes[2] & q) {
+			t ^= q - 1;
+		}
+	}
+
+	axes[0] ^= t;
+	axes[1] ^= t;
+	axes[2] ^= t;
+
+	// NOTE: First axis is the most significant of each triple.
+	return spatialGridMortonEncode(axes[2], axes[1], axes[0]);
+}
+
+struct _ldiCurveKey {
+	uint64_t							key;
+	int									id;
+
+	bool operator<(const _ldiCurveKey& Other) const {
+		if (key != Other.key) {
+			return key < Other.key;
+		}
+
+		return id < Other.id;
+	}
+};
+
+struct _ldiCurveKeyContext {
+	const vec3*							positions;
+	_ldiCurveKey*						keys;
+	ldiSpaceCurve						curve;
+	vec3								boundsMin;
+	float								scale;
+};
+
+void _meshReorderCurveKeyBatch(int StartIdx, int EndIdx, void* UserData) {
+	_ldiCurveKeyContext* context = (_ldiCurveKeyContext*)UserData;
+	const float maxCoord = (float)((1 << MESH_REORDER_CURVE_BITS) - 1);
+
+	for (int i = StartIdx; i < EndIdx; ++i) {
+		vec3 local = (context->positions[i] - context->boundsMin) * context->scale;
+
+		uint32_t x = (uint32_t)clampf(local.x, 0.0f, maxCoord);
+		uint32_t y = (uint32_t)clampf(local.y, 0.0f, maxCoord);
+		uint32_t z = (uint32_t)clampf(local.z, 0.0f, maxCoord);
+
+		context->keys[i].id = i;
+
+		if (context->curve == SC_HILBERT) {
+			context->keys[i].key = _meshReorderHilbertKey(x, y, z);
+		} else {
+			context->keys[i].key = spatialGridMortonEncode(x, y, z);
+		}
+	}
+}
+
+// Order of Positions along the curve. The curve spans the largest side of the bounds on every axis, so cells
+// stay cubes.
+void meshReorderComputeCurveOrder(const vec3* Positions, int Count, ldiSpaceCurve Curve, ldiReorderMap* Map) {
+	PROFILE_ZONE_LOG("Compute curve order");
+	PROFILE_ITEMS(Count);
+
+	vec3 boundsMin(FLT_MAX, FLT_MAX, FLT_MAX);
+	vec3 boundsMax(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+
+	for (int i = 0; i < Count; ++i) {
+		boundsMin.x = min(boundsMin.x, Positions[i].x);
+		boundsMin.y = min(boundsMin.y, Positions[i].y);
+		boundsMin.z = min(boundsMin.z, Positions[i].z);
+		boundsMax.x = max(boundsMax.x, Positions[i].x);
+		boundsMax.y = max(boundsMax.y, Positions[i].y);
+		boundsMax.z = max(boundsMax.z, Positions[i].z);
+	}
+
+	vec3 extent = boundsMax - boundsMin;
+	float maxExtent = max(extent.x, max(extent.y, extent.z));
+
+	std::vector<_ldiCurveKey> keys(Count);
+
+	_ldiCurveKeyContext context = {};
+	context.positions = Positions;
+	context.keys = keys.data();
+	context.curve = Curve;
+	context.boundsMin = boundsMin;
+	context.scale = (maxExtent > 0.0f) ? (float)((1 << MESH_REORDER_CURVE_BITS) - 1) / maxExtent : 0.0f;
+
+	parallelFor(0, Count, 4096, _meshReorderCurveKeyBatch, &context);
+
+	std::sort(keys.begin(), keys.end());
+
+	Map->newToOld.resize(Count);
+
+	for (int i = 0; i < Count; ++i) {
+		Map->newToOld[i] = keys[i].id;
+	}
+
+	_meshReorderMapFillInverse(Map);
+}
+
+//----------------------------------------------------------------------------------------------------
+// Index remapping.
+//----------------------------------------------------------------------------------------------------
+// Moves whole faces of FaceSize indices into the new order.
+void _meshReorderFaces(std::vector<uint32_t>* Indices, int FaceSize, ldiReorderMap* Map) {
+	std::vector<uint32_t> result(Indices->size());
+
+	for (size_t f = 0; f < Map->newToOld.size(); ++f) {
+		for (int c = 0; c < FaceSize; ++c) {
+			result[f * FaceSize + c] = (*Indices)[Map->newToOld[f] * FaceSize + c];
+		}
+	}
+
+	Indices->swap(result);
+}
+
+// Vertex order by first reference in Indices. Vertices no face uses go last, in their old order.
+void _meshReorderVertsByFirstUse(const std::vector<uint32_t>* Indices, int VertCount, ldiReorderMap* Map) {
+	Map->oldToNew.assign(VertCount, -1);
+	Map->newToOld.resize(VertCount);
+
+	int next = 0;
+
+	for (size_t i = 0; i < Indices->size(); ++i) {
+		uint32_t v = (*Indices)[i];
+
+		if (Map->oldToNew[v] == -1) {
+			Map->oldToNew[v] = next;
+			Map->newToOld[next] = v;
+			++next;
+		}
+	}
+
+	for (int v = 0; v < VertCount; ++v) {
+		if (Map->oldToNew[v] == -1) {
+			Map->oldToNew[v] = next;
+			Map->newToOld[next] = v;
+			++next;
+		}
+	}
+}
+
+void _meshReorderRemapIndices(std::vector<uint32_t>* Indices, ldiReorderMap* VertMap) {
+	for (size_t i = 0; i < Indices->size(); ++i) {
+		(*Indices)[i] = VertMap->oldToNew[(*Indices)[i]];
+	}
+}
+
+// Composes two face orders, First applied before Second.
+void _meshReorderCompose(ldiReorderMap* First, ldiReorderMap* Second, ldiReorderMap* Result) {
+	std::vector<int> newToOld(Second->newToOld.size());
+
+	for (size_t i = 0; i < newToOld.size(); ++i) {
+		newToOld[i] = First->newToOld[Second->newToOld[i]];
+	}
+
+	Result->newToOld.swap(newToOld);
+	_meshReorderMapFillInverse(Result);
+}
+
+//----------------------------------------------------------------------------------------------------
+// Vertex cache optimization.
+//----------------------------------------------------------------------------------------------------
+#define MESH_REORDER_CACHE_SIZE 32
+#define MESH_REORDER_CACHE_DECAY_POWER 1.5f
+#define MESH_REORDER_LAST_TRI_SCORE 0.75f
+#define MESH_REORDER_VALENCE_BOOST_SCALE 2.0f
+#define MESH_REORDER_VALENCE_BOOST_POWER 0.5f
+// Valence scores are tabled up to this many remaining faces.
+#define MESH_REORDER_MAX_VALENCE 64
+
+struct _ldiCacheVert {
+	float								score;
+	// Position in the simulated cache, -1 when not cached.
+	int									cachePos;
+	// Faces not emitted yet, they are the first activeCount entries of the vertex's adjacency list.
+	int									activeCount;
+};
+
+struct _ldiCacheScores {
+	float								cache[MESH_REORDER_CACHE_SIZE];
+	float								valence[MESH_REORDER_MAX_VALENCE];
+};
+
+void _meshReorderInitCacheScores(_ldiCacheScores* Scores) {
+	const float scaler = 1.0f / (MESH_REORDER_CACHE_SIZE - 3);
+
+	for (int i = 0; i < MESH_REORDER_CACHE_SIZE; ++i) {
+		if (i < 3) {
+			// NOTE: Verts of the last face score the same, so the order within it doesn't matter.
+			Scores->cache[i] = MESH_REORDER_LAST_TRI_SCORE;
+		} else {
+			Scores->cache[i] = powf(1.0f - (i - 3) * scaler, MESH_REORDER_CACHE_DECAY_POWER);
+		}
+	}
+
+	for (int i = 0; i < MESH_REORDER_MAX_VALENCE; ++i) {
+		Scores->valence[i] = (i == 0) ? 0.0f : MESH_REORDER_VALENCE_BOOST_SCALE * powf((float)i, -MESH_REORDER_VALENCE_BOOST_POWER);
+	}
+}
+
+inline float _meshReorderVertScore(_ldiCacheScores* Scores, _ldiCacheVert* Vert) {
+	if (Vert->activeCount == 0) {
+		return -1.0f;
+	}
+
+	float score = (Vert->cachePos >= 0) ? Scores->cache[Vert->cachePos] : 0.0f;
+	score += Scores->valence[min(Vert->activeCount, MESH_REORDER_MAX_VALENCE - 1)];
+
+	return score;
+}
+
+// Triangle order for vertex cache reuse. Ties, and restarts after the cache runs dry, follow the current
+// face order, so it is worth giving this a spatially sorted mesh.
+void meshReorderOptimizeVertexCache(ldiModel* Model, ldiReorderMap* FaceMap) {
+	PROFILE_ZONE_LOG("Optimize vertex cache");
+
+	int vertCount = (int)Model->verts.size();
+	int triCount = (int)Model->indices.size() / 3;
+	const uint32_t* indices = Model->indices.data();
+
+	PROFILE_ITEMS(triCount);
+
+	_ldiCacheScores scores;
+	_meshReorderInitCacheScores(&scores);
+
+	ldiVertexFaceAdjacency adjacency;
+	meshBuildVertexFaceAdjacency(Model, &adjacency);
+	int* vertFaceStart = adjacency.vertFaceStart.data();
+	int* vertFaces = adjacency.vertFaces.data();
+
+	std::vector<_ldiCacheVert> verts(vertCount);
+
+	for (int v = 0; v < vertCount; ++v) {
+		verts[v].cachePos = -1;
+		verts[v].activeCount = vertFaceStart[v + 1] - vertFaceStart[v];
+		verts[v].score = _meshReorderVertScore(&scores, &verts[v]);
+	}
+
+	std::vector<float> triScores(triCount);
+	std::vector<bool> triEmitted(triCount, false);
+
+	for (int t = 0; t < triCount; ++t) {
+		triScores[t] = verts[indices[t * 3 + 0]].score + verts[indices[t * 3 + 1]].score + verts[indices[t * 3 + 2]].score;
+	}
+
+	// NOTE: Three extra slots hold verts pushed out by the last face until their scores are updated.
+	int cache[MESH_REORDER_CACHE_SIZE + 3];
+	int cacheCount = 0;
+
+	FaceMap->newToOld.resize(triCount);
+
+	int bestTri = -1;
+	int scanCursor = 0;
+
+	for (int emitted = 0; emitted < triCount; ++emitted) {
+		if (bestTri == -1) {
+			while (triEmitted[scanCursor]) {
+				++scanCursor;
+			}
+
+			bestTri = scanCursor;
+		}
+
+		FaceMap->newToOld[emitted] = bestTri;
+		triEmitted[bestTri] = true;
+
+		// Drop the face from its verts and move them to the front of the cache.
+		int newCache[MESH_REORDER_CACHE_SIZE + 3];
+		int newCacheCount = 0;
+
+		for (int c = 0; c < 3; ++c) {
+			int v = indices[bestTri * 3 + c];
+			_ldiCacheVert* vert = &verts[v];
+			int* faces = vertFaces + vertFaceStart[v];
+
+			for (int f = 0; f < vert->activeCount; ++f) {
+				if (faces[f] == bestTri) {
+					faces[f] = faces[vert->activeCount - 1];
+					faces[vert->activeCount - 1] = bestTri;
+					break;
+				}
+			}
+
+			--vert->activeCount;
+			newCache[newCacheCount++] = v;
+		}
+
+		for (int c = 0; c < cacheCount; ++c) {
+			int v = cache[c];
+
+			if (v != newCache[0] && v != newCache[1] && v != newCache[2]) {
+				newCache[newCacheCount++] = v;
+			}
+		}
+
+		for (int c = 0; c < newCacheCount; ++c) {
+			verts[newCache[c]].cachePos = (c < MESH_REORDER_CACHE_SIZE) ? c : -1;
+		}
+
+		cacheCount = min(newCacheCount, MESH_REORDER_CACHE_SIZE);
+		memcpy(cache, newCache, sizeof(int) * cacheCount);
+
+		// Rescore verts that moved and the faces around them, the best of those goes next.
+		float bestScore = -1.0f;
+		bestTri = -1;
+
+		for (int c = 0; c < newCacheCount; ++c) {
+			int v = newCache[c];
+			_ldiCacheVert* vert = &verts[v];
+			float score = _meshReorderVertScore(&scores, vert);
+			float delta = score - vert->score;
+			vert->score = score;
+
+			const int* faces = vertFaces + vertFaceStart[v];
+
+			for (int f = 0; f < vert->activeCount; ++f) {
+				triScores[faces[f]] += delta;
+			}
+		}
+
+		for (int c = 0; c < cacheCount; ++c) {
+			int v = cache[c];
+			_ldiCacheVert* vert = &verts[v];
+			const int* faces = vertFaces + vertFaceStart[v];
+
+			for (int f = 0; f < vert->activeCount; ++f) {
+				int t = faces[f];
+
+				if (triScores[t] > bestScore || (triScores[t] == bestScore && t < bestTri)) {
+					bestScore = triScores[t];
+					bestTri = t;
+				}
+			}
+		}
+	}
+
+	_meshReorderMapFillInverse(FaceMap);
+}
+
+// Average post transform cache misses per triangle for a FIFO cache of CacheSize verts.
+float meshReorderGetAcmr(ldiModel* Model, int CacheSize) {
+	// NOTE: Miss count when each vert last entered the cache.
+	std::vector<int> lastUse(Model->verts.size(), -1);
+	int triCount = (int)Model->indices.size() / 3;
+	int misses = 0;
+
+	for (size_t i = 0; i < Model->indices.size(); ++i) {
+		uint32_t v = Model->indices[i];
+
+		if (lastUse[v] == -1 || misses - lastUse[v] >= CacheSize) {
+			lastUse[v] = misses;
+			++misses;
+		}
+	}
+
+	return (triCount > 0) ? (float)misses / triCount : 0.0f;
+}
+
+//----------------------------------------------------------------------------------------------------
+// Whole meshes.
+//----------------------------------------------------------------------------------------------------
+// Faces along the curve through their centroids, then vertex cache order, then vertices by first use.
+// Result can be null when the permutations aren't needed.
+void meshReorderModel(ldiModel* Model, ldiSpaceCurve Curve, ldiModelReorder* Result) {
+	PROFILE_ZONE_LOG("Reorder model");
+
+	int triCount = (int)Model->indices.size() / 3;
+
+	std::vector<vec3> centroids(triCount);
+
+	for (int t = 0; t < triCount; ++t) {
+		vec3 p0 = Model->verts[Model->indices[t * 3 + 0]].pos;
+		vec3 p1 = Model->verts[Model->indices[t * 3 + 1]].pos;
+		vec3 p2 = Model->verts[Model->indices[t * 3 + 2]].pos;
+		centroids[t] = (p0 + p1 + p2) / 3.0f;
+	}
+
+	ldiModelReorder local;
+	if (!Result) {
+		Result = &local;
+	}
+
+	ldiReorderMap curveMap;
+	meshReorderComputeCurveOrder(centroids.data(), triCount, Curve, &curveMap);
+	_meshReorderFaces(&Model->indices, 3, &curveMap);
+
+	ldiReorderMap cacheMap;
+	meshReorderOptimizeVertexCache(Model, &cacheMap);
+	_meshReorderFaces(&Model->indices, 3, &cacheMap);
+	_meshReorderCompose(&curveMap, &cacheMap, &Result->faces);
+
+	_meshReorderVertsByFirstUse(&Model->indices, (int)Model->verts.size(), &Result->verts);
+	_meshReorderRemapIndices(&Model->indices, &Result->verts);
+	meshReorderApply(Model->verts, &Result->verts);
+}
+
+// Quads along the curve through their centroids, then vertices by first use. Result can be null.
+void meshReorderQuadModel(ldiQuadModel* Model, ldiSpaceCurve Curve, ldiModelReorder* Result) {
+	PROFILE_ZONE_LOG("Reorder quad model");
+
+	int quadCount = (int)Model->indices.size() / 4;
+
+	std::vector<vec3> centroids(quadCount);
+
+	for (int q = 0; q < quadCount; ++q) {
+		vec3 center = vec3Zero;
+
+		for (int c = 0; c < 4; ++c) {
+			center += Model->verts[Model->indices[q * 4 + c]];
+		}
+
+		centroids[q] = center / 4.0f;
+	}
+
+	ldiModelReorder local;
+	if (!Result) {
+		Result = &local;
+	}
+
+	meshReorderComputeCurveOrder(centroids.data(), quadCount, Curve, &Result->faces);
+	_meshReorderFaces(&Model->indices, 4, &Result->faces);
+
+	_meshReorderVertsByFirstUse(&Model->indices, (int)Model->verts.size(), &Result->verts);
+	_meshReorderRemapIndices(&Model->indices, &Result->verts);
+	meshReorderApply(Model->verts, &Result->verts);
+}
+
+// Surfels along the curve through their positions. Surfel ids are left as they are, so they keep pointing at
+// whatever they were created from.
+void meshReorderSurfels(std::vector<ldiNewSurfel>* Surfels, ldiSpaceCurve Curve, ldiReorderMap* Map) {
+	PROFILE_ZONE_LOG("Reorder surfels");
+
+	std::vector<vec3> positions(Surfels->size());
+
+	for (size_t i = 0; i < Surfels->size(); ++i) {
+		positions[i] = (*Surfels)[i].position;
+	}
+
+	ldiReorderMap local;
+	if (!Map) {
+		Map = &local;
+	}
+
+	meshReorderComputeCurveOrder(positions.data(), (int)positions.size(), Curve, Map);
+	meshReorderApply(*Surfels, Map);
+}
\ No newline at end of file
@@ -70,9 +70,7 @@ struct ldiModelEditor {
 
 	ID3D11Texture3D*			sdfVolumeTexture;
 	ID3D11ShaderResourceView*	sdfVolumeResourceView;
-	ID3D11UnorderedAccessView*	sdfVolumeUav;
 	ID3D11SamplerState*			sdfVolumeSamplerState;
-	ID3D11ComputeShader*		sdfVolumeCompute;
 
 	ldiDisplacementPlane		displacePlane;
 	ldiImage					decal0;
@@ -80,6 +78,12 @@ struct ldiModelEditor {
 	ldiRenderModel				sphereTemplate;
 	ldiRenderModel				sphereTarget1;
 
+	// Kept for baking to file.
+	ldiModel					sphereTemplateModel;
+	ldiModel					sphereTarget1Model;
+	ldiPhysicsMesh				sphereTarget1Phys;
+	int							dispFileBakeSize = 8192;
+
 	ID3D11Texture2D*			dispTex;
 	ID3D11ShaderResourceView*	dispView;
 
@@ -175,136 +179,7 @@ bool getPointInTri(vec2 p, vec2 a, vec2 b, vec2 c, float& u, float& v, float& w)
 //}
 
 void geoBakeDisplacementTexture(ldiApp* AppContext, ldiPhysicsMesh* CookedMesh, ldiModel* BaseModel, ldiModel* TargetModel, ldiDispImage* OutTex) {
-	float normalAdjust = -0.4;
-
-	struct ldiTracePoint {
-		int index;
-		vec3 world;
-		vec3 normal;
-		vec2 uv;
-	};
-
-	memset(OutTex->data, 0, 4 * OutTex->width * OutTex->width);
-	memset(OutTex->normalData, 0, 4 * OutTex->width * OutTex->width);
-
-	// Create spatial structure for base model tris.
-
-	int cellW = 128;
-	double sizePerCell = 1.0 / (double)cellW;
-
-	struct ldiSpatialCell {
-		std::vector<int> tris;
-	};
-
-	ldiSpatialCell* cells = new ldiSpatialCell[cellW * cellW];
-
-	for (size_t iterTris = 0; iterTris < BaseModel->indices.size() / 3; ++iterTris) {
-		ldiMeshVertex* v0 = &BaseModel->verts[BaseModel->indices[iterTris * 3 + 0]];
-		ldiMeshVertex* v1 = &BaseModel->verts[BaseModel->indices[iterTris * 3 + 1]];
-		ldiMeshVertex* v2 = &BaseModel->verts[BaseModel->indices[iterTris * 3 + 2]];
-		
-		vec2 bMin;
-		bMin.x = min(min(v0->uv.x, v1->uv.x), v2->uv.x);
-		bMin.y = min(min(v0->uv.y, v1->uv.y), v2->uv.y);
-
-		vec2 bMax;
-		bMax.x = max(max(v0->uv.x, v1->uv.x), v2->uv.x);
-		bMax.y = max(max(v0->uv.y, v1->uv.y), v2->uv.y);
-
-		int cXs = max(bMin.x * cellW, 0);
-		int cXe = min(bMax.x * cellW, cellW - 1);
-
-		int cYs = max(bMin.y * cellW, 0);
-		int cYe = min(bMax.y * cellW, cellW - 1);
-
-		for (int iY = cYs; iY <= cYe; ++iY) {
-			for (int iX = cXs; iX <= cXe; ++iX) {
-				int cellIdx = iX + iY * cellW;
-
-				cells[cellIdx].tris.push_back(iterTris);
-			}
-		}
-	}
-
-	double texelW = 1.0 / OutTex->width;
-	double texelH = 1.0 / OutTex->height;
-
-	for (int iY = 0; iY < OutTex->height; ++iY) {
-		for (int iX = 0; iX < OutTex->width; ++iX) {
-			float u = (iX + 0.5) * texelW;
-			float v = (iY + 0.5) * texelH;
-			int idx = iX + iY * OutTex->width;
-
-			int cellX = u * cellW;
-			int cellY = v * cellW;
-			ldiSpatialCell* cell = &cells[cellX + cellY * cellW];
-
-			// Find the world pos/normal for this texel. (First tri comes first).
-			//for (size_t iterTris = 0; iterTris < BaseModel->indices.size() / 3; ++iterTris) {
-			for (size_t iterTris = 0; iterTris < cell->tris.size(); ++iterTris) {
-				/*ldiMeshVertex* v0 = &BaseModel->verts[BaseModel->indices[iterTris * 3 + 0]];
-				ldiMeshVertex* v1 = &BaseModel->verts[BaseModel->indices[iterTris * 3 + 1]];
-				ldiMeshVertex* v2 = &BaseModel->verts[BaseModel->indices[iterTris * 3 + 2]];*/
-				ldiMeshVertex* v0 = &BaseModel->verts[BaseModel->indices[cell->tris[iterTris] * 3 + 0]];
-				ldiMeshVertex* v1 = &BaseModel->verts[BaseModel->indices[cell->tris[iterTris] * 3 + 1]];
-				ldiMeshVertex* v2 = &BaseModel->verts[BaseModel->indices[cell->tris[iterTris] * 3 + 2]];
-
-				float tU, tV, tW;
-
-				if (getPointInTri(vec2(u, v), v0->uv, v1->uv, v2->uv, tU, tV, tW)) {
-					ldiTracePoint tracePoint = {};
-					tracePoint.index = idx;
-					tracePoint.uv = vec2(u, v);
-					tracePoint.world = v0->pos * tU + v1->pos * tV + v2->pos * tW;
-					tracePoint.normal = v0->normal * tU + v1->normal * tV + v2->normal * tW;
-
-					ldiRaycastResult result = physicsRaycast(CookedMesh, tracePoint.world + tracePoint.normal * normalAdjust, tracePoint.normal, 1.0f);
-
-					if (result.hit) {
-						ldiMeshVertex v0 = TargetModel->verts[TargetModel->indices[result.faceIdx * 3 + 0]];
-						ldiMeshVertex v1 = TargetModel->verts[TargetModel->indices[result.faceIdx * 3 + 1]];
-						ldiMeshVertex v2 = TargetModel->verts[TargetModel->indices[result.faceIdx * 3 + 2]];
-
-						float u = result.barry.x;
-						float v = result.barry.y;
-						float w = 1.0 - (u + v);
-						vec3 normal = w * v0.normal + u * v1.normal + v * v2.normal;
-
-						//vert->pos = result.pos;
-						//vert->normal = normal;//-result.normal;
-
-						//float dist = glm::length(tracePoint.world - result.pos);
-						float dist = result.dist - glm::length(tracePoint.normal * normalAdjust);
-
-						OutTex->normalData[idx * 4 + 0] = (normal.x * 0.5 + 0.5) * 255;
-						OutTex->normalData[idx * 4 + 1] = (normal.y * 0.5 + 0.5) * 255;
-						OutTex->normalData[idx * 4 + 2] = (normal.z * 0.5 + 0.5) * 255;
-						OutTex->normalData[idx * 4 + 3] = 255;
-
-						OutTex->data[idx] = dist;
-
-						/*OutTex->data[idx * 4 + 0] = 127 + dist * 127;
-						OutTex->data[idx * 4 + 1] = 127 + dist * 127;
-						OutTex->data[idx * 4 + 2] = 127 + dist * 127;
-						OutTex->data[idx * 4 + 3] = 255;*/
-					}
-
-					/*OutTex->data[idx * 4 + 0] = tracePoint.world.x * 100;
-					OutTex->data[idx * 4 + 1] = tracePoint.world.y * 100;
-					OutTex->data[idx * 4 + 2] = tracePoint.world.z * 100;*/
-					/*OutTex->data[idx * 4 + 0] = (tracePoint.normal.x * 0.5 + 0.5) * 255;
-					OutTex->data[idx * 4 + 1] = (tracePoint.normal.y * 0.5 + 0.5) * 255;
-					OutTex->data[idx * 4 + 2] = (tracePoint.normal.z * 0.5 + 0.5) * 255;
-					OutTex->data[idx * 4 + 3] = 255;*/
-
-					//tracePoints.push_back(tracePoint);
-					break;
-				}
-			}
-		}
-	}
-
-	delete[] cells;
+	dispBakeToImage(CookedMesh, BaseModel, TargetModel, OutTex);
 }
 
 void geoBakeDisplacement(ldiApp* AppContext, ldiPhysicsMesh* CookedMesh, ldiModel* SrcModel, ldiModel* DstModel) {
@@ -342,6 +217,30 @@ int modelEditorInit(ldiApp* AppContext, ldiModelEditor* Tool) {
 	return 0;
 }
 
+float _modelEditorVoxelSdf(vec3 Pos, void* UserData) {
+	ldiVoxelGrid* grid = (ldiVoxelGrid*)UserData;
+
+	float vgHsX = grid->cellSizeX * 0.5f;
+	float vgHsY = grid->cellSizeY * 0.5f;
+	float vgHsZ = grid->cellSizeZ * 0.5f;
+
+	float radius = 40.0f;
+	float dist = glm::length(Pos - vec3(vgHsX, vgHsY + 30, vgHsZ)) - radius;
+
+	float dist2 = glm::length(Pos - vec3(vgHsX - 20, vgHsY - 20, vgHsZ - 15)) - 30;
+
+	vec3 q = abs(Pos - vec3(vgHsX, vgHsY - 50, vgHsZ)) - vec3(30, 30, 30);
+	float dist3 = glm::length(vmax(q, vec3(0.0f))) + min(max(q.x, max(q.y, q.z)), 0.0) - 4;
+
+	float k = 40.0;
+	float h = clampf(0.5 + 0.5 * (dist3 - dist) / k, 0.0, 1.0);
+	dist = lerp(dist3, dist, h) - k * h * (1.0 - h);
+
+	dist = min(dist, dist2);
+
+	return dist;
+}
+
 int modelEditorLoad(ldiApp* AppContext, ldiModelEditor* Tool) {
 
 	std::cout << "Start shader compile\n";
@@ -369,13 +268,6 @@ int modelEditorLoad(ldiApp* AppContext, ldiModelEditor* Tool) {
 		return 1;
 	}
 
-	//----------------------------------------------------------------------------------------------------
-	// SDF generate compute shader.
-	//----------------------------------------------------------------------------------------------------
-	if (!gfxCreateComputeShader(AppContext, L"../../assets/shaders/generateSdf.hlsl", "mainCs", &Tool->sdfVolumeCompute)) {
-		return 1;
-	}
-
 	//----------------------------------------------------------------------------------------------------
 	// Dilate generate compute shader.s
 	//----------------------------------------------------------------------------------------------------
@@ -476,13 +368,35 @@ int modelEditorLoad(ldiApp* AppContext, ldiModelEditor* Tool) {
 	}
 
 	//----------------------------------------------------------------------------------------------------
-	// SDF volume.
+	// SDF volume of triangle mesh.
 	//----------------------------------------------------------------------------------------------------
 	int sdfWidth = 256;
 	int sdfHeight = 256;
 	int sdfDepth = 256;
 
 	{
+		ldiModel dergnModel = objLoadModel("../../assets/models/dergn.obj");
+		// ldiModel dergnModel = objLoadModel("../../assets/models/test.obj");
+
+		float scale = 24;
+		for (int i = 0; i < dergnModel.verts.size(); ++i) {
+			ldiMeshVertex* vert = &dergnModel.verts[i];
+			vert->pos = vert->pos * scale;
+			vert->pos += vec3(128.0f, 0.0f, 128.0f);
+		}
+
+		std::cout << "Tris: " << dergnModel.indices.size() / 3 << "\n";
+
+		float* sdfVolume = new float[sdfWidth * sdfHeight * sdfDepth];
+
+		{
+			PROFILE_ZONE_LOG("SDF compute");
+
+			ldiMeshDistance meshDistance;
+			meshDistanceBuild(&dergnModel, &meshDistance);
+			meshDistanceFillVolume(&meshDistance, vec3(0.0f, 0.0f, 0.0f), 1.0f, sdfWidth, sdfHeight, sdfDepth, sdfVolume);
+		}
+
 		D3D11_TEXTURE3D_DESC desc = {};
 		desc.Width = sdfWidth;
 		desc.Height = sdfHeight;
@@ -490,35 +404,10 @@ int modelEditorLoad(ldiApp* AppContext, ldiModelEditor* Tool) {
 		desc.MipLevels = 1;
 		desc.Format = DXGI_FORMAT_R32_FLOAT;
 		desc.Usage = D3D11_USAGE_DEFAULT;
-		desc.BindFlags = D3D11_BIND_SHADER_RESOURCE | D3D11_BIND_UNORDERED_ACCESS;
-		desc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+		desc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+		desc.CPUAccessFlags = 0;
 		desc.MiscFlags = 0;
 
-		float* sdfVolume = new float[sdfWidth * sdfHeight * sdfDepth];
-
-		// vec3 sphereOrigin(sdfWidth / 2.0f, sdfHeight / 2.0f, sdfDepth / 2.0f);
-		// float sphereRadius = 128.0f;
-
-		// for (int iZ = 0; iZ < sdfDepth; ++iZ) {
-		// 	for (int iY = 0; iY < sdfHeight; ++iY) {
-		// 		for (int iX = 0; iX < sdfWidth; ++iX) {
-		// 			int idx = iX + iY * sdfWidth + iZ * sdfWidth * sdfHeight;
-
-		// 			vec3 pos(iX + 0.5f, iY + 0.5f, iZ + 0.5f);
-		// 			float dist = glm::length(pos - sphereOrigin) - sphereRadius;
-
-		// 			sdfVolume[idx] = dist;
-		// 		}
-		// 	}
-		// }
-
-		// FILE* sdfFile;
-		// fopen_s(&sdfFile, "../../assets/models/derg256.sdf", "rb");
-
-		// fread(sdfVolume, 4, sdfWidth * sdfHeight * sdfDepth, sdfFile);
-
-		// fclose(sdfFile);
-
 		D3D11_SUBRESOURCE_DATA sub = {};
 		sub.pSysMem = sdfVolume;
 		sub.SysMemPitch = sdfWidth * 4;
@@ -548,111 +437,6 @@ int modelEditorLoad(ldiApp* AppContext, ldiModelEditor* Tool) {
 		AppContext->d3dDevice->CreateSamplerState(&samplerDesc, &Tool->sdfVolumeSamplerState);
 	}
 
-	//----------------------------------------------------------------------------------------------------
-	// Create SDF of triangle mesh.
-	//----------------------------------------------------------------------------------------------------
-	{
-		if (!gfxCreateTexture3DUav(AppContext, Tool->sdfVolumeTexture, &Tool->sdfVolumeUav)) {
-			std::cout << "Could not create UAV\n";
-			return 1;
-		}
-
-		ldiModel dergnModel = objLoadModel("../../assets/models/dergn.obj");
-		// ldiModel dergnModel = objLoadModel("../../assets/models/test.obj");
-
-		float scale = 24;
-		for (int i = 0; i < dergnModel.verts.size(); ++i) {
-			ldiMeshVertex* vert = &dergnModel.verts[i];
-			vert->pos = vert->pos * scale;
-			vert->pos += vec3(128.0f, 0.0f, 128.0f);
-		}
-
-		// Create tri list.
-		std::vector<vec3> tris;
-		tris.reserve(dergnModel.indices.size());
-
-		for (size_t i = 0; i < dergnModel.indices.size(); ++i) {
-			tris.push_back(dergnModel.verts[dergnModel.indices[i]].pos);
-		}
-
-		ID3D11Buffer* triListBuffer;
-
-		if (!gfxCreateStructuredBuffer(AppContext, 4 * 3, tris.size(), tris.data(), &triListBuffer)) {
-			std::cout << "Could not create structured buffer\n";
-			return 1;
-		}
-
-		ID3D11ShaderResourceView* triListResourceView;
-
-		if (!gfxCreateBufferShaderResourceView(AppContext, triListBuffer, &triListResourceView)) {
-			std::cout << "Could not create shader resource view\n";
-			return 1;
-		}
-
-		ID3D11Buffer* constantBuffer;
-
-		struct ldiSdfComputeConstantBuffer {
-			int triCount;
-			float testVal;
-			float __p0;
-			float __p1;
-		};
-
-		{
-			D3D11_BUFFER_DESC desc = {};
-			desc.ByteWidth = sizeof(ldiSdfComputeConstantBuffer);
-			desc.Usage = D3D11_USAGE_IMMUTABLE;
-			desc.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
-			desc.CPUAccessFlags = 0;
-			desc.MiscFlags = 0;
-
-			ldiSdfComputeConstantBuffer cbTemp;
-			std::cout << "Tris size: " << tris.size() << " " << tris.size() / 3 << "\n";
-			cbTemp.triCount = tris.size() / 3;
-			cbTemp.testVal = 0.0f;
-
-			D3D11_SUBRESOURCE_DATA constantBufferData = {};
-			constantBufferData.pSysMem = &cbTemp;
-			
-			if (AppContext->d3dDevice->CreateBuffer(&desc, &constantBufferData, &constantBuffer) != S_OK) {
-				std::cout << "Failed to create constant buffer\n";
-				return 1;
-			}
-		}
-
-		double t0 = getTime();
-
-		D3D11_QUERY_DESC queryDesc = {};
-		queryDesc.Query = D3D11_QUERY_EVENT;
-
-		ID3D11Query* query;
-		if (AppContext->d3dDevice->CreateQuery(&queryDesc, &query) != S_OK) {
-			return false;
-		}
-
-		AppContext->d3dDeviceContext->CSSetShader(Tool->sdfVolumeCompute, 0, 0);
-		AppContext->d3dDeviceContext->CSSetShaderResources(0, 1, &triListResourceView);
-		AppContext->d3dDeviceContext->CSSetUnorderedAccessViews(0, 1, &Tool->sdfVolumeUav, 0);
-		AppContext->d3dDeviceContext->CSSetConstantBuffers(0, 1, &constantBuffer);
-		AppContext->d3dDeviceContext->Dispatch(sdfWidth / 8, sdfHeight / 8, sdfDepth / 8);
-		AppContext->d3dDeviceContext->CSSetShader(0, 0, 0);
-		ID3D11UnorderedAccessView* ppUAViewnullptr[1] = { 0 };
-		AppContext->d3dDeviceContext->CSSetUnorderedAccessViews(0, 1, ppUAViewnullptr, 0);
-
-		AppContext->d3dDeviceContext->End(query);
-		BOOL queryData;
-
-		while (S_OK != AppContext->d3dDeviceContext->GetData(query, &queryData, sizeof(BOOL), 0)) {
-		}
-
-		if (queryData != TRUE) {
-			return false;
-		}
-
-		t0 = getTime() - t0;
-		std::cout << "SDF compute time: " << (t0 * 1000.0) << " ms\n";
-	}
-
 	//----------------------------------------------------------------------------------------------------
 	// Create displacement grid.
 	//----------------------------------------------------------------------------------------------------
@@ -737,28 +521,26 @@ int modelEditorLoad(ldiApp* AppContext, ldiModelEditor* Tool) {
 		//ldiModel sphereTemplateModel = objLoadQuadModel("../../assets/models/sphere_templateMed.obj");
 		//Tool->sphereTemplate = gfxCreateRenderQuadModel(AppContext, &sphereTemplateModel);
 
-		ldiModel sphereTemplateModel = objLoadModel("../../assets/models/sphere_templateUVsMed.obj");
-		Tool->sphereTemplate = gfxCreateRenderModel(AppContext, &sphereTemplateModel);
+		Tool->sphereTemplateModel = objLoadModel("../../assets/models/sphere_templateUVsMed.obj");
+		Tool->sphereTemplate = gfxCreateRenderModel(AppContext, &Tool->sphereTemplateModel);
 
-		ldiModel sphereTarget1 = objLoadModel("../../assets/models/sphere_target1.obj");
-		Tool->sphereTarget1 = gfxCreateRenderModel(AppContext, &sphereTarget1);
+		Tool->sphereTarget1Model = objLoadModel("../../assets/models/sphere_target1.obj");
+		Tool->sphereTarget1 = gfxCreateRenderModel(AppContext, &Tool->sphereTarget1Model);
 
-		ldiPhysicsMesh sphereTarget1Phys;
-		if (physicsCookMesh(AppContext->physics, &sphereTarget1, &sphereTarget1Phys) != 0) {
+		if (physicsCookMesh(AppContext->physics, &Tool->sphereTarget1Model, &Tool->sphereTarget1Phys) != 0) {
 			return 1;
 		}
 
-		double t0 = getTime();
-
 		ldiDispImage dispTex = {};
 		dispTex.width = 2048;
 		dispTex.height = 2048;
 		dispTex.data = new float[dispTex.width * dispTex.height];
 		dispTex.normalData = new uint8_t[dispTex.width * dispTex.height * 4];
 		
-		geoBakeDisplacementTexture(Tool->appContext, &sphereTarget1Phys, &sphereTemplateModel, &sphereTarget1, &dispTex);
-		t0 = getTime() - t0;
-		std::cout << "Bake time: " << (t0 * 1000.0) << " ms\n";
+		{
+			PROFILE_ZONE_LOG("Bake");
+			geoBakeDisplacementTexture(Tool->appContext, &Tool->sphereTarget1Phys, &Tool->sphereTemplateModel, &Tool->sphereTarget1Model, &dispTex);
+		}
 
 		{
 			D3D11_SUBRESOURCE_DATA texData = {};
@@ -926,83 +708,32 @@ int modelEditorLoad(ldiApp* AppContext, ldiModelEditor* Tool) {
 
 		Tool->voxelGrid = voxelCreateGrid(32, 32, 32);
 
-		double t0 = getTime();
-
-		float vgHsX = Tool->voxelGrid.cellSizeX * 0.5f;
-		float vgHsY = Tool->voxelGrid.cellSizeY * 0.5f;
-		float vgHsZ = Tool->voxelGrid.cellSizeZ * 0.5f;
-
-		for (int iZ = 0; iZ < Tool->voxelGrid.cellSizeZ; ++iZ) {
-			for (int iY = 0; iY < Tool->voxelGrid.cellSizeY; ++iY) {
-				for (int iX = 0; iX < Tool->voxelGrid.cellSizeX; ++iX) {
-					vec3 pos;
-					pos.x = (iX + 0.5f);
-					pos.y = (iY + 0.5f);
-					pos.z = (iZ + 0.5f);
-
-					float radius = 40.0f;
-					float dist = glm::length(pos - vec3(vgHsX, vgHsY + 30, vgHsZ)) - radius;
-
-					float dist2 = glm::length(pos - vec3(vgHsX - 20, vgHsY - 20, vgHsZ - 15)) - 30;
-
-					vec3 q = abs(pos - vec3(vgHsX, vgHsY - 50, vgHsZ)) - vec3(30, 30, 30);
-					float dist3 = glm::length(vmax(q, vec3(0.0f))) + min(max(q.x, max(q.y, q.z)), 0.0) - 4;
-
-					vec3 d = abs(pos - vec3(vgHsX, vgHsY - 50, vgHsZ)) - vec3(30, 30, 30);
-					float dist4 = min(max(d.x, max(d.y, d.z)), 0.0) + glm::length(vmax(d, vec3(0.0f)));
-
-					//dist = min(dist, dist4);
-
-					float k = 40.0;
-					float h = clampf(0.5 + 0.5 * (dist3 - dist) / k, 0.0, 1.0);
-					dist = lerp(dist3, dist, h) - k * h * (1.0 - h);
-
-					dist = min(dist, dist2);
-
-					if (dist < 1.0f) {
-						//dist += 1.0f;
-						//dist = max(0, dist);
-						//dist = 1.0f - dist;
-
-						ldiVoxelCell voxel;
-						voxel.value = dist;
-						voxelSetCell(&Tool->voxelGrid, iX, iY, iZ, voxel);
-					}
-
-					/*if (dist < 0.0f) {
-						dist += 1.0f;
-						dist = max(0, dist);
-						dist = 1.0f - dist;
-
-						ldiVoxelCell voxel;
-						voxel.value = dist;
+		{
+			PROFILE_ZONE_LOG("Voxel SDF");
+			PROFILE_ITEMS(Tool->voxelGrid.cellSizeX * Tool->voxelGrid.cellSizeY * Tool->voxelGrid.cellSizeZ);
 
-						voxelSetCell(&Tool->voxelGrid, iX, iY, iZ, voxel);
-					}*/
-				}
-			}
+			voxelFillSdf(&Tool->voxelGrid, _modelEditorVoxelSdf, &Tool->voxelGrid);
 		}
-		t0 = getTime() - t0;
-		std::cout << "Voxel SDF time: " << (t0 * 1000.0) << " ms\n";
 
 		ldiModel voxelModel;
-		t0 = getTime();
-		//voxelCreateModel(&Tool->voxelGrid, &voxelModel);
-		voxelMarch(&Tool->voxelGrid, &voxelModel);
-		t0 = getTime() - t0;
-		std::cout << "Voxel build mesh time: " << (t0 * 1000.0) << " ms\n";
+		{
+			PROFILE_ZONE_LOG("Voxel build mesh");
+			//voxelCreateModel(&Tool->voxelGrid, &voxelModel);
+			voxelMarch(&Tool->voxelGrid, &voxelModel);
+		}
 
-		t0 = getTime();
-		modelCreateFaceNormals(&voxelModel);
-		t0 = getTime() - t0;
-		std::cout << "Voxel mesh calculate normals time: " << (t0 * 1000.0) << " ms\n";
+		{
+			PROFILE_ZONE_LOG("Voxel mesh calculate normals");
+			meshComputeVertexNormals(&voxelModel);
+			PROFILE_ITEMS(voxelModel.indices.size() / 3);
+		}
 
 		Tool->voxelRenderModel = gfxCreateRenderModel(AppContext, &voxelModel);
 
 		std::cout << "Voxel grid size: " << Tool->voxelGrid.cellSizeX << ", " << Tool->voxelGrid.cellSizeY << ", " << Tool->voxelGrid.cellSizeZ << " (" << 
 			Tool->voxelGrid.cellSizeX * Tool->voxelGrid.cellSizeY * Tool->voxelGrid.cellSizeZ << ")\n";
 
-		std::cout << "Voxel grid index size: " << (Tool->voxelGrid.sizeX * Tool->voxelGrid.sizeY * Tool->voxelGrid.sizeZ * sizeof(int)) / 1024.0 << " KB\n";
+		std::cout << "Voxel grid index entries: " << Tool->voxelGrid.chunkMap.size() << " allocated, " << Tool->voxelGrid.solidChunks.size() << " solid\n";
 
 		std::cout << "Voxel allocated chunks: " << Tool->voxelGrid.rawChunks.size() << " (" << (Tool->voxelGrid.rawChunks.size() * sizeof(ldiVoxelChunk)) / (1024.0 * 1024.0) << " MB)\n";
 
@@ -1457,6 +1188,16 @@ void modelEditorShowUi(ldiModelEditor* Tool) {
 		ImGui::DragFloat3("Decal0", (float*)&Tool->decal0Pos, 0.001f, -1.0f, 1.0f);
 		ImGui::SliderFloat("Decal0 scale", &Tool->decal0Scale, 0.01f, 2.0f);
 	}
+
+	if (ImGui::CollapsingHeader("Displacement bake")) {
+		ImGui::InputInt("Size", &Tool->dispFileBakeSize);
+
+		if (ImGui::Button("Bake to file")) {
+			PROFILE_ZONE_LOG("Bake to file");
+			ldiDispBakeSettings settings = dispBakeGetDefaultSettings(Tool->dispFileBakeSize, Tool->dispFileBakeSize);
+			dispBakeToFile(&Tool->sphereTarget1Phys, &Tool->sphereTemplateModel, &Tool->sphereTarget1Model, &settings, "../cache/displacement.bin");
+		}
+	}
 		
 	ImGui::End();
 
@@ -1802,29 +1802,12 @@ int modelInspectorLoad(ldiApp* AppContext, ldiModelInspector* ModelInspector) {
 	//----------------------------------------------------------------------------------------------------
 	t0 = getTime();
 	{
-		const int threadCount = 20;
-		int batchSize = ModelInspector->surfels.size() / threadCount;
-		int batchRemainder = ModelInspector->surfels.size() - (batchSize * threadCount);
-		std::thread workerThread[threadCount];
+		ldiSmoothNormalsThreadContext tc{};
+		tc.grid = &spatialGrid;
+		tc.surfels = &ModelInspector->surfels;
 
 		for (int n = 0; n < 4; ++n) {
-			for (int t = 0; t < threadCount; ++t) {
-				ldiSmoothNormalsThreadContext tc{};
-				tc.grid = &spatialGrid;
-				tc.surfels = &ModelInspector->surfels;
-				tc.startIdx = t * batchSize;
-				tc.endIdx = (t + 1) * batchSize;
-
-				if (t == threadCount - 1) {
-					tc.endIdx += batchRemainder;
-				}
-
-				workerThread[t] = std::move(std::thread(surfelsSmoothNormalsThreadBatch, tc));
-			}
-
-			for (int t = 0; t < threadCount; ++t) {
-				workerThread[t].join();
-			}
+			parallelFor(0, (int)ModelInspector->surfels.size(), 256, surfelsSmoothNormalsThreadBatch, &tc);
 
 			// Apply smoothed normal back to surfel normal.
 			for (int i = 0; i < ModelInspector->surfels.size(); ++i) {
@@ -154,21 +154,32 @@ void pantherWorkerThread(ldiPanther* Panther) {
 
 	while (Panther->workerThreadRunning) {
 		std::cout << "Panther thread wating for serial connection\n";
-		std::unique_lock<std::mutex> lock(Panther->serialPortConnectMutex);
-		// TODO: Need this to wake on error too.
-		Panther->serialPortConnectCondVar.wait(lock);
+		{
+			std::unique_lock<std::mutex> lock(Panther->serialPortConnectMutex);
+
+			// NOTE: Checked under the lock so a connect that happens before we get here isn't missed.
+			while (!Panther->serialPortConnected && Panther->workerThreadRunning) {
+				Panther->serialPortConnectCondVar.wait(lock);
+			}
+		}
 
 		while (Panther->serialPortConnected) {
+			int waitResult = serialPortWaitForData(&Panther->serialPort, 100);
+
+			if (waitResult == -1) {
+				pantherDisconnect(Panther);
+				break;
+			} else if (waitResult == 0) {
+				continue;
+			}
+
 			Panther->recvTempSize = serialPortReadData(&Panther->serialPort, Panther->recvTemp, PANTHER_RECV_TEMP_SIZE);
 			Panther->recvTempPos = 0;
 
 			if (Panther->recvTempSize == -1) {
 				pantherDisconnect(Panther);
 				break;
-			} else if (Panther->recvTempSize == 0) {
-				// TODO: I hate this :(. Find a better way.
-				Sleep(1);
-			} else {
+			} else if (Panther->recvTempSize > 0) {
 				while (Panther->recvTempPos < Panther->recvTempSize) {
 					uint8_t d = Panther->recvTemp[Panther->recvTempPos++];
 
@@ -220,6 +231,7 @@ bool pantherConnect(ldiPanther* Panther, const char* Path) {
 	// TODO: Reset packet recvs?
 
 	if (serialPortConnect(&Panther->serialPort, Path, 921600)) {
+		std::unique_lock<std::mutex> lock(Panther->serialPortConnectMutex);
 		Panther->serialPortConnected = true;
 		Panther->serialPortConnectCondVar.notify_all();
 		return true;
@@ -228,10 +240,31 @@ bool pantherConnect(ldiPanther* Panther, const char* Path) {
 	return false;
 }
 
+// Connects to an in-process device, see deviceSim.h.
+bool pantherConnectLoopback(ldiPanther* Panther, ldiSerialLoopback* Loopback) {
+	pantherDisconnect(Panther);
+
+	Panther->operationExecuting = false;
+	Panther->recvPacketState = 0;
+
+	serialPortConnectLoopback(&Panther->serialPort, Loopback);
+
+	std::unique_lock<std::mutex> lock(Panther->serialPortConnectMutex);
+	Panther->serialPortConnected = true;
+	Panther->serialPortConnectCondVar.notify_all();
+
+	return true;
+}
+
 void pantherDestroy(ldiPanther* Panther) {
 	pantherDisconnect(Panther);
 
-	Panther->workerThreadRunning = false;
+	{
+		std::unique_lock<std::mutex> lock(Panther->serialPortConnectMutex);
+		Panther->workerThreadRunning = false;
+		Panther->serialPortConnectCondVar.notify_all();
+	}
+
 	Panther->workerThread.join();
 }
 
@@ -240,12 +273,14 @@ bool pantherIsExecuting(ldiPanther* Panther) {
 }
 
 bool pantherWaitForExecutionComplete(ldiPanther* Panther) {
-	if (!Panther->operationExecuting) {
-		return true;
+	std::unique_lock<std::mutex> lock(Panther->operationCompleteMutex);
+
+	// NOTE: The response can arrive before we get here, so only wait while it is still outstanding.
+	while (Panther->operationExecuting) {
+		Panther->operationCompleteCondVar.wait(lock);
 	}
 
-	std::unique_lock<std::mutex> lock(Panther->operationCompleteMutex);
-	Panther->operationCompleteCondVar.wait(lock);
+	std::unique_lock<std::mutex> dataLock(Panther->dataLockMutex);
 
 	return Panther->lastSuccessState == PS_OK;
 }
@@ -72,6 +72,10 @@ struct ldiPlatform {
 	// Motion/Galvo/Laser control.
 	ldiPanther					panther;
 
+	// Stand-ins for the hardware when running with -sim.
+	ldiPantherSim				pantherSim;
+	ldiHawkSim					hawkSim;
+
 	int							testPosX;
 	int							testPosY;
 	int							testPosZ;
@@ -106,10 +110,12 @@ struct ldiPlatform {
 	bool						showSurfels = false;
 	bool						showSurfelsSpatialStructure = false;
 
-	std::mutex					liveScanPointsMutex;
-	bool						liveScanPointsUpdated;
+	// Live scan points are published by the worker thread and drained by the render thread.
+	// A reset records the ring position where the new scan starts.
+	ldiRingBuffer				liveScanRing;
+	std::atomic_int64_t			liveScanResetCursor = 0;
+	int64_t						liveScanPointsBaseCursor = 0;
 	std::vector<vec3>			liveScanPoints;
-	std::vector<vec3>			copyOfLiveScanPoints;
 
 	bool						scanShowPointCloud = true;
 	bool						scanUseWorkTrans = true;
@@ -134,6 +140,41 @@ struct ldiPlatform {
 	ldiAntOptimizer				antOptimizer;
 };
 
+// Worker thread only.
+void _platformResetLiveScanPoints(ldiPlatform* Platform) {
+	Platform->liveScanResetCursor.store(ringBufferGetWriteCursor(&Platform->liveScanRing), std::memory_order_release);
+}
+
+// Worker thread only.
+void _platformPublishLiveScanPoints(ldiPlatform* Platform, std::vector<vec3>& Points) {
+	int64_t written = ringBufferWriteWait(&Platform->liveScanRing, Points.data(), Points.size(), 1000);
+
+	if (written != (int64_t)Points.size()) {
+		std::cout << "Live scan points dropped: " << (Points.size() - written) << "\n";
+	}
+}
+
+// Render thread only. Returns true if liveScanPoints changed.
+bool platformUpdateLiveScanPoints(ldiPlatform* Platform) {
+	bool updated = false;
+	int64_t resetCursor = Platform->liveScanResetCursor.load(std::memory_order_acquire);
+
+	// NOTE: liveScanPoints holds the points for ring positions [base, base + size).
+	if (resetCursor > Platform->liveScanPointsBaseCursor) {
+		int64_t staleCount = min(resetCursor - Platform->liveScanPointsBaseCursor, (int64_t)Platform->liveScanPoints.size());
+		Platform->liveScanPoints.erase(Platform->liveScanPoints.begin(), Platform->liveScanPoints.begin() + staleCount);
+		ringBufferSkipTo(&Platform->liveScanRing, resetCursor);
+		Platform->liveScanPointsBaseCursor = resetCursor;
+		updated = true;
+	}
+
+	if (ringBufferReadAll(&Platform->liveScanRing, Platform->liveScanPoints) > 0) {
+		updated = true;
+	}
+
+	return updated;
+}
+
 void platformWorkerThreadJobComplete(ldiPlatform* Platform) {
 	delete Platform->job;
 	Platform->jobState = 0;
@@ -552,11 +593,7 @@ bool _platformScan2(ldiPlatform* Platform, ldiPlatformJobScan* Job) {
 	ldiApp* appContext = Platform->appContext;
 	ldiPanther* panther = &Platform->panther;
 
-	{
-		std::unique_lock<std::mutex> lock(Platform->liveScanPointsMutex);
-		Platform->liveScanPoints.clear();
-		Platform->liveScanPointsUpdated = true;
-	}
+	_platformResetLiveScanPoints(Platform);
 
 	// Set up cameras and other machine state.
 	pantherSendScanLaserStateCommand(panther, true);
@@ -653,6 +690,9 @@ bool _platformScan2(ldiPlatform* Platform, ldiPlatformJobScan* Job) {
 				// Project points onto scan plane.
 				ldiCamera camera = horseGetCamera(&Platform->appContext->calibJob, horsePos, 3280, 2464);
 
+				std::vector<vec3> worldPoints;
+				worldPoints.reserve(scanPoints.size());
+
 				for (size_t pIter = 0; pIter < scanPoints.size(); ++pIter) {
 					ldiLine ray = screenToRay(&camera, scanPoints[pIter]);
 
@@ -662,14 +702,11 @@ bool _platformScan2(ldiPlatform* Platform, ldiPlatformJobScan* Job) {
 
 						// Bake point into work space.
 						worldPoint = invWorkTrans * vec4(worldPoint, 1.0f);
-
-						{
-							std::unique_lock<std::mutex> lock(Platform->liveScanPointsMutex);
-							Platform->liveScanPoints.push_back(worldPoint);
-							Platform->liveScanPointsUpdated = true;
-						}
+						worldPoints.push_back(worldPoint);
 					}
 				}
+
+				_platformPublishLiveScanPoints(Platform, worldPoints);
 			}
 		}
 	}
@@ -681,11 +718,7 @@ bool _platformScan(ldiPlatform* Platform, ldiPlatformJobScan* Job) {
 	ldiApp* appContext = Platform->appContext;
 	ldiPanther* panther = &Platform->panther;
 
-	{
-		std::unique_lock<std::mutex> lock(Platform->liveScanPointsMutex);
-		Platform->liveScanPoints.clear();
-		Platform->liveScanPointsUpdated = true;
-	}
+	_platformResetLiveScanPoints(Platform);
 
 	std::vector<ldiHorsePosition> positions;
 
@@ -781,22 +814,21 @@ bool _platformScan(ldiPlatform* Platform, ldiPlatformJobScan* Job) {
 		computerVisionUndistortPoints(scanPoints, job->camMat, job->camDist);
 
 		// Project points onto scan plane.
-		{
-			std::unique_lock<std::mutex> lock(Platform->liveScanPointsMutex);
+		std::vector<vec3> worldPoints;
+		worldPoints.reserve(scanPoints.size());
 
-			for (size_t pIter = 0; pIter < scanPoints.size(); ++pIter) {
-				ldiLine ray = screenToRay(&camera, scanPoints[pIter]);
+		for (size_t pIter = 0; pIter < scanPoints.size(); ++pIter) {
+			ldiLine ray = screenToRay(&camera, scanPoints[pIter]);
 
-				vec3 worldPoint;
-				if (getRayPlaneIntersection(ray, scanPlane, worldPoint)) {
-					// Bake point into work space.
-					worldPoint = invWorkTrans * vec4(worldPoint, 1.0f);
-					Platform->liveScanPoints.push_back(worldPoint);
-				}
+			vec3 worldPoint;
+			if (getRayPlaneIntersection(ray, scanPlane, worldPoint)) {
+				// Bake point into work space.
+				worldPoint = invWorkTrans * vec4(worldPoint, 1.0f);
+				worldPoints.push_back(worldPoint);
 			}
-
-			Platform->liveScanPointsUpdated = true;
 		}
+
+		_platformPublishLiveScanPoints(Platform, worldPoints);
 	}
 
 	return true;
@@ -900,9 +932,19 @@ int platformInit(ldiApp* AppContext, ldiPlatform* Tool) {
 		return 1;
 	}
 
+	ringBufferInit(&Tool->liveScanRing, sizeof(vec3), 1024 * 1024);
+
 	Tool->workerThread = std::thread(platformWorkerThread, Tool);
 
-	hawkInit(&Tool->hawk, "169.254.72.101", 6969);
+	if (AppContext->useDeviceSim) {
+		pantherSimInit(&Tool->pantherSim);
+
+		if (hawkSimInit(&Tool->hawkSim)) {
+			hawkInit(&Tool->hawk, "127.0.0.1", Tool->hawkSim.port);
+		}
+	} else {
+		hawkInit(&Tool->hawk, "169.254.72.101", 6969);
+	}
 
 	//----------------------------------------------------------------------------------------------------
 	// Cube.
@@ -927,6 +969,9 @@ int platformInit(ldiApp* AppContext, ldiPlatform* Tool) {
 void platformDestroy(ldiPlatform* Platform) {
 	Platform->workerThreadRunning = false;
 	Platform->workerThread.join();
+
+	pantherSimDestroy(&Platform->pantherSim);
+	hawkSimDestroy(&Platform->hawkSim);
 }
 
 bool platformPrepareForNewJob(ldiPlatform* Platform) {
@@ -1539,22 +1584,10 @@ void platformRender(ldiPlatform* Tool, ldiRenderViewBuffers* RenderBuffers, int
 			}*/
 
 			// TODO: Move points update somewhere else?
-			{
-				bool update = false;
-				{
-					std::unique_lock<std::mutex> lock(Tool->liveScanPointsMutex);
-					if (Tool->liveScanPointsUpdated) {
-						Tool->liveScanPointsUpdated = false;
-						Tool->copyOfLiveScanPoints = Tool->liveScanPoints;
-						update = true;
-					}
-				}
-
-				if (update) {
-					std::cout << "Updating point cloud - Size: " << Tool->copyOfLiveScanPoints.size() << "\n";
-					scanUpdatePoints(Tool->appContext, &project->scan, Tool->copyOfLiveScanPoints);
-					project->scanLoaded = true;
-				}
+			if (platformUpdateLiveScanPoints(Tool)) {
+				std::cout << "Updating point cloud - Size: " << Tool->liveScanPoints.size() << "\n";
+				scanUpdatePoints(Tool->appContext, &project->scan, Tool->liveScanPoints);
+				project->scanLoaded = true;
 			}
 		}
 
@@ -2082,7 +2115,15 @@ void platformShowUi(ldiPlatform* Tool) {
 				};
 			} else {
 				if (ImGui::Button("Connect", ImVec2(-1, 0))) {
-					if (pantherConnect(&Tool->panther, "\\\\.\\COM4")) {
+					bool connected;
+
+					if (Tool->appContext->useDeviceSim) {
+						connected = pantherConnectLoopback(&Tool->panther, &Tool->pantherSim.loopback);
+					} else {
+						connected = pantherConnect(&Tool->panther, "\\\\.\\COM4");
+					}
+
+					if (connected) {
 						pantherSendDiagCommand(&Tool->panther);
 					}
 				}
@@ -0,0 +1,425 @@
+#pragma once
+
+#include <algorithm>
+#include <float.h>
+
+//----------------------------------------------------------------------------------------------------
+// Point index.
+//----------------------------------------------------------------------------------------------------
+// k nearest neighbor and radius queries over a fixed set of points, on the CPU.
+//
+// Points live in a flat k-d tree. The tree is complete and implicit: node I has children 2I+1 and 2I+2, every
+// leaf is on the last level, and each node splits its range in half at the median of its longest axis. The
+// layout is known from the point count alone, so each level is built in parallel with nth_element over
+// disjoint ranges. Entries are stored in leaf order alongside their source ids, so a leaf is one contiguous
+// run of memory.
+//
+// Queries descend the nearer child first and skip nodes whose bounds are further away than the worst result
+// kept so far. Neighbors are ordered by distance, then id, so results don't depend on traversal order.
+
+#define POINT_INDEX_LEAF_SIZE 8
+#define POINT_INDEX_STACK_SIZE 64
+#define POINT_INDEX_MAX_K 64
+
+struct ldiPointIndexNode {
+	vec3								min;
+	int									start;
+	vec3								max;
+	int									count;
+};
+
+struct ldiPointIndexEntry {
+	vec3								position;
+	int									id;
+};
+
+struct ldiPointIndex {
+	std::vector<ldiPointIndexNode>		nodes;
+	std::vector<ldiPointIndexEntry>		entries;
+	// Depth of the leaf level, the root is at zero.
+	int									depth;
+	int									firstLeaf;
+};
+
+void pointIndexDestroy(ldiPointIndex* Index) {
+	Index->nodes.clear();
+	Index->nodes.shrink_to_fit();
+	Index->entries.clear();
+	Index->entries.shrink_to_fit();
+	Index->depth = 0;
+	Index->firstLeaf = 0;
+}
+
+//----------------------------------------------------------------------------------------------------
+// Build.
+//----------------------------------------------------------------------------------------------------
+struct _ldiPointIndexEntryCompare {
+	int									axis;
+
+	bool operator()(const ldiPointIndexEntry& A, const ldiPointIndexEntry& B) const {
+		if (A.position[axis] != B.position[axis]) {
+			return A.position[axis] < B.position[axis];
+		}
+
+		return A.id < B.id;
+	}
+};
+
+struct _ldiPointIndexBuildContext {
+	ldiPointIndex*						index;
+	// First node of the level being built.
+	int									levelStart;
+};
+
+void _pointIndexBuildLevelBatch(int StartIdx, int EndIdx, void* UserData) {
+	_ldiPointIndexBuildContext* context = (_ldiPointIndexBuildContext*)UserData;
+	ldiPointIndex* index = context->index;
+
+	for (int i = StartIdx; i < EndIdx; ++i) {
+		int nodeId = context->levelStart + i;
+		ldiPointIndexNode* node = &index->nodes[nodeId];
+		ldiPointIndexEntry* entries = index->entries.data() + node->start;
+
+		vec3 boundsMin(FLT_MAX, FLT_MAX, FLT_MAX);
+		vec3 boundsMax(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+
+		for (int e = 0; e < node->count; ++e) {
+			vec3 p = entries[e].position;
+			boundsMin.x = min(boundsMin.x, p.x);
+			boundsMin.y = min(boundsMin.y, p.y);
+			boundsMin.z = min(boundsMin.z, p.z);
+			boundsMax.x = max(boundsMax.x, p.x);
+			boundsMax.y = max(boundsMax.y, p.y);
+			boundsMax.z = max(boundsMax.z, p.z);
+		}
+
+		node->min = boundsMin;
+		node->max = boundsMax;
+
+		if (nodeId >= index->firstLeaf) {
+			continue;
+		}
+
+		vec3 extent = boundsMax - boundsMin;
+		int axis = 0;
+
+		if (extent.y > extent[axis]) {
+			axis = 1;
+		}
+
+		if (extent.z > extent[axis]) {
+			axis = 2;
+		}
+
+		int leftCount = node->count / 2;
+		std::nth_element(entries, entries + leftCount, entries + node->count, _ldiPointIndexEntryCompare{ axis });
+
+		ldiPointIndexNode* left = &index->nodes[nodeId * 2 + 1];
+		ldiPointIndexNode* right = &index->nodes[nodeId * 2 + 2];
+
+		left->start = node->start;
+		left->count = leftCount;
+		right->start = node->start + leftCount;
+		right->count = node->count - leftCount;
+	}
+}
+
+void pointIndexBuild(ldiPointIndex* Index, const vec3* Positions, int Count) {
+	PROFILE_ZONE_LOG("Build point index");
+	PROFILE_ITEMS(Count);
+
+	pointIndexDestroy(Index);
+
+	if (Count <= 0) {
+		return;
+	}
+
+	Index->entries.resize(Count);
+
+	for (int i = 0; i < Count; ++i) {
+		Index->entries[i].position = Positions[i];
+		Index->entries[i].id = i;
+	}
+
+	// NOTE: Halving leaves ceil(Count / 2^depth) points in the largest leaf.
+	int depth = 0;
+	while (((int64_t)Count + ((int64_t)1 << depth) - 1) >> depth > POINT_INDEX_LEAF_SIZE) {
+		++depth;
+	}
+
+	Index->depth = depth;
+	Index->firstLeaf = (1 << depth) - 1;
+	Index->nodes.resize(((size_t)1 << (depth + 1)) - 1);
+	Index->nodes[0].start = 0;
+	Index->nodes[0].count = Count;
+
+	_ldiPointIndexBuildContext context = {};
+	context.index = Index;
+
+	for (int level = 0; level <= depth; ++level) {
+		context.levelStart = (1 << level) - 1;
+		parallelFor(0, 1 << level, 1, _pointIndexBuildLevelBatch, &context);
+	}
+}
+
+//----------------------------------------------------------------------------------------------------
+// Queries.
+//----------------------------------------------------------------------------------------------------
+inline float _pointIndexBoundsDistSq(const ldiPointIndexNode* Node, vec3 P) {
+	float dx = max(max(Node->min.x - P.x, P.x - Node->max.x), 0.0f);
+	float dy = max(max(Node->min.y - P.y, P.y - Node->max.y), 0.0f);
+	float dz = max(max(Node->min.z - P.z, P.z - Node->max.z), 0.0f);
+
+	return dx * dx + dy * dy + dz * dz;
+}
+
+struct _ldiPointIndexStackEntry {
+	int									nodeId;
+	float								distSq;
+};
+
+// Finds up to K neighbors of Position within MaxDist, nearest first. Returns how many were found, the rest of
+// OutIds is filled with -1 and OutDistSq with FLT_MAX. A point in the index at Position is its own neighbor.
+int pointIndexQueryKnn(ldiPointIndex* Index, vec3 Position, int K, float MaxDist, int* OutIds, float* OutDistSq) {
+	for (int i = 0; i < K; ++i) {
+		OutIds[i] = -1;
+		OutDistSq[i] = FLT_MAX;
+	}
+
+	if (Index->nodes.empty() || K <= 0) {
+		return 0;
+	}
+
+	float maxDistSq = (MaxDist == FLT_MAX) ? FLT_MAX : MaxDist * MaxDist;
+	int found = 0;
+
+	// NOTE: Bounds distance is kept with each stack entry so nodes aren't measured twice.
+	_ldiPointIndexStackEntry stack[POINT_INDEX_STACK_SIZE];
+	int stackSize = 0;
+	stack[stackSize++] = { 0, _pointIndexBoundsDistSq(&Index->nodes[0], Position) };
+
+	while (stackSize > 0) {
+		_ldiPointIndexStackEntry entry = stack[--stackSize];
+		int nodeId = entry.nodeId;
+		const ldiPointIndexNode* node = &Index->nodes[nodeId];
+		float limit = (found == K) ? OutDistSq[K - 1] : maxDistSq;
+
+		if (entry.distSq > limit) {
+			continue;
+		}
+
+		if (nodeId >= Index->firstLeaf) {
+			const ldiPointIndexEntry* entries = Index->entries.data() + node->start;
+
+			for (int e = 0; e < node->count; ++e) {
+				vec3 delta = entries[e].position - Position;
+				float distSq = glm::dot(delta, delta);
+				int id = entries[e].id;
+
+				if (found == K) {
+					if (distSq > OutDistSq[K - 1] || (distSq == OutDistSq[K - 1] && id > OutIds[K - 1])) {
+						continue;
+					}
+				} else if (distSq > maxDistSq) {
+					continue;
+				} else {
+					++found;
+				}
+
+				// NOTE: Insertion into the sorted list, the last slot is either free or being dropped.
+				int slot = found - 1;
+				while (slot > 0 && (OutDistSq[slot - 1] > distSq || (OutDistSq[slot - 1] == distSq && OutIds[slot - 1] > id))) {
+					OutDistSq[slot] = OutDistSq[slot - 1];
+					OutIds[slot] = OutIds[slot - 1];
+					--slot;
+				}
+
+				OutDistSq[slot] = distSq;
+				OutIds[slot] = id;
+			}
+		} else {
+			int leftId = nodeId * 2 + 1;
+			int rightId = nodeId * 2 + 2;
+			float leftDistSq = _pointIndexBoundsDistSq(&Index->nodes[leftId], Position);
+			float rightDistSq = _pointIndexBoundsDistSq(&Index->nodes[rightId], Position);
+
+			// NOTE: Nearer child goes on top of the stack.
+			if (leftDistSq <= rightDistSq) {
+				if (rightDistSq <= limit) {
+					stack[stackSize++] = { rightId, rightDistSq };
+				}
+
+				if (leftDistSq <= limit) {
+					stack[stackSize++] = { leftId, leftDistSq };
+				}
+			} else {
+				if (leftDistSq <= limit) {
+					stack[stackSize++] = { leftId, leftDistSq };
+				}
+
+				if (rightDistSq <= limit) {
+					stack[stackSize++] = { rightId, rightDistSq };
+				}
+			}
+		}
+	}
+
+	return found;
+}
+
+// Counts the points within Radius of Position, and writes their ids to OutIds when it isn't null.
+int _pointIndexQueryRadius(ldiPointIndex* Index, vec3 Position, float RadiusSq, int* OutIds) {
+	if (Index->nodes.empty()) {
+		return 0;
+	}
+
+	int found = 0;
+
+	int stack[POINT_INDEX_STACK_SIZE];
+	int stackSize = 0;
+	stack[stackSize++] = 0;
+
+	while (stackSize > 0) {
+		int nodeId = stack[--stackSize];
+		const ldiPointIndexNode* node = &Index->nodes[nodeId];
+
+		if (_pointIndexBoundsDistSq(node, Position) > RadiusSq) {
+			continue;
+		}
+
+		if (nodeId >= Index->firstLeaf) {
+			const ldiPointIndexEntry* entries = Index->entries.data() + node->start;
+
+			for (int e = 0; e < node->count; ++e) {
+				vec3 delta = entries[e].position - Position;
+
+				if (glm::dot(delta, delta) <= RadiusSq) {
+					if (OutIds) {
+						OutIds[found] = entries[e].id;
+					}
+
+					++found;
+				}
+			}
+		} else {
+			stack[stackSize++] = nodeId * 2 + 2;
+			stack[stackSize++] = nodeId * 2 + 1;
+		}
+	}
+
+	return found;
+}
+
+// Appends the ids of all points within Radius of Position, in no particular order. Returns how many were added.
+int pointIndexQueryRadius(ldiPointIndex* Index, vec3 Position, float Radius, std::vector<int>* Ids) {
+	float radiusSq = Radius * Radius;
+	int count = _pointIndexQueryRadius(Index, Position, radiusSq, nullptr);
+
+	size_t offset = Ids->size();
+	Ids->resize(offset + count);
+	_pointIndexQueryRadius(Index, Position, radiusSq, Ids->data() + offset);
+
+	return count;
+}
+
+//----------------------------------------------------------------------------------------------------
+// Batched queries.
+//----------------------------------------------------------------------------------------------------
+struct _ldiPointIndexBatchContext {
+	ldiPointIndex*						index;
+	const vec3*							positions;
+	int									k;
+	float								maxDist;
+	float								radiusSq;
+	int*								outIds;
+	float*								outDistSq;
+	int*								outCounts;
+	const int*							offsets;
+};
+
+void _pointIndexKnnBatch(int StartIdx, int EndIdx, void* UserData) {
+	_ldiPointIndexBatchContext* context = (_ldiPointIndexBatchContext*)UserData;
+	float localDistSq[POINT_INDEX_MAX_K];
+
+	for (int i = StartIdx; i < EndIdx; ++i) {
+		int* ids = context->outIds + (size_t)i * context->k;
+		float* distSq = context->outDistSq ? context->outDistSq + (size_t)i * context->k : localDistSq;
+
+		int found = pointIndexQueryKnn(context->index, context->positions[i], context->k, context->maxDist, ids, distSq);
+
+		if (context->outCounts) {
+			context->outCounts[i] = found;
+		}
+	}
+}
+
+void _pointIndexRadiusCountBatch(int StartIdx, int EndIdx, void* UserData) {
+	_ldiPointIndexBatchContext* context = (_ldiPointIndexBatchContext*)UserData;
+
+	for (int i = StartIdx; i < EndIdx; ++i) {
+		context->outCounts[i] = _pointIndexQueryRadius(context->index, context->positions[i], context->radiusSq, nullptr);
+	}
+}
+
+void _pointIndexRadiusFillBatch(int StartIdx, int EndIdx, void* UserData) {
+	_ldiPointIndexBatchContext* context = (_ldiPointIndexBatchContext*)UserData;
+
+	for (int i = StartIdx; i < EndIdx; ++i) {
+		_pointIndexQueryRadius(context->index, context->positions[i], context->radiusSq, context->outIds + context->offsets[i]);
+	}
+}
+
+// K neighbors for each of Count positions. Results for position I start at I * K, laid out as in
+// pointIndexQueryKnn. OutDistSq and OutCounts can be null. K is at most POINT_INDEX_MAX_K.
+void pointIndexQueryKnnBatch(ldiPointIndex* Index, const vec3* Positions, int Count, int K, float MaxDist, int* OutIds, float* OutDistSq, int* OutCounts) {
+	PROFILE_ZONE_LOG("Point index knn batch");
+	PROFILE_ITEMS(Count);
+
+	assert(K > 0 && K <= POINT_INDEX_MAX_K);
+
+	_ldiPointIndexBatchContext context = {};
+	context.index = Index;
+	context.positions = Positions;
+	context.k = K;
+	context.maxDist = MaxDist;
+	context.outIds = OutIds;
+	context.outDistSq = OutDistSq;
+	context.outCounts = OutCounts;
+
+	parallelFor(0, Count, 256, _pointIndexKnnBatch, &context);
+}
+
+// Neighbors within Radius for each of Count positions, packed. The ids for position I are
+// Ids[Offsets[I]] to Ids[Offsets[I + 1]], so Offsets ends up with Count + 1 entries.
+// NOTE: Runs every query twice, once to count and once to fill, which keeps the output packed and in
+// position order without any per thread buffers.
+void pointIndexQueryRadiusBatch(ldiPointIndex* Index, const vec3* Positions, int Count, float Radius, std::vector<int>* Offsets, std::vector<int>* Ids) {
+	PROFILE_ZONE_LOG("Point index radius batch");
+	PROFILE_ITEMS(Count);
+
+	Offsets->resize(Count + 1);
+
+	_ldiPointIndexBatchContext context = {};
+	context.index = Index;
+	context.positions = Positions;
+	context.radiusSq = Radius * Radius;
+	context.outCounts = Offsets->data();
+
+	parallelFor(0, Count, 256, _pointIndexRadiusCountBatch, &context);
+
+	int total = 0;
+
+	for (int i = 0; i < Count; ++i) {
+		int count = (*Offsets)[i];
+		(*Offsets)[i] = total;
+		total += count;
+	}
+
+	(*Offsets)[Count] = total;
+	Ids->resize(total);
+
+	context.outIds = Ids->data();
+	context.offsets = Offsets->data();
+
+	parallelFor(0, Count, 256, _pointIndexRadiusFillBatch, &context);
+}
\ No newline at end of file
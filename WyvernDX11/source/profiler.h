@@ -0,0 +1,428 @@
+#pragma once
+
+#include <float.h>
+#include <mutex>
+#include <atomic>
+#include <unordered_map>
+
+//----------------------------------------------------------------------------------------------------
+// Scoped zone profiler.
+//----------------------------------------------------------------------------------------------------
+// Usage:
+//   PROFILE_ZONE("Surfel grouping");			Timed zone until end of scope.
+//   PROFILE_ZONE_LOG("Transfer");				Same, also prints "Transfer: x ms" when the zone ends.
+//   PROFILE_ITEMS(count); PROFILE_BYTES(size);	Attach counts to the innermost zone on this thread.
+//   PROFILE_COUNTER("Queue depth", value);		Standalone counter sample.
+//   PROFILE_THREAD_NAME("Transfer worker");
+//
+// Every thread records into its own buffer, so zones on worker threads never contend with each other.
+// Buffers can be exported as a Chrome trace (chrome://tracing, ui.perfetto.dev) or summarized to the console.
+//
+// NOTE: Compiled out of release builds unless the build defines LDI_PROFILER=1. With the profiler
+// compiled out, PROFILE_ZONE_LOG still prints its elapsed time so console timings are unchanged.
+
+#ifndef LDI_PROFILER
+	#ifdef NDEBUG
+		#define LDI_PROFILER 0
+	#else
+		#define LDI_PROFILER 1
+	#endif
+#endif
+
+#define _PROFILE_CONCAT_INNER(A, B) A##B
+#define _PROFILE_CONCAT(A, B) _PROFILE_CONCAT_INNER(A, B)
+
+// Always available: prints elapsed time for a scope.
+struct ldiScopedLogTimer {
+	const char*	name;
+	double		startTime;
+
+	ldiScopedLogTimer(const char* Name) {
+		name = Name;
+		startTime = getTime();
+	}
+
+	~ldiScopedLogTimer() {
+		double t0 = getTime() - startTime;
+		std::cout << name << ": " << (t0 * 1000.0) << " ms\n";
+	}
+};
+
+#if LDI_PROFILER
+
+enum ldiProfilerEventType {
+	PET_ZONE,
+	PET_COUNTER,
+};
+
+struct ldiProfilerEvent {
+	const char*	name;
+	int			type;
+	int			depth;
+	double		startTime;
+	double		endTime;
+	double		value;
+	int64_t		items;
+	int64_t		bytes;
+};
+
+struct ldiProfilerZone;
+
+struct ldiProfilerThread {
+	int								id;
+	std::string						name;
+	// NOTE: Only contended while exporting. The owning thread is the sole writer.
+	std::mutex						eventsMutex;
+	std::vector<ldiProfilerEvent>	events;
+	ldiProfilerZone*				currentZone = 0;
+	int								depth = 0;
+	std::atomic_bool				retired = false;
+};
+
+struct ldiProfiler {
+	std::mutex						threadsMutex;
+	std::vector<ldiProfilerThread*>	threads;
+	int								nextThreadId = 1;
+	std::atomic_bool				enabled = true;
+};
+
+ldiProfiler _profiler;
+
+// NOTE: Marks the thread buffer as retired when the owning thread exits. Retired buffers keep their
+// events until the next profilerReset.
+struct ldiProfilerThreadHandle {
+	ldiProfilerThread* thread = 0;
+
+	~ldiProfilerThreadHandle() {
+		if (thread) {
+			thread->retired = true;
+		}
+	}
+};
+
+thread_local ldiProfilerThreadHandle _profilerThreadHandle;
+
+ldiProfilerThread* _profilerGetThread() {
+	ldiProfilerThread* thread = _profilerThreadHandle.thread;
+
+	if (thread) {
+		return thread;
+	}
+
+	thread = new ldiProfilerThread();
+	thread->events.reserve(1024);
+
+	{
+		std::unique_lock<std::mutex> lock(_profiler.threadsMutex);
+		thread->id = _profiler.nextThreadId++;
+		thread->name = "Thread " + std::to_string(thread->id);
+		_profiler.threads.push_back(thread);
+	}
+
+	_profilerThreadHandle.thread = thread;
+
+	return thread;
+}
+
+void _profilerPushEvent(ldiProfilerThread* Thread, const ldiProfilerEvent& Event) {
+	std::unique_lock<std::mutex> lock(Thread->eventsMutex);
+	Thread->events.push_back(Event);
+}
+
+struct ldiProfilerZone {
+	const char*			name;
+	double				startTime;
+	int64_t				items = 0;
+	int64_t				bytes = 0;
+	bool				log;
+	bool				active;
+	ldiProfilerThread*	thread;
+	ldiProfilerZone*	parent;
+
+	ldiProfilerZone(const char* Name, bool Log = false) {
+		name = Name;
+		log = Log;
+		active = _profiler.enabled;
+		thread = 0;
+		parent = 0;
+
+		if (active) {
+			thread = _profilerGetThread();
+			parent = thread->currentZone;
+			thread->currentZone = this;
+			thread->depth++;
+		}
+
+		startTime = getTime();
+	}
+
+	~ldiProfilerZone() {
+		double endTime = getTime();
+
+		if (log) {
+			std::cout << name << ": " << ((endTime - startTime) * 1000.0) << " ms\n";
+		}
+
+		if (!active) {
+			return;
+		}
+
+		thread->depth--;
+		thread->currentZone = parent;
+
+		ldiProfilerEvent event;
+		event.name = name;
+		event.type = PET_ZONE;
+		event.depth = thread->depth;
+		event.startTime = startTime;
+		event.endTime = endTime;
+		event.value = 0.0;
+		event.items = items;
+		event.bytes = bytes;
+		_profilerPushEvent(thread, event);
+	}
+};
+
+void profilerSetEnabled(bool Enabled) {
+	_profiler.enabled = Enabled;
+}
+
+void profilerSetThreadName(const char* Name) {
+	ldiProfilerThread* thread = _profilerGetThread();
+	std::unique_lock<std::mutex> lock(thread->eventsMutex);
+	thread->name = Name;
+}
+
+void profilerAddItems(int64_t Count) {
+	ldiProfilerZone* zone = _profilerThreadHandle.thread ? _profilerThreadHandle.thread->currentZone : 0;
+
+	if (zone) {
+		zone->items += Count;
+	}
+}
+
+void profilerAddBytes(int64_t Count) {
+	ldiProfilerZone* zone = _profilerThreadHandle.thread ? _profilerThreadHandle.thread->currentZone : 0;
+
+	if (zone) {
+		zone->bytes += Count;
+	}
+}
+
+void profilerCounter(const char* Name, double Value) {
+	if (!_profiler.enabled) {
+		return;
+	}
+
+	ldiProfilerThread* thread = _profilerGetThread();
+
+	ldiProfilerEvent event;
+	event.name = Name;
+	event.type = PET_COUNTER;
+	event.depth = thread->depth;
+	event.startTime = getTime();
+	event.endTime = event.startTime;
+	event.value = Value;
+	event.items = 0;
+	event.bytes = 0;
+	_profilerPushEvent(thread, event);
+}
+
+// Clears all recorded events and frees buffers of threads that have exited.
+void profilerReset() {
+	std::unique_lock<std::mutex> lock(_profiler.threadsMutex);
+
+	for (size_t i = 0; i < _profiler.threads.size(); ++i) {
+		ldiProfilerThread* thread = _profiler.threads[i];
+
+		if (thread->retired) {
+			delete thread;
+			_profiler.threads[i] = _profiler.threads.back();
+			_profiler.threads.pop_back();
+			--i;
+			continue;
+		}
+
+		std::unique_lock<std::mutex> eventsLock(thread->eventsMutex);
+		thread->events.clear();
+	}
+}
+
+void _profilerWriteJsonString(FILE* File, const char* Str) {
+	fputc('"', File);
+
+	for (const char* c = Str; *c; ++c) {
+		if (*c == '"' || *c == '\\') {
+			fputc('\\', File);
+			fputc(*c, File);
+		} else if ((uint8_t)*c < 0x20) {
+			fprintf(File, "\\u%04x", (int)*c);
+		} else {
+			fputc(*c, File);
+		}
+	}
+
+	fputc('"', File);
+}
+
+// Writes all recorded events in the Chrome trace event format.
+bool profilerExportChromeTrace(const std::string& Path) {
+	FILE* f;
+	if (fopen_s(&f, Path.c_str(), "wb") != 0 || f == 0) {
+		std::cout << "Could not open trace file: " << Path << "\n";
+		return false;
+	}
+
+	int eventCount = 0;
+
+	fprintf(f, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+
+	std::unique_lock<std::mutex> lock(_profiler.threadsMutex);
+
+	for (size_t t = 0; t < _profiler.threads.size(); ++t) {
+		ldiProfilerThread* thread = _profiler.threads[t];
+		std::unique_lock<std::mutex> eventsLock(thread->eventsMutex);
+
+		fprintf(f, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":", (eventCount++ > 0) ? ",\n" : "", thread->id);
+		_profilerWriteJsonString(f, thread->name.c_str());
+		fprintf(f, "}}");
+
+		for (size_t i = 0; i < thread->events.size(); ++i) {
+			ldiProfilerEvent* e = &thread->events[i];
+
+			fprintf(f, ",\n{\"name\":");
+			_profilerWriteJsonString(f, e->name);
+
+			if (e->type == PET_ZONE) {
+				fprintf(f, ",\"cat\":\"zone\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f", thread->id, e->startTime * 1000000.0, (e->endTime - e->startTime) * 1000000.0);
+
+				if (e->items || e->bytes) {
+					fprintf(f, ",\"args\":{\"items\":%lld,\"bytes\":%lld}", e->items, e->bytes);
+				}
+
+				fprintf(f, "}");
+			} else {
+				fprintf(f, ",\"ph\":\"C\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"args\":{\"value\":%f}}", thread->id, e->startTime * 1000000.0, e->value);
+			}
+
+			++eventCount;
+		}
+	}
+
+	fprintf(f, "\n]}\n");
+	fclose(f);
+
+	std::cout << "Exported " << eventCount << " trace events to " << Path << "\n";
+
+	return true;
+}
+
+// Prints per zone aggregates: calls, distinct threads, total/min/max time and throughput.
+void profilerPrintSummary() {
+	struct ldiZoneStats {
+		const char*	name;
+		int			calls = 0;
+		int			threads = 0;
+		int			lastThreadId = -1;
+		double		total = 0.0;
+		double		minTime = DBL_MAX;
+		double		maxTime = 0.0;
+		double		firstStart = DBL_MAX;
+		double		lastEnd = 0.0;
+		int64_t		items = 0;
+		int64_t		bytes = 0;
+	};
+
+	std::vector<ldiZoneStats> stats;
+	std::unordered_map<std::string, int> statsMap;
+
+	{
+		std::unique_lock<std::mutex> lock(_profiler.threadsMutex);
+
+		for (size_t t = 0; t < _profiler.threads.size(); ++t) {
+			ldiProfilerThread* thread = _profiler.threads[t];
+			std::unique_lock<std::mutex> eventsLock(thread->eventsMutex);
+
+			for (size_t i = 0; i < thread->events.size(); ++i) {
+				ldiProfilerEvent* e = &thread->events[i];
+
+				if (e->type != PET_ZONE) {
+					continue;
+				}
+
+				auto entry = statsMap.find(e->name);
+				int statsIdx;
+
+				if (entry == statsMap.end()) {
+					statsIdx = (int)stats.size();
+					statsMap[e->name] = statsIdx;
+					stats.push_back({});
+					stats[statsIdx].name = e->name;
+				} else {
+					statsIdx = entry->second;
+				}
+
+				ldiZoneStats* s = &stats[statsIdx];
+				double duration = e->endTime - e->startTime;
+
+				s->calls++;
+				s->total += duration;
+				s->minTime = min(s->minTime, duration);
+				s->maxTime = max(s->maxTime, duration);
+				s->firstStart = min(s->firstStart, e->startTime);
+				s->lastEnd = max(s->lastEnd, e->endTime);
+				s->items += e->items;
+				s->bytes += e->bytes;
+
+				if (s->lastThreadId != thread->id) {
+					s->lastThreadId = thread->id;
+					s->threads++;
+				}
+			}
+		}
+	}
+
+	std::cout << "Profiler summary:\n";
+
+	for (size_t i = 0; i < stats.size(); ++i) {
+		ldiZoneStats* s = &stats[i];
+		// NOTE: Wall time spans first start to last end, so total / wall shows effective parallelism.
+		double wall = s->lastEnd - s->firstStart;
+
+		std::cout << "  " << s->name << ": calls " << s->calls << " threads " << s->threads;
+		std::cout << " total " << (s->total * 1000.0) << " ms";
+		std::cout << " min " << (s->minTime * 1000.0) << " ms max " << (s->maxTime * 1000.0) << " ms";
+
+		if (s->threads > 1 && wall > 0.0) {
+			std::cout << " parallelism " << (s->total / wall);
+		}
+
+		if (s->items && s->total > 0.0) {
+			std::cout << " items " << s->items << " (" << (s->items / s->total) << "/s)";
+		}
+
+		if (s->bytes && s->total > 0.0) {
+			std::cout << " bytes " << s->bytes << " (" << (s->bytes / s->total / (1024.0 * 1024.0)) << " MB/s)";
+		}
+
+		std::cout << "\n";
+	}
+}
+
+#define PROFILE_ZONE(Name) ldiProfilerZone _PROFILE_CONCAT(_profileZone, __LINE__)(Name)
+#define PROFILE_ZONE_LOG(Name) ldiProfilerZone _PROFILE_CONCAT(_profileZone, __LINE__)(Name, true)
+#define PROFILE_ITEMS(Count) profilerAddItems((int64_t)(Count))
+#define PROFILE_BYTES(Count) profilerAddBytes((int64_t)(Count))
+#define PROFILE_COUNTER(Name, Value) profilerCounter(Name, (double)(Value))
+#define PROFILE_THREAD_NAME(Name) profilerSetThreadName(Name)
+
+#else
+
+#define PROFILE_ZONE(Name)
+#define PROFILE_ZONE_LOG(Name) ldiScopedLogTimer _PROFILE_CONCAT(_profileZone, __LINE__)(Name)
+#define PROFILE_ITEMS(Count)
+#define PROFILE_BYTES(Count)
+#define PROFILE_COUNTER(Name, Value)
+#define PROFILE_THREAD_NAME(Name)
+
+#endif
\ No newline at end of file
@@ -2,6 +2,10 @@
 
 #include "lcms2.h"
 
+// NOTE: Width of the samples preview texture, its height follows the surfel count.
+#define PROJECT_SAMPLES_IMAGE_WIDTH 4096
+#define PROJECT_SAMPLES_PER_SIDE 4
+
 struct ldiProjectContext {
 	std::string					path;
 
@@ -21,6 +25,8 @@ struct ldiProjectContext {
 	ID3D11Texture2D*			sourceTexture;
 	ID3D11ShaderResourceView*	sourceTextureSrv;
 	ldiImage					sourceTextureCmyk;
+	// NOTE: Converts through the color LUT instead of the exact transform, not saved with the project.
+	bool						sourceTextureUseLut = false;
 	ldiImage					sourceTextureCmykChannels[4];
 	ID3D11Texture2D*			sourceTextureCmykTexture[4];
 	ID3D11ShaderResourceView*	sourceTextureCmykSrv[4];
@@ -40,12 +46,17 @@ struct ldiProjectContext {
 	ldiRenderModel				surfelsRenderModel;
 	ldiRenderModel				surfelsGroupRenderModel;
 	ldiRenderModel				surfelsCoverageViewRenderModel;
-	ldiImage					surfelsSamplesRaw;
+	ldiSampleAtlas				surfelsSamples = {};
 	ID3D11Texture2D*			surfelsSamplesTexture;
 	ID3D11ShaderResourceView*	surfelsSamplesTextureSrv;
 	vec3						surfelsBoundsMin;
 	vec3						surfelsBoundsMax;
 	ldiSpatialGrid				surfelsSpatialGrid = {};
+	ldiPointIndex				surfelsPointIndex = {};
+	std::vector<vec3>			surfelsSmoothedNormals;
+	ldiSurfelVis				surfelsVis = {};
+	// NOTE: Refines color transfer only where a surfel needs it, not saved with the project.
+	bool						surfelsAdaptiveTransfer = false;
 
 	//bool						poissonSamplesLoaded = false;
 	//ldiPoissonSpatialGrid		poissonSpatialGrid = {};
@@ -80,6 +91,9 @@ struct ldiProjectContext {
 	ID3D11Buffer*				coverageStagingBuffer;
 
 	int							coverageSurfelCount;
+
+	// NOTE: Shared by every project, entries are keyed by content so they can't go stale.
+	ldiStageCache				stageCache = { "../cache/stages" };
 };
 
 mat4 projectGetSourceTransformMat(ldiProjectContext* Project) {
@@ -92,6 +106,62 @@ mat4 projectGetSourceTransformMat(ldiProjectContext* Project) {
 	return result;
 }
 
+//----------------------------------------------------------------------------------------------------
+// Stage keys.
+//----------------------------------------------------------------------------------------------------
+// NOTE: A key covers everything its stage reads, and nothing else. Bump a stage version when its output
+// format or any hardcoded parameter changes.
+#define PROJECT_SRC_PROFILE_PATH "../../assets/profiles/sRGB_v4_ICC_preference.icc"
+#define PROJECT_DST_PROFILE_PATH "../../assets/profiles/USWebCoatedSWOP.icc"
+
+uint64_t _projectHashModel(uint64_t Key, ldiModel* Model) {
+	Key = hashFnv1aVector(Key, Model->verts);
+
+	return hashFnv1aVector(Key, Model->indices);
+}
+
+uint64_t _projectHashQuadModel(uint64_t Key, ldiQuadModel* Model) {
+	Key = hashFnv1aVector(Key, Model->verts);
+
+	return hashFnv1aVector(Key, Model->indices);
+}
+
+uint64_t _projectHashImage(uint64_t Key, ldiImage* Image, int Channels) {
+	int size[3] = { Image->width, Image->height, Channels };
+	Key = hashFnv1a(Key, size, sizeof(size));
+
+	return hashFnv1a(Key, Image->data, (size_t)Image->width * Image->height * Channels);
+}
+
+// Texture import: the image file, both color profiles, the rendering intent and the LUT mode.
+bool projectGetSourceTextureKey(ldiProjectContext* Project, const char* Path, uint64_t* Key) {
+	PROFILE_ZONE("Source texture key");
+
+	int settings[2] = { INTENT_PERCEPTUAL, Project->sourceTextureUseLut };
+	uint64_t key = stageCacheKeyInit("sourceTexture", 1);
+	key = hashFnv1a(key, settings, sizeof(settings));
+
+	if (!hashFnv1aFile(&key, Path) || !hashFnv1aFile(&key, PROJECT_SRC_PROFILE_PATH) || !hashFnv1aFile(&key, PROJECT_DST_PROFILE_PATH)) {
+		return false;
+	}
+
+	*Key = key;
+
+	return true;
+}
+
+// Quad model: the source geometry and its placement. The voxel and quad mesher settings are part of the version.
+uint64_t projectGetQuadModelKey(ldiProjectContext* Project) {
+	PROFILE_ZONE("Quad model key");
+
+	mat4 worldMat = projectGetSourceTransformMat(Project);
+
+	uint64_t key = stageCacheKeyInit("quadModel", 1);
+	key = hashFnv1a(key, &worldMat, sizeof(mat4));
+
+	return _projectHashModel(key, &Project->sourceModel);
+}
+
 void projectInvalidateSourceModelData(ldiApp* AppContext, ldiProjectContext* Project) {
 	if (Project->sourceModelLoaded) {
 		Project->sourceModelLoaded = false;
@@ -140,10 +210,18 @@ void projectInvalidateSurfelData(ldiApp* AppContext, ldiProjectContext* Project)
 		physicsDestroyCookedMesh(AppContext->physics, &Project->sourceCookedModel);
 		Project->surfelsRenderModel.indexBuffer->Release();
 		Project->surfelsRenderModel.vertexBuffer->Release();
-		delete[] Project->surfelsSamplesRaw.data;
-		Project->surfelsSamplesTexture->Release();
-		Project->surfelsSamplesTextureSrv->Release();
+		sampleAtlasDestroy(&Project->surfelsSamples);
+
+		if (Project->surfelsSamplesTexture) {
+			Project->surfelsSamplesTexture->Release();
+			Project->surfelsSamplesTextureSrv->Release();
+			Project->surfelsSamplesTexture = nullptr;
+			Project->surfelsSamplesTextureSrv = nullptr;
+		}
 		spatialGridDestroy(&Project->surfelsSpatialGrid);
+		pointIndexDestroy(&Project->surfelsPointIndex);
+		Project->surfelsSmoothedNormals.clear();
+		surfelVisDestroy(&Project->surfelsVis);
 	}
 }
 
@@ -177,43 +255,15 @@ bool projectImportModel(ldiApp* AppContext, ldiProjectContext* Project, const st
 
 	Project->sourceModel = objLoadModel(sourceModelFile, sourceModelFileSize);
 
+	// NOTE: Loader order is arbitrary, spatial order makes every later pass over the mesh cache friendly.
+	meshReorderModel(&Project->sourceModel, SC_HILBERT, nullptr);
+
 	return projectFinalizeImportedModel(AppContext, Project);
 }
 
 bool projectFinalizeImportedTexture(ldiApp* AppContext, ldiProjectContext* Project) {
-	vec3 cmykColor[4] = {
-		vec3(0, 166.0 / 255.0, 214.0 / 255.0),
-		vec3(1.0f, 0, 144.0 / 255.0),
-		vec3(245.0 / 255.0, 230.0 / 255.0, 23.0 / 255.0),
-		vec3(0.0f, 0.0f, 0.0f)
-	};
-
-	// NOTE: Converted to sRGB for viewing purposes.
-	for (int channelIter = 0; channelIter < 4; ++channelIter) {
-		ldiImage* image = &Project->sourceTextureCmykChannels[channelIter];
-
-		image->width = Project->sourceTextureCmyk.width;
-		image->height = Project->sourceTextureCmyk.height;
-		image->data = new uint8_t[image->width * image->height * 4];
-
-		for (int i = 0; i < image->width * image->height; ++i) {
-			float v = ((float)Project->sourceTextureCmyk.data[i * 4 + channelIter]) / 255.0f;
-			//float vi = LinearToGamma(v) * 255.0f;
-			float vi = LinearToGamma(v);
-
-			vec3 col = glm::mix(vec3(1, 1, 1), cmykColor[channelIter], vi);
-
-			image->data[i * 4 + 0] = (uint8_t)(col.r * 255);
-			image->data[i * 4 + 1] = (uint8_t)(col.g * 255);
-			image->data[i * 4 + 2] = (uint8_t)(col.b * 255);
+	PROFILE_ZONE("Finalize imported texture");
 
-			//image->data[i * 4 + 0] = cmykImagePixels[i * 4 + channelIter];
-			//image->data[i * 4 + 1] = cmykImagePixels[i * 4 + channelIter];
-			//image->data[i * 4 + 2] = cmykImagePixels[i * 4 + channelIter];
-			image->data[i * 4 + 3] = 255;
-		}
-	}
-	
 	if (!gfxCreateTextureR8G8B8A8Basic(AppContext, &Project->sourceTextureRaw, &Project->sourceTexture, &Project->sourceTextureSrv)) {
 		return false;
 	}
@@ -236,55 +286,79 @@ bool projectImportTexture(ldiApp* AppContext, ldiProjectContext* Project, const
 
 	std::cout << "Project source texture path: " << Path << "\n";
 
-	double t0 = getTime();
+	PROFILE_ZONE("Import texture");
+
+	uint64_t stageKey = 0;
+	bool stageKeyValid = projectGetSourceTextureKey(Project, Path, &stageKey);
+
+	if (stageKeyValid) {
+		FILE* file = stageCacheOpenRead(&Project->stageCache, "sourceTexture", stageKey);
+
+		if (file) {
+			PROFILE_ZONE_LOG("Load cached texture");
+			deserialize(file, &Project->sourceTextureRaw, 4);
+			deserialize(file, &Project->sourceTextureCmyk, 4);
+			fclose(file);
+			colorCreateCmykPreviews(&Project->sourceTextureCmyk, Project->sourceTextureCmykChannels);
+
+			return projectFinalizeImportedTexture(AppContext, Project);
+		}
+	}
 
 	int x, y, n;
-	uint8_t* imageRawPixels = imageLoadRgba(Path, &x, &y, &n);
+	uint8_t* imageRawPixels;
+	{
+		PROFILE_ZONE_LOG("Load texture");
+		imageRawPixels = imageLoadRgba(Path, &x, &y, &n);
+		PROFILE_BYTES((int64_t)x * y * 4);
+	}
 
 	Project->sourceTextureRaw.width = x;
 	Project->sourceTextureRaw.height = y;
 	Project->sourceTextureRaw.data = imageRawPixels;
 
-	t0 = getTime() - t0;
-	std::cout << "Load texture: " << x << ", " << y << " (" << n << ") " << t0 * 1000.0f << " ms\n";
+	std::cout << "Texture size: " << x << ", " << y << " (" << n << ")\n";
 
 	//----------------------------------------------------------------------------------------------------
 	// CMYK transformation.
 	//----------------------------------------------------------------------------------------------------
-	//hsRGB = cmsCreate_sRGBProfile();
-	cmsHPROFILE srgbProfile = cmsOpenProfileFromFile("../../assets/profiles/sRGB_v4_ICC_preference.icc", "r");
-	cmsHPROFILE cmykProfile = cmsOpenProfileFromFile("../../assets/profiles/USWebCoatedSWOP.icc", "r");
+	ldiColorTransform* colorTransform = colorGetTransform(PROJECT_SRC_PROFILE_PATH, PROJECT_DST_PROFILE_PATH, INTENT_PERCEPTUAL, Project->sourceTextureUseLut);
 
-	double versionInfo = cmsGetProfileVersion(srgbProfile);
-	std::cout << "sRGB olor profile info: " << versionInfo << "\n";
-
-	versionInfo = cmsGetProfileVersion(cmykProfile);
-	std::cout << "CMYK color profile info: " << versionInfo << "\n";
-
-	cmsHTRANSFORM colorTransform = cmsCreateTransform(srgbProfile, TYPE_RGBA_8, cmykProfile, TYPE_CMYK_8, INTENT_PERCEPTUAL, 0);
+	if (!colorTransform) {
+		delete[] imageRawPixels;
+		Project->sourceTextureRaw = {};
+		return false;
+	}
 
 	std::cout << "Converting sRGB image to CMYK\n";
-	uint8_t* cmykImagePixels = new uint8_t[x * y * 4];
-	cmsDoTransform(colorTransform, imageRawPixels, cmykImagePixels, x * y);
+	{
+		PROFILE_ZONE_LOG("CMYK transform");
+		// NOTE: Channel previews for viewing are created in the same pass.
+		colorConvertImage(colorTransform, &Project->sourceTextureRaw, &Project->sourceTextureCmyk, Project->sourceTextureUseLut, Project->sourceTextureCmykChannels);
+		PROFILE_ITEMS((int64_t)x * y);
+		PROFILE_BYTES((int64_t)x * y * 4);
+	}
 
-	Project->sourceTextureCmyk.width = x;
-	Project->sourceTextureCmyk.height = y;
-	Project->sourceTextureCmyk.data = cmykImagePixels;
+	if (stageKeyValid) {
+		FILE* file = stageCacheBeginWrite(&Project->stageCache, "sourceTexture", stageKey);
 
-	cmsDeleteTransform(colorTransform);
-	cmsCloseProfile(srgbProfile);
-	cmsCloseProfile(cmykProfile);
+		if (file) {
+			serialize(file, &Project->sourceTextureRaw, 4);
+			serialize(file, &Project->sourceTextureCmyk, 4);
+			stageCacheEndWrite(&Project->stageCache, "sourceTexture", stageKey, file);
+		}
+	}
 
 	return projectFinalizeImportedTexture(AppContext, Project);
 }
 
-bool projectCreateVoxelMesh(ldiModel* Model) {
-	double t0 = getTime();
-	if (!stlSaveModel("../cache/source.stl", Model)) {
-		return false;
+bool projectCreateVoxelMesh(ldiModel* Model, const mat4* Transform = nullptr) {
+	{
+		PROFILE_ZONE_LOG("Save STL");
+		if (!stlSaveModel("../cache/source.stl", Model, Transform)) {
+			return false;
+		}
 	}
-	t0 = getTime() - t0;
-	std::cout << "Save STL: " << t0 * 1000.0f << " ms\n";
 
 	STARTUPINFOA si;
 	PROCESS_INFORMATION pi;
@@ -407,10 +481,15 @@ static bool projectLoadQuadModel(ldiApp* AppContext, ldiProjectContext* Project,
 		return false;
 	}
 
+	// NOTE: Surfels are created in quad order, so this also lays out surfels and their sample tiles spatially.
+	meshReorderQuadModel(&Project->quadModel, SC_HILBERT, nullptr);
+
 	return true;
 }
 
 static bool projectCreateQuadModel(ldiApp* AppContext, ldiProjectContext* Project) {
+	PROFILE_ZONE("Project create quad model");
+
 	projectInvalidateQuadModelData(AppContext, Project);
 
 	if (!Project->sourceModelLoaded) {
@@ -419,10 +498,19 @@ static bool projectCreateQuadModel(ldiApp* AppContext, ldiProjectContext* Projec
 
 	Project->quadModelLoaded = false;
 
+	uint64_t stageKey = projectGetQuadModelKey(Project);
+	FILE* file = stageCacheOpenRead(&Project->stageCache, "quadModel", stageKey);
+
+	if (file) {
+		deserialize(file, &Project->quadModel);
+		fclose(file);
+
+		return projectFinalizeQuadModel(AppContext, Project);
+	}
+
 	mat4 worldMat = projectGetSourceTransformMat(Project);
-	ldiModel transModel = modelGetTransformed(&Project->sourceModel, worldMat);
 
-	if (!projectCreateVoxelMesh(&transModel)) {
+	if (!projectCreateVoxelMesh(&Project->sourceModel, &worldMat)) {
 		return false;
 	}
 
@@ -434,6 +522,13 @@ static bool projectCreateQuadModel(ldiApp* AppContext, ldiProjectContext* Projec
 		return false;
 	}
 
+	file = stageCacheBeginWrite(&Project->stageCache, "quadModel", stageKey);
+
+	if (file) {
+		serialize(file, &Project->quadModel);
+		stageCacheEndWrite(&Project->stageCache, "quadModel", stageKey, file);
+	}
+
 	return projectFinalizeQuadModel(AppContext, Project);
 }
 
@@ -476,42 +571,53 @@ void geoCreateSurfels(ldiQuadModel* Model, std::vector<ldiSurfel>* Result) {
 	}
 }
 
-void geoCreateSurfelsHigh(ldiQuadModel* Model, std::vector<ldiSurfel>* Result) {
-	int quadCount = Model->indices.size() / 4;
+//----------------------------------------------------------------------------------------------------
+// Parallel surfel creation.
+//----------------------------------------------------------------------------------------------------
+// NOTE: Every generator makes a fixed number of surfels per quad, so the output offset of quad I is just I
+// times that count. The output is sized once and each quad writes its own slots, which keeps the order the
+// same for any thread count.
+struct _ldiCreateSurfelsContext {
+	ldiQuadModel*				model;
+	ldiSurfel*					surfels;
+	ldiNewSurfel*				newSurfels;
+	int							samplesTexWidth;
+	int							samplesTexHeight;
+	int							samplesPerSide;
+};
 
-	Result->clear();
-	Result->reserve(quadCount * 4);
+inline void _geoGetQuad(ldiQuadModel* Model, int QuadIdx, vec3* Corners, vec3* Center, vec3* Normal) {
+	for (int c = 0; c < 4; ++c) {
+		Corners[c] = Model->verts[Model->indices[QuadIdx * 4 + c]];
+	}
 
-	for (int i = 0; i < quadCount; ++i) {
-		vec3 p0 = Model->verts[Model->indices[i * 4 + 0]];
-		vec3 p1 = Model->verts[Model->indices[i * 4 + 1]];
-		vec3 p2 = Model->verts[Model->indices[i * 4 + 2]];
-		vec3 p3 = Model->verts[Model->indices[i * 4 + 3]];
+	*Center = (Corners[0] + Corners[1] + Corners[2] + Corners[3]) / 4.0f;
 
-		vec3 center = p0 + p1 + p2 + p3;
-		center /= 4;
+	vec3 normal0 = glm::normalize(glm::cross(Corners[1] - Corners[0], Corners[3] - Corners[0]));
+	vec3 normal1 = glm::normalize(glm::cross(Corners[3] - Corners[2], Corners[1] - Corners[2]));
 
-		float s0 = glm::length(p0 - p1);
-		float s1 = glm::length(p1 - p2);
-		float s2 = glm::length(p2 - p3);
-		float s3 = glm::length(p3 - p0);
+	*Normal = glm::normalize(normal0 + normal1);
+}
 
-		vec3 normal0 = glm::normalize(glm::cross(p1 - p0, p3 - p0));
-		vec3 normal1 = glm::normalize(glm::cross(p3 - p2, p1 - p2));
+void _geoCreateSurfelsHighBatch(int StartIdx, int EndIdx, void* UserData) {
+	_ldiCreateSurfelsContext* context = (_ldiCreateSurfelsContext*)UserData;
 
-		vec3 normal = normal0 + normal1;
-		normal = glm::normalize(normal);
+	for (int i = StartIdx; i < EndIdx; ++i) {
+		vec3 p[4];
+		vec3 center;
+		vec3 normal;
+		_geoGetQuad(context->model, i, p, &center, &normal);
 
 		vec3 s[4];
 
 		// Bilinear interpolation of corners.
-		vec3 a = (p0 + (p1 - p0) * 0.25f);
-		vec3 b = (p3 + (p2 - p3) * 0.25f);
+		vec3 a = (p[0] + (p[1] - p[0]) * 0.25f);
+		vec3 b = (p[3] + (p[2] - p[3]) * 0.25f);
 		s[0] = (a + (b - a) * 0.25f);
 		s[1] = (a + (b - a) * 0.75f);
 
-		a = (p0 + (p1 - p0) * 0.75f);
-		b = (p3 + (p2 - p3) * 0.75f);
+		a = (p[0] + (p[1] - p[0]) * 0.75f);
+		b = (p[3] + (p[2] - p[3]) * 0.75f);
 		s[2] = (a + (b - a) * 0.25f);
 		s[3] = (a + (b - a) * 0.75f);
 
@@ -523,73 +629,92 @@ void geoCreateSurfelsHigh(ldiQuadModel* Model, std::vector<ldiSurfel>* Result) {
 			surfel.scale = 0.0075f;
 			surfel.position = s[sIter];
 
-			Result->push_back(surfel);
+			context->surfels[(size_t)i * 4 + sIter] = surfel;
 		}
 	}
 }
 
-void geoCreateSurfelsNew(ldiQuadModel* Model, std::vector<ldiNewSurfel>* Result, const int SamplesTexWidth, const int SamplesPerSide) {
-	const int samplesPerSurfel = SamplesPerSide * SamplesPerSide;
-	const double sampleTexPixel = 1.0 / SamplesTexWidth;
+void geoCreateSurfelsHigh(ldiQuadModel* Model, std::vector<ldiSurfel>* Result) {
+	PROFILE_ZONE("Create surfels high");
 
-	const int quadCount = Model->indices.size() / 4;
+	int quadCount = Model->indices.size() / 4;
+	PROFILE_ITEMS(quadCount);
 
 	Result->clear();
-	Result->reserve(quadCount);
+	Result->resize((size_t)quadCount * 4);
 
-	for (int i = 0; i < quadCount; ++i) {
-		vec3 p0 = Model->verts[Model->indices[i * 4 + 0]];
-		vec3 p1 = Model->verts[Model->indices[i * 4 + 1]];
-		vec3 p2 = Model->verts[Model->indices[i * 4 + 2]];
-		vec3 p3 = Model->verts[Model->indices[i * 4 + 3]];
+	_ldiCreateSurfelsContext context = {};
+	context.model = Model;
+	context.surfels = Result->data();
 
-		vec3 center = p0 + p1 + p2 + p3;
-		center /= 4;
+	parallelFor(0, quadCount, 1024, _geoCreateSurfelsHighBatch, &context);
+}
 
-		float s0 = glm::length(p0 - p1);
-		float s1 = glm::length(p1 - p2);
-		float s2 = glm::length(p2 - p3);
-		float s3 = glm::length(p3 - p0);
+void _geoCreateSurfelsNewBatch(int StartIdx, int EndIdx, void* UserData) {
+	_ldiCreateSurfelsContext* context = (_ldiCreateSurfelsContext*)UserData;
 
-		vec3 normal0 = glm::normalize(glm::cross(p1 - p0, p3 - p0));
-		vec3 normal1 = glm::normalize(glm::cross(p3 - p2, p1 - p2));
+	const int tilesPerRow = context->samplesTexWidth / context->samplesPerSide;
+	const double sampleTexPixelX = 1.0 / context->samplesTexWidth;
+	const double sampleTexPixelY = 1.0 / context->samplesTexHeight;
 
-		vec3 normal = normal0 + normal1;
-		normal = glm::normalize(normal);
+	for (int i = StartIdx; i < EndIdx; ++i) {
+		vec3 p[4];
+		vec3 center;
+		vec3 normal;
+		_geoGetQuad(context->model, i, p, &center, &normal);
 
 		// Sample texture location.
-		const int tileX = i % (SamplesTexWidth / SamplesPerSide);
-		const int tileY = i / (SamplesTexWidth / SamplesPerSide);
-		const vec2 uvMin(tileX * SamplesPerSide * sampleTexPixel, tileY * SamplesPerSide * sampleTexPixel);
-		const vec2 uvMax((tileX + 1) * SamplesPerSide * sampleTexPixel, (tileY + 1) * SamplesPerSide * sampleTexPixel);
+		const int tileX = i % tilesPerRow;
+		const int tileY = i / tilesPerRow;
+		const vec2 uvMin(tileX * context->samplesPerSide * sampleTexPixelX, tileY * context->samplesPerSide * sampleTexPixelY);
+		const vec2 uvMax((tileX + 1) * context->samplesPerSide * sampleTexPixelX, (tileY + 1) * context->samplesPerSide * sampleTexPixelY);
 
-		ldiNewSurfel surfel = {};
-		surfel.id = i;
-		surfel.position = center;
-		surfel.normal = normal;
+		ldiNewSurfel* surfel = &context->newSurfels[i];
+		*surfel = {};
+		surfel->id = i;
+		surfel->position = center;
+		surfel->normal = normal;
 
 		vec3 color(1, 1, 1);// = normal * 0.5f + 0.5f;
-		
-		surfel.verts[0].color = color;
-		surfel.verts[0].position = p0;
-		surfel.verts[0].uv = vec2(uvMin.x, uvMin.y);
-
-		surfel.verts[1].color = color;
-		surfel.verts[1].position = p1;
-		surfel.verts[1].uv = vec2(uvMax.x, uvMin.y);
-
-		surfel.verts[2].color = color;
-		surfel.verts[2].position = p2;
-		surfel.verts[2].uv = vec2(uvMax.x, uvMax.y);
-
-		surfel.verts[3].color = color;
-		surfel.verts[3].position = p3;
-		surfel.verts[3].uv = vec2(uvMin.x, uvMax.y);
-		
-		Result->push_back(surfel);
+
+		surfel->verts[0].color = color;
+		surfel->verts[0].position = p[0];
+		surfel->verts[0].uv = vec2(uvMin.x, uvMin.y);
+
+		surfel->verts[1].color = color;
+		surfel->verts[1].position = p[1];
+		surfel->verts[1].uv = vec2(uvMax.x, uvMin.y);
+
+		surfel->verts[2].color = color;
+		surfel->verts[2].position = p[2];
+		surfel->verts[2].uv = vec2(uvMax.x, uvMax.y);
+
+		surfel->verts[3].color = color;
+		surfel->verts[3].position = p[3];
+		surfel->verts[3].uv = vec2(uvMin.x, uvMax.y);
 	}
 }
 
+// Surfel UVs address the tile layout of sampleAtlasCreateImage, SamplesTexWidth wide.
+void geoCreateSurfelsNew(ldiQuadModel* Model, std::vector<ldiNewSurfel>* Result, const int SamplesTexWidth, const int SamplesPerSide) {
+	PROFILE_ZONE("Create surfels");
+
+	const int quadCount = Model->indices.size() / 4;
+	PROFILE_ITEMS(quadCount);
+
+	Result->clear();
+	Result->resize(quadCount);
+
+	_ldiCreateSurfelsContext context = {};
+	context.model = Model;
+	context.newSurfels = Result->data();
+	context.samplesTexWidth = SamplesTexWidth;
+	context.samplesTexHeight = sampleAtlasGetImageHeight(quadCount, SamplesPerSide, SamplesTexWidth);
+	context.samplesPerSide = SamplesPerSide;
+
+	parallelFor(0, quadCount, 1024, _geoCreateSurfelsNewBatch, &context);
+}
+
 vec4 getColorSample(ldiImage* Image, vec2 Uv) {
 	Uv.y = 1.0 - Uv.y;
 
@@ -613,255 +738,398 @@ vec4 getColorSample(ldiImage* Image, vec2 Uv) {
 	return result;
 }
 
-vec4 getColorSampleBilinear(ldiImage* Image, vec2 Uv) {
-	Uv.y = 1.0 - Uv.y;
+// NOTE: Max samples per side for one surfel batch.
+#define TRANSFER_MAX_SAMPLES_PER_SIDE 8
+// NOTE: Largest channel difference between corner samples, in 8 bit steps, that still counts as a smooth region.
+#define TRANSFER_ADAPTIVE_THRESHOLD 6
 
-	float cX = Uv.x * Image->width;
-	float cY = Uv.y * Image->height;
+struct ldiColorTransferThreadContext {
+	ldiPhysics* physics;
+	ldiPhysicsMesh* cookedMesh;
+	ldiModel* srcModel;
+	ldiTexSampler* sampler;
+	ldiSampleAtlas* samples;
+	std::vector<ldiNewSurfel>* surfels;
+	int samplesPerSide;
+	bool adaptive;
+	std::atomic_int64_t rayCount = 0;
+	std::atomic_int64_t lookupCount = 0;
+};
 
-	int p0X = (int)(cX - 0.5);
-	int p0Y = (int)(cY - 0.5);
+// Casts the ray for sample X, Y of a surfel. On a hit returns the source texture UV and triangle.
+bool _geoTransferCastSample(ldiColorTransferThreadContext* Context, ldiNewSurfel* Surfel, int X, int Y, vec2* Uv, int* FaceIdx) {
+	const float normalAdjust = 0.01;
+	const double samplePosOffsetHalf = 0.5 / Context->samplesPerSide;
+	const double lerpX = ((double)X / (double)Context->samplesPerSide) + samplePosOffsetHalf;
+	const double lerpY = ((double)Y / (double)Context->samplesPerSide) + samplePosOffsetHalf;
 
-	int p1X = (int)(cX + 0.5);
-	int p1Y = (int)(cY - 0.5);
+	const vec3 posX0 = glm::mix(Surfel->verts[0].position, Surfel->verts[1].position, lerpX);
+	const vec3 posX1 = glm::mix(Surfel->verts[3].position, Surfel->verts[2].position, lerpX);
+	const vec3 pos = glm::mix(posX0, posX1, lerpY);
 
-	int p2X = (int)(cX - 0.5);
-	int p2Y = (int)(cY + 0.5);
+	ldiRaycastResult result = physicsRaycast(Context->cookedMesh, pos + Surfel->normal * normalAdjust, -Surfel->normal, 0.1f);
 
-	int p3X = (int)(cX + 0.5);
-	int p3Y = (int)(cY + 0.5);
+	if (!result.hit) {
+		return false;
+	}
 
-	float lerpX = (cX + 0.5f) - floorf(cX + 0.5f);
-	float lerpY = (cY + 0.5f) - floorf(cY + 0.5f);
+	ldiMeshVertex v0 = Context->srcModel->verts[Context->srcModel->indices[result.faceIdx * 3 + 0]];
+	ldiMeshVertex v1 = Context->srcModel->verts[Context->srcModel->indices[result.faceIdx * 3 + 1]];
+	ldiMeshVertex v2 = Context->srcModel->verts[Context->srcModel->indices[result.faceIdx * 3 + 2]];
 
-	p0X = clamp(p0X, 0, Image->width - 1);
-	p0Y = clamp(p0Y, 0, Image->height - 1);
+	float u = result.barry.x;
+	float v = result.barry.y;
+	float w = 1.0 - (u + v);
 
-	p1X = clamp(p1X, 0, Image->width - 1);
-	p1Y = clamp(p1Y, 0, Image->height - 1);
+	*Uv = w * v0.uv + u * v1.uv + v * v2.uv;
+	*FaceIdx = result.faceIdx;
 
-	p2X = clamp(p2X, 0, Image->width - 1);
-	p2Y = clamp(p2Y, 0, Image->height - 1);
+	return true;
+}
 
-	p3X = clamp(p3X, 0, Image->width - 1);
-	p3Y = clamp(p3Y, 0, Image->height - 1);
+inline uint32_t _geoTransferLerpColor(uint32_t C00, uint32_t C10, uint32_t C01, uint32_t C11, float X, float Y) {
+	uint32_t result = 0;
 
-	vec4 s0;
-	vec4 s1;
-	vec4 s2;
-	vec4 s3;
+	for (int shift = 0; shift < 32; shift += 8) {
+		float a = (float)((C00 >> shift) & 0xFF);
+		float b = (float)((C10 >> shift) & 0xFF);
+		float c = (float)((C01 >> shift) & 0xFF);
+		float d = (float)((C11 >> shift) & 0xFF);
+		float value = (a * (1.0f - X) + b * X) * (1.0f - Y) + (c * (1.0f - X) + d * X) * Y;
 
-	{
-		uint32_t sample = *(uint32_t*)(&Image->data[(p0X + p0Y * Image->width) * 4]);
-		
-		s0.r = (float)((sample >> 0) & 0xFF) / 255.0;
-		s0.g = (float)((sample >> 8) & 0xFF) / 255.0;
-		s0.b = (float)((sample >> 16) & 0xFF) / 255.0;
-		s0.a = (float)((sample >> 24) & 0xFF) / 255.0;
+		result |= (uint32_t)(value + 0.5f) << shift;
 	}
 
-	{
-		uint32_t sample = *(uint32_t*)(&Image->data[(p1X + p1Y * Image->width) * 4]);
+	return result;
+}
 
-		s1.r = (float)((sample >> 0) & 0xFF) / 255.0;
-		s1.g = (float)((sample >> 8) & 0xFF) / 255.0;
-		s1.b = (float)((sample >> 16) & 0xFF) / 255.0;
-		s1.a = (float)((sample >> 24) & 0xFF) / 255.0;
+inline int _geoTransferColorRange(const uint32_t* Colors, int Count) {
+	int result = 0;
+
+	for (int shift = 0; shift < 32; shift += 8) {
+		int lo = 255;
+		int hi = 0;
+
+		for (int i = 0; i < Count; ++i) {
+			int value = (Colors[i] >> shift) & 0xFF;
+			lo = min(lo, value);
+			hi = max(hi, value);
+		}
+
+		result = max(result, hi - lo);
 	}
 
-	{
-		uint32_t sample = *(uint32_t*)(&Image->data[(p2X + p2Y * Image->width) * 4]);
+	return result;
+}
+
+// Adaptive transfer for one surfel. Casts the four corner samples first. When they all land on the same
+// triangle, every other sample would too: rays are parallel, so hits and UVs are an affine function of the
+// start position, and the UVs of the inner samples are the bilinear blend of the corner UVs. Texture lookups
+// are then prefiltered for the sample spacing, and if the corner colors agree within the threshold the inner
+// colors are blended as well. Anything else falls back to casting every sample.
+// NOTE: Assumes nothing closer than the corner triangle sits between the corners, within the 0.1 ray length.
+bool _geoTransferAdaptiveSurfel(ldiColorTransferThreadContext* Context, ldiNewSurfel* Surfel, uint32_t* Samples, int* Rays, int* Lookups) {
+	const int n = Context->samplesPerSide;
+	const int cornerX[4] = { 0, n - 1, 0, n - 1 };
+	const int cornerY[4] = { 0, 0, n - 1, n - 1 };
+
+	vec2 cornerUvs[4];
+	int cornerFaces[4];
+
+	for (int c = 0; c < 4; ++c) {
+		++(*Rays);
+
+		if (!_geoTransferCastSample(Context, Surfel, cornerX[c], cornerY[c], &cornerUvs[c], &cornerFaces[c])) {
+			return false;
+		}
 
-		s2.r = (float)((sample >> 0) & 0xFF) / 255.0;
-		s2.g = (float)((sample >> 8) & 0xFF) / 255.0;
-		s2.b = (float)((sample >> 16) & 0xFF) / 255.0;
-		s2.a = (float)((sample >> 24) & 0xFF) / 255.0;
+		if (cornerFaces[c] != cornerFaces[0]) {
+			return false;
+		}
 	}
 
-	{
-		uint32_t sample = *(uint32_t*)(&Image->data[(p3X + p3Y * Image->width) * 4]);
+	float footprint = 0.0f;
 
-		s3.r = (float)((sample >> 0) & 0xFF) / 255.0;
-		s3.g = (float)((sample >> 8) & 0xFF) / 255.0;
-		s3.b = (float)((sample >> 16) & 0xFF) / 255.0;
-		s3.a = (float)((sample >> 24) & 0xFF) / 255.0;
+	if (Context->sampler->mipCount > 1) {
+		float spacing = min(glm::length(cornerUvs[1] - cornerUvs[0]), glm::length(cornerUvs[2] - cornerUvs[0])) / (n - 1);
+		footprint = spacing * Context->sampler->mips[0].width;
 	}
 
-	vec4 x0 = glm::mix(s0, s1, lerpX);
-	vec4 x1 = glm::mix(s2, s3, lerpX);
-	vec4 y1 = glm::mix(x0, x1, lerpY);
-	
-	return y1;
+	uint32_t cornerColors[4];
+	texSampleBilinear(Context->sampler, 4, cornerUvs, cornerColors, footprint);
+	*Lookups += 4;
+
+	if (_geoTransferColorRange(cornerColors, 4) <= TRANSFER_ADAPTIVE_THRESHOLD) {
+		for (int iY = 0; iY < n; ++iY) {
+			for (int iX = 0; iX < n; ++iX) {
+				Samples[iX + iY * n] = _geoTransferLerpColor(cornerColors[0], cornerColors[1], cornerColors[2], cornerColors[3], (float)iX / (n - 1), (float)iY / (n - 1));
+			}
+		}
+
+		return true;
+	}
+
+	vec2 uvs[TRANSFER_MAX_SAMPLES_PER_SIDE * TRANSFER_MAX_SAMPLES_PER_SIDE];
+
+	for (int iY = 0; iY < n; ++iY) {
+		for (int iX = 0; iX < n; ++iX) {
+			float x = (float)iX / (n - 1);
+			float y = (float)iY / (n - 1);
+			uvs[iX + iY * n] = glm::mix(glm::mix(cornerUvs[0], cornerUvs[1], x), glm::mix(cornerUvs[2], cornerUvs[3], x), y);
+		}
+	}
+
+	texSampleBilinear(Context->sampler, n * n, uvs, Samples, footprint);
+	*Lookups += n * n;
+
+	return true;
 }
 
-struct ldiColorTransferThreadContext {
-	ldiPhysics* physics;
-	ldiPhysicsMesh* cookedMesh;
-	ldiModel* srcModel;
-	ldiImage* image;
-	ldiImage* samplesImage;
-	std::vector<ldiNewSurfel>* surfels;
-	int samplesPerSide;
-	int	startIdx;
-	int	endIdx;
-};
+void geoTransferThreadBatch(int StartIdx, int EndIdx, void* UserData) {
+	ldiColorTransferThreadContext* context = (ldiColorTransferThreadContext*)UserData;
 
-void geoTransferThreadBatch(ldiColorTransferThreadContext Context) {
-	const float normalAdjust = 0.01;
-	const double sampleTexPixel = 1.0 / Context.samplesImage->width;
-	const double samplePosOffsetHalf = 0.5 / Context.samplesPerSide;
-
-	for (size_t i = Context.startIdx; i < Context.endIdx; ++i) {
-		ldiNewSurfel* s = &(*Context.surfels)[i];
-
-		for (int iY = 0; iY < Context.samplesPerSide; ++iY) {
-			for (int iX = 0; iX < Context.samplesPerSide; ++iX) {
-				const double lerpX = ((double)iX / (double)Context.samplesPerSide) + samplePosOffsetHalf;
-				const double lerpY = ((double)iY / (double)Context.samplesPerSide) + samplePosOffsetHalf;
-
-				const vec3 posX0 = glm::mix(s->verts[0].position, s->verts[1].position, lerpX);
-				const vec3 posX1 = glm::mix(s->verts[3].position, s->verts[2].position, lerpX);
-				const vec3 pos = glm::mix(posX0, posX1, lerpY);
-
-				const float uvX = lerp(s->verts[0].uv.x, s->verts[1].uv.x, lerpX);
-				const float uvY = lerp(s->verts[0].uv.y, s->verts[2].uv.y, lerpY);
-				
-				const int pX = (int)(uvX / sampleTexPixel);
-				const int pY = (int)(uvY / sampleTexPixel);
-				const int samplesImageIdx = pX + pY * Context.samplesImage->width;
-
-				ldiRaycastResult result = physicsRaycast(Context.cookedMesh, pos + s->normal * normalAdjust, -s->normal, 0.1f);
-
-				if (result.hit) {
-					ldiMeshVertex v0 = Context.srcModel->verts[Context.srcModel->indices[result.faceIdx * 3 + 0]];
-					ldiMeshVertex v1 = Context.srcModel->verts[Context.srcModel->indices[result.faceIdx * 3 + 1]];
-					ldiMeshVertex v2 = Context.srcModel->verts[Context.srcModel->indices[result.faceIdx * 3 + 2]];
-
-					float u = result.barry.x;
-					float v = result.barry.y;
-					float w = 1.0 - (u + v);
-					vec2 uv = w * v0.uv + u * v1.uv + v * v2.uv;
-
-					vec4 s0 = getColorSampleBilinear(Context.image, uv);
-					//vec4 s0 = getColorSample(Context.image, uv);
-
-					Context.samplesImage->data[samplesImageIdx * 4 + 0] = s0.r * 255;
-					Context.samplesImage->data[samplesImageIdx * 4 + 1] = s0.g * 255;
-					Context.samplesImage->data[samplesImageIdx * 4 + 2] = s0.b * 255;
-					Context.samplesImage->data[samplesImageIdx * 4 + 3] = s0.a * 255;
-				} else {
-					Context.samplesImage->data[samplesImageIdx * 4 + 0] = 255;
-					Context.samplesImage->data[samplesImageIdx * 4 + 1] = 0;
-					Context.samplesImage->data[samplesImageIdx * 4 + 2] = 0;
-					Context.samplesImage->data[samplesImageIdx * 4 + 3] = 255;
+	PROFILE_ZONE("Transfer batch");
+	PROFILE_ITEMS((int64_t)(EndIdx - StartIdx) * context->samplesPerSide * context->samplesPerSide);
+
+	const int sampleCount = context->samplesPerSide * context->samplesPerSide;
+	const uint32_t missColor = 0xFF0000FF;
+
+	// NOTE: Texture lookups for all hits of a surfel are gathered and sampled as one batch.
+	int hitSampleIdx[TRANSFER_MAX_SAMPLES_PER_SIDE * TRANSFER_MAX_SAMPLES_PER_SIDE];
+	vec2 hitUvs[TRANSFER_MAX_SAMPLES_PER_SIDE * TRANSFER_MAX_SAMPLES_PER_SIDE];
+	uint32_t hitColors[TRANSFER_MAX_SAMPLES_PER_SIDE * TRANSFER_MAX_SAMPLES_PER_SIDE];
+	bool hit[TRANSFER_MAX_SAMPLES_PER_SIDE * TRANSFER_MAX_SAMPLES_PER_SIDE];
+
+	int rays = 0;
+	int lookups = 0;
+
+	for (int i = StartIdx; i < EndIdx; ++i) {
+		ldiNewSurfel* s = &(*context->surfels)[i];
+		// NOTE: Footprint samples are in the same row major order as sampleIdx.
+		uint32_t* samples = sampleAtlasGetFootprint(context->samples, i);
+
+		// NOTE: Corner rays of a failed adaptive attempt are cast again below, it only fails on edges and seams.
+		if (context->adaptive && _geoTransferAdaptiveSurfel(context, s, samples, &rays, &lookups)) {
+			continue;
+		}
+
+		int hitCount = 0;
+
+		for (int iY = 0; iY < context->samplesPerSide; ++iY) {
+			for (int iX = 0; iX < context->samplesPerSide; ++iX) {
+				const int sampleIdx = iX + iY * context->samplesPerSide;
+				int faceIdx;
+
+				hit[sampleIdx] = _geoTransferCastSample(context, s, iX, iY, &hitUvs[hitCount], &faceIdx);
+
+				if (hit[sampleIdx]) {
+					hitSampleIdx[hitCount] = sampleIdx;
+					++hitCount;
 				}
 			}
 		}
-	}
-}
 
-void geoTransferColorToSurfels(ldiApp* AppContext, ldiPhysicsMesh* CookedMesh, ldiModel* SrcModel, ldiImage* Image, std::vector<ldiNewSurfel>* Surfels, ldiImage* SamplesImage) {
-	double t0 = getTime();
+		rays += sampleCount;
+		lookups += hitCount;
 
-	const int threadCount = 20;
-	int batchSize = Surfels->size() / threadCount;
-	int batchRemainder = Surfels->size() - (batchSize * threadCount);
-	std::thread workerThread[threadCount];
+		float footprint = 0.0f;
 
-	const int samplesPerSide = 4;
+		if (context->sampler->mipCount > 1) {
+			// NOTE: Closest spacing between neighbouring hits, UV seams only make spacing larger.
+			float minDist = FLT_MAX;
+
+			for (int h = 1; h < hitCount; ++h) {
+				if (hitSampleIdx[h] == hitSampleIdx[h - 1] + 1 && (hitSampleIdx[h] % context->samplesPerSide) != 0) {
+					minDist = min(minDist, glm::length(hitUvs[h] - hitUvs[h - 1]));
+				}
+			}
 
-	for (int t = 0; t < threadCount; ++t) {
-		ldiColorTransferThreadContext tc{};
-		tc.physics = AppContext->physics;
-		tc.cookedMesh = CookedMesh;
-		tc.srcModel = SrcModel;
-		tc.image = Image;
-		tc.samplesImage = SamplesImage;
-		tc.surfels = Surfels;
-		tc.samplesPerSide = samplesPerSide;
-		tc.startIdx = t * batchSize;
-		tc.endIdx = (t + 1) * batchSize;
-
-		if (t == threadCount - 1) {
-			tc.endIdx += batchRemainder;
+			if (minDist != FLT_MAX) {
+				footprint = minDist * context->sampler->mips[0].width;
+			}
 		}
 
-		workerThread[t] = std::thread(geoTransferThreadBatch, tc);
-	}
+		texSampleBilinear(context->sampler, hitCount, hitUvs, hitColors, footprint);
+
+		int h = 0;
 
-	for (int t = 0; t < threadCount; ++t) {
-		workerThread[t].join();
+		for (int sampleIdx = 0; sampleIdx < sampleCount; ++sampleIdx) {
+			if (hit[sampleIdx]) {
+				samples[sampleIdx] = hitColors[h++];
+			} else {
+				samples[sampleIdx] = missColor;
+			}
+		}
 	}
 
-	t0 = getTime() - t0;
+	context->rayCount += rays;
+	context->lookupCount += lookups;
+}
+
+// Fills Samples with a footprint for every surfel, indexed by surfel position in Surfels.
+// UseMips filters minified texture regions from a mip chain instead of skipping texels.
+// Adaptive only casts every sample where a surfel spans triangle edges or detailed texture, it always uses mips.
+void geoTransferColorToSurfels(ldiApp* AppContext, ldiPhysicsMesh* CookedMesh, ldiModel* SrcModel, ldiImage* Image, std::vector<ldiNewSurfel>* Surfels, ldiSampleAtlas* Samples, bool UseMips = false, bool Adaptive = false) {
+	PROFILE_ZONE_LOG("Transfer");
+
+	const int samplesPerSide = 4;
+
+	sampleAtlasDestroy(Samples);
+	sampleAtlasInit(Samples, samplesPerSide);
+	sampleAtlasAllocRange(Samples, 0, (int)Surfels->size());
+
+	ldiTexSampler sampler;
+	texSamplerInit(&sampler, Image, TAM_CLAMP, (UseMips || Adaptive) ? TEXSAMPLER_MAX_MIPS : 1);
+
+	ldiColorTransferThreadContext tc{};
+	tc.physics = AppContext->physics;
+	tc.cookedMesh = CookedMesh;
+	tc.srcModel = SrcModel;
+	tc.sampler = &sampler;
+	tc.samples = Samples;
+	tc.surfels = Surfels;
+	tc.samplesPerSide = samplesPerSide;
+	tc.adaptive = Adaptive;
+
+	// NOTE: Raycast cost varies a lot per surfel, dynamic chunks keep threads busy on uneven meshes.
+	parallelFor(0, (int)Surfels->size(), 256, geoTransferThreadBatch, &tc);
+
+	texSamplerDestroy(&sampler);
+
+	PROFILE_ITEMS(Surfels->size() * samplesPerSide * samplesPerSide);
 	std::cout << "Transfer color count: " << (Surfels->size() * samplesPerSide * samplesPerSide) << "\n";
-	std::cout << "Transfer time: " << t0 * 1000.0f << " ms\n";
+	std::cout << "Transfer rays: " << tc.rayCount << " lookups: " << tc.lookupCount << "\n";
 }
 
-struct ldiSmoothNormalsThreadContext {
-	ldiSpatialGrid* grid;
-	std::vector<ldiSurfel>* surfels;
-	int						startIdx;
-	int						endIdx;
+//----------------------------------------------------------------------------------------------------
+// Surfel normal smoothing.
+//----------------------------------------------------------------------------------------------------
+struct ldiNormalSmoothSettings {
+	// Neighbors per surfel, including itself. At most POINT_INDEX_MAX_K.
+	int									neighborCount;
+	// Neighbors further than this are ignored.
+	float								radius;
+	// Gaussian falloff over distance.
+	float								sigma;
+	int									iterations;
+	// Neighbors whose normal is at or below this dot product with the surfel's own are ignored, keeps the
+	// two sides of thin walls apart.
+	float								minAgreement;
 };
 
-void surfelsSmoothNormalsThreadBatch(ldiSmoothNormalsThreadContext Context) {
-	for (int i = Context.startIdx; i < Context.endIdx; ++i) {
-		ldiSurfel* srcSurfel = &(*Context.surfels)[i];
-		vec3 avgNorm = srcSurfel->normal;
-		int avgCount = 1;
+ldiNormalSmoothSettings geoGetDefaultNormalSmoothSettings() {
+	ldiNormalSmoothSettings result = {};
+	result.neighborCount = 16;
+	result.radius = 0.03f;
+	result.sigma = 0.01f;
+	result.iterations = 4;
+	result.minAgreement = 0.0f;
 
-		vec3 cell = spatialGridGetCellFromWorldPosition(Context.grid, srcSurfel->position);
+	return result;
+}
 
-		int sX = (int)(cell.x - 0.5f);
-		int eX = sX + 1;
+struct ldiSmoothNormalsThreadContext {
+	int									neighborCount;
+	float								minAgreement;
+	float								falloff;
+	// Per surfel runs of neighborCount ids and weights, ids are -1 past the neighbors found.
+	const int*							neighborIds;
+	float*								neighborWeights;
+	const vec3*							srcNormals;
+	vec3*								dstNormals;
+};
 
-		int sY = (int)(cell.y - 0.5f);
-		int eY = sY + 1;
+// Turns the squared distances from the neighbor query into Gaussian weights, in place.
+void _surfelsNormalWeightsBatch(int StartIdx, int EndIdx, void* UserData) {
+	ldiSmoothNormalsThreadContext* context = (ldiSmoothNormalsThreadContext*)UserData;
 
-		int sZ = (int)(cell.z - 0.5f);
-		int eZ = sZ + 1;
+	for (int i = StartIdx; i < EndIdx; ++i) {
+		float* weights = context->neighborWeights + (size_t)i * context->neighborCount;
 
-		for (int iZ = sZ; iZ <= eZ; ++iZ) {
-			for (int iY = sY; iY <= eY; ++iY) {
-				for (int iX = sX; iX <= eX; ++iX) {
-					ldiSpatialCellResult cellResult = spatialGridGetCell(Context.grid, iX, iY, iZ);
-					for (int s = 0; s < cellResult.count; ++s) {
-						int surfelId = cellResult.data[s];
+		for (int n = 0; n < context->neighborCount; ++n) {
+			weights[n] = (weights[n] == FLT_MAX) ? 0.0f : expf(weights[n] * context->falloff);
+		}
+	}
+}
 
-						if (surfelId != i) {
-							ldiSurfel* dstSurfel = &(*Context.surfels)[surfelId];
+void surfelsSmoothNormalsThreadBatch(int StartIdx, int EndIdx, void* UserData) {
+	ldiSmoothNormalsThreadContext* context = (ldiSmoothNormalsThreadContext*)UserData;
 
-							float dist = glm::length(dstSurfel->position - srcSurfel->position);
+	for (int i = StartIdx; i < EndIdx; ++i) {
+		const int* ids = context->neighborIds + (size_t)i * context->neighborCount;
+		const float* weights = context->neighborWeights + (size_t)i * context->neighborCount;
+		vec3 srcNormal = context->srcNormals[i];
+		vec3 avgNorm = vec3Zero;
 
-							if (dist < 0.02f) {
-								avgNorm += dstSurfel->normal * (1.0f - (dist / 0.02f));
-								avgCount += 1;
-							}
-						}
-					}
-				}
+		for (int n = 0; n < context->neighborCount && ids[n] != -1; ++n) {
+			vec3 normal = context->srcNormals[ids[n]];
+
+			if (glm::dot(normal, srcNormal) > context->minAgreement) {
+				avgNorm += normal * weights[n];
 			}
 		}
 
-		avgNorm = glm::normalize(avgNorm);
-		srcSurfel->smoothedNormal = avgNorm;
+		float length = glm::length(avgNorm);
+		context->dstNormals[i] = (length > 0.0f) ? avgNorm / length : srcNormal;
 	}
 }
 
-bool projectFinalizeSurfels(ldiApp* AppContext, ldiProjectContext* Project) {
-	gfxCreateTextureR8G8B8A8Basic(AppContext, &Project->surfelsSamplesRaw, &Project->surfelsSamplesTexture, &Project->surfelsSamplesTextureSrv);
-	Project->surfelsRenderModel = gfxCreateNewSurfelRenderModel(AppContext, &Project->surfels);
+// Gaussian weighted average of each surfel normal with its nearest neighbors, repeated for several iterations.
+// Neighborhoods and weights are found once up front, then each iteration reads one normal buffer and writes the
+// other, so the result doesn't depend on surfel order or thread scheduling.
+void geoSmoothSurfelNormals(std::vector<ldiNewSurfel>* Surfels, ldiPointIndex* Index, ldiNormalSmoothSettings* Settings, std::vector<vec3>* Result) {
+	PROFILE_ZONE_LOG("Smooth surfel normals");
+
+	int surfelCount = (int)Surfels->size();
+	int neighborCount = Settings->neighborCount;
+
+	PROFILE_ITEMS((int64_t)surfelCount * neighborCount * Settings->iterations);
+
+	std::vector<vec3> positions(surfelCount);
+	std::vector<vec3> normals[2];
+	normals[0].resize(surfelCount);
+	normals[1].resize(surfelCount);
+
+	for (int i = 0; i < surfelCount; ++i) {
+		positions[i] = (*Surfels)[i].position;
+		normals[0][i] = (*Surfels)[i].normal;
+	}
+
+	std::vector<int> neighborIds((size_t)surfelCount * neighborCount);
+	std::vector<float> neighborWeights((size_t)surfelCount * neighborCount);
+
+	pointIndexQueryKnnBatch(Index, positions.data(), surfelCount, neighborCount, Settings->radius, neighborIds.data(), neighborWeights.data(), nullptr);
+
+	ldiSmoothNormalsThreadContext tc{};
+	tc.neighborCount = neighborCount;
+	tc.minAgreement = Settings->minAgreement;
+	tc.falloff = -1.0f / (2.0f * Settings->sigma * Settings->sigma);
+	tc.neighborIds = neighborIds.data();
+	tc.neighborWeights = neighborWeights.data();
+
+	parallelFor(0, surfelCount, 256, _surfelsNormalWeightsBatch, &tc);
+
+	int src = 0;
+
+	for (int n = 0; n < Settings->iterations; ++n) {
+		tc.srcNormals = normals[src].data();
+		tc.dstNormals = normals[1 - src].data();
+		parallelFor(0, surfelCount, 256, surfelsSmoothNormalsThreadBatch, &tc);
+		src = 1 - src;
+	}
+
+	*Result = std::move(normals[src]);
+}
+
+void geoBuildSurfelSpatialGrid(std::vector<ldiNewSurfel>* Surfels, float CellSize, ldiSpatialGrid* Grid, vec3* BoundsMin, vec3* BoundsMax) {
+	PROFILE_ZONE_LOG("Build surfel spatial grid");
+	PROFILE_ITEMS(Surfels->size());
 
-	//----------------------------------------------------------------------------------------------------
-	// Create spatial structure for surfels.
-	//----------------------------------------------------------------------------------------------------
-	double t0 = getTime();
 	vec3 surfelsMin(10000, 10000, 10000);
 	vec3 surfelsMax(-10000, -10000, -10000);
 
-	for (size_t i = 0; i < Project->surfels.size(); ++i) {
-		ldiNewSurfel* s = &Project->surfels[i];
+	for (size_t i = 0; i < Surfels->size(); ++i) {
+		ldiNewSurfel* s = &(*Surfels)[i];
 
 		surfelsMin.x = min(surfelsMin.x, s->position.x);
 		surfelsMin.y = min(surfelsMin.y, s->position.y);
@@ -872,58 +1140,176 @@ bool projectFinalizeSurfels(ldiApp* AppContext, ldiProjectContext* Project) {
 		surfelsMax.z = max(surfelsMax.z, s->position.z);
 	}
 
-	ldiSpatialGrid spatialGrid{};
-	spatialGridInit(&spatialGrid, surfelsMin, surfelsMax, 0.03f);
+	std::vector<vec3> positions(Surfels->size());
 
-	for (size_t i = 0; i < Project->surfels.size(); ++i) {
-		spatialGridPrepEntry(&spatialGrid, Project->surfels[i].position);
+	for (size_t i = 0; i < Surfels->size(); ++i) {
+		positions[i] = (*Surfels)[i].position;
 	}
 
-	spatialGridCompile(&spatialGrid);
+	// NOTE: Surfels are a thin shell, so the auto layout usually picks the sparse grid.
+	ldiSpatialGrid spatialGrid{};
+	spatialGridBuild(&spatialGrid, surfelsMin, surfelsMax, CellSize, positions.data(), nullptr, (int)positions.size());
 
-	for (size_t i = 0; i < Project->surfels.size(); ++i) {
-		spatialGridAddEntry(&spatialGrid, Project->surfels[i].position, (int)i);
+	*Grid = spatialGrid;
+	*BoundsMin = surfelsMin;
+	*BoundsMax = surfelsMax;
+}
+
+// Surfels: the quad model and the sample tile layout.
+uint64_t projectGetSurfelsKey(ldiProjectContext* Project, int SamplesTexWidth, int SamplesPerSide) {
+	PROFILE_ZONE("Surfels key");
+
+	int layout[2] = { SamplesTexWidth, SamplesPerSide };
+	uint64_t key = stageCacheKeyInit("surfels", 2);
+	key = hashFnv1a(key, layout, sizeof(layout));
+
+	return _projectHashQuadModel(key, &Project->quadModel);
+}
+
+// Color transfer: the transfer mode, the surfels, the source mesh they're projected onto, and its CMYK texture.
+// NOTE: The source placement isn't included, surfels already carry it.
+uint64_t projectGetColorTransferKey(ldiProjectContext* Project) {
+	PROFILE_ZONE("Color transfer key");
+
+	int adaptive = Project->surfelsAdaptiveTransfer;
+	uint64_t key = stageCacheKeyInit("colorTransfer", 2);
+	key = hashFnv1a(key, &adaptive, sizeof(int));
+	key = hashFnv1aVector(key, Project->surfels);
+	key = _projectHashModel(key, &Project->sourceModel);
+
+	return _projectHashImage(key, &Project->sourceTextureCmyk, 4);
+}
+
+// Smoothed normals: the surfels and the smoothing settings.
+uint64_t projectGetSurfelNormalsKey(ldiProjectContext* Project, ldiNormalSmoothSettings* Settings) {
+	PROFILE_ZONE("Surfel normals key");
+
+	uint64_t key = stageCacheKeyInit("surfelNormals", 1);
+	key = hashFnv1a(key, Settings, sizeof(ldiNormalSmoothSettings));
+
+	return hashFnv1aVector(key, Project->surfels);
+}
+
+bool projectFinalizeSurfels(ldiApp* AppContext, ldiProjectContext* Project) {
+	{
+		// NOTE: The preview texture is the only dense copy of the samples, and only lives on the GPU.
+		ldiImage samplesImage = {};
+		sampleAtlasCreateImage(&Project->surfelsSamples, PROJECT_SAMPLES_IMAGE_WIDTH, &samplesImage);
+
+		if (!gfxCreateTextureR8G8B8A8Basic(AppContext, &samplesImage, &Project->surfelsSamplesTexture, &Project->surfelsSamplesTextureSrv)) {
+			std::cout << "Could not create samples texture " << samplesImage.width << "x" << samplesImage.height << "\n";
+			Project->surfelsSamplesTexture = nullptr;
+			Project->surfelsSamplesTextureSrv = nullptr;
+		}
+
+		delete[] samplesImage.data;
 	}
 
-	Project->surfelsSpatialGrid = spatialGrid;
-	Project->surfelsBoundsMin = surfelsMin;
-	Project->surfelsBoundsMax = surfelsMax;
+	Project->surfelsRenderModel = gfxCreateNewSurfelRenderModel(AppContext, &Project->surfels);
+
+	//----------------------------------------------------------------------------------------------------
+	// Create spatial structure for surfels.
+	//----------------------------------------------------------------------------------------------------
+	geoBuildSurfelSpatialGrid(&Project->surfels, 0.03f, &Project->surfelsSpatialGrid, &Project->surfelsBoundsMin, &Project->surfelsBoundsMax);
+
+	//----------------------------------------------------------------------------------------------------
+	// Smooth normals for view planning.
+	//----------------------------------------------------------------------------------------------------
+	{
+		std::vector<vec3> positions(Project->surfels.size());
+
+		for (size_t i = 0; i < Project->surfels.size(); ++i) {
+			positions[i] = Project->surfels[i].position;
+		}
+
+		pointIndexBuild(&Project->surfelsPointIndex, positions.data(), (int)positions.size());
+
+		ldiNormalSmoothSettings smoothSettings = geoGetDefaultNormalSmoothSettings();
+		uint64_t stageKey = projectGetSurfelNormalsKey(Project, &smoothSettings);
+		FILE* file = stageCacheOpenRead(&Project->stageCache, "surfelNormals", stageKey);
+
+		if (file) {
+			deserialize(file, Project->surfelsSmoothedNormals);
+			fclose(file);
+		} else {
+			geoSmoothSurfelNormals(&Project->surfels, &Project->surfelsPointIndex, &smoothSettings, &Project->surfelsSmoothedNormals);
+
+			file = stageCacheBeginWrite(&Project->stageCache, "surfelNormals", stageKey);
+
+			if (file) {
+				serialize(file, Project->surfelsSmoothedNormals);
+				stageCacheEndWrite(&Project->stageCache, "surfelNormals", stageKey, file);
+			}
+		}
+	}
 
-	t0 = getTime() - t0;
-	std::cout << "Build surfel spatial grid: " << t0 * 1000.0f << " ms\n";
-	
 	Project->surfelsLoaded = true;
 
 	return true;
 }
 
 bool projectCreateSurfels(ldiApp* AppContext, ldiProjectContext* Project) {
+	PROFILE_ZONE("Project create surfels");
+
 	projectInvalidateSurfelData(AppContext, Project);
 
 	if (!Project->quadModelLoaded || !Project->sourceTextureLoaded) {
 		return false;
 	}
 
-	Project->surfelsSamplesRaw.width = 4096;
-	Project->surfelsSamplesRaw.height = Project->surfelsSamplesRaw.width;
-	Project->surfelsSamplesRaw.data = new uint8_t[Project->surfelsSamplesRaw.width * Project->surfelsSamplesRaw.width * 4];
-	memset(Project->surfelsSamplesRaw.data, 0, Project->surfelsSamplesRaw.width * Project->surfelsSamplesRaw.width * 4);
+	const int samplesTexWidth = PROJECT_SAMPLES_IMAGE_WIDTH;
+	const int samplesPerSide = PROJECT_SAMPLES_PER_SIDE;
 
-	geoCreateSurfelsNew(&Project->quadModel, &Project->surfels, Project->surfelsSamplesRaw.width, 4);
+	uint64_t surfelsKey = projectGetSurfelsKey(Project, samplesTexWidth, samplesPerSide);
+	FILE* file = stageCacheOpenRead(&Project->stageCache, "surfels", surfelsKey);
+
+	if (file) {
+		deserialize(file, Project->surfels);
+		fclose(file);
+	} else {
+		geoCreateSurfelsNew(&Project->quadModel, &Project->surfels, samplesTexWidth, samplesPerSide);
+
+		file = stageCacheBeginWrite(&Project->stageCache, "surfels", surfelsKey);
+
+		if (file) {
+			serialize(file, Project->surfels);
+			stageCacheEndWrite(&Project->stageCache, "surfels", surfelsKey, file);
+		}
+	}
 	//geoCreateSurfels(&Project->quadModel, &Project->surfelsLow);
 	//geoCreateSurfelsHigh(&Project->quadModel, &Project->surfelsHigh);
 	//std::cout << "High res surfel count: " << Project->surfelsHigh.size() << "\n";
 
-	physicsCookMesh(AppContext->physics, &Project->sourceModel, &Project->sourceCookedModel);
+	// NOTE: Always cooked, even when the transfer below is cached, the surfel data owns it.
+	{
+		PROFILE_ZONE("Cook source mesh");
+		physicsCookMesh(AppContext->physics, &Project->sourceModel, &Project->sourceCookedModel);
+	}
+
+	uint64_t transferKey = projectGetColorTransferKey(Project);
+	file = stageCacheOpenRead(&Project->stageCache, "colorTransfer", transferKey);
+	bool transferCached = false;
+
+	if (file) {
+		transferCached = sampleAtlasDeserialize(file, &Project->surfelsSamples);
+		fclose(file);
+	}
+
+	if (!transferCached) {
+		geoTransferColorToSurfels(AppContext, &Project->sourceCookedModel, &Project->sourceModel, &Project->sourceTextureCmyk, &Project->surfels, &Project->surfelsSamples, false, Project->surfelsAdaptiveTransfer);
 
-	geoTransferColorToSurfels(AppContext, &Project->sourceCookedModel, &Project->sourceModel, &Project->sourceTextureCmyk, &Project->surfels, &Project->surfelsSamplesRaw);
+		file = stageCacheBeginWrite(&Project->stageCache, "colorTransfer", transferKey);
+
+		if (file) {
+			sampleAtlasSerialize(file, &Project->surfelsSamples);
+			stageCacheEndWrite(&Project->stageCache, "colorTransfer", transferKey, file);
+		}
+	}
 	
 	//geoTransferColorToSurfels(AppContext, &Project->sourceCookedModel, &Project->sourceModel, &Project->sourceTextureCmyk, &Project->surfelsHigh);
 	//geoTransferColorToSurfels(AppContext, &Project->sourceCookedModel, &Project->sourceModel, &Project->sourceTextureRaw, &Project->surfelsHigh);
 
-	//geoTransferColorToSurfels(AppContext, &Project->sourceCookedModel, &Project->sourceModel, &Project->sourceTextureRaw, &Project->surfelsNew, &Project->surfelsSamplesRaw);
-
-	//imageWrite("samplestest.png", 4096, 4096, 4, 4096 * 4, Project->surfelsSamplesRaw.data);
+	//geoTransferColorToSurfels(AppContext, &Project->sourceCookedModel, &Project->sourceModel, &Project->sourceTextureRaw, &Project->surfelsNew, &Project->surfelsSamples);
 
 	//----------------------------------------------------------------------------------------------------
 	// Create spatial structure for surfels.
@@ -964,45 +1350,6 @@ bool projectCreateSurfels(ldiApp* AppContext, ldiProjectContext* Project) {
 	t0 = getTime() - t0;
 	std::cout << "Build spatial grid: " << t0 * 1000.0f << " ms\n";*/
 
-	//----------------------------------------------------------------------------------------------------
-	// Smooth normals.
-	//----------------------------------------------------------------------------------------------------
-	//t0 = getTime();
-	//{
-	//	const int threadCount = 20;
-	//	int batchSize = Project->surfelsLow.size() / threadCount;
-	//	int batchRemainder = Project->surfelsLow.size() - (batchSize * threadCount);
-	//	std::thread workerThread[threadCount];
-
-	//	for (int n = 0; n < 4; ++n) {
-	//		for (int t = 0; t < threadCount; ++t) {
-	//			ldiSmoothNormalsThreadContext tc{};
-	//			tc.grid = &spatialGrid;
-	//			tc.surfels = &Project->surfelsLow;
-	//			tc.startIdx = t * batchSize;
-	//			tc.endIdx = (t + 1) * batchSize;
-
-	//			if (t == threadCount - 1) {
-	//				tc.endIdx += batchRemainder;
-	//			}
-
-	//			workerThread[t] = std::move(std::thread(surfelsSmoothNormalsThreadBatch, tc));
-	//		}
-
-	//		for (int t = 0; t < threadCount; ++t) {
-	//			workerThread[t].join();
-	//		}
-
-	//		// Apply smoothed normal back to surfel normal.
-	//		for (int i = 0; i < Project->surfelsLow.size(); ++i) {
-	//			ldiSurfel* srcSurfel = &Project->surfelsLow[i];
-	//			srcSurfel->normal = srcSurfel->smoothedNormal;
-	//		}
-	//	}
-	//}
-	//t0 = getTime() - t0;
-	//std::cout << "Normal smoothing: " << t0 * 1000.0f << " ms\n";
-
 	//Project->surfelLowRenderModel = gfxCreateSurfelRenderModel(AppContext, &Project->surfelsLow);
 	//Project->surfelHighRenderModel = gfxCreateSurfelRenderModel(AppContext, &Project->surfelsHigh, 0.001f, 0);
 	//Project->coveragePointModel = gfxCreateCoveragePointRenderModel(AppContext, &Project->surfelsLow, &Project->quadModel);
@@ -1013,6 +1360,7 @@ bool projectCreateSurfels(ldiApp* AppContext, ldiProjectContext* Project) {
 void _surfacePartitioning(ldiApp* AppContext, ldiProjectContext* Project) {
 	ldiSpatialGrid* grid = &Project->surfelsSpatialGrid;
 	std::vector<ldiNewSurfel>* surfels = &Project->surfels;
+	std::vector<vec3>* normals = &Project->surfelsSmoothedNormals;
 
 	std::vector<int> groupIds;
 	groupIds.resize(surfels->size());
@@ -1024,85 +1372,88 @@ void _surfacePartitioning(ldiApp* AppContext, ldiProjectContext* Project) {
 		std::vector<int> surfelIds;
 	};
 
-	double t0 = getTime();
-
 	std::vector<ldiSurfelGroup> surfelGroups;
-	surfelGroups.push_back({ 0, getRandomColorHighSaturation(), vec3Zero });
+	{
+		PROFILE_ZONE_LOG("Surfel grouping");
+		PROFILE_ITEMS(surfels->size());
 
-	for (size_t iterSeed = 0; iterSeed < surfels->size(); ++iterSeed) {
-		//for (size_t iterSeed = 0; iterSeed < 2000; ++iterSeed) {
-		if (groupIds[iterSeed] != 0) {
-			continue;
-		}
+		surfelGroups.push_back({ 0, getRandomColorHighSaturation(), vec3Zero });
+
+		for (size_t iterSeed = 0; iterSeed < surfels->size(); ++iterSeed) {
+			//for (size_t iterSeed = 0; iterSeed < 2000; ++iterSeed) {
+			if (groupIds[iterSeed] != 0) {
+				continue;
+			}
 
-		std::queue<int> surfelQueue;
-		surfelQueue.push(iterSeed);
-		surfelGroups.push_back({ (int)surfelGroups.size(), getRandomColorHighSaturation(), (*surfels)[iterSeed].normal });
-		ldiSurfelGroup* currentGroup = &surfelGroups.back();
+			std::queue<int> surfelQueue;
+			surfelQueue.push(iterSeed);
+			surfelGroups.push_back({ (int)surfelGroups.size(), getRandomColorHighSaturation(), (*normals)[iterSeed] });
+			ldiSurfelGroup* currentGroup = &surfelGroups.back();
 
-		while (true) {
-			std::vector<bool> groupProcessed;
-			groupProcessed.resize(surfels->size());
+			while (true) {
+				std::vector<bool> groupProcessed;
+				groupProcessed.resize(surfels->size());
 
-			int updateCount = 0;
+				int updateCount = 0;
 
-			while (!surfelQueue.empty()) {
-				int srcSurfelId = surfelQueue.front();
-				surfelQueue.pop();
+				while (!surfelQueue.empty()) {
+					int srcSurfelId = surfelQueue.front();
+					surfelQueue.pop();
 
-				if (groupProcessed[srcSurfelId]) {
-					continue;
-				}
+					if (groupProcessed[srcSurfelId]) {
+						continue;
+					}
 
-				groupProcessed[srcSurfelId] = true;
+					groupProcessed[srcSurfelId] = true;
 
-				ldiNewSurfel* srcSurfel = &(*surfels)[srcSurfelId];
-				groupIds[srcSurfelId] = currentGroup->id;
-				currentGroup->surfelIds.push_back(srcSurfelId);
+					ldiNewSurfel* srcSurfel = &(*surfels)[srcSurfelId];
+					groupIds[srcSurfelId] = currentGroup->id;
+					currentGroup->surfelIds.push_back(srcSurfelId);
 
-				vec3 cell = spatialGridGetCellFromWorldPosition(grid, srcSurfel->position);
+					vec3 cell = spatialGridGetCellFromWorldPosition(grid, srcSurfel->position);
 
-				int sX = (int)cell.x - 1;
-				int eX = sX + 3;
+					int sX = (int)cell.x - 1;
+					int eX = sX + 3;
 
-				int sY = (int)cell.y - 1;
-				int eY = sY + 3;
+					int sY = (int)cell.y - 1;
+					int eY = sY + 3;
 
-				int sZ = (int)cell.z - 1;
-				int eZ = sZ + 3;
+					int sZ = (int)cell.z - 1;
+					int eZ = sZ + 3;
 
-				sX = max(0, sX);
-				eX = min(grid->countX - 1, eX);
+					sX = max(0, sX);
+					eX = min(grid->countX - 1, eX);
 
-				sY = max(0, sY);
-				eY = min(grid->countY - 1, eY);
+					sY = max(0, sY);
+					eY = min(grid->countY - 1, eY);
 
-				sZ = max(0, sZ);
-				eZ = min(grid->countZ - 1, eZ);
+					sZ = max(0, sZ);
+					eZ = min(grid->countZ - 1, eZ);
 
-				float distVal = 0.03f;
+					float distVal = 0.03f;
 
-				for (int iZ = sZ; iZ <= eZ; ++iZ) {
-					for (int iY = sY; iY <= eY; ++iY) {
-						for (int iX = sX; iX <= eX; ++iX) {
-							ldiSpatialCellResult cellResult = spatialGridGetCell(grid, iX, iY, iZ);
-							for (int s = 0; s < cellResult.count; ++s) {
-								int surfelId = cellResult.data[s];
+					for (int iZ = sZ; iZ <= eZ; ++iZ) {
+						for (int iY = sY; iY <= eY; ++iY) {
+							for (int iX = sX; iX <= eX; ++iX) {
+								ldiSpatialCellResult cellResult = spatialGridGetCell(grid, iX, iY, iZ);
+								for (int s = 0; s < cellResult.count; ++s) {
+									int surfelId = cellResult.data[s];
 
-								if (groupIds[surfelId] == 0) {
-									ldiNewSurfel* dstSurfel = &(*surfels)[surfelId];
+									if (groupIds[surfelId] == 0) {
+										ldiNewSurfel* dstSurfel = &(*surfels)[surfelId];
 
-									float dist = glm::length(dstSurfel->position - srcSurfel->position);
+										float dist = glm::length(dstSurfel->position - srcSurfel->position);
 
-									if (dist <= distVal) {
-										float angle = glm::dot(glm::normalize(currentGroup->normal), dstSurfel->normal);
+										if (dist <= distVal) {
+											float angle = glm::dot(glm::normalize(currentGroup->normal), (*normals)[surfelId]);
 
-										if (angle > 0.866f) { // 30 degs
-											++updateCount;
-											currentGroup->normal += dstSurfel->normal;
-											surfelQueue.push(surfelId);
-											//groupIds[surfelId] = currentGroup->id;
-											//currentGroup->surfelIds.push_back(surfelId);
+											if (angle > 0.866f) { // 30 degs
+												++updateCount;
+												currentGroup->normal += (*normals)[surfelId];
+												surfelQueue.push(surfelId);
+												//groupIds[surfelId] = currentGroup->id;
+												//currentGroup->surfelIds.push_back(surfelId);
+											}
 										}
 									}
 								}
@@ -1110,38 +1461,35 @@ void _surfacePartitioning(ldiApp* AppContext, ldiProjectContext* Project) {
 						}
 					}
 				}
-			}
 
-			std::cout << "Update count: " << updateCount << "\n";
+				//std::cout << "Update count: " << updateCount << "\n";
 
-			if (updateCount > 0) {
-				for (size_t i = 0; i < currentGroup->surfelIds.size(); ++i) {
-					surfelQueue.push(currentGroup->surfelIds[i]);
+				if (updateCount > 0) {
+					for (size_t i = 0; i < currentGroup->surfelIds.size(); ++i) {
+						surfelQueue.push(currentGroup->surfelIds[i]);
+					}
+				} else {
+					break;
 				}
-			} else {
-				break;
 			}
 		}
-	}
-
-	/*surfelGroups.push_back({ (int)surfelGroups.size(), getRandomColorHighSaturation(), vec3Zero });
 
-	for (size_t i = 0; i < surfels->size(); ++i) {
-		ldiNewSurfel* srcSurfel = &(*surfels)[i];
+		/*surfelGroups.push_back({ (int)surfelGroups.size(), getRandomColorHighSaturation(), vec3Zero });
 
-		if (groupIds[i] != 0) {
-			continue;
-		}
+		for (size_t i = 0; i < surfels->size(); ++i) {
+			ldiNewSurfel* srcSurfel = &(*surfels)[i];
 
-		float angle = glm::dot(glm::normalize(surfelGroups[1].normal), srcSurfel->normal);
+			if (groupIds[i] != 0) {
+				continue;
+			}
 
-		if (angle > 0.9f) {
-			groupIds[i] = (int)surfelGroups.size();
-		}
-	}*/
+			float angle = glm::dot(glm::normalize(surfelGroups[1].normal), srcSurfel->normal);
 
-	t0 = getTime() - t0;
-	std::cout << "Surfel grouping in: " << t0 * 1000.0f << " ms\n";
+			if (angle > 0.9f) {
+				groupIds[i] = (int)surfelGroups.size();
+			}
+		}*/
+	}
 
 	for (size_t i = 0; i < Project->surfels.size(); ++i) {
 		if (groupIds[i] != 0) {
@@ -1166,6 +1514,8 @@ void _surfacePartitioning(ldiApp* AppContext, ldiProjectContext* Project) {
 }
 
 bool _surfelCoveragePrep(ldiApp* AppContext, ldiProjectContext* Project) {
+	PROFILE_ZONE("Surfel coverage prep");
+
 	{
 		D3D11_TEXTURE2D_DESC tex2dDesc = {};
 		tex2dDesc.Width = Project->toolViewSize;
@@ -1257,102 +1607,39 @@ bool _surfelCoveragePrep(ldiApp* AppContext, ldiProjectContext* Project) {
 }
 
 bool _surfelTracing(ldiApp* AppContext, ldiProjectContext* Project) {
-	ldiModel surfelTriModel = {};
-
-	int quadCount = Project->surfels.size();
-	int triCount = quadCount * 2;
-	int vertCount = quadCount * 4;
+	PROFILE_ZONE_LOG("Vis query");
+	PROFILE_ITEMS(Project->surfels.size());
 
-	surfelTriModel.verts.resize(vertCount);
-	surfelTriModel.indices.resize(triCount * 3);
-
-	for (int i = 0; i < (int)Project->surfels.size(); ++i) {
-		ldiNewSurfel* s = &Project->surfels[i];
-
-		surfelTriModel.verts[i * 4 + 0].pos = s->verts[0].position;
-		surfelTriModel.verts[i * 4 + 1].pos = s->verts[1].position;
-		surfelTriModel.verts[i * 4 + 2].pos = s->verts[2].position;
-		surfelTriModel.verts[i * 4 + 3].pos = s->verts[3].position;
+	Project->debugPoints.clear();
+	Project->debugLineSegs.clear();
 
-		surfelTriModel.indices[i * 6 + 0] = i * 4 + 2;
-		surfelTriModel.indices[i * 6 + 1] = i * 4 + 1;
-		surfelTriModel.indices[i * 6 + 2] = i * 4 + 0;
-		surfelTriModel.indices[i * 6 + 3] = i * 4 + 0;
-		surfelTriModel.indices[i * 6 + 4] = i * 4 + 3;
-		surfelTriModel.indices[i * 6 + 5] = i * 4 + 2;
+	// NOTE: Built on first use, it holds a copy of every quad and nothing else needs it.
+	if (Project->surfelsVis.entries.empty()) {
+		surfelVisBuild(&Project->surfelsVis, &Project->surfels);
 	}
 
-	ldiPhysicsMesh cookedSurfels = {};
-	physicsCookMesh(AppContext->physics, &surfelTriModel, &cookedSurfels);
+	// NOTE: Each surfel is tested along its own normal with the cone the PhysX query used.
+	ldiSurfelVisSettings settings = surfelVisGetDefaultSettings();
+	settings.tests = SVT_CONE;
 
-	double t0 = getTime();
+	std::vector<vec3> dirs(Project->surfels.size());
 
-	float normalAdjust = 0.005f;
-
-	Project->debugPoints.clear();
-	Project->debugLineSegs.clear();
-
-	ldiPhysicsCone cone = {};
-	if (!physicsCreateCone(AppContext->physics, 21.0f, 0.25f, 12, &cone)) {
-		return false;
+	for (size_t i = 0; i < Project->surfels.size(); ++i) {
+		dirs[i] = Project->surfels[i].normal;
 	}
 
+	std::vector<uint8_t> results;
+	surfelVisQueryDirs(&Project->surfelsVis, dirs.data(), &settings, &results);
+
 	for (int i = 0; i < (int)Project->surfels.size(); ++i) {
 		ldiNewSurfel* s = &Project->surfels[i];
-		vec3 startPos = s->position + s->normal * normalAdjust;
-
-		//ldiRaycastResult result = physicsRaycast(&cookedSurfels, startPos, s->normal, 20.15f);
-		//if (result.hit) {
-		//	//Project->debugLineSegs.push_back({ startPos, result.pos });
-
-		//	s->verts[0].color = vec3(1.0f, 0.0f, 0.0f);
-		//	s->verts[1].color = vec3(1.0f, 0.0f, 0.0f);
-		//	s->verts[2].color = vec3(1.0f, 0.0f, 0.0f);
-		//	s->verts[3].color = vec3(1.0f, 0.0f, 0.0f);
-		//} else {
-		//	s->verts[0].color = vec3(0.5f, 0.5f, 0.5f);
-		//	s->verts[1].color = vec3(0.5f, 0.5f, 0.5f);
-		//	s->verts[2].color = vec3(0.5f, 0.5f, 0.5f);
-		//	s->verts[3].color = vec3(0.5f, 0.5f, 0.5f);
-		//}
-
-		//if (physicsBeamOverlap(&cookedSurfels, startPos, s->normal, 0.02, 21.0f)) {
-		//	//vec3 start = outMat * vec4(0, 0, 0, 1.0f);
-		//	//vec3 end = outMat * vec4(1.0f, 0, 0, 1.0f);
-		//	//Project->debugLineSegs.push_back({ start, end });
-		//	//Project->debugLineSegs.push_back({ startPos, startPos + s->normal * (10.1f + 0.01f) });
-
-		//	s->verts[0].color = vec3(1.0f, 0.0f, 0.0f);
-		//	s->verts[1].color = vec3(1.0f, 0.0f, 0.0f);
-		//	s->verts[2].color = vec3(1.0f, 0.0f, 0.0f);
-		//	s->verts[3].color = vec3(1.0f, 0.0f, 0.0f);
-		//} else {
-		//	s->verts[0].color = vec3(0.5f, 0.5f, 0.5f);
-		//	s->verts[1].color = vec3(0.5f, 0.5f, 0.5f);
-		//	s->verts[2].color = vec3(0.5f, 0.5f, 0.5f);
-		//	s->verts[3].color = vec3(0.5f, 0.5f, 0.5f);
-		//}
-
-		//if (physicsConeOverlap(&cookedSurfels, &cone, startPos, s->normal)) {
-		//	//vec3 start = outMat * vec4(0, 0, 0, 1.0f);
-		//	//vec3 end = outMat * vec4(1.0f, 0, 0, 1.0f);
-		//	//Project->debugLineSegs.push_back({ start, end });
-		//	//Project->debugLineSegs.push_back({ startPos, startPos + s->normal * (10.1f + 0.01f) });
-
-		//	s->verts[0].color = vec3(1.0f, 0.0f, 0.0f);
-		//	s->verts[1].color = vec3(1.0f, 0.0f, 0.0f);
-		//	s->verts[2].color = vec3(1.0f, 0.0f, 0.0f);
-		//	s->verts[3].color = vec3(1.0f, 0.0f, 0.0f);
-		//} else {
-		//	s->verts[0].color = vec3(0.5f, 0.5f, 0.5f);
-		//	s->verts[1].color = vec3(0.5f, 0.5f, 0.5f);
-		//	s->verts[2].color = vec3(0.5f, 0.5f, 0.5f);
-		//	s->verts[3].color = vec3(0.5f, 0.5f, 0.5f);
-		//}
-	}
+		vec3 color = (results[i] & SVR_CONE) ? vec3(1.0f, 0.0f, 0.0f) : vec3(0.5f, 0.5f, 0.5f);
 
-	t0 = getTime() - t0;
-	std::cout << "Vis query time: " << (t0 * 1000) << " ms\n";
+		s->verts[0].color = color;
+		s->verts[1].color = color;
+		s->verts[2].color = color;
+		s->verts[3].color = color;
+	}
 
 	Project->surfelsGroupRenderModel = gfxCreateQuadSurfelRenderModel(AppContext, &Project->surfels);
 
@@ -1360,6 +1647,8 @@ bool _surfelTracing(ldiApp* AppContext, ldiProjectContext* Project) {
 }
 
 bool projectProcess(ldiApp* AppContext, ldiProjectContext* Project) {
+	PROFILE_ZONE_LOG("Project process");
+
 	Project->processed = false;
 
 	if (!Project->surfelsLoaded) {
@@ -1415,13 +1704,15 @@ void projectSave(ldiApp* AppContext, ldiProjectContext* Project) {
 	fwrite(&Project->surfelsLoaded, sizeof(bool), 1, file);
 	if (Project->surfelsLoaded) {
 		serialize(file, Project->surfels);
-		serialize(file, &Project->surfelsSamplesRaw, 4);
+		sampleAtlasSerialize(file, &Project->surfelsSamples);
 	}
 
 	fclose(file);
 }
 
 bool projectLoad(ldiApp* AppContext, ldiProjectContext* Project, const std::string& Path) {
+	PROFILE_ZONE_LOG("Project load");
+
 	std::cout << "Loading project: " << Project->path << "\n";
 
 	projectInit(AppContext, Project);
@@ -1446,6 +1737,7 @@ bool projectLoad(ldiApp* AppContext, ldiProjectContext* Project, const std::stri
 	if (Project->sourceTextureLoaded) {
 		deserialize(file, &Project->sourceTextureRaw, 4);
 		deserialize(file, &Project->sourceTextureCmyk, 4);
+		colorCreateCmykPreviews(&Project->sourceTextureCmyk, Project->sourceTextureCmykChannels);
 		projectFinalizeImportedTexture(AppContext, Project);
 	}
 
@@ -1458,8 +1750,54 @@ bool projectLoad(ldiApp* AppContext, ldiProjectContext* Project, const std::stri
 	fread(&Project->surfelsLoaded, sizeof(bool), 1, file);
 	if (Project->surfelsLoaded) {
 		deserialize(file, Project->surfels);
-		deserialize(file, &Project->surfelsSamplesRaw, 4);
-		projectFinalizeSurfels(AppContext, Project);
+
+		uint32_t samplesMagic = 0;
+		fread(&samplesMagic, sizeof(uint32_t), 1, file);
+		fseek(file, -(long)sizeof(uint32_t), SEEK_CUR);
+
+		bool samplesLoaded = false;
+
+		if (samplesMagic == SAMPLE_ATLAS_MAGIC) {
+			samplesLoaded = sampleAtlasDeserialize(file, &Project->surfelsSamples);
+		} else {
+			// NOTE: Older projects stored the samples as the dense 4096 x 4096 tile image, tile I at I % 1024, I / 1024.
+			ldiImage samplesImage = {};
+			fread(&samplesImage.width, sizeof(int), 1, file);
+			fread(&samplesImage.height, sizeof(int), 1, file);
+
+			if (samplesImage.width == PROJECT_SAMPLES_IMAGE_WIDTH && samplesImage.height == PROJECT_SAMPLES_IMAGE_WIDTH) {
+				size_t size = (size_t)samplesImage.width * samplesImage.height * 4;
+				samplesImage.data = new uint8_t[size];
+
+				if (fread(samplesImage.data, size, 1, file) == 1) {
+					int surfelCount = (int)Project->surfels.size();
+					sampleAtlasFromImage(&Project->surfelsSamples, &samplesImage, PROJECT_SAMPLES_PER_SIDE, surfelCount);
+
+					// NOTE: Surfel UVs addressed the square image, the atlas image is only as tall as the surfels need.
+					float uvScaleY = (float)samplesImage.height / sampleAtlasGetImageHeight(surfelCount, PROJECT_SAMPLES_PER_SIDE, PROJECT_SAMPLES_IMAGE_WIDTH);
+
+					for (int i = 0; i < surfelCount; ++i) {
+						for (int v = 0; v < 4; ++v) {
+							Project->surfels[i].verts[v].uv.y *= uvScaleY;
+						}
+					}
+
+					samplesLoaded = true;
+				}
+
+				delete[] samplesImage.data;
+			}
+		}
+
+		// NOTE: Everything before the surfels is already loaded, so a bad sample block only drops the surfels.
+		if (samplesLoaded) {
+			projectFinalizeSurfels(AppContext, Project);
+		} else {
+			std::cout << "Could not load surfel samples, surfels need to be created again\n";
+			sampleAtlasDestroy(&Project->surfelsSamples);
+			Project->surfels.clear();
+			Project->surfelsLoaded = false;
+		}
 	}
 
 	fclose(file);
@@ -1698,6 +2036,8 @@ void projectShowUi(ldiApp* AppContext, ldiProjectContext* Project, ldiCamera* Te
 		}
 
 		if (ImGui::CollapsingHeader("Source texture")) {
+			ImGui::Checkbox("Fast CMYK conversion (LUT)", &Project->sourceTextureUseLut);
+
 			if (ImGui::Button("Import texture")) {
 				std::string filePath;
 				if (showOpenFileDialog(AppContext->hWnd, AppContext->currentWorkingDir, filePath, L"PNG file", L"*.png")) {
@@ -1770,13 +2110,22 @@ void projectShowUi(ldiApp* AppContext, ldiProjectContext* Project, ldiCamera* Te
 		}
 
 		if (ImGui::CollapsingHeader("Surfels")) {
+			ImGui::Checkbox("Adaptive transfer", &Project->surfelsAdaptiveTransfer);
+
 			if (ImGui::Button("Create surfels")) {
 				projectCreateSurfels(AppContext, Project);
 			}
 
-			if (Project->sourceTextureLoaded) {
-				float w = ImGui::GetContentRegionAvail().x;
-				ImGui::Image(Project->surfelsSamplesTextureSrv, ImVec2(w, w));
+			if (Project->surfelsLoaded) {
+				ldiSampleAtlas* samples = &Project->surfelsSamples;
+				int pageCount = sampleAtlasGetAllocatedPageCount(samples);
+				ImGui::Text("Sample pages: %d / %d (%.1f MB)", pageCount, (int)samples->pages.size(), pageCount * _sampleAtlasPageSize(samples) * 4.0 / (1024.0 * 1024.0));
+
+				if (Project->surfelsSamplesTextureSrv) {
+					float w = ImGui::GetContentRegionAvail().x;
+					int height = sampleAtlasGetImageHeight(samples->surfelCount, samples->samplesPerSide, PROJECT_SAMPLES_IMAGE_WIDTH);
+					ImGui::Image(Project->surfelsSamplesTextureSrv, ImVec2(w, w * height / PROJECT_SAMPLES_IMAGE_WIDTH));
+				}
 			}
 		}
 
@@ -1785,6 +2134,13 @@ void projectShowUi(ldiApp* AppContext, ldiProjectContext* Project, ldiCamera* Te
 				projectProcess(AppContext, Project);
 			}
 
+			ImGui::Checkbox("Use stage cache", &Project->stageCache.enabled);
+			ImGui::SameLine();
+			if (ImGui::Button("Clear stage cache")) {
+				stageCacheClear(&Project->stageCache);
+			}
+			ImGui::Text("Stage cache hits: %d misses: %d", Project->stageCache.hitCount, Project->stageCache.missCount);
+
 			ImGui::SliderFloat("Camera FOV X", &Project->fovX, 1.0f, 180.0f);
 			ImGui::SliderFloat("Camera FOV Y", &Project->fovY, 1.0f, 180.0f);
 		}
@@ -0,0 +1,264 @@
+#pragma once
+
+#include <atomic>
+
+//----------------------------------------------------------------------------------------------------
+// Lock-free single producer, single consumer ring buffer.
+//----------------------------------------------------------------------------------------------------
+// NOTE: Exactly one thread may call the write functions and exactly one thread may call the read
+// functions. Elements are fixed size and copied in and out as raw bytes. Read and write cursors are
+// monotonic element counters, the slot is cursor & (capacity - 1).
+//
+// The producer can wait for space on an auto-reset event that the consumer only signals when the
+// producer has flagged that it is about to sleep, so the fast path never makes a kernel call.
+
+struct ldiRingBuffer {
+	uint8_t*				data = nullptr;
+	int						elementSize = 0;
+	int64_t					capacity = 0;
+	int64_t					mask = 0;
+
+	// Written by the producer.
+	alignas(64) std::atomic_int64_t	writeCursor = 0;
+	std::atomic_int64_t		overflowCount = 0;
+	std::atomic_bool		producerWaiting = false;
+	int64_t					cachedReadCursor = 0;
+
+	// Written by the consumer.
+	alignas(64) std::atomic_int64_t	readCursor = 0;
+	int64_t					cachedWriteCursor = 0;
+
+	alignas(64) HANDLE		spaceAvailableEvent = NULL;
+};
+
+// Capacity is rounded up to a power of two.
+void ringBufferInit(ldiRingBuffer* Ring, int ElementSize, int64_t Capacity) {
+	int64_t capacity = 1;
+	while (capacity < Capacity) {
+		capacity <<= 1;
+	}
+
+	Ring->elementSize = ElementSize;
+	Ring->capacity = capacity;
+	Ring->mask = capacity - 1;
+	Ring->data = new uint8_t[capacity * ElementSize];
+	Ring->writeCursor = 0;
+	Ring->readCursor = 0;
+	Ring->overflowCount = 0;
+	Ring->producerWaiting = false;
+	Ring->cachedReadCursor = 0;
+	Ring->cachedWriteCursor = 0;
+	Ring->spaceAvailableEvent = CreateEvent(NULL, FALSE, FALSE, NULL);
+}
+
+void ringBufferDestroy(ldiRingBuffer* Ring) {
+	if (Ring->data) {
+		delete[] Ring->data;
+		Ring->data = nullptr;
+	}
+
+	if (Ring->spaceAvailableEvent) {
+		CloseHandle(Ring->spaceAvailableEvent);
+		Ring->spaceAvailableEvent = NULL;
+	}
+}
+
+// Copy between the ring and a linear buffer, handling the wrap at the end of the storage.
+inline void _ringBufferCopyIn(ldiRingBuffer* Ring, int64_t Cursor, const uint8_t* Src, int64_t Count) {
+	int64_t slot = Cursor & Ring->mask;
+	int64_t firstCount = min(Count, Ring->capacity - slot);
+
+	memcpy(Ring->data + slot * Ring->elementSize, Src, firstCount * Ring->elementSize);
+
+	if (firstCount < Count) {
+		memcpy(Ring->data, Src + firstCount * Ring->elementSize, (Count - firstCount) * Ring->elementSize);
+	}
+}
+
+inline void _ringBufferCopyOut(ldiRingBuffer* Ring, int64_t Cursor, uint8_t* Dst, int64_t Count) {
+	int64_t slot = Cursor & Ring->mask;
+	int64_t firstCount = min(Count, Ring->capacity - slot);
+
+	memcpy(Dst, Ring->data + slot * Ring->elementSize, firstCount * Ring->elementSize);
+
+	if (firstCount < Count) {
+		memcpy(Dst + firstCount * Ring->elementSize, Ring->data, (Count - firstCount) * Ring->elementSize);
+	}
+}
+
+//----------------------------------------------------------------------------------------------------
+// Producer.
+//----------------------------------------------------------------------------------------------------
+inline int64_t ringBufferGetFreeCount(ldiRingBuffer* Ring) {
+	int64_t write = Ring->writeCursor.load(std::memory_order_relaxed);
+	int64_t free = Ring->capacity - (write - Ring->cachedReadCursor);
+
+	if (free == 0) {
+		Ring->cachedReadCursor = Ring->readCursor.load(std::memory_order_acquire);
+		free = Ring->capacity - (write - Ring->cachedReadCursor);
+	}
+
+	return free;
+}
+
+// Position of the next element the producer will write.
+inline int64_t ringBufferGetWriteCursor(ldiRingBuffer* Ring) {
+	return Ring->writeCursor.load(std::memory_order_relaxed);
+}
+
+inline void _ringBufferPublish(ldiRingBuffer* Ring, int64_t NewWriteCursor) {
+	Ring->writeCursor.store(NewWriteCursor, std::memory_order_release);
+}
+
+// Write as many elements as fit without blocking. Elements that do not fit are dropped and counted
+// in overflowCount. Returns the number of elements written.
+int64_t ringBufferWrite(ldiRingBuffer* Ring, const void* Elements, int64_t Count) {
+	if (Count <= 0) {
+		return 0;
+	}
+
+	int64_t free = ringBufferGetFreeCount(Ring);
+
+	if (free < Count) {
+		Ring->cachedReadCursor = Ring->readCursor.load(std::memory_order_acquire);
+		free = Ring->capacity - (Ring->writeCursor.load(std::memory_order_relaxed) - Ring->cachedReadCursor);
+	}
+
+	int64_t writeCount = min(free, Count);
+
+	if (writeCount < Count) {
+		Ring->overflowCount.fetch_add(Count - writeCount, std::memory_order_relaxed);
+	}
+
+	if (writeCount == 0) {
+		return 0;
+	}
+
+	int64_t write = Ring->writeCursor.load(std::memory_order_relaxed);
+	_ringBufferCopyIn(Ring, write, (const uint8_t*)Elements, writeCount);
+	_ringBufferPublish(Ring, write + writeCount);
+
+	return writeCount;
+}
+
+// Block until free space is available or the timeout expires. Returns the free element count.
+int64_t ringBufferWaitForSpace(ldiRingBuffer* Ring, int TimeoutMs) {
+	int64_t free = ringBufferGetFreeCount(Ring);
+
+	if (free > 0) {
+		return free;
+	}
+
+	Ring->producerWaiting.store(true, std::memory_order_seq_cst);
+
+	// NOTE: Check again after flagging so a read that happened in between is not missed.
+	Ring->cachedReadCursor = Ring->readCursor.load(std::memory_order_seq_cst);
+	free = Ring->capacity - (Ring->writeCursor.load(std::memory_order_relaxed) - Ring->cachedReadCursor);
+
+	if (free == 0) {
+		WaitForSingleObject(Ring->spaceAvailableEvent, TimeoutMs);
+		Ring->cachedReadCursor = Ring->readCursor.load(std::memory_order_acquire);
+		free = Ring->capacity - (Ring->writeCursor.load(std::memory_order_relaxed) - Ring->cachedReadCursor);
+	}
+
+	Ring->producerWaiting.store(false, std::memory_order_relaxed);
+
+	return free;
+}
+
+// Write all elements, waiting for the consumer to make space. If the total wait exceeds the timeout
+// the remaining elements are dropped and counted in overflowCount. Returns the number written.
+int64_t ringBufferWriteWait(ldiRingBuffer* Ring, const void* Elements, int64_t Count, int TimeoutMs) {
+	const uint8_t* src = (const uint8_t*)Elements;
+	int64_t written = 0;
+	double startTime = getTime();
+
+	while (written < Count) {
+		int64_t free = ringBufferGetFreeCount(Ring);
+
+		if (free == 0) {
+			int remainingMs = TimeoutMs - (int)((getTime() - startTime) * 1000.0);
+
+			if (remainingMs <= 0) {
+				break;
+			}
+
+			free = ringBufferWaitForSpace(Ring, remainingMs);
+
+			if (free == 0) {
+				continue;
+			}
+		}
+
+		int64_t writeCount = min(free, Count - written);
+		int64_t write = Ring->writeCursor.load(std::memory_order_relaxed);
+		_ringBufferCopyIn(Ring, write, src + written * Ring->elementSize, writeCount);
+		_ringBufferPublish(Ring, write + writeCount);
+		written += writeCount;
+	}
+
+	if (written < Count) {
+		Ring->overflowCount.fetch_add(Count - written, std::memory_order_relaxed);
+	}
+
+	return written;
+}
+
+//----------------------------------------------------------------------------------------------------
+// Consumer.
+//----------------------------------------------------------------------------------------------------
+inline void _ringBufferRelease(ldiRingBuffer* Ring, int64_t NewReadCursor) {
+	Ring->readCursor.store(NewReadCursor, std::memory_order_seq_cst);
+
+	if (Ring->producerWaiting.load(std::memory_order_seq_cst)) {
+		Ring->producerWaiting.store(false, std::memory_order_relaxed);
+		SetEvent(Ring->spaceAvailableEvent);
+	}
+}
+
+// Copy out up to MaxCount elements. Returns the number of elements read.
+int64_t ringBufferRead(ldiRingBuffer* Ring, void* Elements, int64_t MaxCount) {
+	Ring->cachedWriteCursor = Ring->writeCursor.load(std::memory_order_acquire);
+
+	int64_t read = Ring->readCursor.load(std::memory_order_relaxed);
+	int64_t readCount = min(Ring->cachedWriteCursor - read, MaxCount);
+
+	if (readCount <= 0) {
+		return 0;
+	}
+
+	_ringBufferCopyOut(Ring, read, (uint8_t*)Elements, readCount);
+	_ringBufferRelease(Ring, read + readCount);
+
+	return readCount;
+}
+
+// Append everything currently available to a vector.
+template<class T> int64_t ringBufferReadAll(ldiRingBuffer* Ring, std::vector<T>& Elements) {
+	assert(sizeof(T) == Ring->elementSize);
+
+	Ring->cachedWriteCursor = Ring->writeCursor.load(std::memory_order_acquire);
+
+	int64_t read = Ring->readCursor.load(std::memory_order_relaxed);
+	int64_t readCount = Ring->cachedWriteCursor - read;
+
+	if (readCount <= 0) {
+		return 0;
+	}
+
+	size_t offset = Elements.size();
+	Elements.resize(offset + readCount);
+	_ringBufferCopyOut(Ring, read, (uint8_t*)&Elements[offset], readCount);
+	_ringBufferRelease(Ring, read + readCount);
+
+	return readCount;
+}
+
+// Discard elements up to, but not including, the given write cursor position.
+void ringBufferSkipTo(ldiRingBuffer* Ring, int64_t Cursor) {
+	int64_t read = Ring->readCursor.load(std::memory_order_relaxed);
+
+	if (Cursor > read) {
+		_ringBufferRelease(Ring, Cursor);
+	}
+}
@@ -0,0 +1,460 @@
+#pragma once
+
+#include <mutex>
+#include <intrin.h>
+
+//----------------------------------------------------------------------------------------------------
+// Calibration sample archive.
+//----------------------------------------------------------------------------------------------------
+// Single file holding many 8-bit sample frames with their axis positions. Frames are compressed
+// individually so any one can be read by index without touching the rest.
+//
+// Layout:
+//   ldiSampleArchiveHeader
+//   Packed frames, back to back.
+//   ldiSampleArchiveEntry[entryCount] at indexOffset.
+//
+// Frames are coded losslessly with the LOCO-I (MED) predictor and adaptive Rice codes on blocks of
+// residuals. Flat blocks cost a single bit, which covers the dark background in most calibration frames.
+
+#define SAMPLE_ARCHIVE_MAGIC 0x5241534C // 'LSAR'
+#define SAMPLE_ARCHIVE_VERSION 1
+#define SAMPLE_ARCHIVE_EXT ".lsa"
+
+#define SAMPLE_ARCHIVE_BLOCK_SIZE 16
+// NOTE: Rice quotients at or above this are escaped and stored as raw bytes.
+#define SAMPLE_ARCHIVE_RICE_ESCAPE 24
+
+enum ldiSampleArchiveCompression {
+	SAC_NONE = 0,
+	SAC_MED_RICE = 1,
+};
+
+struct ldiSampleArchiveHeader {
+	uint32_t	magic;
+	int			version;
+	int			entryCount;
+	int			reserved;
+	uint64_t	indexOffset;
+};
+
+struct ldiSampleArchiveEntry {
+	int			phase;
+	int			X;
+	int			Y;
+	int			Z;
+	int			C;
+	int			A;
+	int			width;
+	int			height;
+	int			compression;
+	int			reserved;
+	// NOTE: Same hash calibLoadCalibSampleData gives the equivalent .dat file.
+	uint64_t	contentHash;
+	uint64_t	offset;
+	uint64_t	packedSize;
+};
+
+struct ldiSampleArchive {
+	std::string							path;
+	FILE*								file = 0;
+	bool								writing = false;
+	// NOTE: Guards the file position, readers on other threads share one handle.
+	std::mutex							fileMutex;
+	std::vector<ldiSampleArchiveEntry>	entries;
+};
+
+//----------------------------------------------------------------------------------------------------
+// Bit streams.
+//----------------------------------------------------------------------------------------------------
+struct ldiBitWriter {
+	std::vector<uint8_t>*	data;
+	uint64_t				acc;
+	int						bitCount;
+};
+
+inline void _bitWriterPut(ldiBitWriter* Writer, uint32_t Value, int Bits) {
+	Writer->acc |= (uint64_t)Value << Writer->bitCount;
+	Writer->bitCount += Bits;
+
+	while (Writer->bitCount >= 8) {
+		Writer->data->push_back((uint8_t)Writer->acc);
+		Writer->acc >>= 8;
+		Writer->bitCount -= 8;
+	}
+}
+
+void _bitWriterFlush(ldiBitWriter* Writer) {
+	if (Writer->bitCount > 0) {
+		Writer->data->push_back((uint8_t)Writer->acc);
+	}
+
+	// NOTE: Padding so the reader can always refill a full word.
+	for (int i = 0; i < 8; ++i) {
+		Writer->data->push_back(0);
+	}
+
+	Writer->acc = 0;
+	Writer->bitCount = 0;
+}
+
+struct ldiBitReader {
+	const uint8_t*			data;
+	const uint8_t*			end;
+	uint64_t				acc;
+	int						bitCount;
+	// NOTE: Bytes asked for past the end. Writers pad enough that valid streams never get here.
+	int						overrun;
+};
+
+inline void _bitReaderRefill(ldiBitReader* Reader) {
+	if (Reader->end - Reader->data >= 8) {
+		// NOTE: Whole word load. Bytes past the last whole one are read again next time, which is harmless.
+		uint64_t word;
+		memcpy(&word, Reader->data, 8);
+		Reader->acc |= word << Reader->bitCount;
+		Reader->data += (63 - Reader->bitCount) >> 3;
+		Reader->bitCount |= 56;
+		return;
+	}
+
+	while (Reader->bitCount <= 56) {
+		uint64_t byte = 0;
+
+		if (Reader->data < Reader->end) {
+			byte = *Reader->data++;
+		} else {
+			++Reader->overrun;
+		}
+
+		Reader->acc |= byte << Reader->bitCount;
+		Reader->bitCount += 8;
+	}
+}
+
+inline uint32_t _bitReaderGet(ldiBitReader* Reader, int Bits) {
+	uint32_t result = (uint32_t)(Reader->acc & ((1ull << Bits) - 1));
+	Reader->acc >>= Bits;
+	Reader->bitCount -= Bits;
+
+	return result;
+}
+
+//----------------------------------------------------------------------------------------------------
+// Frame codec.
+//----------------------------------------------------------------------------------------------------
+inline int _sampleArchivePredict(const uint8_t* Row, const uint8_t* PrevRow, int X) {
+	if (PrevRow == nullptr) {
+		return (X == 0) ? 0 : Row[X - 1];
+	}
+
+	if (X == 0) {
+		return PrevRow[0];
+	}
+
+	int a = Row[X - 1];
+	int b = PrevRow[X];
+	int c = PrevRow[X - 1];
+
+	// NOTE: MED is the median of a, b and a + b - c. Written this way it has no branches, residuals from
+	// sensor noise make the usual form mispredict constantly.
+	return max(min(a, b), min(max(a, b), a + b - c));
+}
+
+// Residuals wrap at 8 bits and are zigzagged so small values of either sign get short codes.
+inline uint32_t _sampleArchiveZigzag(int Pixel, int Prediction) {
+	int d = (int8_t)(uint8_t)(Pixel - Prediction);
+	return (d >= 0) ? (uint32_t)(d * 2) : (uint32_t)(-d * 2 - 1);
+}
+
+inline uint8_t _sampleArchiveUnzigzag(uint32_t Value, int Prediction) {
+	int d = (Value & 1) ? -(int)((Value + 1) >> 1) : (int)(Value >> 1);
+	return (uint8_t)(Prediction + d);
+}
+
+int _sampleArchiveRiceCost(const uint32_t* Values, int Count, int K) {
+	int cost = 0;
+
+	for (int i = 0; i < Count; ++i) {
+		uint32_t q = Values[i] >> K;
+		cost += (q < SAMPLE_ARCHIVE_RICE_ESCAPE) ? (int)q + 1 + K : SAMPLE_ARCHIVE_RICE_ESCAPE + 8;
+	}
+
+	return cost;
+}
+
+void sampleArchiveEncodeFrame(ldiImage* Image, std::vector<uint8_t>& Packed) {
+	Packed.clear();
+	Packed.reserve(Image->width * Image->height / 2);
+
+	ldiBitWriter writer = {};
+	writer.data = &Packed;
+
+	uint32_t block[SAMPLE_ARCHIVE_BLOCK_SIZE];
+
+	for (int iY = 0; iY < Image->height; ++iY) {
+		const uint8_t* row = Image->data + iY * Image->width;
+		const uint8_t* prevRow = (iY > 0) ? row - Image->width : nullptr;
+
+		for (int blockX = 0; blockX < Image->width; blockX += SAMPLE_ARCHIVE_BLOCK_SIZE) {
+			int count = min(SAMPLE_ARCHIVE_BLOCK_SIZE, Image->width - blockX);
+			uint32_t blockSum = 0;
+
+			for (int i = 0; i < count; ++i) {
+				int x = blockX + i;
+				block[i] = _sampleArchiveZigzag(row[x], _sampleArchivePredict(row, prevRow, x));
+				blockSum += block[i];
+			}
+
+			if (blockSum == 0) {
+				_bitWriterPut(&writer, 0, 1);
+				continue;
+			}
+
+			// NOTE: Best K is within one of log2 of the mean residual.
+			int meanK = 0;
+			while (meanK < 7 && ((uint32_t)count << (meanK + 1)) <= blockSum) {
+				++meanK;
+			}
+
+			int bestK = max(meanK - 1, 0);
+			int bestCost = _sampleArchiveRiceCost(block, count, bestK);
+
+			for (int k = bestK + 1; k <= min(meanK + 1, 7); ++k) {
+				int cost = _sampleArchiveRiceCost(block, count, k);
+
+				if (cost < bestCost) {
+					bestCost = cost;
+					bestK = k;
+				}
+			}
+
+			_bitWriterPut(&writer, 1 | (bestK << 1), 4);
+
+			for (int i = 0; i < count; ++i) {
+				uint32_t q = block[i] >> bestK;
+
+				if (q < SAMPLE_ARCHIVE_RICE_ESCAPE) {
+					_bitWriterPut(&writer, (1u << q) - 1, q + 1);
+					_bitWriterPut(&writer, block[i] & ((1u << bestK) - 1), bestK);
+				} else {
+					_bitWriterPut(&writer, (1u << SAMPLE_ARCHIVE_RICE_ESCAPE) - 1, SAMPLE_ARCHIVE_RICE_ESCAPE);
+					_bitWriterPut(&writer, block[i], 8);
+				}
+			}
+		}
+	}
+
+	_bitWriterFlush(&writer);
+}
+
+// Image must already be allocated at the frame size.
+bool sampleArchiveDecodeFrame(const uint8_t* Packed, size_t PackedSize, ldiImage* Image) {
+	ldiBitReader reader = {};
+	reader.data = Packed;
+	reader.end = Packed + PackedSize;
+
+	for (int iY = 0; iY < Image->height; ++iY) {
+		uint8_t* row = Image->data + iY * Image->width;
+		const uint8_t* prevRow = (iY > 0) ? row - Image->width : nullptr;
+
+		for (int blockX = 0; blockX < Image->width; blockX += SAMPLE_ARCHIVE_BLOCK_SIZE) {
+			int count = min(SAMPLE_ARCHIVE_BLOCK_SIZE, Image->width - blockX);
+
+			_bitReaderRefill(&reader);
+
+			if (_bitReaderGet(&reader, 1) == 0) {
+				for (int i = 0; i < count; ++i) {
+					int x = blockX + i;
+					row[x] = (uint8_t)_sampleArchivePredict(row, prevRow, x);
+				}
+
+				continue;
+			}
+
+			int k = (int)_bitReaderGet(&reader, 3);
+
+			for (int i = 0; i < count; ++i) {
+				_bitReaderRefill(&reader);
+
+				// NOTE: Valid streams never have more than an escape's worth of ones in a row, so there is a zero.
+				unsigned long q;
+				_BitScanForward64(&q, ~reader.acc);
+
+				uint32_t value;
+
+				if (q < SAMPLE_ARCHIVE_RICE_ESCAPE) {
+					// NOTE: Quotient and its terminating zero.
+					_bitReaderGet(&reader, q + 1);
+					value = (q << k) | _bitReaderGet(&reader, k);
+				} else {
+					_bitReaderGet(&reader, SAMPLE_ARCHIVE_RICE_ESCAPE);
+					value = _bitReaderGet(&reader, 8);
+				}
+
+				int x = blockX + i;
+				row[x] = _sampleArchiveUnzigzag(value, _sampleArchivePredict(row, prevRow, x));
+			}
+		}
+
+		if (reader.overrun > 0) {
+			std::cout << "Sample archive frame data truncated\n";
+			return false;
+		}
+	}
+
+	return true;
+}
+
+//----------------------------------------------------------------------------------------------------
+// Archive files.
+//----------------------------------------------------------------------------------------------------
+bool sampleArchiveCreate(ldiSampleArchive* Archive, const std::string& Path) {
+	Archive->path = Path;
+	Archive->entries.clear();
+	Archive->writing = true;
+
+	fopen_s(&Archive->file, Path.c_str(), "wb");
+
+	if (Archive->file == 0) {
+		std::cout << "Could not create sample archive: " << Path << "\n";
+		return false;
+	}
+
+	// NOTE: Placeholder, the real header is written on close once the index is known.
+	ldiSampleArchiveHeader header = {};
+	fwrite(&header, sizeof(ldiSampleArchiveHeader), 1, Archive->file);
+
+	return true;
+}
+
+// Appends an already packed frame. Entry offset and packed size are filled in here.
+void sampleArchiveAddPacked(ldiSampleArchive* Archive, ldiSampleArchiveEntry* Entry, const std::vector<uint8_t>& Packed) {
+	std::unique_lock<std::mutex> lock(Archive->fileMutex);
+
+	ldiSampleArchiveEntry entry = *Entry;
+	entry.offset = (uint64_t)_ftelli64(Archive->file);
+	entry.packedSize = Packed.size();
+
+	fwrite(Packed.data(), 1, Packed.size(), Archive->file);
+	Archive->entries.push_back(entry);
+}
+
+// Compresses a frame for sampleArchiveAddPacked. Entry axis positions are left as they are, everything
+// else that describes the frame is filled in.
+void sampleArchivePackFrame(ldiImage* Image, ldiSampleArchiveEntry* Entry, std::vector<uint8_t>& Packed) {
+	Entry->width = Image->width;
+	Entry->height = Image->height;
+	Entry->compression = SAC_MED_RICE;
+
+	int header[8] = { Entry->phase, Entry->X, Entry->Y, Entry->Z, Entry->C, Entry->A, Image->width, Image->height };
+	Entry->contentHash = hashFnv1a(HASH_FNV1A_SEED, header, sizeof(header));
+	Entry->contentHash = hashFnv1a(Entry->contentHash, Image->data, (size_t)Image->width * Image->height);
+
+	sampleArchiveEncodeFrame(Image, Packed);
+
+	// NOTE: Noisy frames can code larger than raw, store those as is.
+	if (Packed.size() >= (size_t)Image->width * Image->height) {
+		Entry->compression = SAC_NONE;
+		Packed.assign(Image->data, Image->data + Image->width * Image->height);
+	}
+}
+
+// Compresses and appends a frame. Returns the entry index.
+int sampleArchiveAdd(ldiSampleArchive* Archive, ldiImage* Image, int X, int Y, int Z, int C, int A, int Phase) {
+	ldiSampleArchiveEntry entry = {};
+	entry.phase = Phase;
+	entry.X = X;
+	entry.Y = Y;
+	entry.Z = Z;
+	entry.C = C;
+	entry.A = A;
+
+	std::vector<uint8_t> packed;
+	sampleArchivePackFrame(Image, &entry, packed);
+	sampleArchiveAddPacked(Archive, &entry, packed);
+
+	return (int)Archive->entries.size() - 1;
+}
+
+bool sampleArchiveOpen(ldiSampleArchive* Archive, const std::string& Path) {
+	Archive->path = Path;
+	Archive->entries.clear();
+	Archive->writing = false;
+
+	fopen_s(&Archive->file, Path.c_str(), "rb");
+
+	if (Archive->file == 0) {
+		std::cout << "Could not open sample archive: " << Path << "\n";
+		return false;
+	}
+
+	ldiSampleArchiveHeader header = {};
+	fread(&header, sizeof(ldiSampleArchiveHeader), 1, Archive->file);
+
+	if (header.magic != SAMPLE_ARCHIVE_MAGIC || header.version != SAMPLE_ARCHIVE_VERSION) {
+		std::cout << "Not a valid sample archive: " << Path << "\n";
+		fclose(Archive->file);
+		Archive->file = 0;
+		return false;
+	}
+
+	Archive->entries.resize(header.entryCount);
+	_fseeki64(Archive->file, (int64_t)header.indexOffset, SEEK_SET);
+	fread(Archive->entries.data(), sizeof(ldiSampleArchiveEntry), header.entryCount, Archive->file);
+
+	return true;
+}
+
+// Writes the index when the archive was created for writing.
+void sampleArchiveClose(ldiSampleArchive* Archive) {
+	if (Archive->file == 0) {
+		return;
+	}
+
+	if (Archive->writing) {
+		ldiSampleArchiveHeader header = {};
+		header.magic = SAMPLE_ARCHIVE_MAGIC;
+		header.version = SAMPLE_ARCHIVE_VERSION;
+		header.entryCount = (int)Archive->entries.size();
+		header.indexOffset = (uint64_t)_ftelli64(Archive->file);
+
+		fwrite(Archive->entries.data(), sizeof(ldiSampleArchiveEntry), Archive->entries.size(), Archive->file);
+		_fseeki64(Archive->file, 0, SEEK_SET);
+		fwrite(&header, sizeof(ldiSampleArchiveHeader), 1, Archive->file);
+	}
+
+	fclose(Archive->file);
+	Archive->file = 0;
+	Archive->writing = false;
+}
+
+// Reads the packed bytes of a frame. Safe to call from several threads.
+bool sampleArchiveReadPacked(ldiSampleArchive* Archive, int Index, std::vector<uint8_t>& Packed) {
+	if (Index < 0 || Index >= (int)Archive->entries.size()) {
+		std::cout << "Sample archive index out of range: " << Index << "\n";
+		return false;
+	}
+
+	ldiSampleArchiveEntry* entry = &Archive->entries[Index];
+	Packed.resize(entry->packedSize);
+
+	std::unique_lock<std::mutex> lock(Archive->fileMutex);
+	_fseeki64(Archive->file, (int64_t)entry->offset, SEEK_SET);
+
+	return fread(Packed.data(), 1, Packed.size(), Archive->file) == Packed.size();
+}
+
+// Image must already be allocated at the entry frame size.
+bool sampleArchiveUnpack(ldiSampleArchiveEntry* Entry, const std::vector<uint8_t>& Packed, ldiImage* Image) {
+	if (Entry->compression == SAC_NONE) {
+		if (Packed.size() != (size_t)Image->width * Image->height) {
+			return false;
+		}
+
+		memcpy(Image->data, Packed.data(), Packed.size());
+		return true;
+	}
+
+	return sampleArchiveDecodeFrame(Packed.data(), Packed.size(), Image);
+}
\ No newline at end of file
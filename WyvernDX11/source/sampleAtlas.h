@@ -0,0 +1,294 @@
+#pragma once
+
+//----------------------------------------------------------------------------------------------------
+// Sample atlas.
+//----------------------------------------------------------------------------------------------------
+// Sparse storage for the color samples of each surfel.
+//
+// Every surfel owns a footprint of SamplesPerSide x SamplesPerSide RGBA8 samples, row major. Footprints are
+// stored by surfel id in fixed size pages of SAMPLE_ATLAS_PAGE_SURFELS surfels. Pages are only allocated for
+// the surfel ranges passed to sampleAtlasAllocRange, and only those are saved. There is no upper limit on the
+// surfel count.
+//
+// For display the footprints are laid out as tiles in a 2D image, tile I at column I % (Width / SamplesPerSide)
+// and row I / (Width / SamplesPerSide), and the image is only as tall as the surfel count needs.
+
+#define SAMPLE_ATLAS_PAGE_SURFELS 4096
+#define SAMPLE_ATLAS_MAGIC 0x534C5441
+
+struct ldiSampleAtlas {
+	int									samplesPerSide;
+	// Samples in one footprint.
+	int									footprintSize;
+	int									surfelCount;
+	// Null until allocated.
+	std::vector<uint32_t*>				pages;
+};
+
+void sampleAtlasInit(ldiSampleAtlas* Atlas, int SamplesPerSide) {
+	Atlas->samplesPerSide = SamplesPerSide;
+	Atlas->footprintSize = SamplesPerSide * SamplesPerSide;
+	Atlas->surfelCount = 0;
+	Atlas->pages.clear();
+}
+
+void sampleAtlasDestroy(ldiSampleAtlas* Atlas) {
+	for (size_t i = 0; i < Atlas->pages.size(); ++i) {
+		delete[] Atlas->pages[i];
+	}
+
+	Atlas->pages.clear();
+	Atlas->pages.shrink_to_fit();
+	Atlas->surfelCount = 0;
+}
+
+inline size_t _sampleAtlasPageSize(ldiSampleAtlas* Atlas) {
+	return (size_t)SAMPLE_ATLAS_PAGE_SURFELS * Atlas->footprintSize;
+}
+
+// Makes room for surfels up to SurfelCount without allocating any pages.
+void sampleAtlasResize(ldiSampleAtlas* Atlas, int SurfelCount) {
+	int pageCount = (SurfelCount + SAMPLE_ATLAS_PAGE_SURFELS - 1) / SAMPLE_ATLAS_PAGE_SURFELS;
+
+	for (int i = pageCount; i < (int)Atlas->pages.size(); ++i) {
+		delete[] Atlas->pages[i];
+	}
+
+	Atlas->pages.resize(pageCount, nullptr);
+	Atlas->surfelCount = SurfelCount;
+}
+
+// Allocates the pages for surfels First to First + Count, growing the atlas if needed. New samples are zero.
+// NOTE: Not thread safe, allocate before handing ranges to worker threads.
+void sampleAtlasAllocRange(ldiSampleAtlas* Atlas, int First, int Count) {
+	if (Count <= 0) {
+		return;
+	}
+
+	if (First + Count > Atlas->surfelCount) {
+		sampleAtlasResize(Atlas, First + Count);
+	}
+
+	int firstPage = First / SAMPLE_ATLAS_PAGE_SURFELS;
+	int lastPage = (First + Count - 1) / SAMPLE_ATLAS_PAGE_SURFELS;
+	size_t pageSize = _sampleAtlasPageSize(Atlas);
+
+	for (int i = firstPage; i <= lastPage; ++i) {
+		if (!Atlas->pages[i]) {
+			Atlas->pages[i] = new uint32_t[pageSize];
+			memset(Atlas->pages[i], 0, pageSize * sizeof(uint32_t));
+		}
+	}
+}
+
+// Footprint of SurfelId, null if its page isn't allocated.
+inline uint32_t* sampleAtlasGetFootprint(ldiSampleAtlas* Atlas, int SurfelId) {
+	if (SurfelId < 0 || SurfelId >= Atlas->surfelCount) {
+		return nullptr;
+	}
+
+	uint32_t* page = Atlas->pages[SurfelId / SAMPLE_ATLAS_PAGE_SURFELS];
+
+	if (!page) {
+		return nullptr;
+	}
+
+	return page + (size_t)(SurfelId % SAMPLE_ATLAS_PAGE_SURFELS) * Atlas->footprintSize;
+}
+
+// Zero for samples that were never written.
+inline uint32_t sampleAtlasGetSample(ldiSampleAtlas* Atlas, int SurfelId, int X, int Y) {
+	uint32_t* footprint = sampleAtlasGetFootprint(Atlas, SurfelId);
+
+	if (!footprint) {
+		return 0;
+	}
+
+	return footprint[X + Y * Atlas->samplesPerSide];
+}
+
+int sampleAtlasGetAllocatedPageCount(ldiSampleAtlas* Atlas) {
+	int result = 0;
+
+	for (size_t i = 0; i < Atlas->pages.size(); ++i) {
+		if (Atlas->pages[i]) {
+			++result;
+		}
+	}
+
+	return result;
+}
+
+//----------------------------------------------------------------------------------------------------
+// Image layout.
+//----------------------------------------------------------------------------------------------------
+// Height of an image Width wide that holds a tile for each of SurfelCount surfels.
+int sampleAtlasGetImageHeight(int SurfelCount, int SamplesPerSide, int Width) {
+	int tilesPerRow = Width / SamplesPerSide;
+	int rows = max((SurfelCount + tilesPerRow - 1) / tilesPerRow, 1);
+
+	return rows * SamplesPerSide;
+}
+
+struct _ldiSampleAtlasImageContext {
+	ldiSampleAtlas*						atlas;
+	ldiImage*							image;
+	int									tilesPerRow;
+};
+
+void _sampleAtlasImageBatch(int StartIdx, int EndIdx, void* UserData) {
+	_ldiSampleAtlasImageContext* context = (_ldiSampleAtlasImageContext*)UserData;
+	ldiSampleAtlas* atlas = context->atlas;
+	uint32_t* pixels = (uint32_t*)context->image->data;
+	int sps = atlas->samplesPerSide;
+
+	for (int i = StartIdx; i < EndIdx; ++i) {
+		uint32_t* footprint = sampleAtlasGetFootprint(atlas, i);
+
+		if (!footprint) {
+			continue;
+		}
+
+		int tileX = i % context->tilesPerRow;
+		int tileY = i / context->tilesPerRow;
+
+		for (int y = 0; y < sps; ++y) {
+			uint32_t* dst = pixels + (size_t)(tileY * sps + y) * context->image->width + tileX * sps;
+			memcpy(dst, footprint + y * sps, sps * sizeof(uint32_t));
+		}
+	}
+}
+
+// Lays all footprints out as tiles in an RGBA8 image Width wide, unallocated tiles are zero.
+void sampleAtlasCreateImage(ldiSampleAtlas* Atlas, int Width, ldiImage* Result) {
+	PROFILE_ZONE("Sample atlas image");
+
+	Result->width = Width;
+	Result->height = sampleAtlasGetImageHeight(Atlas->surfelCount, Atlas->samplesPerSide, Width);
+
+	size_t pixelCount = (size_t)Result->width * Result->height;
+	Result->data = new uint8_t[pixelCount * 4];
+	memset(Result->data, 0, pixelCount * 4);
+
+	_ldiSampleAtlasImageContext context = {};
+	context.atlas = Atlas;
+	context.image = Result;
+	context.tilesPerRow = Width / Atlas->samplesPerSide;
+
+	parallelFor(0, Atlas->surfelCount, 1024, _sampleAtlasImageBatch, &context);
+}
+
+void _sampleAtlasFromImageBatch(int StartIdx, int EndIdx, void* UserData) {
+	_ldiSampleAtlasImageContext* context = (_ldiSampleAtlasImageContext*)UserData;
+	ldiSampleAtlas* atlas = context->atlas;
+	uint32_t* pixels = (uint32_t*)context->image->data;
+	int sps = atlas->samplesPerSide;
+
+	for (int i = StartIdx; i < EndIdx; ++i) {
+		uint32_t* footprint = sampleAtlasGetFootprint(atlas, i);
+		int tileX = i % context->tilesPerRow;
+		int tileY = i / context->tilesPerRow;
+
+		for (int y = 0; y < sps; ++y) {
+			uint32_t* src = pixels + (size_t)(tileY * sps + y) * context->image->width + tileX * sps;
+			memcpy(footprint + y * sps, src, sps * sizeof(uint32_t));
+		}
+	}
+}
+
+// Inverse of sampleAtlasCreateImage, reads footprints for SurfelCount surfels from an RGBA8 tile image.
+// Surfels past the last whole tile in the image are left unallocated.
+void sampleAtlasFromImage(ldiSampleAtlas* Atlas, ldiImage* Image, int SamplesPerSide, int SurfelCount) {
+	PROFILE_ZONE("Sample atlas from image");
+
+	sampleAtlasDestroy(Atlas);
+	sampleAtlasInit(Atlas, SamplesPerSide);
+	sampleAtlasResize(Atlas, SurfelCount);
+
+	int tilesPerRow = Image->width / SamplesPerSide;
+	int tileCount = min(SurfelCount, tilesPerRow * (Image->height / SamplesPerSide));
+	sampleAtlasAllocRange(Atlas, 0, tileCount);
+
+	_ldiSampleAtlasImageContext context = {};
+	context.atlas = Atlas;
+	context.image = Image;
+	context.tilesPerRow = tilesPerRow;
+
+	parallelFor(0, tileCount, 1024, _sampleAtlasFromImageBatch, &context);
+}
+
+//----------------------------------------------------------------------------------------------------
+// Serialization.
+//----------------------------------------------------------------------------------------------------
+// NOTE: Pages are written one at a time with a presence flag, unallocated pages take no space.
+void sampleAtlasSerialize(FILE* File, ldiSampleAtlas* Atlas) {
+	uint32_t magic = SAMPLE_ATLAS_MAGIC;
+	int pageSurfels = SAMPLE_ATLAS_PAGE_SURFELS;
+	int pageCount = (int)Atlas->pages.size();
+
+	fwrite(&magic, sizeof(uint32_t), 1, File);
+	fwrite(&Atlas->samplesPerSide, sizeof(int), 1, File);
+	fwrite(&pageSurfels, sizeof(int), 1, File);
+	fwrite(&Atlas->surfelCount, sizeof(int), 1, File);
+	fwrite(&pageCount, sizeof(int), 1, File);
+
+	size_t pageSize = _sampleAtlasPageSize(Atlas);
+
+	for (int i = 0; i < pageCount; ++i) {
+		uint8_t present = Atlas->pages[i] ? 1 : 0;
+		fwrite(&present, sizeof(uint8_t), 1, File);
+
+		if (present) {
+			fwrite(Atlas->pages[i], sizeof(uint32_t), pageSize, File);
+		}
+	}
+}
+
+bool sampleAtlasDeserialize(FILE* File, ldiSampleAtlas* Atlas) {
+	sampleAtlasDestroy(Atlas);
+
+	uint32_t magic = 0;
+	int samplesPerSide = 0;
+	int pageSurfels = 0;
+	int surfelCount = 0;
+	int pageCount = 0;
+
+	fread(&magic, sizeof(uint32_t), 1, File);
+	fread(&samplesPerSide, sizeof(int), 1, File);
+	fread(&pageSurfels, sizeof(int), 1, File);
+	fread(&surfelCount, sizeof(int), 1, File);
+	fread(&pageCount, sizeof(int), 1, File);
+
+	if (magic != SAMPLE_ATLAS_MAGIC || pageSurfels != SAMPLE_ATLAS_PAGE_SURFELS || samplesPerSide <= 0) {
+		std::cout << "Sample atlas data is not compatible\n";
+		return false;
+	}
+
+	sampleAtlasInit(Atlas, samplesPerSide);
+	sampleAtlasResize(Atlas, surfelCount);
+
+	if (pageCount != (int)Atlas->pages.size()) {
+		std::cout << "Sample atlas page count does not match surfel count\n";
+		sampleAtlasDestroy(Atlas);
+		return false;
+	}
+
+	size_t pageSize = _sampleAtlasPageSize(Atlas);
+
+	for (int i = 0; i < pageCount; ++i) {
+		uint8_t present = 0;
+		fread(&present, sizeof(uint8_t), 1, File);
+
+		if (present) {
+			Atlas->pages[i] = new uint32_t[pageSize];
+
+			if (fread(Atlas->pages[i], sizeof(uint32_t), pageSize, File) != pageSize) {
+				std::cout << "Sample atlas data is truncated\n";
+				sampleAtlasDestroy(Atlas);
+				return false;
+			}
+		}
+	}
+
+	return true;
+}
\ No newline at end of file
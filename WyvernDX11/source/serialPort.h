@@ -1,20 +1,112 @@
 #pragma once
 
+#include <deque>
+#include <atomic>
+
 // https://learn.microsoft.com/en-us/previous-versions/ff802693(v=msdn.10)
 
 // TODO: Check for available serial ports:
 // https://github.com/serialport/bindings-cpp/blob/main/src/serialport_win.cpp
 
+// In-process byte stream. A pair of these stands in for a COM port when talking to a device simulator.
+struct ldiSerialPipe {
+	std::mutex				mutex;
+	std::condition_variable	dataCondVar;
+	std::deque<uint8_t>		data;
+	bool					closed = false;
+};
+
+struct ldiSerialLoopback {
+	ldiSerialPipe			hostToDevice;
+	ldiSerialPipe			deviceToHost;
+};
+
 struct ldiSerialPort {
 	HANDLE descriptor = INVALID_HANDLE_VALUE;
-	bool connected = false;
+	HANDLE rxEvent = NULL;
+	// NOTE: Writes can come from a different thread than the pending comm event wait, each needs its own event.
+	HANDLE txEvent = NULL;
+	std::atomic_bool connected = false;
+	// NOTE: Cleared on disconnect while the reader thread may still be using the port, load it once per call.
+	std::atomic<ldiSerialLoopback*> loopback = nullptr;
 };
 
+void serialPipeOpen(ldiSerialPipe* Pipe) {
+	std::unique_lock<std::mutex> lock(Pipe->mutex);
+	Pipe->data.clear();
+	Pipe->closed = false;
+}
+
+void serialPipeClose(ldiSerialPipe* Pipe) {
+	std::unique_lock<std::mutex> lock(Pipe->mutex);
+	Pipe->closed = true;
+	Pipe->dataCondVar.notify_all();
+}
+
+int serialPipeWrite(ldiSerialPipe* Pipe, uint8_t* Buffer, int32_t BufferSize) {
+	std::unique_lock<std::mutex> lock(Pipe->mutex);
+
+	if (Pipe->closed) {
+		return -1;
+	}
+
+	Pipe->data.insert(Pipe->data.end(), Buffer, Buffer + BufferSize);
+	Pipe->dataCondVar.notify_all();
+
+	return BufferSize;
+}
+
+// Non blocking. Returns bytes read, or -1 if the pipe is closed and empty.
+int32_t serialPipeRead(ldiSerialPipe* Pipe, uint8_t* Buffer, int32_t BufferSize) {
+	std::unique_lock<std::mutex> lock(Pipe->mutex);
+
+	if (Pipe->data.empty()) {
+		return Pipe->closed ? -1 : 0;
+	}
+
+	int32_t count = min(BufferSize, (int32_t)Pipe->data.size());
+	std::copy(Pipe->data.begin(), Pipe->data.begin() + count, Buffer);
+	Pipe->data.erase(Pipe->data.begin(), Pipe->data.begin() + count);
+
+	return count;
+}
+
+// Returns 1 when data is available, 0 on timeout and -1 if the pipe is closed.
+int serialPipeWaitForData(ldiSerialPipe* Pipe, int TimeoutMs) {
+	std::unique_lock<std::mutex> lock(Pipe->mutex);
+
+	if (Pipe->data.empty() && !Pipe->closed) {
+		Pipe->dataCondVar.wait_for(lock, std::chrono::milliseconds(TimeoutMs));
+	}
+
+	if (!Pipe->data.empty()) {
+		return 1;
+	}
+
+	return Pipe->closed ? -1 : 0;
+}
+
 bool serialPortDisconnect(ldiSerialPort* Port) {
+	ldiSerialLoopback* loopback = Port->loopback.exchange(nullptr);
+
+	if (loopback) {
+		serialPipeClose(&loopback->hostToDevice);
+	}
+
 	if (Port->descriptor != INVALID_HANDLE_VALUE) {
 		CloseHandle(Port->descriptor);
 	}
 
+	if (Port->rxEvent != NULL) {
+		CloseHandle(Port->rxEvent);
+		Port->rxEvent = NULL;
+	}
+
+	if (Port->txEvent != NULL) {
+		CloseHandle(Port->txEvent);
+		Port->txEvent = NULL;
+	}
+
 	Port->descriptor = INVALID_HANDLE_VALUE;
 	Port->connected = false;
 
@@ -91,20 +183,46 @@ bool serialPortConnect(ldiSerialPort* Port, const char* Name, int BitRate) {
 	timeouts.WriteTotalTimeoutMultiplier = 0;
 	SetCommTimeouts(handle, &timeouts);
 
+	// NOTE: Used by serialPortWaitForData to sleep until bytes arrive.
+	SetCommMask(handle, EV_RXCHAR);
+
 	Port->descriptor = handle;
+	Port->rxEvent = CreateEvent(NULL, TRUE, FALSE, NULL);
+	Port->txEvent = CreateEvent(NULL, TRUE, FALSE, NULL);
 	Port->connected = true;
 	std::cout << "Serial Connect: Connected to " << Name << "\n";
 
 	return true;
 }
 
+// Connects to an in-process device instead of a COM port. All other serialPort calls work the same.
+bool serialPortConnectLoopback(ldiSerialPort* Port, ldiSerialLoopback* Loopback) {
+	serialPortDisconnect(Port);
+
+	serialPipeOpen(&Loopback->hostToDevice);
+	serialPipeOpen(&Loopback->deviceToHost);
+
+	Port->loopback = Loopback;
+	Port->connected = true;
+	std::cout << "Serial Connect: Connected to loopback\n";
+
+	return true;
+}
+
 int serialPortWriteData(ldiSerialPort* Port, uint8_t* Buffer, int32_t BufferSize) {
 	if (!Port->connected) {
 		std::cout << "Serial Write: Invalid Serial Port.\n";
 		return -1;
 	}
 
+	ldiSerialLoopback* loopback = Port->loopback.load();
+
+	if (loopback) {
+		return serialPipeWrite(&loopback->hostToDevice, Buffer, BufferSize);
+	}
+
 	OVERLAPPED overlapped = {};
+	overlapped.hEvent = Port->txEvent;
 	DWORD bytesWritten = 0;
 
 	if (!WriteFile(Port->descriptor, Buffer, BufferSize, &bytesWritten, &overlapped)) {
@@ -123,7 +241,6 @@ int serialPortWriteData(ldiSerialPort* Port, uint8_t* Buffer, int32_t BufferSize
 				return -1;
 			} else {
 				if (bytesWritten != BufferSize) {
-					// TODO: This can occur if some other IO operation on the same handle completes before this one. Need to unique hEvent.
 					std::cout << "Serial Write: Failed to write all bytes: " << bytesWritten << "/" << BufferSize << "\n";
 					//serialPortDisconnect(Port);
 					return -1;
@@ -151,6 +268,12 @@ int32_t serialPortReadData(ldiSerialPort* Port, uint8_t* Buffer, int32_t BufferS
 		return -1;
 	}
 
+	ldiSerialLoopback* loopback = Port->loopback.load();
+
+	if (loopback) {
+		return serialPipeRead(&loopback->deviceToHost, Buffer, BufferSize);
+	}
+
 	// Sit here doing things for RECV for now.
 
 	//DWORD dwCommEvent;
@@ -201,7 +324,9 @@ int32_t serialPortReadData(ldiSerialPort* Port, uint8_t* Buffer, int32_t BufferS
 
 	//return -1;
 
+	// NOTE: Reads happen on the same thread as serialPortWaitForData, after its wait has been retired.
 	OVERLAPPED overlapped = {};
+	overlapped.hEvent = Port->rxEvent;
 	DWORD bytesRead;
 
 	if (!ReadFile(Port->descriptor, Buffer, BufferSize, &bytesRead, &overlapped)) {
@@ -223,4 +348,59 @@ int32_t serialPortReadData(ldiSerialPort* Port, uint8_t* Buffer, int32_t BufferS
 	}
 
 	return 0;
+}
+
+// Block until there are bytes to read or the timeout expires.
+// Returns 1 when data is available, 0 on timeout and -1 on error.
+int serialPortWaitForData(ldiSerialPort* Port, int TimeoutMs) {
+	if (!Port->connected) {
+		return -1;
+	}
+
+	ldiSerialLoopback* loopback = Port->loopback.load();
+
+	if (loopback) {
+		return serialPipeWaitForData(&loopback->deviceToHost, TimeoutMs);
+	}
+
+	DWORD errors;
+	COMSTAT status;
+
+	if (!ClearCommError(Port->descriptor, &errors, &status)) {
+		return -1;
+	}
+
+	if (status.cbInQue > 0) {
+		return 1;
+	}
+
+	OVERLAPPED overlapped = {};
+	overlapped.hEvent = Port->rxEvent;
+	ResetEvent(Port->rxEvent);
+
+	DWORD eventMask = 0;
+
+	if (WaitCommEvent(Port->descriptor, &eventMask, &overlapped)) {
+		return 1;
+	}
+
+	if (GetLastError() != ERROR_IO_PENDING) {
+		std::cout << "Serial Wait: WaitCommEvent Failed.\n";
+		return -1;
+	}
+
+	DWORD transferred = 0;
+
+	if (WaitForSingleObject(Port->rxEvent, TimeoutMs) != WAIT_OBJECT_0) {
+		// NOTE: The overlapped structure lives on the stack, so the pending wait must be retired before returning.
+		CancelIoEx(Port->descriptor, &overlapped);
+		GetOverlappedResult(Port->descriptor, &overlapped, &transferred, TRUE);
+		return 0;
+	}
+
+	if (!GetOverlappedResult(Port->descriptor, &overlapped, &transferred, FALSE)) {
+		return -1;
+	}
+
+	return 1;
 }
\ No newline at end of file
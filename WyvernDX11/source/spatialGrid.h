@@ -3,6 +3,19 @@
 //----------------------------------------------------------------------------------------------------
 // Basic spatial grid.
 //----------------------------------------------------------------------------------------------------
+// Cells are stored in data as a count followed by that many values. Dense grids map every cell in the box
+// to its data offset through index, sparse grids only keep occupied cells in hashTable, keyed by Morton code.
+
+struct ldiSpatialGridHashSlot {
+	// SPATIAL_GRID_EMPTY_KEY when unused.
+	uint64_t key;
+	int offset;
+};
+
+#define SPATIAL_GRID_EMPTY_KEY UINT64_MAX
+// Morton codes interleave 21 bits per axis.
+#define SPATIAL_GRID_MAX_AXIS_CELLS (1 << 21)
+
 struct ldiSpatialGrid {
 	vec3 min;
 	vec3 max;
@@ -15,6 +28,9 @@ struct ldiSpatialGrid {
 	int countTotal;
 	int* index;
 	int* data;
+	ldiSpatialGridHashSlot* hashTable;
+	int hashMask;
+	int occupiedCount;
 };
 
 void spatialGridDestroy(ldiSpatialGrid* Grid) {
@@ -26,10 +42,15 @@ void spatialGridDestroy(ldiSpatialGrid* Grid) {
 		delete[] Grid->data;
 	}
 
+	if (Grid->hashTable) {
+		delete[] Grid->hashTable;
+	}
+
 	memset(Grid, 0, sizeof(ldiSpatialGrid));
 }
 
-void spatialGridInit(ldiSpatialGrid* Grid, vec3 MinBounds, vec3 MaxBounds, float CellSize) {
+// Fits the cell counts to the bounds with a cell of padding on each side. Returns the number of cells in the box.
+int64_t _spatialGridSetBounds(ldiSpatialGrid* Grid, vec3 MinBounds, vec3 MaxBounds, float CellSize) {
 	Grid->cellSize = CellSize;
 
 	Grid->origin = MinBounds + (MaxBounds - MinBounds) * 0.5f;
@@ -38,15 +59,20 @@ void spatialGridInit(ldiSpatialGrid* Grid, vec3 MinBounds, vec3 MaxBounds, float
 	Grid->countX = ceilf(Grid->size.x / CellSize) + 2;
 	Grid->countY = ceilf(Grid->size.y / CellSize) + 2;
 	Grid->countZ = ceilf(Grid->size.z / CellSize) + 2;
-	Grid->countTotal = Grid->countX * Grid->countY * Grid->countZ;
-
-	std::cout << "Spatial grid cell counts: " << Grid->countX << ", " << Grid->countY << ", " << Grid->countZ << " (" << Grid->countTotal << ")\n";
 
 	Grid->size = vec3(Grid->countX * CellSize, Grid->countY * CellSize, Grid->countZ * CellSize);
 
 	Grid->min = Grid->origin - Grid->size * 0.5f;
 	Grid->max = Grid->origin + Grid->size * 0.5f;
 
+	return (int64_t)Grid->countX * Grid->countY * Grid->countZ;
+}
+
+void spatialGridInit(ldiSpatialGrid* Grid, vec3 MinBounds, vec3 MaxBounds, float CellSize) {
+	Grid->countTotal = (int)_spatialGridSetBounds(Grid, MinBounds, MaxBounds, CellSize);
+
+	std::cout << "Spatial grid cell counts: " << Grid->countX << ", " << Grid->countY << ", " << Grid->countZ << " (" << Grid->countTotal << ")\n";
+
 	assert(Grid->countTotal > 0);
 	Grid->index = new int[Grid->countTotal];
 	memset(Grid->index, 0, sizeof(int) * Grid->countTotal);
@@ -127,7 +153,85 @@ void spatialGridAddEntry(ldiSpatialGrid* Grid, vec3 Position, int Value) {
 	Grid->data[dataOffset] += 1;
 }
 
+//----------------------------------------------------------------------------------------------------
+// Morton codes.
+//----------------------------------------------------------------------------------------------------
+inline uint64_t _spatialGridSpreadBits(uint64_t V) {
+	V &= 0x1FFFFF;
+	V = (V | (V << 32)) & 0x1F00000000FFFF;
+	V = (V | (V << 16)) & 0x1F0000FF0000FF;
+	V = (V | (V << 8)) & 0x100F00F00F00F00F;
+	V = (V | (V << 4)) & 0x10C30C30C30C30C3;
+	V = (V | (V << 2)) & 0x1249249249249249;
+
+	return V;
+}
+
+inline int _spatialGridCompactBits(uint64_t V) {
+	V &= 0x1249249249249249;
+	V = (V | (V >> 2)) & 0x10C30C30C30C30C3;
+	V = (V | (V >> 4)) & 0x100F00F00F00F00F;
+	V = (V | (V >> 8)) & 0x1F0000FF0000FF;
+	V = (V | (V >> 16)) & 0x1F00000000FFFF;
+	V = (V | (V >> 32)) & 0x1FFFFF;
+
+	return (int)V;
+}
+
+inline uint64_t spatialGridMortonEncode(int CellX, int CellY, int CellZ) {
+	return _spatialGridSpreadBits(CellX) | (_spatialGridSpreadBits(CellY) << 1) | (_spatialGridSpreadBits(CellZ) << 2);
+}
+
+inline void spatialGridMortonDecode(uint64_t Code, int* CellX, int* CellY, int* CellZ) {
+	*CellX = _spatialGridCompactBits(Code);
+	*CellY = _spatialGridCompactBits(Code >> 1);
+	*CellZ = _spatialGridCompactBits(Code >> 2);
+}
+
+inline uint32_t _spatialGridHash(uint64_t Key) {
+	return (uint32_t)((Key * 0x9E3779B97F4A7C15ull) >> 32);
+}
+
+// Data offset of an occupied cell in a sparse grid, -1 if the cell is empty.
+int _spatialGridHashFind(ldiSpatialGrid* Grid, uint64_t Key) {
+	uint32_t slot = _spatialGridHash(Key) & Grid->hashMask;
+
+	while (true) {
+		ldiSpatialGridHashSlot* entry = &Grid->hashTable[slot];
+
+		if (entry->key == Key) {
+			return entry->offset;
+		}
+
+		if (entry->key == SPATIAL_GRID_EMPTY_KEY) {
+			return -1;
+		}
+
+		slot = (slot + 1) & Grid->hashMask;
+	}
+}
+
 void spatialGridRenderOccupied(ldiApp* AppContext, ldiSpatialGrid* Grid) {
+	if (Grid->hashTable) {
+		for (int i = 0; i <= Grid->hashMask; ++i) {
+			ldiSpatialGridHashSlot* entry = &Grid->hashTable[i];
+
+			if (entry->key == SPATIAL_GRID_EMPTY_KEY) {
+				continue;
+			}
+
+			int cellX, cellY, cellZ;
+			spatialGridMortonDecode(entry->key, &cellX, &cellY, &cellZ);
+
+			vec3 worldSpace = vec3(cellX, cellY, cellZ) * Grid->cellSize + Grid->min;
+			vec3 max = worldSpace + Grid->cellSize;
+
+			pushDebugBoxMinMax(&AppContext->defaultDebug, worldSpace, max, vec3(1, 0, 1));
+		}
+
+		return;
+	}
+
 	for (int i = 0; i < Grid->countTotal; ++i) {
 		int dataOffset = Grid->index[i];
 
@@ -171,10 +275,18 @@ struct ldiSpatialCellResult {
 
 ldiSpatialCellResult spatialGridGetCell(ldiSpatialGrid* Grid, int CellX, int CellY, int CellZ) {
 	ldiSpatialCellResult result{};
+	int dataOffset;
 
-	int cellId = spatialGridGetCellId(Grid, CellX, CellY, CellZ);
+	if (Grid->hashTable) {
+		if (CellX < 0 || CellY < 0 || CellZ < 0 || CellX >= Grid->countX || CellY >= Grid->countY || CellZ >= Grid->countZ) {
+			return result;
+		}
 
-	int dataOffset = Grid->index[cellId];
+		dataOffset = _spatialGridHashFind(Grid, spatialGridMortonEncode(CellX, CellY, CellZ));
+	} else {
+		int cellId = spatialGridGetCellId(Grid, CellX, CellY, CellZ);
+		dataOffset = Grid->index[cellId];
+	}
 
 	if (dataOffset != -1) {
 		result.count = Grid->data[dataOffset];
@@ -184,6 +296,289 @@ ldiSpatialCellResult spatialGridGetCell(ldiSpatialGrid* Grid, int CellX, int Cel
 	return result;
 }
 
+//----------------------------------------------------------------------------------------------------
+// Parallel build.
+//----------------------------------------------------------------------------------------------------
+// Builds the whole grid from a list of positions in one go. Items get the Morton code of their cell as a key,
+// are radix sorted by it, and every run of equal keys becomes a cell. Cell data ends up in Morton order, so
+// neighboring cells are close in memory as well. Values within a cell keep their input order.
+
+enum ldiSpatialGridLayout {
+	SGL_AUTO,
+	SGL_DENSE,
+	SGL_SPARSE,
+};
+
+#define SPATIAL_GRID_SORT_BLOCK 16384
+// Auto layout goes sparse when the box has this many more cells than there are items.
+#define SPATIAL_GRID_SPARSE_RATIO 8
+
+struct _ldiSpatialGridBuildContext {
+	ldiSpatialGrid*						grid;
+	const vec3*							positions;
+	const int*							values;
+	int									count;
+	int									blockCount;
+
+	uint64_t*							srcKeys;
+	int*								srcValues;
+	uint64_t*							dstKeys;
+	int*								dstValues;
+	int									shift;
+	// 256 digit counts per block, become scatter offsets after the scan.
+	int*								histograms;
+
+	// Cells per block, becomes the first cell of each block after the scan.
+	int*								blockCells;
+	// First sorted item of each cell, with the item count at the end.
+	int*								cellStarts;
+};
+
+void _spatialGridKeysBatch(int StartIdx, int EndIdx, void* UserData) {
+	_ldiSpatialGridBuildContext* context = (_ldiSpatialGridBuildContext*)UserData;
+	ldiSpatialGrid* grid = context->grid;
+
+	for (int i = StartIdx; i < EndIdx; ++i) {
+		vec3 local = (context->positions[i] - grid->min) / grid->cellSize;
+
+		int cellX = clampf(local.x, 0.0f, (float)(grid->countX - 1));
+		int cellY = clampf(local.y, 0.0f, (float)(grid->countY - 1));
+		int cellZ = clampf(local.z, 0.0f, (float)(grid->countZ - 1));
+
+		context->srcKeys[i] = spatialGridMortonEncode(cellX, cellY, cellZ);
+		context->srcValues[i] = context->values ? context->values[i] : i;
+	}
+}
+
+void _spatialGridHistogramBatch(int StartIdx, int EndIdx, void* UserData) {
+	_ldiSpatialGridBuildContext* context = (_ldiSpatialGridBuildContext*)UserData;
+
+	for (int b = StartIdx; b < EndIdx; ++b) {
+		int* histogram = context->histograms + b * 256;
+		memset(histogram, 0, sizeof(int) * 256);
+
+		int start = b * SPATIAL_GRID_SORT_BLOCK;
+		int end = min(start + SPATIAL_GRID_SORT_BLOCK, context->count);
+
+		for (int i = start; i < end; ++i) {
+			histogram[(context->srcKeys[i] >> context->shift) & 0xFF]++;
+		}
+	}
+}
+
+void _spatialGridScatterBatch(int StartIdx, int EndIdx, void* UserData) {
+	_ldiSpatialGridBuildContext* context = (_ldiSpatialGridBuildContext*)UserData;
+
+	for (int b = StartIdx; b < EndIdx; ++b) {
+		int* offsets = context->histograms + b * 256;
+
+		int start = b * SPATIAL_GRID_SORT_BLOCK;
+		int end = min(start + SPATIAL_GRID_SORT_BLOCK, context->count);
+
+		for (int i = start; i < end; ++i) {
+			uint64_t key = context->srcKeys[i];
+			int dst = offsets[(key >> context->shift) & 0xFF]++;
+
+			context->dstKeys[dst] = key;
+			context->dstValues[dst] = context->srcValues[i];
+		}
+	}
+}
+
+void _spatialGridCountCellsBatch(int StartIdx, int EndIdx, void* UserData) {
+	_ldiSpatialGridBuildContext* context = (_ldiSpatialGridBuildContext*)UserData;
+	const uint64_t* keys = context->srcKeys;
+
+	for (int b = StartIdx; b < EndIdx; ++b) {
+		int start = b * SPATIAL_GRID_SORT_BLOCK;
+		int end = min(start + SPATIAL_GRID_SORT_BLOCK, context->count);
+		int cells = 0;
+
+		for (int i = start; i < end; ++i) {
+			if (i == 0 || keys[i] != keys[i - 1]) {
+				++cells;
+			}
+		}
+
+		context->blockCells[b] = cells;
+	}
+}
+
+void _spatialGridCellStartsBatch(int StartIdx, int EndIdx, void* UserData) {
+	_ldiSpatialGridBuildContext* context = (_ldiSpatialGridBuildContext*)UserData;
+	const uint64_t* keys = context->srcKeys;
+
+	for (int b = StartIdx; b < EndIdx; ++b) {
+		int start = b * SPATIAL_GRID_SORT_BLOCK;
+		int end = min(start + SPATIAL_GRID_SORT_BLOCK, context->count);
+		int cellId = context->blockCells[b];
+
+		for (int i = start; i < end; ++i) {
+			if (i == 0 || keys[i] != keys[i - 1]) {
+				context->cellStarts[cellId++] = i;
+			}
+		}
+	}
+}
+
+void _spatialGridFillCellsBatch(int StartIdx, int EndIdx, void* UserData) {
+	_ldiSpatialGridBuildContext* context = (_ldiSpatialGridBuildContext*)UserData;
+	ldiSpatialGrid* grid = context->grid;
+
+	for (int c = StartIdx; c < EndIdx; ++c) {
+		int start = context->cellStarts[c];
+		int end = context->cellStarts[c + 1];
+
+		// NOTE: Each cell before this one added a count slot ahead of its items.
+		int offset = start + c;
+		grid->data[offset] = end - start;
+		memcpy(grid->data + offset + 1, context->srcValues + start, sizeof(int) * (end - start));
+
+		if (grid->index) {
+			int cellX, cellY, cellZ;
+			spatialGridMortonDecode(context->srcKeys[start], &cellX, &cellY, &cellZ);
+			grid->index[spatialGridGetCellId(grid, cellX, cellY, cellZ)] = offset;
+		}
+	}
+}
+
+// Values can be null, each item then stores its own index. Positions outside the bounds go to the nearest edge cell.
+void spatialGridBuild(ldiSpatialGrid* Grid, vec3 MinBounds, vec3 MaxBounds, float CellSize, const vec3* Positions, const int* Values, int Count, ldiSpatialGridLayout Layout = SGL_AUTO) {
+	PROFILE_ZONE_LOG("Spatial grid build");
+	PROFILE_ITEMS(Count);
+
+	spatialGridDestroy(Grid);
+	int64_t boxCells = _spatialGridSetBounds(Grid, MinBounds, MaxBounds, CellSize);
+
+	assert(Grid->countX <= SPATIAL_GRID_MAX_AXIS_CELLS && Grid->countY <= SPATIAL_GRID_MAX_AXIS_CELLS && Grid->countZ <= SPATIAL_GRID_MAX_AXIS_CELLS);
+
+	if (Layout == SGL_AUTO) {
+		Layout = (boxCells > (int64_t)Count * SPATIAL_GRID_SPARSE_RATIO || boxCells > INT_MAX) ? SGL_SPARSE : SGL_DENSE;
+	}
+
+	if (Layout == SGL_DENSE) {
+		assert(boxCells <= INT_MAX);
+		Grid->countTotal = (int)boxCells;
+		Grid->index = new int[Grid->countTotal];
+		memset(Grid->index, 0xFF, sizeof(int) * Grid->countTotal);
+	}
+
+	std::vector<uint64_t> keys[2];
+	std::vector<int> values[2];
+	keys[0].resize(Count);
+	keys[1].resize(Count);
+	values[0].resize(Count);
+	values[1].resize(Count);
+
+	_ldiSpatialGridBuildContext context = {};
+	context.grid = Grid;
+	context.positions = Positions;
+	context.values = Values;
+	context.count = Count;
+	context.blockCount = (Count + SPATIAL_GRID_SORT_BLOCK - 1) / SPATIAL_GRID_SORT_BLOCK;
+	context.srcKeys = keys[0].data();
+	context.srcValues = values[0].data();
+
+	parallelFor(0, Count, 4096, _spatialGridKeysBatch, &context);
+
+	//----------------------------------------------------------------------------------------------------
+	// Radix sort, 8 bits per pass, only over the bits the cell counts can reach.
+	//----------------------------------------------------------------------------------------------------
+	int maxAxisCount = max(Grid->countX, max(Grid->countY, Grid->countZ));
+	int axisBits = 0;
+	while ((1 << axisBits) < maxAxisCount) {
+		++axisBits;
+	}
+
+	int passCount = (axisBits * 3 + 7) / 8;
+	std::vector<int> histograms(context.blockCount * 256);
+	context.histograms = histograms.data();
+
+	for (int pass = 0; pass < passCount; ++pass) {
+		context.shift = pass * 8;
+		context.srcKeys = keys[pass & 1].data();
+		context.srcValues = values[pass & 1].data();
+		context.dstKeys = keys[(pass + 1) & 1].data();
+		context.dstValues = values[(pass + 1) & 1].data();
+
+		parallelFor(0, context.blockCount, 1, _spatialGridHistogramBatch, &context);
+
+		// NOTE: Digit major, then block, keeps the sort stable.
+		int offset = 0;
+		for (int d = 0; d < 256; ++d) {
+			for (int b = 0; b < context.blockCount; ++b) {
+				int count = histograms[b * 256 + d];
+				histograms[b * 256 + d] = offset;
+				offset += count;
+			}
+		}
+
+		parallelFor(0, context.blockCount, 1, _spatialGridScatterBatch, &context);
+	}
+
+	context.srcKeys = keys[passCount & 1].data();
+	context.srcValues = values[passCount & 1].data();
+
+	//----------------------------------------------------------------------------------------------------
+	// Cell ranges.
+	//----------------------------------------------------------------------------------------------------
+	std::vector<int> blockCells(context.blockCount);
+	context.blockCells = blockCells.data();
+
+	parallelFor(0, context.blockCount, 1, _spatialGridCountCellsBatch, &context);
+
+	int cellCount = 0;
+	for (int b = 0; b < context.blockCount; ++b) {
+		int cells = blockCells[b];
+		blockCells[b] = cellCount;
+		cellCount += cells;
+	}
+
+	std::vector<int> cellStarts(cellCount + 1);
+	cellStarts[cellCount] = Count;
+	context.cellStarts = cellStarts.data();
+
+	parallelFor(0, context.blockCount, 1, _spatialGridCellStartsBatch, &context);
+
+	Grid->occupiedCount = cellCount;
+	Grid->data = new int[cellCount + Count];
+
+	parallelFor(0, cellCount, 1024, _spatialGridFillCellsBatch, &context);
+
+	if (Layout == SGL_SPARSE) {
+		// NOTE: Power of two table kept under half full.
+		int tableSize = 16;
+		while (tableSize < cellCount * 2) {
+			tableSize *= 2;
+		}
+
+		Grid->hashMask = tableSize - 1;
+		Grid->hashTable = new ldiSpatialGridHashSlot[tableSize];
+
+		for (int i = 0; i < tableSize; ++i) {
+			Grid->hashTable[i].key = SPATIAL_GRID_EMPTY_KEY;
+			Grid->hashTable[i].offset = -1;
+		}
+
+		for (int c = 0; c < cellCount; ++c) {
+			uint64_t key = context.srcKeys[cellStarts[c]];
+			uint32_t slot = _spatialGridHash(key) & Grid->hashMask;
+
+			while (Grid->hashTable[slot].key != SPATIAL_GRID_EMPTY_KEY) {
+				slot = (slot + 1) & Grid->hashMask;
+			}
+
+			Grid->hashTable[slot].key = key;
+			Grid->hashTable[slot].offset = cellStarts[c] + c;
+		}
+	}
+
+	size_t indexBytes = Grid->index ? sizeof(int) * (size_t)Grid->countTotal : sizeof(ldiSpatialGridHashSlot) * (size_t)(Grid->hashMask + 1);
+
+	std::cout << "Spatial grid " << (Grid->hashTable ? "sparse" : "dense") << ": " << Grid->countX << ", " << Grid->countY << ", " << Grid->countZ
+		<< " occupied " << cellCount << " of " << boxCells << " index " << (indexBytes / 1024.0 / 1024.0) << " MB\n";
+}
+
 //----------------------------------------------------------------------------------------------------
 // Poisson disk spatial grid.
 //----------------------------------------------------------------------------------------------------
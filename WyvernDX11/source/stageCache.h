@@ -0,0 +1,131 @@
+#pragma once
+
+#include <filesystem>
+
+//----------------------------------------------------------------------------------------------------
+// Stage cache.
+//----------------------------------------------------------------------------------------------------
+// Content addressed disk cache for the outputs of long pipeline stages.
+//
+// A stage key hashes the stage name and version, its parameters, and the content of everything it reads.
+// Inputs are hashed by content rather than by where they came from, so keys survive a project save and
+// load, and a change upstream only reaches the stages that actually read the changed data.
+//
+// Each output is one file named after its stage and key. Files are written under a temporary name and
+// renamed when complete, so an interrupted write is never read back.
+
+#define STAGE_CACHE_MAGIC 0x4353444C
+#define STAGE_CACHE_FORMAT 1
+
+// Start of a stage key. Inputs are chained on with hashFnv1a.
+uint64_t stageCacheKeyInit(const char* Stage, int Version) {
+	uint64_t key = hashFnv1a(HASH_FNV1A_SEED, Stage, strlen(Stage));
+
+	return hashFnv1a(key, &Version, sizeof(int));
+}
+
+//----------------------------------------------------------------------------------------------------
+// Disk cache.
+//----------------------------------------------------------------------------------------------------
+struct ldiStageCache {
+	std::string							dir;
+	bool								enabled = true;
+	int									hitCount = 0;
+	int									missCount = 0;
+};
+
+struct _ldiStageCacheHeader {
+	uint32_t							magic;
+	int									format;
+	uint64_t							key;
+};
+
+std::string stageCacheGetPath(ldiStageCache* Cache, const char* Stage, uint64_t Key) {
+	char keyStr[32];
+	sprintf_s(keyStr, sizeof(keyStr), "%016llx", (unsigned long long)Key);
+
+	return Cache->dir + "/" + Stage + "_" + keyStr + ".bin";
+}
+
+// Opens a stored output for reading, positioned after the header. Null on a miss or when disabled.
+FILE* stageCacheOpenRead(ldiStageCache* Cache, const char* Stage, uint64_t Key) {
+	if (!Cache->enabled) {
+		return nullptr;
+	}
+
+	std::string path = stageCacheGetPath(Cache, Stage, Key);
+
+	FILE* file;
+	if (fopen_s(&file, path.c_str(), "rb") != 0) {
+		Cache->missCount++;
+		std::cout << "Stage cache miss: " << Stage << "\n";
+		return nullptr;
+	}
+
+	_ldiStageCacheHeader header = {};
+	fread(&header, sizeof(header), 1, file);
+
+	if (header.magic != STAGE_CACHE_MAGIC || header.format != STAGE_CACHE_FORMAT || header.key != Key) {
+		std::cout << "Stage cache entry invalid: " << path << "\n";
+		fclose(file);
+		Cache->missCount++;
+		return nullptr;
+	}
+
+	Cache->hitCount++;
+	std::cout << "Stage cache hit: " << Stage << "\n";
+
+	return file;
+}
+
+// Starts writing an output, null when disabled or the file can't be created. Finish with stageCacheEndWrite.
+FILE* stageCacheBeginWrite(ldiStageCache* Cache, const char* Stage, uint64_t Key) {
+	if (!Cache->enabled) {
+		return nullptr;
+	}
+
+	std::error_code error;
+	std::filesystem::create_directories(Cache->dir, error);
+
+	std::string path = stageCacheGetPath(Cache, Stage, Key) + ".tmp";
+
+	FILE* file;
+	if (fopen_s(&file, path.c_str(), "wb") != 0) {
+		std::cout << "Stage cache could not write: " << path << "\n";
+		return nullptr;
+	}
+
+	_ldiStageCacheHeader header = {};
+	header.magic = STAGE_CACHE_MAGIC;
+	header.format = STAGE_CACHE_FORMAT;
+	header.key = Key;
+	fwrite(&header, sizeof(header), 1, file);
+
+	return file;
+}
+
+void stageCacheEndWrite(ldiStageCache* Cache, const char* Stage, uint64_t Key, FILE* File) {
+	bool failed = ferror(File) != 0;
+	fclose(File);
+
+	std::string path = stageCacheGetPath(Cache, Stage, Key);
+	std::error_code error;
+
+	if (failed) {
+		std::filesystem::remove(path + ".tmp", error);
+		std::cout << "Stage cache write failed: " << path << "\n";
+		return;
+	}
+
+	std::filesystem::rename(path + ".tmp", path, error);
+
+	if (error) {
+		std::cout << "Stage cache could not store: " << path << " (" << error.message() << ")\n";
+	}
+}
+
+void stageCacheClear(ldiStageCache* Cache) {
+	removeAllFilesInDirectory(Cache->dir);
+	Cache->hitCount = 0;
+	Cache->missCount = 0;
+}
\ No newline at end of file
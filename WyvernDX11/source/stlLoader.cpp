@@ -1,7 +1,8 @@
 #include "stlLoader.h"
 #include <iostream>
+#include <cstring>
 
-bool stlSaveModel(const char* FileName, ldiModel* Model) {
+bool stlSaveModel(const char* FileName, ldiModel* Model, const mat4* Transform) {
 	std::cout << "Save STL file to: " << FileName << "\n";
 
 	uint32_t triCount = Model->indices.size() / 3;
@@ -22,33 +23,54 @@ bool stlSaveModel(const char* FileName, ldiModel* Model) {
 
 	fwrite(&triCount, sizeof(triCount), 1, file);
 
-	for (int i = 0; i < triCount; ++i) {
-		ldiMeshVertex v0 = Model->verts[Model->indices[i * 3 + 0]];
-		ldiMeshVertex v1 = Model->verts[Model->indices[i * 3 + 1]];
-		ldiMeshVertex v2 = Model->verts[Model->indices[i * 3 + 2]];
+	mat4 transform = Transform ? *Transform : mat4(1.0f);
+	glm::mat3 normalMat = glm::transpose(glm::inverse(glm::mat3(transform)));
+
+	// NOTE: Triangles are 50 bytes on disk, written through a chunk buffer instead of per float.
+	const int chunkTris = 4096;
+	const int triSize = 50;
+	std::vector<uint8_t> chunk(chunkTris * triSize);
+	int chunkCount = 0;
+
+	for (uint32_t i = 0; i < triCount; ++i) {
+		ldiMeshVertex* v0 = &Model->verts[Model->indices[i * 3 + 0]];
+		ldiMeshVertex* v1 = &Model->verts[Model->indices[i * 3 + 1]];
+		ldiMeshVertex* v2 = &Model->verts[Model->indices[i * 3 + 2]];
 
 		// TODO: Should be face normal, but just using v0.
 		// NOTE: STL importers seem to completely ignore this and just flat shade anyway?
-		fwrite(&v0.normal.x, sizeof(float), 1, file);
-		fwrite(&v0.normal.y, sizeof(float), 1, file);
-		fwrite(&v0.normal.z, sizeof(float), 1, file);
+		vec3 record[4];
+		record[0] = v0->normal;
+		record[1] = v2->pos;
+		record[2] = v1->pos;
+		record[3] = v0->pos;
+
+		if (Transform) {
+			record[0] = normalMat * record[0];
 
-		fwrite(&v2.pos.x, sizeof(float), 1, file);
-		fwrite(&v2.pos.y, sizeof(float), 1, file);
-		fwrite(&v2.pos.z, sizeof(float), 1, file);
+			if (glm::dot(record[0], record[0]) > 0.0f) {
+				record[0] = glm::normalize(record[0]);
+			}
 
-		fwrite(&v1.pos.x, sizeof(float), 1, file);
-		fwrite(&v1.pos.y, sizeof(float), 1, file);
-		fwrite(&v1.pos.z, sizeof(float), 1, file);
+			for (int j = 1; j < 4; ++j) {
+				record[j] = transform * vec4(record[j], 1.0f);
+			}
+		}
 
-		fwrite(&v0.pos.x, sizeof(float), 1, file);
-		fwrite(&v0.pos.y, sizeof(float), 1, file);
-		fwrite(&v0.pos.z, sizeof(float), 1, file);
+		uint8_t* dst = &chunk[chunkCount * triSize];
+		memcpy(dst, record, sizeof(record));
 
 		uint16_t attrCount = 0;
-		fwrite(&attrCount, sizeof(attrCount), 1, file);
+		memcpy(dst + sizeof(record), &attrCount, sizeof(attrCount));
+
+		if (++chunkCount == chunkTris) {
+			fwrite(chunk.data(), triSize, chunkCount, file);
+			chunkCount = 0;
+		}
 	}
 
+	fwrite(chunk.data(), triSize, chunkCount, file);
+
 	fclose(file);
 
 	return true;
@@ -2,4 +2,5 @@
 
 #include "model.h"
 
-bool stlSaveModel(const char* FileName, ldiModel* Model);
\ No newline at end of file
+// Transform is applied on write, so posed models don't need a transformed copy.
+bool stlSaveModel(const char* FileName, ldiModel* Model, const mat4* Transform = nullptr);
\ No newline at end of file
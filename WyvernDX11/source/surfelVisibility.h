@@ -0,0 +1,851 @@
+#pragma once
+
+#include <algorithm>
+#include <float.h>
+
+//----------------------------------------------------------------------------------------------------
+// Surfel visibility.
+//----------------------------------------------------------------------------------------------------
+// Batched occlusion tests between surfels and view directions, on the CPU.
+//
+// Surfel quads are held in a bounding volume tree with the same implicit layout as the point index: node I
+// has children 2I+1 and 2I+2, every leaf is on the last level, and each node splits its range in half at
+// the median surfel position along the longest axis of its bounds. Every node also keeps a cone that bounds
+// the normals of the surfels below it.
+//
+// A query asks whether a beam (a capsule) or a cone leaving a surfel towards a view overlaps any other
+// surfel quad, which is what physicsBeamOverlap and physicsConeOverlap test against a cooked surfel mesh.
+// The tree serves both sides of the query: as occluders, nodes outside the query volume are skipped, and as
+// query surfels, whole subtrees whose normal cone faces away from a view are rejected without any tests.
+//
+// Query surfels are walked in tree order, so neighboring queries in a batch visit the same nodes.
+
+#define SURFEL_VIS_LEAF_SIZE 4
+#define SURFEL_VIS_STACK_SIZE 64
+// NOTE: Subtrees of about this many surfels make up one task in a batch.
+#define SURFEL_VIS_TASK_LEVELS 6
+
+enum ldiSurfelVisTest {
+	SVT_BEAM = 1,
+	SVT_CONE = 2,
+};
+
+// Result flags for each surfel and view pair, zero when the surfel is visible.
+enum ldiSurfelVisResult {
+	SVR_BACKFACING = 1,
+	SVR_BEAM = 2,
+	SVR_CONE = 4,
+};
+
+struct ldiSurfelVisSettings {
+	// Queries start this far above the surfel along its normal.
+	float								normalOffset;
+	float								beamRadius;
+	float								beamLength;
+	// Apex at the query start, Radius at Length.
+	float								coneLength;
+	float								coneRadius;
+	// Surfels whose normal has a lower dot product with the view direction are backfacing.
+	float								minFacing;
+	// ldiSurfelVisTest flags.
+	int									tests;
+};
+
+struct ldiSurfelVisNode {
+	vec3								min;
+	int									start;
+	vec3								max;
+	int									count;
+};
+
+struct ldiSurfelVisCone {
+	vec3								axis;
+	// Half angle in radians, PI when the normals don't fit in a cone.
+	float								angle;
+};
+
+struct ldiSurfelVisEntry {
+	vec3								verts[4];
+	vec3								position;
+	vec3								normal;
+	int									id;
+};
+
+struct ldiSurfelVis {
+	std::vector<ldiSurfelVisNode>		nodes;
+	std::vector<ldiSurfelVisCone>		cones;
+	std::vector<ldiSurfelVisEntry>		entries;
+	// Depth of the leaf level, the root is at zero.
+	int									depth;
+	int									firstLeaf;
+};
+
+ldiSurfelVisSettings surfelVisGetDefaultSettings() {
+	ldiSurfelVisSettings result = {};
+	result.normalOffset = 0.005f;
+	result.beamRadius = 0.02f;
+	result.beamLength = 21.0f;
+	result.coneLength = 21.0f;
+	result.coneRadius = 0.25f;
+	result.minFacing = 0.0f;
+	result.tests = SVT_BEAM | SVT_CONE;
+
+	return result;
+}
+
+void surfelVisDestroy(ldiSurfelVis* Vis) {
+	Vis->nodes.clear();
+	Vis->nodes.shrink_to_fit();
+	Vis->cones.clear();
+	Vis->cones.shrink_to_fit();
+	Vis->entries.clear();
+	Vis->entries.shrink_to_fit();
+	Vis->depth = 0;
+	Vis->firstLeaf = 0;
+}
+
+//----------------------------------------------------------------------------------------------------
+// Build.
+//----------------------------------------------------------------------------------------------------
+struct _ldiSurfelVisEntryCompare {
+	int									axis;
+
+	bool operator()(const ldiSurfelVisEntry& A, const ldiSurfelVisEntry& B) const {
+		if (A.position[axis] != B.position[axis]) {
+			return A.position[axis] < B.position[axis];
+		}
+
+		return A.id < B.id;
+	}
+};
+
+struct _ldiSurfelVisBuildContext {
+	ldiSurfelVis*						vis;
+	// First node of the level being built.
+	int									levelStart;
+};
+
+void _surfelVisBuildLevelBatch(int StartIdx, int EndIdx, void* UserData) {
+	_ldiSurfelVisBuildContext* context = (_ldiSurfelVisBuildContext*)UserData;
+	ldiSurfelVis* vis = context->vis;
+
+	for (int i = StartIdx; i < EndIdx; ++i) {
+		int nodeId = context->levelStart + i;
+		ldiSurfelVisNode* node = &vis->nodes[nodeId];
+		ldiSurfelVisEntry* entries = vis->entries.data() + node->start;
+
+		vec3 boundsMin(FLT_MAX, FLT_MAX, FLT_MAX);
+		vec3 boundsMax(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+
+		for (int e = 0; e < node->count; ++e) {
+			for (int v = 0; v < 4; ++v) {
+				vec3 p = entries[e].verts[v];
+				boundsMin.x = min(boundsMin.x, p.x);
+				boundsMin.y = min(boundsMin.y, p.y);
+				boundsMin.z = min(boundsMin.z, p.z);
+				boundsMax.x = max(boundsMax.x, p.x);
+				boundsMax.y = max(boundsMax.y, p.y);
+				boundsMax.z = max(boundsMax.z, p.z);
+			}
+		}
+
+		node->min = boundsMin;
+		node->max = boundsMax;
+
+		if (nodeId >= vis->firstLeaf) {
+			continue;
+		}
+
+		vec3 extent = boundsMax - boundsMin;
+		int axis = 0;
+
+		if (extent.y > extent[axis]) {
+			axis = 1;
+		}
+
+		if (extent.z > extent[axis]) {
+			axis = 2;
+		}
+
+		int leftCount = node->count / 2;
+		std::nth_element(entries, entries + leftCount, entries + node->count, _ldiSurfelVisEntryCompare{ axis });
+
+		ldiSurfelVisNode* left = &vis->nodes[nodeId * 2 + 1];
+		ldiSurfelVisNode* right = &vis->nodes[nodeId * 2 + 2];
+
+		left->start = node->start;
+		left->count = leftCount;
+		right->start = node->start + leftCount;
+		right->count = node->count - leftCount;
+	}
+}
+
+inline ldiSurfelVisCone _surfelVisConeMerge(ldiSurfelVisCone A, ldiSurfelVisCone B) {
+	vec3 axis = A.axis + B.axis;
+	float axisLength = glm::length(axis);
+
+	if (A.angle >= (float)M_PI || B.angle >= (float)M_PI || axisLength < 1e-6f) {
+		return { vec3(0.0f, 0.0f, 1.0f), (float)M_PI };
+	}
+
+	axis /= axisLength;
+
+	float angleA = acosf(glm::clamp(glm::dot(axis, A.axis), -1.0f, 1.0f)) + A.angle;
+	float angleB = acosf(glm::clamp(glm::dot(axis, B.axis), -1.0f, 1.0f)) + B.angle;
+
+	return { axis, min(max(angleA, angleB), (float)M_PI) };
+}
+
+void _surfelVisConeLevelBatch(int StartIdx, int EndIdx, void* UserData) {
+	_ldiSurfelVisBuildContext* context = (_ldiSurfelVisBuildContext*)UserData;
+	ldiSurfelVis* vis = context->vis;
+
+	for (int i = StartIdx; i < EndIdx; ++i) {
+		int nodeId = context->levelStart + i;
+
+		if (nodeId < vis->firstLeaf) {
+			vis->cones[nodeId] = _surfelVisConeMerge(vis->cones[nodeId * 2 + 1], vis->cones[nodeId * 2 + 2]);
+			continue;
+		}
+
+		ldiSurfelVisNode* node = &vis->nodes[nodeId];
+		const ldiSurfelVisEntry* entries = vis->entries.data() + node->start;
+
+		vec3 axis(0.0f, 0.0f, 0.0f);
+
+		for (int e = 0; e < node->count; ++e) {
+			axis += entries[e].normal;
+		}
+
+		float axisLength = glm::length(axis);
+
+		if (axisLength < 1e-6f) {
+			vis->cones[nodeId] = { vec3(0.0f, 0.0f, 1.0f), (float)M_PI };
+			continue;
+		}
+
+		axis /= axisLength;
+		float minDot = 1.0f;
+
+		for (int e = 0; e < node->count; ++e) {
+			minDot = min(minDot, glm::dot(axis, entries[e].normal));
+		}
+
+		vis->cones[nodeId] = { axis, acosf(glm::clamp(minDot, -1.0f, 1.0f)) };
+	}
+}
+
+void surfelVisBuild(ldiSurfelVis* Vis, std::vector<ldiNewSurfel>* Surfels) {
+	PROFILE_ZONE_LOG("Build surfel visibility");
+	PROFILE_ITEMS(Surfels->size());
+
+	surfelVisDestroy(Vis);
+
+	int count = (int)Surfels->size();
+
+	if (count <= 0) {
+		return;
+	}
+
+	Vis->entries.resize(count);
+
+	for (int i = 0; i < count; ++i) {
+		ldiNewSurfel* s = &(*Surfels)[i];
+		ldiSurfelVisEntry* entry = &Vis->entries[i];
+
+		for (int v = 0; v < 4; ++v) {
+			entry->verts[v] = s->verts[v].position;
+		}
+
+		entry->position = s->position;
+		entry->normal = s->normal;
+		entry->id = i;
+	}
+
+	int depth = 0;
+	while (((int64_t)count + ((int64_t)1 << depth) - 1) >> depth > SURFEL_VIS_LEAF_SIZE) {
+		++depth;
+	}
+
+	Vis->depth = depth;
+	Vis->firstLeaf = (1 << depth) - 1;
+	Vis->nodes.resize(((size_t)1 << (depth + 1)) - 1);
+	Vis->cones.resize(Vis->nodes.size());
+	Vis->nodes[0].start = 0;
+	Vis->nodes[0].count = count;
+
+	_ldiSurfelVisBuildContext context = {};
+	context.vis = Vis;
+
+	for (int level = 0; level <= depth; ++level) {
+		context.levelStart = (1 << level) - 1;
+		parallelFor(0, 1 << level, 1, _surfelVisBuildLevelBatch, &context);
+	}
+
+	// NOTE: Normal cones go bottom up, each level only reads the one below it.
+	for (int level = depth; level >= 0; --level) {
+		context.levelStart = (1 << level) - 1;
+		parallelFor(0, 1 << level, 64, _surfelVisConeLevelBatch, &context);
+	}
+}
+
+//----------------------------------------------------------------------------------------------------
+// Primitive tests.
+//----------------------------------------------------------------------------------------------------
+// Closest point on triangle ABC to P, from Ericson's Real-Time Collision Detection.
+vec3 _surfelVisClosestPointTriangle(vec3 P, vec3 A, vec3 B, vec3 C) {
+	vec3 ab = B - A;
+	vec3 ac = C - A;
+	vec3 ap = P - A;
+	float d1 = glm::dot(ab, ap);
+	float d2 = glm::dot(ac, ap);
+
+	if (d1 <= 0.0f && d2 <= 0.0f) {
+		return A;
+	}
+
+	vec3 bp = P - B;
+	float d3 = glm::dot(ab, bp);
+	float d4 = glm::dot(ac, bp);
+
+	if (d3 >= 0.0f && d4 <= d3) {
+		return B;
+	}
+
+	float vc = d1 * d4 - d3 * d2;
+
+	if (vc <= 0.0f && d1 >= 0.0f && d3 <= 0.0f) {
+		return A + ab * (d1 / (d1 - d3));
+	}
+
+	vec3 cp = P - C;
+	float d5 = glm::dot(ab, cp);
+	float d6 = glm::dot(ac, cp);
+
+	if (d6 >= 0.0f && d5 <= d6) {
+		return C;
+	}
+
+	float vb = d5 * d2 - d1 * d6;
+
+	if (vb <= 0.0f && d2 >= 0.0f && d6 <= 0.0f) {
+		return A + ac * (d2 / (d2 - d6));
+	}
+
+	float va = d3 * d6 - d5 * d4;
+
+	if (va <= 0.0f && (d4 - d3) >= 0.0f && (d5 - d6) >= 0.0f) {
+		return B + (C - B) * ((d4 - d3) / ((d4 - d3) + (d5 - d6)));
+	}
+
+	float denom = 1.0f / (va + vb + vc);
+
+	return A + ab * (vb * denom) + ac * (vc * denom);
+}
+
+// Squared distance between segments P0P1 and Q0Q1, from Ericson's Real-Time Collision Detection.
+float _surfelVisSegmentSegmentDistSq(vec3 P0, vec3 P1, vec3 Q0, vec3 Q1) {
+	vec3 d1 = P1 - P0;
+	vec3 d2 = Q1 - Q0;
+	vec3 r = P0 - Q0;
+	float a = glm::dot(d1, d1);
+	float e = glm::dot(d2, d2);
+	float f = glm::dot(d2, r);
+	float s = 0.0f;
+	float t = 0.0f;
+
+	if (a <= 1e-12f && e <= 1e-12f) {
+		return glm::dot(r, r);
+	}
+
+	if (a <= 1e-12f) {
+		t = glm::clamp(f / e, 0.0f, 1.0f);
+	} else {
+		float c = glm::dot(d1, r);
+
+		if (e <= 1e-12f) {
+			s = glm::clamp(-c / a, 0.0f, 1.0f);
+		} else {
+			float b = glm::dot(d1, d2);
+			float denom = a * e - b * b;
+
+			if (denom != 0.0f) {
+				s = glm::clamp((b * f - c * e) / denom, 0.0f, 1.0f);
+			}
+
+			t = (b * s + f) / e;
+
+			if (t < 0.0f) {
+				t = 0.0f;
+				s = glm::clamp(-c / a, 0.0f, 1.0f);
+			} else if (t > 1.0f) {
+				t = 1.0f;
+				s = glm::clamp((b - c) / a, 0.0f, 1.0f);
+			}
+		}
+	}
+
+	vec3 delta = (P0 + d1 * s) - (Q0 + d2 * t);
+
+	return glm::dot(delta, delta);
+}
+
+// Whether segment P0P1 crosses triangle ABC, either side.
+bool _surfelVisSegmentTriangle(vec3 P0, vec3 P1, vec3 A, vec3 B, vec3 C) {
+	vec3 dir = P1 - P0;
+	vec3 e1 = B - A;
+	vec3 e2 = C - A;
+	vec3 p = glm::cross(dir, e2);
+	float det = glm::dot(e1, p);
+
+	if (fabsf(det) < 1e-12f) {
+		return false;
+	}
+
+	float invDet = 1.0f / det;
+	vec3 s = P0 - A;
+	float u = glm::dot(s, p) * invDet;
+
+	if (u < 0.0f || u > 1.0f) {
+		return false;
+	}
+
+	vec3 q = glm::cross(s, e1);
+	float v = glm::dot(dir, q) * invDet;
+
+	if (v < 0.0f || u + v > 1.0f) {
+		return false;
+	}
+
+	float t = glm::dot(e2, q) * invDet;
+
+	return t >= 0.0f && t <= 1.0f;
+}
+
+// Whether triangle ABC comes within Radius of segment P0P1.
+bool _surfelVisCapsuleTriangle(vec3 P0, vec3 P1, float Radius, vec3 A, vec3 B, vec3 C) {
+	if (_surfelVisSegmentTriangle(P0, P1, A, B, C)) {
+		return true;
+	}
+
+	// NOTE: When the segment doesn't cross the triangle, the closest pair has a segment end or a triangle edge in it.
+	float radiusSq = Radius * Radius;
+	vec3 delta = _surfelVisClosestPointTriangle(P0, A, B, C) - P0;
+
+	if (glm::dot(delta, delta) <= radiusSq) {
+		return true;
+	}
+
+	delta = _surfelVisClosestPointTriangle(P1, A, B, C) - P1;
+
+	if (glm::dot(delta, delta) <= radiusSq) {
+		return true;
+	}
+
+	return _surfelVisSegmentSegmentDistSq(P0, P1, A, B) <= radiusSq
+		|| _surfelVisSegmentSegmentDistSq(P0, P1, B, C) <= radiusSq
+		|| _surfelVisSegmentSegmentDistSq(P0, P1, C, A) <= radiusSq;
+}
+
+struct _ldiSurfelVisCone {
+	vec3								apex;
+	vec3								axis;
+	float								length;
+	// Squared tangent of the half angle.
+	float								tanSq;
+};
+
+inline bool _surfelVisPointInCone(const _ldiSurfelVisCone* Cone, vec3 P) {
+	vec3 d = P - Cone->apex;
+	float t = glm::dot(d, Cone->axis);
+
+	if (t < 0.0f || t > Cone->length) {
+		return false;
+	}
+
+	return glm::dot(d, d) - t * t <= Cone->tanSq * t * t;
+}
+
+// Whether segment AB enters the cone. Being inside is a quadratic condition along the segment, bounded by
+// two planes, so it can only change at the roots of those. Each root and the middle of each span between
+// them is tested, which is exact.
+bool _surfelVisSegmentCone(const _ldiSurfelVisCone* Cone, vec3 A, vec3 B) {
+	vec3 d0 = A - Cone->apex;
+	vec3 e = B - A;
+	float t0 = glm::dot(d0, Cone->axis);
+	float te = glm::dot(e, Cone->axis);
+	float k = 1.0f + Cone->tanSq;
+
+	float splits[8];
+	int splitCount = 0;
+	splits[splitCount++] = 0.0f;
+	splits[splitCount++] = 1.0f;
+
+	if (te != 0.0f) {
+		splits[splitCount++] = -t0 / te;
+		splits[splitCount++] = (Cone->length - t0) / te;
+	}
+
+	// NOTE: k * t^2 - |d|^2 is zero on the cone surface.
+	float qa = k * te * te - glm::dot(e, e);
+	float qb = 2.0f * (k * t0 * te - glm::dot(d0, e));
+	float qc = k * t0 * t0 - glm::dot(d0, d0);
+
+	if (fabsf(qa) > 1e-12f) {
+		float disc = qb * qb - 4.0f * qa * qc;
+
+		if (disc >= 0.0f) {
+			float root = sqrtf(disc);
+			splits[splitCount++] = (-qb - root) / (2.0f * qa);
+			splits[splitCount++] = (-qb + root) / (2.0f * qa);
+		}
+	} else if (fabsf(qb) > 1e-12f) {
+		splits[splitCount++] = -qc / qb;
+	}
+
+	int validCount = 0;
+
+	for (int i = 0; i < splitCount; ++i) {
+		if (splits[i] >= 0.0f && splits[i] <= 1.0f) {
+			splits[validCount++] = splits[i];
+		}
+	}
+
+	std::sort(splits, splits + validCount);
+
+	for (int i = 0; i < validCount; ++i) {
+		if (_surfelVisPointInCone(Cone, A + e * splits[i])) {
+			return true;
+		}
+
+		if (i + 1 < validCount && _surfelVisPointInCone(Cone, A + e * ((splits[i] + splits[i + 1]) * 0.5f))) {
+			return true;
+		}
+	}
+
+	return false;
+}
+
+// Whether triangle ABC overlaps the cone.
+// NOTE: Covers any triangle edge entering the cone and the axis crossing the triangle. That misses only a
+// triangle that cuts across the base cap without touching the axis segment or the cone's side, which needs a
+// triangle much larger than the cone is wide. Surfels never are.
+bool _surfelVisConeTriangle(const _ldiSurfelVisCone* Cone, vec3 A, vec3 B, vec3 C) {
+	if (_surfelVisSegmentCone(Cone, A, B) || _surfelVisSegmentCone(Cone, B, C) || _surfelVisSegmentCone(Cone, C, A)) {
+		return true;
+	}
+
+	return _surfelVisSegmentTriangle(Cone->apex, Cone->apex + Cone->axis * Cone->length, A, B, C);
+}
+
+// Conservative test of node bounds against a capsule, as a segment against the bounds grown by the radius.
+bool _surfelVisBoundsCapsule(const ldiSurfelVisNode* Node, vec3 P0, vec3 P1, float Radius) {
+	vec3 dir = P1 - P0;
+	float tMin = 0.0f;
+	float tMax = 1.0f;
+
+	for (int axis = 0; axis < 3; ++axis) {
+		float lo = Node->min[axis] - Radius;
+		float hi = Node->max[axis] + Radius;
+
+		if (fabsf(dir[axis]) < 1e-12f) {
+			if (P0[axis] < lo || P0[axis] > hi) {
+				return false;
+			}
+
+			continue;
+		}
+
+		float inv = 1.0f / dir[axis];
+		float t1 = (lo - P0[axis]) * inv;
+		float t2 = (hi - P0[axis]) * inv;
+
+		if (t1 > t2) {
+			std::swap(t1, t2);
+		}
+
+		tMin = max(tMin, t1);
+		tMax = min(tMax, t2);
+
+		if (tMin > tMax) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+// Conservative test of node bounds against a cone, using the sphere around the bounds.
+bool _surfelVisBoundsCone(const ldiSurfelVisNode* Node, const _ldiSurfelVisCone* Cone, float CosAngle, float SinAngle) {
+	vec3 center = (Node->min + Node->max) * 0.5f;
+	float radius = glm::length(Node->max - Node->min) * 0.5f;
+	vec3 d = center - Cone->apex;
+	float t = glm::dot(d, Cone->axis);
+
+	if (t < -radius || t > Cone->length + radius) {
+		return false;
+	}
+
+	float perp = sqrtf(max(glm::dot(d, d) - t * t, 0.0f));
+
+	// NOTE: Signed distance to the side of the infinite cone, measured in the plane through the axis.
+	return perp * CosAngle - t * SinAngle <= radius;
+}
+
+//----------------------------------------------------------------------------------------------------
+// Queries.
+//----------------------------------------------------------------------------------------------------
+inline float _surfelVisNodeOrder(const ldiSurfelVisNode* Node, vec3 Origin, vec3 Dir) {
+	return glm::dot((Node->min + Node->max) * 0.5f - Origin, Dir);
+}
+
+// Whether a beam of Radius from Origin along Dir, Length long, overlaps any surfel other than IgnoreId.
+// NOTE: Matches physicsBeamOverlap, the capsule's round end touches Origin.
+bool surfelVisTestBeam(ldiSurfelVis* Vis, vec3 Origin, vec3 Dir, float Radius, float Length, int IgnoreId = -1) {
+	if (Vis->nodes.empty()) {
+		return false;
+	}
+
+	vec3 p0 = Origin + Dir * Radius;
+	vec3 p1 = Origin + Dir * (Radius + Length);
+
+	int stack[SURFEL_VIS_STACK_SIZE];
+	int stackSize = 0;
+	stack[stackSize++] = 0;
+
+	while (stackSize > 0) {
+		int nodeId = stack[--stackSize];
+		const ldiSurfelVisNode* node = &Vis->nodes[nodeId];
+
+		if (node->count == 0 || !_surfelVisBoundsCapsule(node, p0, p1, Radius)) {
+			continue;
+		}
+
+		if (nodeId >= Vis->firstLeaf) {
+			const ldiSurfelVisEntry* entries = Vis->entries.data() + node->start;
+
+			for (int e = 0; e < node->count; ++e) {
+				const ldiSurfelVisEntry* entry = &entries[e];
+
+				if (entry->id == IgnoreId) {
+					continue;
+				}
+
+				if (_surfelVisCapsuleTriangle(p0, p1, Radius, entry->verts[2], entry->verts[1], entry->verts[0])
+					|| _surfelVisCapsuleTriangle(p0, p1, Radius, entry->verts[0], entry->verts[3], entry->verts[2])) {
+					return true;
+				}
+			}
+		} else {
+			// NOTE: Occluders are most likely close to the origin, so the nearer child goes on top.
+			int leftId = nodeId * 2 + 1;
+			int rightId = nodeId * 2 + 2;
+
+			if (_surfelVisNodeOrder(&Vis->nodes[leftId], Origin, Dir) <= _surfelVisNodeOrder(&Vis->nodes[rightId], Origin, Dir)) {
+				stack[stackSize++] = rightId;
+				stack[stackSize++] = leftId;
+			} else {
+				stack[stackSize++] = leftId;
+				stack[stackSize++] = rightId;
+			}
+		}
+	}
+
+	return false;
+}
+
+// Whether a cone with its apex at Origin, opening along Dir to Radius at Length, overlaps any surfel other
+// than IgnoreId.
+// NOTE: Matches physicsConeOverlap with a cone from physicsCreateCone, without the faceting.
+bool surfelVisTestCone(ldiSurfelVis* Vis, vec3 Origin, vec3 Dir, float Radius, float Length, int IgnoreId = -1) {
+	if (Vis->nodes.empty()) {
+		return false;
+	}
+
+	_ldiSurfelVisCone cone;
+	cone.apex = Origin;
+	cone.axis = Dir;
+	cone.length = Length;
+	cone.tanSq = (Radius / Length) * (Radius / Length);
+
+	float slant = sqrtf(Length * Length + Radius * Radius);
+	float cosAngle = Length / slant;
+	float sinAngle = Radius / slant;
+	vec3 axisEnd = Origin + Dir * Length;
+
+	int stack[SURFEL_VIS_STACK_SIZE];
+	int stackSize = 0;
+	stack[stackSize++] = 0;
+
+	while (stackSize > 0) {
+		int nodeId = stack[--stackSize];
+		const ldiSurfelVisNode* node = &Vis->nodes[nodeId];
+
+		// NOTE: The cone also sits inside the capsule around its axis, which is the tighter bound near the apex.
+		if (node->count == 0 || !_surfelVisBoundsCapsule(node, Origin, axisEnd, Radius) || !_surfelVisBoundsCone(node, &cone, cosAngle, sinAngle)) {
+			continue;
+		}
+
+		if (nodeId >= Vis->firstLeaf) {
+			const ldiSurfelVisEntry* entries = Vis->entries.data() + node->start;
+
+			for (int e = 0; e < node->count; ++e) {
+				const ldiSurfelVisEntry* entry = &entries[e];
+
+				if (entry->id == IgnoreId) {
+					continue;
+				}
+
+				if (_surfelVisConeTriangle(&cone, entry->verts[2], entry->verts[1], entry->verts[0])
+					|| _surfelVisConeTriangle(&cone, entry->verts[0], entry->verts[3], entry->verts[2])) {
+					return true;
+				}
+			}
+		} else {
+			int leftId = nodeId * 2 + 1;
+			int rightId = nodeId * 2 + 2;
+
+			if (_surfelVisNodeOrder(&Vis->nodes[leftId], Origin, Dir) <= _surfelVisNodeOrder(&Vis->nodes[rightId], Origin, Dir)) {
+				stack[stackSize++] = rightId;
+				stack[stackSize++] = leftId;
+			} else {
+				stack[stackSize++] = leftId;
+				stack[stackSize++] = rightId;
+			}
+		}
+	}
+
+	return false;
+}
+
+// Runs the requested tests for one surfel towards Dir, returns ldiSurfelVisResult flags.
+int _surfelVisTestEntry(ldiSurfelVis* Vis, const ldiSurfelVisEntry* Entry, vec3 Dir, ldiSurfelVisSettings* Settings) {
+	if (glm::dot(Entry->normal, Dir) < Settings->minFacing) {
+		return SVR_BACKFACING;
+	}
+
+	vec3 origin = Entry->position + Entry->normal * Settings->normalOffset;
+	int result = 0;
+
+	if ((Settings->tests & SVT_BEAM) && surfelVisTestBeam(Vis, origin, Dir, Settings->beamRadius, Settings->beamLength, Entry->id)) {
+		result |= SVR_BEAM;
+	}
+
+	if ((Settings->tests & SVT_CONE) && surfelVisTestCone(Vis, origin, Dir, Settings->coneRadius, Settings->coneLength, Entry->id)) {
+		result |= SVR_CONE;
+	}
+
+	return result;
+}
+
+//----------------------------------------------------------------------------------------------------
+// Batched queries.
+//----------------------------------------------------------------------------------------------------
+struct _ldiSurfelVisBatchContext {
+	ldiSurfelVis*						vis;
+	ldiSurfelVisSettings*				settings;
+	const vec3*							dirs;
+	int									taskLevelStart;
+	int									taskLevelCount;
+	size_t								surfelCount;
+	uint8_t*							results;
+};
+
+void _surfelVisViewsBatch(int StartIdx, int EndIdx, void* UserData) {
+	_ldiSurfelVisBatchContext* context = (_ldiSurfelVisBatchContext*)UserData;
+	ldiSurfelVis* vis = context->vis;
+	ldiSurfelVisSettings* settings = context->settings;
+
+	for (int i = StartIdx; i < EndIdx; ++i) {
+		int viewIdx = i / context->taskLevelCount;
+		vec3 dir = context->dirs[viewIdx];
+		uint8_t* results = context->results + (size_t)viewIdx * context->surfelCount;
+
+		// NOTE: The largest normal dot product inside a cone is at the angle between axis and view, less the cone's angle.
+		float facingAngle = acosf(glm::clamp(settings->minFacing, -1.0f, 1.0f));
+
+		int stack[SURFEL_VIS_STACK_SIZE];
+		int stackSize = 0;
+		stack[stackSize++] = context->taskLevelStart + i % context->taskLevelCount;
+
+		while (stackSize > 0) {
+			int nodeId = stack[--stackSize];
+			const ldiSurfelVisNode* node = &vis->nodes[nodeId];
+			const ldiSurfelVisCone* cone = &vis->cones[nodeId];
+			const ldiSurfelVisEntry* entries = vis->entries.data() + node->start;
+
+			float axisAngle = acosf(glm::clamp(glm::dot(cone->axis, dir), -1.0f, 1.0f));
+
+			if (axisAngle - cone->angle > facingAngle) {
+				for (int e = 0; e < node->count; ++e) {
+					results[entries[e].id] = SVR_BACKFACING;
+				}
+
+				continue;
+			}
+
+			if (nodeId >= vis->firstLeaf) {
+				for (int e = 0; e < node->count; ++e) {
+					results[entries[e].id] = (uint8_t)_surfelVisTestEntry(vis, &entries[e], dir, settings);
+				}
+			} else {
+				stack[stackSize++] = nodeId * 2 + 2;
+				stack[stackSize++] = nodeId * 2 + 1;
+			}
+		}
+	}
+}
+
+void _surfelVisDirsBatch(int StartIdx, int EndIdx, void* UserData) {
+	_ldiSurfelVisBatchContext* context = (_ldiSurfelVisBatchContext*)UserData;
+
+	for (int i = StartIdx; i < EndIdx; ++i) {
+		const ldiSurfelVisEntry* entry = &context->vis->entries[i];
+		context->results[entry->id] = (uint8_t)_surfelVisTestEntry(context->vis, entry, context->dirs[entry->id], context->settings);
+	}
+}
+
+// Tests every surfel against each of ViewCount directions, which point from the surfels towards the viewer.
+// The ldiSurfelVisResult flags for surfel S and view V end up at Results[V * SurfelCount + S].
+void surfelVisQueryViews(ldiSurfelVis* Vis, const vec3* ViewDirs, int ViewCount, ldiSurfelVisSettings* Settings, std::vector<uint8_t>* Results) {
+	PROFILE_ZONE_LOG("Surfel visibility views");
+	PROFILE_ITEMS((int64_t)Vis->entries.size() * ViewCount);
+
+	Results->resize(Vis->entries.size() * ViewCount);
+
+	if (Vis->nodes.empty() || ViewCount <= 0) {
+		return;
+	}
+
+	int taskLevel = max(Vis->depth - SURFEL_VIS_TASK_LEVELS, 0);
+
+	_ldiSurfelVisBatchContext context = {};
+	context.vis = Vis;
+	context.settings = Settings;
+	context.dirs = ViewDirs;
+	context.taskLevelStart = (1 << taskLevel) - 1;
+	context.taskLevelCount = 1 << taskLevel;
+	context.surfelCount = Vis->entries.size();
+	context.results = Results->data();
+
+	// NOTE: Tasks for the same view are next to each other, so threads share the top of the tree.
+	parallelFor(0, ViewCount * context.taskLevelCount, 1, _surfelVisViewsBatch, &context);
+}
+
+// Tests each surfel against its own direction, Dirs has one per surfel. Results has the ldiSurfelVisResult
+// flags for each surfel.
+void surfelVisQueryDirs(ldiSurfelVis* Vis, const vec3* Dirs, ldiSurfelVisSettings* Settings, std::vector<uint8_t>* Results) {
+	PROFILE_ZONE_LOG("Surfel visibility dirs");
+	PROFILE_ITEMS(Vis->entries.size());
+
+	Results->resize(Vis->entries.size());
+
+	_ldiSurfelVisBatchContext context = {};
+	context.vis = Vis;
+	context.settings = Settings;
+	context.dirs = Dirs;
+	context.results = Results->data();
+
+	// NOTE: Walks entries in tree order, neighboring queries traverse the same nodes.
+	parallelFor(0, (int)Vis->entries.size(), 64, _surfelVisDirsBatch, &context);
+}
\ No newline at end of file
@@ -0,0 +1,260 @@
+#pragma once
+
+#include <emmintrin.h>
+
+//----------------------------------------------------------------------------------------------------
+// Batched texture sampling.
+//----------------------------------------------------------------------------------------------------
+// Bilinear sampling of RGBA8 images over arrays of UVs. Addressing math runs 4 UVs at a time, texel
+// fetches are scalar loads (no gather on the SSE2 baseline) and the 4 channels of each sample are
+// filtered together. Results are packed RGBA8, truncated the same way as writing float * 255 to a byte.
+//
+// UVs follow the project convention, V = 0 is the bottom row of the image.
+
+// Set to 0 to use the scalar path for everything.
+#define TEXSAMPLER_SIMD 1
+#define TEXSAMPLER_MAX_MIPS 16
+
+enum ldiTexAddressMode {
+	TAM_CLAMP,
+	TAM_WRAP,
+};
+
+struct ldiTexSampler {
+	ldiTexAddressMode	addressMode;
+	int					mipCount;
+	// NOTE: Mip 0 is the source image and is not owned by the sampler.
+	ldiImage			mips[TEXSAMPLER_MAX_MIPS];
+};
+
+struct ldiTexMipBuildContext {
+	ldiImage*			src;
+	ldiImage*			dst;
+};
+
+void texSamplerMipBatch(int StartIdx, int EndIdx, void* UserData) {
+	ldiTexMipBuildContext* context = (ldiTexMipBuildContext*)UserData;
+	ldiImage* src = context->src;
+	ldiImage* dst = context->dst;
+
+	for (int iY = StartIdx; iY < EndIdx; ++iY) {
+		int sY0 = min(iY * 2, src->height - 1);
+		int sY1 = min(iY * 2 + 1, src->height - 1);
+
+		for (int iX = 0; iX < dst->width; ++iX) {
+			int sX0 = min(iX * 2, src->width - 1);
+			int sX1 = min(iX * 2 + 1, src->width - 1);
+
+			uint8_t* p00 = &src->data[(sX0 + sY0 * src->width) * 4];
+			uint8_t* p10 = &src->data[(sX1 + sY0 * src->width) * 4];
+			uint8_t* p01 = &src->data[(sX0 + sY1 * src->width) * 4];
+			uint8_t* p11 = &src->data[(sX1 + sY1 * src->width) * 4];
+			uint8_t* d = &dst->data[(iX + iY * dst->width) * 4];
+
+			for (int c = 0; c < 4; ++c) {
+				d[c] = (uint8_t)((p00[c] + p10[c] + p01[c] + p11[c] + 2) / 4);
+			}
+		}
+	}
+}
+
+// Image must be RGBA8 and outlive the sampler. MaxMips of 1 samples the image directly.
+void texSamplerInit(ldiTexSampler* Sampler, ldiImage* Image, ldiTexAddressMode AddressMode, int MaxMips = 1) {
+	Sampler->addressMode = AddressMode;
+	Sampler->mips[0] = *Image;
+	Sampler->mipCount = 1;
+
+	MaxMips = min(MaxMips, TEXSAMPLER_MAX_MIPS);
+
+	while (Sampler->mipCount < MaxMips) {
+		ldiImage* src = &Sampler->mips[Sampler->mipCount - 1];
+
+		if (src->width == 1 && src->height == 1) {
+			break;
+		}
+
+		ldiImage* dst = &Sampler->mips[Sampler->mipCount];
+		dst->width = max(1, src->width / 2);
+		dst->height = max(1, src->height / 2);
+		dst->data = new uint8_t[dst->width * dst->height * 4];
+
+		ldiTexMipBuildContext mc;
+		mc.src = src;
+		mc.dst = dst;
+		parallelFor(0, dst->height, 16, texSamplerMipBatch, &mc);
+
+		++Sampler->mipCount;
+	}
+}
+
+void texSamplerDestroy(ldiTexSampler* Sampler) {
+	for (int i = 1; i < Sampler->mipCount; ++i) {
+		delete[] Sampler->mips[i].data;
+	}
+
+	Sampler->mipCount = 0;
+}
+
+// Footprint is the distance between neighbouring samples in mip 0 texels.
+int texSamplerGetMip(ldiTexSampler* Sampler, float Footprint) {
+	if (Footprint <= 1.0f) {
+		return 0;
+	}
+
+	return min((int)log2f(Footprint), Sampler->mipCount - 1);
+}
+
+//----------------------------------------------------------------------------------------------------
+// Scalar path.
+//----------------------------------------------------------------------------------------------------
+inline void _texGetCoords(ldiTexAddressMode AddressMode, float Coord, int Size, int* C0, int* C1, float* Frac) {
+	if (AddressMode == TAM_WRAP) {
+		Coord -= floorf(Coord);
+	}
+
+	float x = Coord * Size - 0.5f;
+	float xf = floorf(x);
+	int xi = (int)xf;
+	*Frac = x - xf;
+
+	if (AddressMode == TAM_WRAP) {
+		*C0 = (xi < 0) ? Size - 1 : xi;
+		*C1 = (xi + 1 >= Size) ? 0 : xi + 1;
+	} else {
+		*C0 = clamp(xi, 0, Size - 1);
+		*C1 = clamp(xi + 1, 0, Size - 1);
+	}
+}
+
+uint32_t texSampleBilinearScalar(ldiTexSampler* Sampler, int Mip, vec2 Uv) {
+	ldiImage* image = &Sampler->mips[Mip];
+
+	int x0, x1, y0, y1;
+	float fX, fY;
+	_texGetCoords(Sampler->addressMode, Uv.x, image->width, &x0, &x1, &fX);
+	_texGetCoords(Sampler->addressMode, 1.0f - Uv.y, image->height, &y0, &y1, &fY);
+
+	const uint8_t* p00 = &image->data[(x0 + y0 * image->width) * 4];
+	const uint8_t* p10 = &image->data[(x1 + y0 * image->width) * 4];
+	const uint8_t* p01 = &image->data[(x0 + y1 * image->width) * 4];
+	const uint8_t* p11 = &image->data[(x1 + y1 * image->width) * 4];
+
+	uint32_t result = 0;
+
+	for (int c = 0; c < 4; ++c) {
+		float a = p00[c] + (p10[c] - p00[c]) * fX;
+		float b = p01[c] + (p11[c] - p01[c]) * fX;
+		float v = a + (b - a) * fY;
+
+		result |= (uint32_t)(uint8_t)v << (c * 8);
+	}
+
+	return result;
+}
+
+//----------------------------------------------------------------------------------------------------
+// SIMD path.
+//----------------------------------------------------------------------------------------------------
+inline __m128 _texFloor(__m128 X) {
+	// NOTE: SSE2 has no floor, truncate and step down for negative non-integers.
+	__m128 t = _mm_cvtepi32_ps(_mm_cvttps_epi32(X));
+	return _mm_sub_ps(t, _mm_and_ps(_mm_cmplt_ps(X, t), _mm_set1_ps(1.0f)));
+}
+
+inline __m128i _texSelect(__m128i Mask, __m128i A, __m128i B) {
+	return _mm_or_si128(_mm_and_si128(Mask, A), _mm_andnot_si128(Mask, B));
+}
+
+inline void _texGetCoords4(ldiTexAddressMode AddressMode, __m128 Coord, int Size, __m128i* C0, __m128i* C1, __m128* Frac) {
+	if (AddressMode == TAM_WRAP) {
+		Coord = _mm_sub_ps(Coord, _texFloor(Coord));
+	}
+
+	__m128 x = _mm_sub_ps(_mm_mul_ps(Coord, _mm_set1_ps((float)Size)), _mm_set1_ps(0.5f));
+	__m128 xf = _texFloor(x);
+	__m128i xi = _mm_cvttps_epi32(xf);
+	__m128i xi1 = _mm_add_epi32(xi, _mm_set1_epi32(1));
+	__m128i zero = _mm_setzero_si128();
+	__m128i last = _mm_set1_epi32(Size - 1);
+
+	*Frac = _mm_sub_ps(x, xf);
+
+	if (AddressMode == TAM_WRAP) {
+		*C0 = _texSelect(_mm_cmplt_epi32(xi, zero), last, xi);
+		*C1 = _texSelect(_mm_cmpgt_epi32(xi1, last), zero, xi1);
+	} else {
+		// NOTE: No epi32 min/max in SSE2.
+		xi = _texSelect(_mm_cmplt_epi32(xi, zero), zero, xi);
+		xi = _texSelect(_mm_cmpgt_epi32(xi, last), last, xi);
+		xi1 = _texSelect(_mm_cmplt_epi32(xi1, zero), zero, xi1);
+		xi1 = _texSelect(_mm_cmpgt_epi32(xi1, last), last, xi1);
+		*C0 = xi;
+		*C1 = xi1;
+	}
+}
+
+inline __m128 _texUnpack(uint32_t Texel) {
+	__m128i zero = _mm_setzero_si128();
+	__m128i t = _mm_cvtsi32_si128((int)Texel);
+	t = _mm_unpacklo_epi8(t, zero);
+	t = _mm_unpacklo_epi16(t, zero);
+	return _mm_cvtepi32_ps(t);
+}
+
+void _texSampleBilinear4(ldiTexSampler* Sampler, int Mip, const vec2* Uvs, uint32_t* Results) {
+	ldiImage* image = &Sampler->mips[Mip];
+	const uint32_t* texels = (const uint32_t*)image->data;
+
+	__m128 u = _mm_setr_ps(Uvs[0].x, Uvs[1].x, Uvs[2].x, Uvs[3].x);
+	__m128 v = _mm_sub_ps(_mm_set1_ps(1.0f), _mm_setr_ps(Uvs[0].y, Uvs[1].y, Uvs[2].y, Uvs[3].y));
+
+	__m128i x0, x1, y0, y1;
+	__m128 fX, fY;
+	_texGetCoords4(Sampler->addressMode, u, image->width, &x0, &x1, &fX);
+	_texGetCoords4(Sampler->addressMode, v, image->height, &y0, &y1, &fY);
+
+	alignas(16) int ax0[4], ax1[4], ay0[4], ay1[4];
+	alignas(16) float afX[4], afY[4];
+	_mm_store_si128((__m128i*)ax0, x0);
+	_mm_store_si128((__m128i*)ax1, x1);
+	_mm_store_si128((__m128i*)ay0, y0);
+	_mm_store_si128((__m128i*)ay1, y1);
+	_mm_store_ps(afX, fX);
+	_mm_store_ps(afY, fY);
+
+	for (int i = 0; i < 4; ++i) {
+		int row0 = ay0[i] * image->width;
+		int row1 = ay1[i] * image->width;
+
+		__m128 p00 = _texUnpack(texels[ax0[i] + row0]);
+		__m128 p10 = _texUnpack(texels[ax1[i] + row0]);
+		__m128 p01 = _texUnpack(texels[ax0[i] + row1]);
+		__m128 p11 = _texUnpack(texels[ax1[i] + row1]);
+
+		__m128 wX = _mm_set1_ps(afX[i]);
+		__m128 a = _mm_add_ps(p00, _mm_mul_ps(_mm_sub_ps(p10, p00), wX));
+		__m128 b = _mm_add_ps(p01, _mm_mul_ps(_mm_sub_ps(p11, p01), wX));
+		__m128 c = _mm_add_ps(a, _mm_mul_ps(_mm_sub_ps(b, a), _mm_set1_ps(afY[i])));
+
+		__m128i ci = _mm_cvttps_epi32(c);
+		ci = _mm_packs_epi32(ci, ci);
+		ci = _mm_packus_epi16(ci, ci);
+		Results[i] = (uint32_t)_mm_cvtsi128_si32(ci);
+	}
+}
+
+// Samples Count UVs into packed RGBA8 Results.
+void texSampleBilinear(ldiTexSampler* Sampler, int Count, const vec2* Uvs, uint32_t* Results, float Footprint = 0.0f) {
+	int mip = texSamplerGetMip(Sampler, Footprint);
+	int i = 0;
+
+#if TEXSAMPLER_SIMD
+	for (; i + 4 <= Count; i += 4) {
+		_texSampleBilinear4(Sampler, mip, Uvs + i, Results + i);
+	}
+#endif
+
+	for (; i < Count; ++i) {
+		Results[i] = texSampleBilinearScalar(Sampler, mip, Uvs[i]);
+	}
+}
\ No newline at end of file
@@ -0,0 +1,346 @@
+#pragma once
+
+#include <atomic>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <string>
+#include <condition_variable>
+
+//----------------------------------------------------------------------------------------------------
+// Work-stealing thread pool.
+//----------------------------------------------------------------------------------------------------
+// Process-wide pool sized to the hardware. Each worker owns a deque, it pops its own work from the back
+// and steals from the front of other workers when empty. Tasks pushed from non-pool threads go to a
+// shared inject queue. Threads that wait on a task group run queued tasks while they wait, so nested
+// parallelFor calls from inside tasks don't deadlock.
+//
+// Usage:
+//   parallelFor(0, count, 64, myRangeFunc, &context);
+//
+//   ldiTaskGroup group;
+//   threadPoolRun(&group, myTaskFunc, &context);
+//   threadPoolWait(&group);
+
+typedef void (*ldiTaskFunc)(void* UserData);
+typedef void (*ldiParallelForFunc)(int StartIdx, int EndIdx, void* UserData);
+
+struct ldiTaskGroup {
+	std::atomic_int				pending = 0;
+	std::atomic_bool			cancelled = false;
+	std::mutex					mutex;
+	std::condition_variable		doneCondVar;
+};
+
+struct ldiTask {
+	ldiTaskFunc					func;
+	void*						userData;
+	ldiTaskGroup*				group;
+};
+
+struct ldiThreadPoolWorker {
+	std::mutex					mutex;
+	std::deque<ldiTask>			tasks;
+	std::thread					thread;
+};
+
+struct ldiThreadPool {
+	std::atomic_bool					initialized = false;
+	std::mutex							initMutex;
+	std::vector<ldiThreadPoolWorker*>	workers;
+
+	std::mutex							injectMutex;
+	std::deque<ldiTask>					injectTasks;
+
+	std::atomic_int						queuedCount = 0;
+	std::atomic_bool					shutdown = false;
+	std::mutex							wakeMutex;
+	std::condition_variable				wakeCondVar;
+};
+
+ldiThreadPool _threadPool;
+thread_local int _threadPoolWorkerIdx = -1;
+
+bool _threadPoolPopTask(ldiTask* Task) {
+	int workerCount = (int)_threadPool.workers.size();
+	int ownIdx = _threadPoolWorkerIdx;
+
+	if (ownIdx != -1) {
+		ldiThreadPoolWorker* worker = _threadPool.workers[ownIdx];
+		std::unique_lock<std::mutex> lock(worker->mutex);
+
+		if (!worker->tasks.empty()) {
+			*Task = worker->tasks.back();
+			worker->tasks.pop_back();
+			_threadPool.queuedCount--;
+			return true;
+		}
+	}
+
+	{
+		std::unique_lock<std::mutex> lock(_threadPool.injectMutex);
+
+		if (!_threadPool.injectTasks.empty()) {
+			*Task = _threadPool.injectTasks.front();
+			_threadPool.injectTasks.pop_front();
+			_threadPool.queuedCount--;
+			return true;
+		}
+	}
+
+	// NOTE: Steal the oldest task, it is most likely the largest piece of remaining work.
+	int startIdx = (ownIdx != -1) ? ownIdx + 1 : 0;
+
+	for (int i = 0; i < workerCount; ++i) {
+		int victimIdx = (startIdx + i) % workerCount;
+
+		if (victimIdx == ownIdx) {
+			continue;
+		}
+
+		ldiThreadPoolWorker* victim = _threadPool.workers[victimIdx];
+
+		std::unique_lock<std::mutex> lock(victim->mutex);
+
+		if (!victim->tasks.empty()) {
+			*Task = victim->tasks.front();
+			victim->tasks.pop_front();
+			_threadPool.queuedCount--;
+			return true;
+		}
+	}
+
+	return false;
+}
+
+void _threadPoolExecute(ldiTask* Task) {
+	ldiTaskGroup* group = Task->group;
+
+	if (!group->cancelled) {
+		Task->func(Task->userData);
+	}
+
+	// NOTE: Decrement under the group lock so a waiter can't destroy the group while we notify.
+	std::unique_lock<std::mutex> lock(group->mutex);
+
+	if (--group->pending == 0) {
+		group->doneCondVar.notify_all();
+	}
+}
+
+void _threadPoolWorkerThread(int WorkerIdx) {
+	_threadPoolWorkerIdx = WorkerIdx;
+	PROFILE_THREAD_NAME(("Worker " + std::to_string(WorkerIdx)).c_str());
+
+	while (true) {
+		ldiTask task;
+
+		if (_threadPoolPopTask(&task)) {
+			_threadPoolExecute(&task);
+			continue;
+		}
+
+		std::unique_lock<std::mutex> lock(_threadPool.wakeMutex);
+
+		while (_threadPool.queuedCount == 0 && !_threadPool.shutdown) {
+			_threadPool.wakeCondVar.wait(lock);
+		}
+
+		if (_threadPool.shutdown && _threadPool.queuedCount == 0) {
+			return;
+		}
+	}
+}
+
+// WorkerCount of 0 uses one worker per hardware thread, minus the calling thread which also runs tasks
+// while it waits.
+void threadPoolInit(int WorkerCount = 0) {
+	if (_threadPool.initialized) {
+		return;
+	}
+
+	std::unique_lock<std::mutex> lock(_threadPool.initMutex);
+
+	if (_threadPool.initialized) {
+		return;
+	}
+
+	if (WorkerCount <= 0) {
+		WorkerCount = max(1, (int)std::thread::hardware_concurrency() - 1);
+	}
+
+	_threadPool.shutdown = false;
+	_threadPool.workers.resize(WorkerCount);
+
+	for (int i = 0; i < WorkerCount; ++i) {
+		_threadPool.workers[i] = new ldiThreadPoolWorker();
+	}
+
+	// NOTE: All workers must exist before any thread starts stealing.
+	for (int i = 0; i < WorkerCount; ++i) {
+		_threadPool.workers[i]->thread = std::thread(_threadPoolWorkerThread, i);
+	}
+
+	_threadPool.initialized = true;
+
+	std::cout << "Thread pool workers: " << WorkerCount << "\n";
+}
+
+// Runs remaining queued tasks, then stops and joins all workers.
+void threadPoolDestroy() {
+	std::unique_lock<std::mutex> initLock(_threadPool.initMutex);
+
+	if (!_threadPool.initialized) {
+		return;
+	}
+
+	{
+		std::unique_lock<std::mutex> lock(_threadPool.wakeMutex);
+		_threadPool.shutdown = true;
+	}
+	_threadPool.wakeCondVar.notify_all();
+
+	for (size_t i = 0; i < _threadPool.workers.size(); ++i) {
+		_threadPool.workers[i]->thread.join();
+		delete _threadPool.workers[i];
+	}
+
+	_threadPool.workers.clear();
+	_threadPool.initialized = false;
+}
+
+// Number of threads that run tasks, including the waiting thread.
+int threadPoolGetThreadCount() {
+	threadPoolInit();
+	return (int)_threadPool.workers.size() + 1;
+}
+
+void threadPoolRun(ldiTaskGroup* Group, ldiTaskFunc Func, void* UserData) {
+	threadPoolInit();
+
+	ldiTask task;
+	task.func = Func;
+	task.userData = UserData;
+	task.group = Group;
+
+	Group->pending++;
+	_threadPool.queuedCount++;
+
+	if (_threadPoolWorkerIdx != -1) {
+		ldiThreadPoolWorker* worker = _threadPool.workers[_threadPoolWorkerIdx];
+		std::unique_lock<std::mutex> lock(worker->mutex);
+		worker->tasks.push_back(task);
+	} else {
+		std::unique_lock<std::mutex> lock(_threadPool.injectMutex);
+		_threadPool.injectTasks.push_back(task);
+	}
+
+	{
+		std::unique_lock<std::mutex> lock(_threadPool.wakeMutex);
+	}
+	_threadPool.wakeCondVar.notify_one();
+}
+
+// Runs one queued task on the calling thread. Returns false if there was nothing to run. Lets threads that
+// block on something other than a task group keep the pool moving.
+bool threadPoolRunOne() {
+	ldiTask task;
+
+	if (!_threadPoolPopTask(&task)) {
+		return false;
+	}
+
+	_threadPoolExecute(&task);
+
+	return true;
+}
+
+// Blocks until every task in the group has finished or been skipped by cancel. Runs queued tasks meanwhile.
+void threadPoolWait(ldiTaskGroup* Group) {
+	while (Group->pending > 0) {
+		if (threadPoolRunOne()) {
+			continue;
+		}
+
+		std::unique_lock<std::mutex> lock(Group->mutex);
+
+		if (Group->pending > 0) {
+			// NOTE: Timeout so we pick up tasks that are pushed while the group is still running.
+			Group->doneCondVar.wait_for(lock, std::chrono::milliseconds(1));
+		}
+	}
+
+	// NOTE: Sync with the last _threadPoolExecute so it has released the group before we return.
+	std::unique_lock<std::mutex> lock(Group->mutex);
+}
+
+// Tasks in the group that have not started are skipped. Running tasks can poll threadPoolIsCancelled.
+void threadPoolCancel(ldiTaskGroup* Group) {
+	Group->cancelled = true;
+}
+
+bool threadPoolIsCancelled(ldiTaskGroup* Group) {
+	return Group && Group->cancelled;
+}
+
+//----------------------------------------------------------------------------------------------------
+// Parallel for.
+//----------------------------------------------------------------------------------------------------
+struct ldiParallelForRange {
+	ldiParallelForFunc			func;
+	void*						userData;
+	ldiTaskGroup*				group;
+	ldiTaskGroup*				cancelGroup;
+	std::atomic_int				nextIdx;
+	int							endIdx;
+	int							grain;
+};
+
+void _parallelForTask(void* UserData) {
+	ldiParallelForRange* range = (ldiParallelForRange*)UserData;
+
+	while (!range->group->cancelled && !threadPoolIsCancelled(range->cancelGroup)) {
+		int startIdx = range->nextIdx.fetch_add(range->grain);
+
+		if (startIdx >= range->endIdx) {
+			break;
+		}
+
+		range->func(startIdx, min(startIdx + range->grain, range->endIdx), range->userData);
+	}
+}
+
+// Calls Func over [StartIdx, EndIdx) in chunks of at least MinGrain items. Chunks are handed out
+// dynamically so uneven work balances across threads. Returns when the whole range is done, or early
+// if CancelGroup is cancelled.
+void parallelFor(int StartIdx, int EndIdx, int MinGrain, ldiParallelForFunc Func, void* UserData, ldiTaskGroup* CancelGroup = 0) {
+	int count = EndIdx - StartIdx;
+
+	if (count <= 0) {
+		return;
+	}
+
+	int threadCount = threadPoolGetThreadCount();
+	// NOTE: Around 8 chunks per thread is enough to even out uneven items without much overhead.
+	int grain = max(max(1, MinGrain), count / (threadCount * 8));
+	int chunkCount = (count + grain - 1) / grain;
+	int taskCount = min(threadCount, chunkCount);
+
+	ldiTaskGroup group;
+
+	ldiParallelForRange range;
+	range.func = Func;
+	range.userData = UserData;
+	range.group = &group;
+	range.cancelGroup = CancelGroup;
+	range.nextIdx = StartIdx;
+	range.endIdx = EndIdx;
+	range.grain = grain;
+
+	for (int i = 1; i < taskCount; ++i) {
+		threadPoolRun(&group, _parallelForTask, &range);
+	}
+
+	_parallelForTask(&range);
+	threadPoolWait(&group);
+}
\ No newline at end of file
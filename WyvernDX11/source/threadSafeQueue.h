@@ -6,16 +6,16 @@
 
 struct ldiThreadSafeQueue {
 	std::queue<void*>			queue;
+	bool						terminated = false;
 
 	std::mutex					mutex;
-	std::mutex					waitForElementMutex;
 	std::condition_variable		waitForElementCondVar;
 };
 
 void tsqPush(ldiThreadSafeQueue* Queue, void* Element) {
 	std::unique_lock<std::mutex> lock(Queue->mutex);
 	Queue->queue.push(Element);
-	Queue->waitForElementCondVar.notify_all();
+	Queue->waitForElementCondVar.notify_one();
 }
 
 void* tsqPop(ldiThreadSafeQueue* Queue) {
@@ -31,21 +31,27 @@ void* tsqPop(ldiThreadSafeQueue* Queue) {
 	return nullptr;
 }
 
+// Blocks until an element is available. Returns nullptr once the queue has been terminated and drained.
 void* tsqWaitPop(ldiThreadSafeQueue* Queue) {
-	// TODO: Allow waiting threads to exit.
-
-	while (true) {
-		void* element = tsqPop(Queue);
-
-		if (element != nullptr) {
-			return element;
-		}
+	std::unique_lock<std::mutex> lock(Queue->mutex);
 
-		std::unique_lock<std::mutex> lock(Queue->waitForElementMutex);
+	while (Queue->queue.empty() && !Queue->terminated) {
 		Queue->waitForElementCondVar.wait(lock);
 	}
+
+	if (Queue->queue.empty()) {
+		return nullptr;
+	}
+
+	void* element = Queue->queue.front();
+	Queue->queue.pop();
+
+	return element;
 }
 
+// Wakes all waiting threads and makes tsqWaitPop return nullptr when the queue is empty.
 void tsqTerminate(ldiThreadSafeQueue* Queue) {
+	std::unique_lock<std::mutex> lock(Queue->mutex);
+	Queue->terminated = true;
 	Queue->waitForElementCondVar.notify_all();
 }
\ No newline at end of file
@@ -253,6 +253,31 @@ bool getLineRectIntersection(vec2 lineOrigin, vec2 lineDirection, vec2 rectMin,
 	return true;
 }
 
+//----------------------------------------------------------------------------------------------------
+// Hashing.
+//----------------------------------------------------------------------------------------------------
+#define HASH_FNV1A_SEED 14695981039346656037ull
+
+// FNV-1a, chain calls by passing the previous result as Hash.
+uint64_t hashFnv1a(uint64_t Hash, const void* Data, size_t Size) {
+	const uint8_t* bytes = (const uint8_t*)Data;
+
+	for (size_t i = 0; i < Size; ++i) {
+		Hash ^= bytes[i];
+		Hash *= 1099511628211ull;
+	}
+
+	return Hash;
+}
+
+// Adds the element count ahead of the data, so split points between vectors can't collide.
+template<class T> uint64_t hashFnv1aVector(uint64_t Hash, const std::vector<T>& Vector) {
+	uint64_t size = Vector.size();
+	Hash = hashFnv1a(Hash, &size, sizeof(size));
+
+	return hashFnv1a(Hash, Vector.data(), Vector.size() * sizeof(T));
+}
+
 //----------------------------------------------------------------------------------------------------
 // Strings.
 //----------------------------------------------------------------------------------------------------
@@ -320,6 +345,23 @@ int readFile(const std::string& Path, uint8_t** Data) {
 	return (int)fileLen;
 }
 
+// Chains the size and content of a whole file onto Hash, false if it can't be read.
+bool hashFnv1aFile(uint64_t* Hash, const std::string& Path) {
+	uint8_t* data;
+	int size = readFile(Path, &data);
+
+	if (size < 0) {
+		return false;
+	}
+
+	uint64_t size64 = size;
+	*Hash = hashFnv1a(*Hash, &size64, sizeof(size64));
+	*Hash = hashFnv1a(*Hash, data, size);
+	delete[] data;
+
+	return true;
+}
+
 bool showOpenFileDialog(HWND WindowHandle, const std::string& DefaultFolderPath, std::string& FilePath, const LPCWSTR ExtensionInfo, const LPCWSTR ExtensionFilter) {
 	bool result = false;
 	
@@ -1,9 +1,17 @@
 #pragma once
 
 #include <stdint.h>
+#include <unordered_map>
+#include <unordered_set>
+#include <algorithm>
+#include <climits>
 
 #define VOXEL_CHUNK_SIZE 8
 #define VOXEL_CHUNK_TOTAL (VOXEL_CHUNK_SIZE * VOXEL_CHUNK_SIZE * VOXEL_CHUNK_SIZE)
+// NOTE: Cells further than this from the surface are not stored, only the sign of their chunk is kept.
+#define VOXEL_NARROW_BAND 2.0f
+#define VOXEL_OUTSIDE_VALUE 10.0f
+#define VOXEL_INSIDE_VALUE -10.0f
 
 struct ldiVoxelCell {
 	float value;
@@ -26,6 +34,8 @@ struct ldiVoxelChunk {
 	int z;
 };
 
+// Sparse grid. Chunks are found through a hash of their chunk coordinate and only chunks that contain
+// the surface band are allocated. Chunks fully inside the surface are tracked by key only.
 struct ldiVoxelGrid {
 	int cellSizeX;
 	int cellSizeY;
@@ -34,10 +44,18 @@ struct ldiVoxelGrid {
 	int sizeY;
 	int sizeZ;
 	float scale;
-	int* chunks;
+	std::unordered_map<uint64_t, int> chunkMap;
+	std::unordered_set<uint64_t> solidChunks;
 	std::vector<ldiVoxelChunk*> rawChunks;
 };
 
+// Cell position in grid cell units, returns signed distance in cell units. Negative is inside.
+typedef float (*ldiVoxelSdfFunc)(vec3 CellPos, void* UserData);
+
+inline uint64_t voxelGetChunkKey(int ChunkX, int ChunkY, int ChunkZ) {
+	return ((uint64_t)(uint32_t)ChunkX & 0x1FFFFF) | (((uint64_t)(uint32_t)ChunkY & 0x1FFFFF) << 21) | (((uint64_t)(uint32_t)ChunkZ & 0x1FFFFF) << 42);
+}
+
 ldiVoxelGrid voxelCreateGrid(int SizeX, int SizeY, int SizeZ) {
 	ldiVoxelGrid result;
 
@@ -51,26 +69,60 @@ ldiVoxelGrid voxelCreateGrid(int SizeX, int SizeY, int SizeZ) {
 
 	result.scale = 0.1f;
 
-	result.chunks = new int[SizeX * SizeY * SizeZ];
-	memset(result.chunks, -1, 4 * SizeX * SizeY * SizeZ);
-
 	return result;
 }
 
-ldiVoxelChunk* voxelGetChunk(ldiVoxelGrid* Grid, int CellPosX, int CellPosY, int CellPosZ) {
-	int posX = CellPosX / VOXEL_CHUNK_SIZE;
-	int posY = CellPosY / VOXEL_CHUNK_SIZE;
-	int posZ = CellPosZ / VOXEL_CHUNK_SIZE;
+void voxelDestroyGrid(ldiVoxelGrid* Grid) {
+	for (size_t i = 0; i < Grid->rawChunks.size(); ++i) {
+		delete Grid->rawChunks[i];
+	}
 
-	int idx = posX + posY * Grid->sizeX + posZ * Grid->sizeX * Grid->sizeY;
+	Grid->rawChunks.clear();
+	Grid->chunkMap.clear();
+	Grid->solidChunks.clear();
+}
 
-	int chunkIdx = Grid->chunks[idx];
+inline ldiVoxelChunk* voxelGetChunkByChunkPos(ldiVoxelGrid* Grid, int ChunkX, int ChunkY, int ChunkZ) {
+	auto entry = Grid->chunkMap.find(voxelGetChunkKey(ChunkX, ChunkY, ChunkZ));
 
-	if (chunkIdx == -1) {
+	if (entry == Grid->chunkMap.end()) {
 		return 0;
 	}
 
-	return Grid->rawChunks[chunkIdx];
+	return Grid->rawChunks[entry->second];
+}
+
+// Value used for every cell of a chunk that is not allocated.
+inline float voxelGetUnallocatedValue(ldiVoxelGrid* Grid, int ChunkX, int ChunkY, int ChunkZ) {
+	if (Grid->solidChunks.find(voxelGetChunkKey(ChunkX, ChunkY, ChunkZ)) != Grid->solidChunks.end()) {
+		return VOXEL_INSIDE_VALUE;
+	}
+
+	return VOXEL_OUTSIDE_VALUE;
+}
+
+ldiVoxelChunk* voxelGetChunk(ldiVoxelGrid* Grid, int CellPosX, int CellPosY, int CellPosZ) {
+	return voxelGetChunkByChunkPos(Grid, CellPosX / VOXEL_CHUNK_SIZE, CellPosY / VOXEL_CHUNK_SIZE, CellPosZ / VOXEL_CHUNK_SIZE);
+}
+
+ldiVoxelChunk* _voxelCreateChunk(ldiVoxelGrid* Grid, int ChunkX, int ChunkY, int ChunkZ) {
+	ldiVoxelChunk* newChunk = new ldiVoxelChunk;
+	memset(newChunk, 0, sizeof(ldiVoxelChunk));
+
+	for (int i = 0; i < VOXEL_CHUNK_TOTAL; ++i) {
+		newChunk->cells[i].value = VOXEL_OUTSIDE_VALUE;
+	}
+
+	newChunk->x = ChunkX;
+	newChunk->y = ChunkY;
+	newChunk->z = ChunkZ;
+
+	uint64_t key = voxelGetChunkKey(ChunkX, ChunkY, ChunkZ);
+	Grid->chunkMap[key] = (int)Grid->rawChunks.size();
+	Grid->solidChunks.erase(key);
+	Grid->rawChunks.push_back(newChunk);
+
+	return newChunk;
 }
 
 ldiVoxelChunk* voxelGetOrCreateChunk(ldiVoxelGrid* Grid, int CellPosX, int CellPosY, int CellPosZ) {
@@ -78,27 +130,13 @@ ldiVoxelChunk* voxelGetOrCreateChunk(ldiVoxelGrid* Grid, int CellPosX, int CellP
 	int posY = CellPosY / VOXEL_CHUNK_SIZE;
 	int posZ = CellPosZ / VOXEL_CHUNK_SIZE;
 
-	int idx = posX + posY * Grid->sizeX + posZ * Grid->sizeX * Grid->sizeY;
+	ldiVoxelChunk* chunk = voxelGetChunkByChunkPos(Grid, posX, posY, posZ);
 
-	int chunkIdx = Grid->chunks[idx];
-
-	if (chunkIdx == -1) {
-		ldiVoxelChunk* newChunk = new ldiVoxelChunk;
-		memset(newChunk, 0, sizeof(ldiVoxelChunk));
-
-		for (int i = 0; i < VOXEL_CHUNK_TOTAL; ++i) {
-			newChunk->cells[i].value = 10.0f;
-		}
-
-		newChunk->x = posX;
-		newChunk->y = posY;
-		newChunk->z = posZ;
-		Grid->chunks[idx] = (int)Grid->rawChunks.size();
-		Grid->rawChunks.push_back(newChunk);
-		return newChunk;
+	if (!chunk) {
+		chunk = _voxelCreateChunk(Grid, posX, posY, posZ);
 	}
 
-	return Grid->rawChunks[chunkIdx];
+	return chunk;
 }
 
 void voxelSetCell(ldiVoxelGrid* Grid, int CellPosX, int CellPosY, int CellPosZ, ldiVoxelCell Cell) {
@@ -129,6 +167,103 @@ ldiVoxelCell* voxelGetCell(ldiVoxelGrid* Grid, int CellPosX, int CellPosY, int C
 	return &chunk->cells[idx];
 };
 
+//----------------------------------------------------------------------------------------------------
+// Parallel SDF fill.
+//----------------------------------------------------------------------------------------------------
+enum ldiVoxelChunkClass : uint8_t {
+	VCC_OUTSIDE,
+	VCC_INSIDE,
+	VCC_SURFACE,
+};
+
+struct ldiVoxelFillThreadContext {
+	ldiVoxelGrid*			grid;
+	ldiVoxelSdfFunc			sdf;
+	void*					userData;
+	float					band;
+	std::vector<uint8_t>*	chunkClass;
+};
+
+void voxelClassifyThreadBatch(int StartIdx, int EndIdx, void* UserData) {
+	ldiVoxelFillThreadContext* context = (ldiVoxelFillThreadContext*)UserData;
+	ldiVoxelGrid* grid = context->grid;
+	// NOTE: Distance from chunk center to its furthest cell center.
+	const float chunkRadius = sqrtf(3.0f) * (VOXEL_CHUNK_SIZE - 1) * 0.5f;
+
+	for (int i = StartIdx; i < EndIdx; ++i) {
+		int cX = i % grid->sizeX;
+		int cY = (i / grid->sizeX) % grid->sizeY;
+		int cZ = i / (grid->sizeX * grid->sizeY);
+
+		vec3 center = vec3(cX, cY, cZ) * (float)VOXEL_CHUNK_SIZE + vec3(VOXEL_CHUNK_SIZE * 0.5f);
+		float dist = context->sdf(center, context->userData);
+
+		// NOTE: Assumes the SDF is no steeper than 1 cell per cell.
+		if (dist > chunkRadius + context->band) {
+			(*context->chunkClass)[i] = VCC_OUTSIDE;
+		} else if (dist < -(chunkRadius + context->band)) {
+			(*context->chunkClass)[i] = VCC_INSIDE;
+		} else {
+			(*context->chunkClass)[i] = VCC_SURFACE;
+		}
+	}
+}
+
+void voxelFillThreadBatch(int StartIdx, int EndIdx, void* UserData) {
+	ldiVoxelFillThreadContext* context = (ldiVoxelFillThreadContext*)UserData;
+	ldiVoxelGrid* grid = context->grid;
+
+	for (int chunkIdx = StartIdx; chunkIdx < EndIdx; ++chunkIdx) {
+		ldiVoxelChunk* chunk = grid->rawChunks[chunkIdx];
+		vec3 base = vec3(chunk->x, chunk->y, chunk->z) * (float)VOXEL_CHUNK_SIZE;
+
+		for (int iZ = 0; iZ < VOXEL_CHUNK_SIZE; ++iZ) {
+			for (int iY = 0; iY < VOXEL_CHUNK_SIZE; ++iY) {
+				for (int iX = 0; iX < VOXEL_CHUNK_SIZE; ++iX) {
+					vec3 pos = base + vec3(iX + 0.5f, iY + 0.5f, iZ + 0.5f);
+					chunk->cells[iX + iY * VOXEL_CHUNK_SIZE + iZ * VOXEL_CHUNK_SIZE * VOXEL_CHUNK_SIZE].value = context->sdf(pos, context->userData);
+				}
+			}
+		}
+	}
+}
+
+// Replaces grid contents with the SDF sampled at cell centers. Only chunks within Band of the surface
+// are allocated, chunks fully inside are recorded as solid.
+void voxelFillSdf(ldiVoxelGrid* Grid, ldiVoxelSdfFunc Sdf, void* UserData, float Band = VOXEL_NARROW_BAND) {
+	PROFILE_ZONE("Voxel fill SDF");
+
+	voxelDestroyGrid(Grid);
+
+	const int chunkCount = Grid->sizeX * Grid->sizeY * Grid->sizeZ;
+	std::vector<uint8_t> chunkClass(chunkCount);
+
+	ldiVoxelFillThreadContext tc{};
+	tc.grid = Grid;
+	tc.sdf = Sdf;
+	tc.userData = UserData;
+	tc.band = Band;
+	tc.chunkClass = &chunkClass;
+
+	parallelFor(0, chunkCount, 256, voxelClassifyThreadBatch, &tc);
+
+	for (int i = 0; i < chunkCount; ++i) {
+		int cX = i % Grid->sizeX;
+		int cY = (i / Grid->sizeX) % Grid->sizeY;
+		int cZ = i / (Grid->sizeX * Grid->sizeY);
+
+		if (chunkClass[i] == VCC_SURFACE) {
+			_voxelCreateChunk(Grid, cX, cY, cZ);
+		} else if (chunkClass[i] == VCC_INSIDE) {
+			Grid->solidChunks.insert(voxelGetChunkKey(cX, cY, cZ));
+		}
+	}
+
+	parallelFor(0, (int)Grid->rawChunks.size(), 4, voxelFillThreadBatch, &tc);
+
+	PROFILE_ITEMS((int64_t)Grid->rawChunks.size() * VOXEL_CHUNK_TOTAL);
+}
+
 void voxelPushQuadIndices(ldiModel* Model) {
 	int startIdx = Model->verts.size() - 4;
 	Model->indices.push_back(startIdx + 0);
@@ -557,100 +692,305 @@ const int _cubeEdgeFlags[] = {
 	0xf00, 0xe09, 0xd03, 0xc0a, 0xb06, 0xa0f, 0x905, 0x80c, 0x70c, 0x605, 0x50f, 0x406, 0x30a, 0x203, 0x109, 0x000
 };
 
-void voxelMarch(ldiVoxelGrid* Grid, ldiModel* Model) {
-	// Generate a mesh for each cube.
-	for (int iZ = 0; iZ < Grid->cellSizeZ - 1; ++iZ) {
-		for (int iY = 0; iY < Grid->cellSizeY - 1; ++iY) {
-			for (int iX = 0; iX < Grid->cellSizeX - 1; ++iX) {
-
-				// Build corner data.
-				float cornerValue[8];
-
-				int flagIndex = 0;
-				for (int i = 0; i < 8; ++i) {
-					ivec3 cellPos(iX, iY, iZ);
-					cellPos += _vertexOffsetI[i];
-					cornerValue[i] = 0;
-
-					ldiVoxelCell* cell = voxelGetCell(Grid, cellPos.x, cellPos.y, cellPos.z);
-					if (!cell) {
-						continue;
-					}
+//----------------------------------------------------------------------------------------------------
+// Parallel marching cubes.
+//----------------------------------------------------------------------------------------------------
+// Each chunk marches its own cubes with a local edge cache so vertices are shared inside the chunk.
+// An edge belongs to the chunk that contains its lower endpoint. Edges on a chunk's far faces belong to
+// a neighbour chunk and are stitched to the neighbour's vertex after all chunks are done.
+
+#define VOXEL_MARCH_SIDE (VOXEL_CHUNK_SIZE + 1)
+#define VOXEL_MARCH_EMPTY_EDGE INT_MIN
+
+struct ldiVoxelChunkMesh {
+	std::vector<vec3>						verts;
+	// NOTE: >= 0 is an owned vertex, < 0 is -(foreign edge + 1).
+	std::vector<int>						indices;
+	std::vector<uint64_t>					foreignEdges;
+	std::vector<vec3>						foreignVerts;
+	std::vector<int>						foreignOwnerChunk;
+	std::vector<int>						foreignOwnerVert;
+	// NOTE: Owned vertices on the near faces, sorted by edge key. Neighbours resolve against these.
+	std::vector<std::pair<uint64_t, int>>	boundaryEdges;
+	int										baseVertex;
+	int										baseIndex;
+	int										fallbackVertex;
+	int										unresolvedCount;
+};
+
+struct ldiVoxelMarchThreadContext {
+	ldiVoxelGrid*					grid;
+	std::vector<ldiVoxelChunkMesh>*	meshes;
+	ldiModel*						model;
+};
+
+inline uint64_t _voxelGetEdgeKey(int CellX, int CellY, int CellZ, int Axis) {
+	return ((uint64_t)CellX & 0xFFFFF) | (((uint64_t)CellY & 0xFFFFF) << 20) | (((uint64_t)CellZ & 0xFFFFF) << 40) | ((uint64_t)Axis << 60);
+}
 
-					if (cell->value <= 0.0f) {
-						flagIndex |= 1 << i;
-						cornerValue[i] = cell->value;
+inline int _voxelGetMarchIdx(int X, int Y, int Z) {
+	return X + Y * VOXEL_MARCH_SIDE + Z * VOXEL_MARCH_SIDE * VOXEL_MARCH_SIDE;
+}
+
+void voxelMarchThreadBatch(int StartIdx, int EndIdx, void* UserData) {
+	ldiVoxelMarchThreadContext* context = (ldiVoxelMarchThreadContext*)UserData;
+	ldiVoxelGrid* grid = context->grid;
+
+	float values[VOXEL_MARCH_SIDE * VOXEL_MARCH_SIDE * VOXEL_MARCH_SIDE];
+	int edgeCache[VOXEL_MARCH_SIDE * VOXEL_MARCH_SIDE * VOXEL_MARCH_SIDE * 3];
+
+	// Lower endpoint and axis for each cube edge.
+	ivec3 edgeLower[12];
+	int edgeAxis[12];
+
+	for (int i = 0; i < 12; ++i) {
+		ivec3 a = _vertexOffsetI[_edgeConnection[i][0]];
+		ivec3 b = _vertexOffsetI[_edgeConnection[i][1]];
+		edgeLower[i] = ivec3(min(a.x, b.x), min(a.y, b.y), min(a.z, b.z));
+		edgeAxis[i] = (a.x != b.x) ? 0 : ((a.y != b.y) ? 1 : 2);
+	}
+
+	for (int chunkIdx = StartIdx; chunkIdx < EndIdx; ++chunkIdx) {
+		ldiVoxelChunk* chunk = grid->rawChunks[chunkIdx];
+		ldiVoxelChunkMesh* mesh = &(*context->meshes)[chunkIdx];
+		ivec3 base = ivec3(chunk->x, chunk->y, chunk->z) * VOXEL_CHUNK_SIZE;
+
+		// Gather chunk values plus the first layer of the +X, +Y, +Z neighbours.
+		ldiVoxelChunk* neighbours[8];
+		float unallocatedValue[8];
+
+		for (int n = 0; n < 8; ++n) {
+			int nX = chunk->x + (n & 1);
+			int nY = chunk->y + ((n >> 1) & 1);
+			int nZ = chunk->z + ((n >> 2) & 1);
+
+			neighbours[n] = (n == 0) ? chunk : voxelGetChunkByChunkPos(grid, nX, nY, nZ);
+			unallocatedValue[n] = neighbours[n] ? 0.0f : voxelGetUnallocatedValue(grid, nX, nY, nZ);
+		}
+
+		for (int iZ = 0; iZ < VOXEL_MARCH_SIDE; ++iZ) {
+			for (int iY = 0; iY < VOXEL_MARCH_SIDE; ++iY) {
+				for (int iX = 0; iX < VOXEL_MARCH_SIDE; ++iX) {
+					int n = (iX / VOXEL_CHUNK_SIZE) | ((iY / VOXEL_CHUNK_SIZE) << 1) | ((iZ / VOXEL_CHUNK_SIZE) << 2);
+					float value = unallocatedValue[n];
+
+					if (neighbours[n]) {
+						int lX = iX % VOXEL_CHUNK_SIZE;
+						int lY = iY % VOXEL_CHUNK_SIZE;
+						int lZ = iZ % VOXEL_CHUNK_SIZE;
+						value = neighbours[n]->cells[lX + lY * VOXEL_CHUNK_SIZE + lZ * VOXEL_CHUNK_SIZE * VOXEL_CHUNK_SIZE].value;
 					}
+
+					values[_voxelGetMarchIdx(iX, iY, iZ)] = value;
 				}
+			}
+		}
 
-				int edgeFlags = _cubeEdgeFlags[flagIndex];
+		std::fill(edgeCache, edgeCache + VOXEL_MARCH_SIDE * VOXEL_MARCH_SIDE * VOXEL_MARCH_SIDE * 3, VOXEL_MARCH_EMPTY_EDGE);
 
-				if (edgeFlags == 0) {
-					continue;
-				}
+		for (int iZ = 0; iZ < VOXEL_CHUNK_SIZE; ++iZ) {
+			for (int iY = 0; iY < VOXEL_CHUNK_SIZE; ++iY) {
+				for (int iX = 0; iX < VOXEL_CHUNK_SIZE; ++iX) {
+					int flagIndex = 0;
 
-				vec3 edgeVertex[12];
+					for (int i = 0; i < 8; ++i) {
+						ivec3 p = ivec3(iX, iY, iZ) + _vertexOffsetI[i];
 
-				for (int i = 0; i < 12; ++i) {
-					if ((edgeFlags & (1 << i)) != 0) {
-						// Intersection at mid edge.
-						float offset = 0.5f;
+						if (values[_voxelGetMarchIdx(p.x, p.y, p.z)] <= 0.0f) {
+							flagIndex |= 1 << i;
+						}
+					}
 
-						ivec3 cellPos0 = ivec3(iX, iY, iZ) + _vertexOffsetI[_edgeConnection[i][0]];
-						ivec3 cellPos1 = ivec3(iX, iY, iZ) + _vertexOffsetI[_edgeConnection[i][1]];
+					int edgeFlags = _cubeEdgeFlags[flagIndex];
 
-						ldiVoxelCell* cell0 = voxelGetCell(Grid, cellPos0.x, cellPos0.y, cellPos0.z);
-						ldiVoxelCell* cell1 = voxelGetCell(Grid, cellPos1.x, cellPos1.y, cellPos1.z);
+					if (edgeFlags == 0) {
+						continue;
+					}
 
-						float c0 = 10.0f;
-						float c1 = 10.0f;
+					int edgeVertex[12];
 
-						if (cell0) {
-							c0 = cell0->value;
+					for (int i = 0; i < 12; ++i) {
+						if ((edgeFlags & (1 << i)) == 0) {
+							continue;
 						}
 
-						if (cell1) {
-							c1 = cell1->value;
+						ivec3 l = ivec3(iX, iY, iZ) + edgeLower[i];
+						int axis = edgeAxis[i];
+						int cacheIdx = _voxelGetMarchIdx(l.x, l.y, l.z) * 3 + axis;
+						int vert = edgeCache[cacheIdx];
+
+						if (vert == VOXEL_MARCH_EMPTY_EDGE) {
+							ivec3 dir(0);
+							dir[axis] = 1;
+							ivec3 u = l + dir;
+
+							float c0 = values[_voxelGetMarchIdx(l.x, l.y, l.z)];
+							float c1 = values[_voxelGetMarchIdx(u.x, u.y, u.z)];
+							float delta = c1 - c0;
+							float offset = (delta == 0.0f) ? 0.0f : (0.0f - c0) / delta;
+
+							vec3 pos = (vec3(base + l) + offset * vec3(dir)) * grid->scale;
+							ivec3 cell = base + l;
+							uint64_t key = _voxelGetEdgeKey(cell.x, cell.y, cell.z, axis);
+
+							if (l.x == VOXEL_CHUNK_SIZE || l.y == VOXEL_CHUNK_SIZE || l.z == VOXEL_CHUNK_SIZE) {
+								mesh->foreignEdges.push_back(key);
+								mesh->foreignVerts.push_back(pos);
+								vert = -(int)mesh->foreignEdges.size();
+							} else {
+								vert = (int)mesh->verts.size();
+								mesh->verts.push_back(pos);
+
+								if (l.x == 0 || l.y == 0 || l.z == 0) {
+									mesh->boundaryEdges.push_back({ key, vert });
+								}
+							}
+
+							edgeCache[cacheIdx] = vert;
 						}
 
-						float delta = c1 - c0;
-						offset = (delta == 0.0f) ? 0.0f : (0.0f - c0) / delta;
-
+						edgeVertex[i] = vert;
+					}
 
-						/*if (cell0 && cell0->value != 0.0f) {
-							offset = cell0->value;
-						} else if (cell1 && cell1->value != 0.0f) {
-							offset = 1.0f - (cell1->value);
-						} else {
-							std::cout << "invalid cubing\n";
-							exit(1);
-						}*/
+					for (int i = 0; i < 5; ++i) {
+						if (_triangleConnectionTable[flagIndex][3 * i] < 0) {
+							break;
+						}
 
-						edgeVertex[i] = vec3(iX, iY, iZ) + _vertexOffset[_edgeConnection[i][0]] + offset * _edgeDirection[i];
+						for (int j = 0; j < 3; ++j) {
+							mesh->indices.push_back(edgeVertex[_triangleConnectionTable[flagIndex][3 * i + j]]);
+						}
 					}
 				}
+			}
+		}
 
-				for (int i = 0; i < 5; ++i) {
-					if (_triangleConnectionTable[flagIndex][3 * i] < 0) {
-						break;
-					}
+		std::sort(mesh->boundaryEdges.begin(), mesh->boundaryEdges.end());
+	}
+}
 
-					int idx = (int)Model->verts.size();
+void voxelStitchThreadBatch(int StartIdx, int EndIdx, void* UserData) {
+	ldiVoxelMarchThreadContext* context = (ldiVoxelMarchThreadContext*)UserData;
+	ldiVoxelGrid* grid = context->grid;
+	std::vector<ldiVoxelChunkMesh>* meshes = context->meshes;
 
-					for (int j = 0; j < 3; ++j) {
-						int vert = _triangleConnectionTable[flagIndex][3 * i + j];
+	for (int chunkIdx = StartIdx; chunkIdx < EndIdx; ++chunkIdx) {
+		ldiVoxelChunkMesh* mesh = &(*meshes)[chunkIdx];
+		mesh->foreignOwnerChunk.resize(mesh->foreignEdges.size());
+		mesh->foreignOwnerVert.resize(mesh->foreignEdges.size());
+		mesh->unresolvedCount = 0;
 
-						ldiMeshVertex v;
-						v.pos = edgeVertex[vert] * Grid->scale;
-						v.normal = vec3(0, 1, 0);
-						v.uv = vec2(1, 0);
+		for (size_t i = 0; i < mesh->foreignEdges.size(); ++i) {
+			uint64_t key = mesh->foreignEdges[i];
+			int cellX = (int)(key & 0xFFFFF);
+			int cellY = (int)((key >> 20) & 0xFFFFF);
+			int cellZ = (int)((key >> 40) & 0xFFFFF);
 
-						Model->indices.push_back(idx + j);// + (2 - j));
-						Model->verts.push_back(v);
-					}
+			mesh->foreignOwnerChunk[i] = -1;
+			mesh->foreignOwnerVert[i] = -1;
+
+			auto owner = grid->chunkMap.find(voxelGetChunkKey(cellX / VOXEL_CHUNK_SIZE, cellY / VOXEL_CHUNK_SIZE, cellZ / VOXEL_CHUNK_SIZE));
+
+			if (owner != grid->chunkMap.end()) {
+				std::vector<std::pair<uint64_t, int>>* ownerEdges = &(*meshes)[owner->second].boundaryEdges;
+				auto entry = std::lower_bound(ownerEdges->begin(), ownerEdges->end(), std::pair<uint64_t, int>(key, INT_MIN));
+
+				if (entry != ownerEdges->end() && entry->first == key) {
+					mesh->foreignOwnerChunk[i] = owner->second;
+					mesh->foreignOwnerVert[i] = entry->second;
 				}
 			}
+
+			// NOTE: Should not happen since both chunks see the same values, but keep the vertex unwelded if it does.
+			if (mesh->foreignOwnerChunk[i] == -1) {
+				mesh->foreignOwnerVert[i] = mesh->unresolvedCount++;
+			}
 		}
 	}
+}
+
+void voxelWriteModelThreadBatch(int StartIdx, int EndIdx, void* UserData) {
+	ldiVoxelMarchThreadContext* context = (ldiVoxelMarchThreadContext*)UserData;
+	std::vector<ldiVoxelChunkMesh>* meshes = context->meshes;
+	ldiModel* model = context->model;
+
+	for (int chunkIdx = StartIdx; chunkIdx < EndIdx; ++chunkIdx) {
+		ldiVoxelChunkMesh* mesh = &(*meshes)[chunkIdx];
+
+		ldiMeshVertex v;
+		v.normal = vec3(0, 1, 0);
+		v.uv = vec2(1, 0);
+
+		for (size_t i = 0; i < mesh->verts.size(); ++i) {
+			v.pos = mesh->verts[i];
+			model->verts[mesh->baseVertex + i] = v;
+		}
+
+		for (size_t i = 0; i < mesh->foreignEdges.size(); ++i) {
+			if (mesh->foreignOwnerChunk[i] == -1) {
+				v.pos = mesh->foreignVerts[i];
+				model->verts[mesh->fallbackVertex + mesh->foreignOwnerVert[i]] = v;
+			}
+		}
+
+		for (size_t i = 0; i < mesh->indices.size(); ++i) {
+			int vert = mesh->indices[i];
+			uint32_t globalIdx;
+
+			if (vert >= 0) {
+				globalIdx = mesh->baseVertex + vert;
+			} else {
+				int foreignIdx = -vert - 1;
+				int ownerChunk = mesh->foreignOwnerChunk[foreignIdx];
+
+				if (ownerChunk != -1) {
+					globalIdx = (*meshes)[ownerChunk].baseVertex + mesh->foreignOwnerVert[foreignIdx];
+				} else {
+					globalIdx = mesh->fallbackVertex + mesh->foreignOwnerVert[foreignIdx];
+				}
+			}
+
+			model->indices[mesh->baseIndex + i] = globalIdx;
+		}
+	}
+}
+
+// Appends a welded triangle mesh of the zero isosurface to Model.
+void voxelMarch(ldiVoxelGrid* Grid, ldiModel* Model) {
+	PROFILE_ZONE("Voxel march");
+
+	const int chunkCount = (int)Grid->rawChunks.size();
+	std::vector<ldiVoxelChunkMesh> meshes(chunkCount);
+
+	ldiVoxelMarchThreadContext tc{};
+	tc.grid = Grid;
+	tc.meshes = &meshes;
+	tc.model = Model;
+
+	parallelFor(0, chunkCount, 1, voxelMarchThreadBatch, &tc);
+	parallelFor(0, chunkCount, 16, voxelStitchThreadBatch, &tc);
+
+	// NOTE: Offsets are assigned in chunk order so output is identical for any thread count.
+	int vertCount = (int)Model->verts.size();
+	int indexCount = (int)Model->indices.size();
+
+	for (size_t i = 0; i < meshes.size(); ++i) {
+		meshes[i].baseVertex = vertCount;
+		vertCount += (int)meshes[i].verts.size();
+	}
+
+	for (size_t i = 0; i < meshes.size(); ++i) {
+		meshes[i].fallbackVertex = vertCount;
+		vertCount += meshes[i].unresolvedCount;
+
+		meshes[i].baseIndex = indexCount;
+		indexCount += (int)meshes[i].indices.size();
+	}
+
+	Model->verts.resize(vertCount);
+	Model->indices.resize(indexCount);
+
+	parallelFor(0, chunkCount, 4, voxelWriteModelThreadBatch, &tc);
 
+	PROFILE_ITEMS((int64_t)Grid->rawChunks.size() * VOXEL_CHUNK_TOTAL);
 }
\ No newline at end of file